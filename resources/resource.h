@@ -135,6 +135,29 @@
 #define IDS_SETTING_NAME_SELECT_FLASH_COLOR 217
 #define IDS_SETTING_NAME_COPY_FLASH_TIME 218
 #define IDS_REALLY_PURGE                220
+#define IDS_SETTING_NAME_CACHE_SIZE_AUTO 221
+#define IDS_STATS_SAVED                 222
+#define IDS_SETTING_NAME_SORT_FIELD     223
+#define IDS_SETTING_NAME_SORT_ORDER     224
+#define IDS_ENUM_SORT_FIELD_NAME        225
+#define IDS_ENUM_SORT_FIELD_DATE        226
+#define IDS_ENUM_SORT_FIELD_SIZE        227
+#define IDS_ENUM_SORT_ORDER_ASCENDING   228
+#define IDS_ENUM_SORT_ORDER_DESCENDING  229
+#define IDS_SETTING_NAME_RECURSIVE_SCAN 230
+#define IDS_SETTING_NAME_RECURSIVE_SCAN_DEPTH 231
+#define IDS_ENUM_SORT_FIELD_CAPTURED    232
+#define IDS_ENUM_SORT_FIELD_DIMENSIONS  233
+#define IDS_SETTING_NAME_SHOW_FORMAT    234
+#define IDS_ENUM_SHOW_FORMAT_ALL        235
+#define IDS_ENUM_SHOW_FORMAT_JPEG       236
+#define IDS_ENUM_SHOW_FORMAT_PNG        237
+#define IDS_ENUM_SHOW_FORMAT_GIF        238
+#define IDS_ENUM_SHOW_FORMAT_BMP        239
+#define IDS_ENUM_SHOW_FORMAT_TIFF       240
+#define IDS_ENUM_SHOW_FORMAT_WEBP       241
+#define IDS_ENUM_SHOW_FORMAT_HEIF       242
+#define IDS_ENUM_SHOW_FORMAT_OTHER      243
 #define IDC_TAB_CONTROL                 1001
 #define IDC_SETTINGS_TAB_CONTROL        1001
 #define IDC_LIST_HOTKEYS                1002
@@ -240,13 +263,15 @@
 #define ID_TRANFORM_RESET               40104
 #define IDS_ALL_FILES                   40104
 #define IDS_IMAGE_FILES                 40105
+#define ID_VIEW_DEBUG_OVERLAY           40106
+#define ID_VIEW_DUMP_STATS              40107
 
 // Next default values for new objects
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
-#define _APS_NEXT_RESOURCE_VALUE        221
-#define _APS_NEXT_COMMAND_VALUE         40105
+#define _APS_NEXT_RESOURCE_VALUE        244
+#define _APS_NEXT_COMMAND_VALUE         40108
 #define _APS_NEXT_CONTROL_VALUE         1037
 #define _APS_NEXT_SYMED_VALUE           122
 #endif
@@ -1,9 +0,0 @@
-#include "hlsl.h"
-
-Texture2D mytexture : register(t0);
-SamplerState mysampler : register(s0);
-
-float4 main(vs_out input) : SV_TARGET
-{
-    return mytexture.Sample(mysampler, input.texcoord);
-}
@@ -65,6 +65,9 @@ namespace imageview::app
 
     // GetModuleHandle(null)
     HMODULE instance;
+
+    // file loads, folder scans and parallel pixel stuff
+    thread_pool_t thread_pool;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -75,28 +78,34 @@ namespace
     using namespace DirectX;
 
     using app::window;
+    using app::thread_pool;
 
 #include "shader_inc/vs_rectangle.h"
 #include "shader_inc/ps_texture.h"
-#include "shader_inc/ps_copy_texture.h"
 #include "shader_inc/ps_solid.h"
 #include "shader_inc/ps_stripe.h"
 
     //////////////////////////////////////////////////////////////////////
-    // WM_USER messages for scanner thread
+    // main window timers
 
-    enum scanner_thread_user_message_t : uint
+    enum timer_id_t : UINT_PTR
     {
-        WM_SCAN_FOLDER = WM_USER,    // please scan a folder (lparam -> path)
+        timer_id_cache_governor = 1,       // check system memory and resize the cache budget
+        timer_id_navigation_settle = 2     // key repeat navigation has stopped, load the target
     };
 
-    //////////////////////////////////////////////////////////////////////
-    // WM_USER messages for file_loader thread
+    // how often to check system memory
 
-    enum loader_thread_user_message_t : uint
-    {
-        WM_LOAD_FILE = WM_USER    // please load this file (lparam -> filepath)
-    };
+    uint constexpr cache_governor_interval_ms = 2000;
+
+    // cursor moves closer together than this are coalesced (key auto-repeat)
+
+    double constexpr navigation_repeat_seconds = 0.15;
+
+    // load the coalesced target if there are no more moves for this long (or on key up)
+    // it has to be longer than the repeat time or slow auto-repeat would settle on every step
+
+    uint constexpr navigation_settle_ms = static_cast<uint>(navigation_repeat_seconds * 1000) + 50;
 
     //////////////////////////////////////////////////////////////////////
     // types of WM_COPYDATA messages that can be sent
@@ -204,12 +213,17 @@ namespace
     //////////////////////////////////////////////////////////////////////
     // files which have been loaded
 
-    std::unordered_map<std::wstring, image::image_file *> loaded_files;
+    std::unordered_map<file::id_t, image::image_file *, file::id_hash> loaded_files;
 
     //////////////////////////////////////////////////////////////////////
     // files which have been requested to load
 
-    std::unordered_map<std::wstring, image::image_file *> loading_files;
+    std::unordered_map<file::id_t, image::image_file *, file::id_hash> loading_files;
+
+    // loads which finished after the window had gone, freed at exit
+
+    std::mutex orphaned_files_mutex;
+    std::vector<image::image_file *> orphaned_files;
 
     //////////////////////////////////////////////////////////////////////
 
@@ -227,11 +241,20 @@ namespace
     // dummy image file for showing the clipboard
     image::image_file clipboard_image_file;
 
-    // folder scanner thread id so we can PostMessage to it
-    uint scanner_thread_id{ (uint)-1 };
+    // scans can finish out of order, only the most recent one is wanted
+    uint folder_scan_id{ 0 };
+
+    // set to cancel the most recent scan, the job holds a reference so it's closed by whichever finishes last
+    std::shared_ptr<void> folder_scan_cancel_event;
 
-    // file loading happens in this thread
-    uint file_loader_thread_id{ (uint)-1 };
+    // file loading happens on these threads, most important first
+    scheduler::load_scheduler file_scheduler;
+
+    // cache hit rate, load latencies and evictions
+    telemetry::cache_metrics metrics;
+
+    // show the cache metrics in the top left
+    bool show_debug_overlay{ false };
 
     // set this to signal that the application is exiting
     // all threads should quit asap when this is set
@@ -240,6 +263,9 @@ namespace
     // which image currently being displayed (which might be that dodgy clipboard one)
     image::image_file *current_file{ null };
 
+    // the current file changed on disk so it's not in the cache any more, delete it when it's replaced
+    image::image_file *stale_current_file{ null };
+
     // wait on this before sending a message to the window which must arrive safely
     HANDLE window_created_event{ null };
 
@@ -258,6 +284,30 @@ namespace
     uint64 cache_in_use{ 0 };
     std::mutex cache_mutex;
 
+    // loaded files ordered by how much we'd like to keep them
+    cache::eviction_queue cache_queue;
+
+    // decides how big the cache can be
+    cache::governor cache_governor;
+
+    // which way (-1, 0, 1) the user last moved through the folder
+    int navigation_direction{ 0 };
+
+    // decides how many files around the current one to prefetch
+    cache::prefetch_estimator prefetch;
+
+    // time between cursor moves
+    timer_t navigation_timer;
+
+    // cursor has moved but the file there hasn't been loaded yet (coalescing)
+    bool navigation_pending{ false };
+
+    // key whose WM_KEYDOWN is being translated into a command, 0 if it's not a key
+    uint command_key{ 0 };
+
+    // key which did the last navigation (0 for menus etc), releasing it settles the navigation
+    uint navigation_key{ 0 };
+
     // how many times WM_SHOWWINDOW (because startup hassle)
     int window_show_count{ 0 };
 
@@ -285,8 +335,6 @@ namespace
     bool s_in_suspend = false;
     bool s_minimized = false;
 
-    thread_pool_t thread_pool;
-
     //////////////////////////////////////////////////////////////////////
     // shader constants header is shared with the HLSL files
 
@@ -321,13 +369,16 @@ namespace
     ComPtr<ID3D11PixelShader> solid_shader;
     ComPtr<ID3D11PixelShader> stripe_shader;
 
-    ComPtr<ID3D11PixelShader> copy_texture_shader;
-
     ComPtr<ID3D11VertexShader> vertex_shader;
 
     ComPtr<ID3D11ShaderResourceView> image_texture_view;
     ComPtr<ID3D11Texture2D> image_texture;
 
+    // sharper pixels for the part of the image that's on screen when it had to be shrunk to fit in a texture
+
+    ComPtr<ID3D11ShaderResourceView> detail_texture_view;
+    ComPtr<ID3D11Texture2D> detail_texture;
+
     ComPtr<ID3D11SamplerState> sampler_state;
     ComPtr<ID3D11Buffer> constant_buffer;
     ComPtr<ID3D11RasterizerState> rasterizer_state;
@@ -406,6 +457,45 @@ namespace
     // frame/wall timer for animation
     timer_t app_timer;
 
+    // what was drawn in the last frame, kept to save reallocating the overlays every time
+    software_renderer::frame_t current_frame;
+
+    // detail_texture is this bit of the image (0..1 in the texture) at this scale of the full size image
+
+    rect_f detail_uv{ 0, 0, 0, 0 };
+    float detail_scale{ 0 };
+
+    // and its pixels, which the software renderer draws from
+    std::vector<byte> detail_pixels;
+    image::image_t detail_image{};
+
+    // results for any other request are for an image which has gone
+
+    uint detail_request_id{ 0 };
+    bool detail_request_pending{ false };
+    bool detail_failed{ false };
+
+    // a region decoded on a worker
+
+    struct detail_region_t
+    {
+        uint request_id;
+        rect_f uv;
+        float scale;
+        std::vector<byte> pixels;
+        image::image_t img;
+        HRESULT hr;
+    };
+
+    // never reset, for the frame scheduler
+    timer_t frame_timer;
+
+    // when to draw frames
+    frame_scheduler_t frames;
+
+    // messages start fading out this far (0..1) through their fade time (see draw_text_overlays)
+    double constexpr message_fade_start = 0.75;
+
     // timer for flashing when copy
     timer_t copy_flash_timer;
 
@@ -415,6 +505,11 @@ namespace
     // when was the selection copied for animating flash
     double copy_timestamp{ 0 };
 
+    // copies are put in the clipboard on workers, only the latest one
+    // the mutex keeps the workers out of each other's way, the main thread just bumps the id
+    std::mutex clipboard_mutex;
+    std::atomic<uint> clipboard_copy_id{ 0 };
+
     HCURSOR current_mouse_cursor;
 
     // which frame rendering
@@ -476,15 +571,30 @@ namespace
     };
 
     HRESULT show_image(image::image_file *f);
+    HRESULT do_folder_scan(std::wstring const &file_path,
+                           uint scan_id,
+                           file::scan_folder_sort_field sort_field,
+                           file::scan_folder_sort_order order,
+                           image::format_t format,
+                           uint max_depth,
+                           HANDLE cancel_event);
+    void resort_files();
+    void start_metadata_indexer();
 
     //////////////////////////////////////////////////////////////////////
     // set the banner message and how long before it fades out
 
     void set_message(std::wstring const &message, int fade_time)
     {
+        // the app timer only moves on when a frame is drawn, which might have been a while ago
+
+        app_timer.update();
+
         current_message = message;
         message_timestamp = app_timer.wall_time();
         message_fade_time = fade_time;
+
+        frames.invalidate();
     }
 
     //////////////////////////////////////////////////////////////////////
@@ -504,6 +614,7 @@ namespace
         if(f == null) {
             return E_INVALIDARG;
         }
+        frames.invalidate();
         select_active = false;
 
         HRESULT load_hr = f->hresult;
@@ -532,131 +643,365 @@ namespace
     }
 
     //////////////////////////////////////////////////////////////////////
-    // get size of file + decoded image for cache
+    // make a new image_file to be loaded, it goes in loading_files until it arrives
 
-    HRESULT get_image_file_size(std::wstring const &filename, uint64 *size)
+    image::image_file *new_file_loader(std::wstring const &filename,
+                                       file::id_t const &id,
+                                       int index,
+                                       bool is_cache_load)
     {
-        if(size == null || filename.empty()) {
-            return E_INVALIDARG;
+        image::image_file *f = new image::image_file();
+        f->filename = filename;
+        f->id = id;
+        f->index = index;
+        f->is_cache_load = is_cache_load;
+        f->cancel_event = CreateEventW(null, true, false, null);
+        loading_files[id] = f;
+        return f;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // cancel a file load, it's removed from loading_files right away so
+    // a new request for the same file will start a fresh load
+
+    void cancel_file_load(image::image_file *f)
+    {
+        LOG_DEBUG(L"Cancel loading {} ({})", f->filename, f->index);
+
+        if(f->cancel_event != null) {
+            SetEvent(f->cancel_event);
         }
+        loading_files.erase(f->id);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // how many files around the current one to prefetch
 
-        uint64 file_size;
+    int prefetch_depth()
+    {
+        int decoders = thread_pool.worker_count() - scheduler::load_scheduler::max_reads;
+        return prefetch.depth(cache_governor.budget(), decoders);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // how much is held where, for the debug overlay and stats dump
 
-        CHK_HR(file::get_size(filename, file_size));
+    telemetry::resident_t get_resident()
+    {
+        telemetry::resident_t r;
 
-        uint32 w, h;
-        uint64 image_size;
+        for(auto const &l : loaded_files) {
+            r.files_cached += 1;
+            r.file_bytes += l.second->bytes.size();
+            r.pixel_bytes += l.second->pixels.size();
+        }
+        r.files_loading = static_cast<int>(loading_files.size());
 
-        CHK_HR(image::get_size(filename, w, h, image_size));
+        // full mip chain is another third
+        r.texture_bytes = static_cast<uint64>(actual_texture_width) * actual_texture_height * 4 * 4 / 3;
 
-        *size = (size_t)image_size + file_size;
+        r.budget = cache_governor.budget();
+        return r;
+    }
 
-        return S_OK;
+    //////////////////////////////////////////////////////////////////////
+    // cancel any loads which are outside the prefetch window around `cursor`
+    // (except the one which has been asked for)
+
+    void cancel_unwanted_loads(int cursor)
+    {
+        std::vector<int> window;
+
+        if(current_folder_scan != null) {
+            cache::get_prefetch_order(
+                cursor, navigation_direction, (int)current_folder_scan->files.size(), prefetch_depth(), window);
+        }
+        std::sort(window.begin(), window.end());
+
+        std::vector<image::image_file *> unwanted;
+
+        for(auto const &l : loading_files) {
+
+            image::image_file *f = l.second;
+
+            if(f == requested_file || (f->index != -1 && f->index == cursor)) {
+                continue;
+            }
+
+            if(f->index == -1 || !std::binary_search(window.begin(), window.end(), f->index)) {
+                unwanted.push_back(f);
+            }
+        }
+
+        for(auto f : unwanted) {
+            cancel_file_load(f);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // read a file, this is the first stage of a load on the file_scheduler
+
+    void file_read_job(image::image_file *fl)
+    {
+        LOG_CONTEXT("file_loader");
+
+        // it might have been cancelled while it was in the queue
+
+        if(WaitForSingleObject(fl->cancel_event, 0) == WAIT_OBJECT_0) {
+            fl->hresult = E_ABORT;
+            return;
+        }
+
+        // load the file synchronously to this thread
+        fl->hresult = file::load(fl->filename, fl->bytes, fl->cancel_event);
     }
 
     //////////////////////////////////////////////////////////////////////
-    // kick off a file loader thread
+    // decode a file which has been read, second stage
 
-    void start_file_loader(image::image_file *loader)
+    void file_decode_job(image::image_file *fl)
     {
-        thread_pool.create_thread(
-            [](image::image_file *fl) {
+        LOG_CONTEXT("file_loader");
 
-                LOG_CONTEXT("file_loader");
+        if(WaitForSingleObject(fl->cancel_event, 0) == WAIT_OBJECT_0) {
+            fl->hresult = E_ABORT;
+            return;
+        }
 
-                // load the file synchronously to this thread
-                fl->hresult = file::load(fl->filename, fl->bytes, quit_event);
+        // Need to call this in any thread which uses Windows Imaging Component
+        (void)CoInitializeEx(null, COINIT_APARTMENTTHREADED);
 
-                if(SUCCEEDED(fl->hresult)) {
+        // decode the image
+        fl->hresult = image::decode(fl, fl->cancel_event);
 
-                    // Need to call this in any thread which uses Windows Imaging Component
-                    (void)CoInitializeEx(null, COINIT_APARTMENTTHREADED);
+        CoUninitialize();
+    }
 
-                    // decode the image
-                    fl->hresult = image::decode(fl);
+    //////////////////////////////////////////////////////////////////////
+    // let the window know, either way, that the file load attempt is complete, failed or
+    // otherwise
 
-                    CoUninitialize();
-                }
+    void file_load_done(image::image_file *fl)
+    {
+        WaitForSingleObject(window_created_event, INFINITE);
+
+        if(!PostMessageW(window, app::WM_FILE_LOAD_COMPLETE, 0, reinterpret_cast<LPARAM>(fl))) {
+            std::lock_guard lock(orphaned_files_mutex);
+            orphaned_files.push_back(fl);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // throw a file out of the cache
+
+    void evict_file(image::image_file *f)
+    {
+        LOG_DEBUG(L"Removing {} ({}) from cache (now {} MB in use)", f->filename, f->index, cache_in_use / 1048576);
 
-                // let the window know, either way, that the file load attempt is complete, failed or
-                // otherwise
-                WaitForSingleObject(window_created_event, INFINITE);
-                PostMessageW(window, app::WM_FILE_LOAD_COMPLETE, 0, reinterpret_cast<LPARAM>(fl));
-            },
-            loader);
+        int distance = -1;
+        if(f->index != -1 && current_file_cursor != -1) {
+            distance = abs(f->index - current_file_cursor);
+        }
+        metrics.add_eviction(f->filename, distance, f->total_size());
+
+        cache_queue.remove(f);
+        cache_in_use -= f->total_size();
+        loaded_files.erase(f->id);
+        delete f;
     }
 
     //////////////////////////////////////////////////////////////////////
-    // warm the cache by loading N files either side of the current one
+    // warm the cache by loading N files around the current one, more of
+    // them in the direction of travel
 
     HRESULT warm_cache()
     {
         // if it's a normal file in the current folder
-        if(current_file != null && !current_file->is_clipboard && current_file->index != -1) {
+        if(current_file == null || current_file->is_clipboard || current_file->index == -1) {
+            return S_OK;
+        }
+
+        // and they're not flicking through the folder
+        if(navigation_pending) {
+            return S_OK;
+        }
+
+        int cursor = current_file->index;
 
-            int const num_images_to_cache = 12;
+        cancel_unwanted_loads(cursor);
 
-            for(int i = 0; i < num_images_to_cache; ++i) {
+        cache_queue.set_cursor(cursor, navigation_direction);
 
-                int y = current_file->index - (i + 2) / 2 * ((i & 1) * 2 - 1);
+        std::vector<int> indices;
+        cache::get_prefetch_order(
+            cursor, navigation_direction, (int)current_folder_scan->files.size(), prefetch_depth(), indices);
 
-                if(y >= 0 && y < (int)current_folder_scan->files.size()) {
+        uint64 cache_size = cache_governor.budget();
 
-                    std::wstring this_file = current_folder_scan->path + L"\\" + current_folder_scan->files[y].name;
+        for(int y : indices) {
 
-                    if(loading_files.find(this_file) == loading_files.end() &&
-                       loaded_files.find(this_file) == loaded_files.end()) {
+            std::wstring this_file = current_folder_scan->path + L"\\" + current_folder_scan->files[y].name;
 
-                        // remove things from cache until it's <= cache_size + required size
+            // the next one in the direction of travel goes ahead of the rest
 
-                        uint64 img_size;
-                        if(SUCCEEDED(get_image_file_size(this_file, &img_size))) {
+            scheduler::priority_t priority = scheduler::priority_speculative;
+            if(cache::score(y, cursor, navigation_direction) <= cache::ahead_weight) {
+                priority = scheduler::priority_next;
+            }
 
-                            size_t cache_size = settings.cache_size_mb * 1048576llu;
+            file::id_t this_id = current_folder_scan->file_id(y);
 
-                            while((cache_in_use + img_size) > cache_size) {
+            auto loading = loading_files.find(this_id);
+            if(loading != loading_files.end()) {
+                file_scheduler.promote(loading->second, priority);
+                continue;
+            }
 
-                                image::image_file *loser = null;
-                                uint loser_diff = 0;
-                                for(auto const &fl : loaded_files) {
-                                    uint diff = std::abs(fl.second->index - current_file_cursor);
-                                    if(diff > loser_diff) {
-                                        loser_diff = diff;
-                                        loser = fl.second;
-                                    }
-                                }
+            if(loaded_files.find(this_id) != loaded_files.end()) {
+                continue;
+            }
 
-                                if(loser != null) {
+            // a guess from the size the folder scan found, opening each file to read the
+            // header here would stall the ui thread for every candidate
 
-                                    LOG_DEBUG(L"Removing {} ({}) from cache (now {} MB in use)",
-                                              loser->filename,
-                                              loser->index,
-                                              cache_in_use / 1048576);
+            uint64 img_size = prefetch.cache_size(current_folder_scan->files[y].size);
 
-                                    cache_in_use -= loser->total_size();
-                                    loaded_files.erase(loser->filename);
-                                } else {
-                                    break;
-                                }
-                            }
+            // remove things from cache until it's <= cache_size + required size, but
+            // never throw out something which is worth more than the thing being loaded
 
-                            if((cache_in_use + img_size) <= cache_size) {
+            int this_score = cache::score(y, cursor, navigation_direction);
 
-                                LOG_DEBUG(L"Caching {} at {}", this_file, y);
-                                image::image_file *cache_file = new image::image_file();
-                                cache_file->filename = this_file;
-                                cache_file->is_cache_load = true;
-                                loading_files[this_file] = cache_file;
-                                start_file_loader(cache_file);
-                            }
-                        }
-                    }
+            while((cache_in_use + img_size) > cache_size) {
+
+                image::image_file *loser = cache_queue.worst();
+
+                if(loser == null || loser == current_file || cache_queue.get_score(loser) <= this_score) {
+                    break;
                 }
+                evict_file(loser);
+            }
+
+            // indices are in order of value so if this one doesn't fit, nothing after it should be loaded
+
+            if((cache_in_use + img_size) > cache_size) {
+                break;
             }
+
+            LOG_DEBUG(L"Caching {} at {}", this_file, y);
+            file_scheduler.add(new_file_loader(this_file, this_id, y, true), priority);
         }
         return S_OK;
     }
 
+    //////////////////////////////////////////////////////////////////////
+    // throw things out of the cache until it fits in the budget
+
+    void trim_cache()
+    {
+        uint64 cache_size = cache_governor.budget();
+
+        while(cache_in_use > cache_size) {
+
+            image::image_file *loser = cache_queue.worst();
+
+            if(loser == null || loser == current_file) {
+                break;
+            }
+            evict_file(loser);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // ask the governor how big the cache should be now
+
+    void update_cache_budget()
+    {
+        uint64 manual_budget = settings.cache_size_mb * 1048576llu;
+
+        if(cache_governor.update(cache_in_use, settings.cache_size_auto, manual_budget)) {
+            trim_cache();
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // file order from the settings, the enums line up
+
+    file::scan_folder_sort_field get_sort_field()
+    {
+        return static_cast<file::scan_folder_sort_field>(settings.sort_field);
+    }
+
+    file::scan_folder_sort_order get_sort_order()
+    {
+        return static_cast<file::scan_folder_sort_order>(settings.sort_order);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // which type of file to show, none for all of them (the enums line up)
+
+    image::format_t get_format_filter()
+    {
+        return static_cast<image::format_t>(settings.show_format);
+    }
+
+    // should a file go in a list limited to `format_filter`
+
+    bool passes_format_filter(std::wstring const &name, uint32 format_filter)
+    {
+        auto format = static_cast<image::format_t>(format_filter);
+        return format == image::format_t::none || image::get_format(name.data(), name.size()) == format;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // how many levels of subfolders to scan
+
+    uint get_scan_depth()
+    {
+        return settings.recursive_scan ? settings.recursive_scan_depth : 0;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void cancel_folder_scan()
+    {
+        if(folder_scan_cancel_event != null) {
+            SetEvent(folder_scan_cancel_event.get());
+            folder_scan_cancel_event.reset();
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // scan a folder on the thread pool, any scan already going is cancelled (and ignored if it reports back)
+    // the sort settings are read here because settings belong to the main thread
+
+    HRESULT start_folder_scan(std::wstring const &file_path)
+    {
+        // whatever was going on in the old folder is of no interest now
+
+        folder_watcher::stop();
+        metadata_indexer::stop();
+        cancel_folder_scan();
+
+        HANDLE event;
+        CHK_NULL(event = CreateEvent(null, true, false, null));
+        folder_scan_cancel_event = std::shared_ptr<void>(event, CloseHandle);
+
+        folder_scan_id += 1;
+
+        uint scan_id = folder_scan_id;
+
+        file::scan_folder_sort_field sort_field = get_sort_field();
+        file::scan_folder_sort_order order = get_sort_order();
+        image::format_t format = get_format_filter();
+        uint max_depth = get_scan_depth();
+
+        std::shared_ptr<void> cancel_event = folder_scan_cancel_event;
+
+        return thread_pool.add_job([file_path, scan_id, sort_field, order, format, max_depth, cancel_event]() {
+            do_folder_scan(file_path, scan_id, sort_field, order, format, max_depth, cancel_event.get());
+        });
+    }
+
     //////////////////////////////////////////////////////////////////////
     // load an image file or get it from the cache (or notice that it's
     // already being loaded and just let it arrive later)
@@ -667,6 +1012,13 @@ namespace
             return E_INVALIDARG;
         }
 
+        // this supersedes any coalesced navigation
+
+        if(navigation_pending) {
+            navigation_pending = false;
+            KillTimer(window, timer_id_navigation_settle);
+        }
+
         // get somewhat canonical filepath and parts thereof
 
         std::wstring folder;
@@ -683,12 +1035,40 @@ namespace
             folder.pop_back();
         }
 
+        // if it's the one the cursor is on, we know where it is in the folder already
+        // (names in the scan can include subfolders so compare the whole path)
+
+        int index = -1;
+        if(current_folder_scan != null && current_file_cursor != -1 &&
+           current_file_cursor < (int)current_folder_scan->files.size()) {
+
+            std::wstring const &cursor_name = current_folder_scan->files[current_file_cursor].name;
+            std::wstring cursor_path = std::format(L"{}\\{}", current_folder_scan->path, cursor_name);
+
+            if(_wcsicmp(cursor_path.c_str(), fullpath.c_str()) == 0) {
+                index = current_file_cursor;
+            }
+        }
+
+        // the cache is keyed on file identity so different paths to the same file find it
+
+        file::id_t id;
+        if(index != -1) {
+            id = current_folder_scan->file_id(index);
+        } else {
+            HRESULT hr = file::get_id(fullpath, id);
+            if(FAILED(hr)) {
+                set_message(std::format(L"{} {}", fullpath, windows_error_message(hr)), 5);
+                return hr;
+            }
+        }
+
         // if it's in the cache already, just show it
-        // TODO (chs): make this file path compare canonical
 
-        auto found = loaded_files.find(fullpath);
+        auto found = loaded_files.find(id);
         if(found != loaded_files.end()) {
             LOG_DEBUG(L"Already got {}", name);
+            metrics.hits += 1;
             CHK_HR(display_image(found->second));
             CHK_HR(warm_cache());
             return S_OK;
@@ -701,10 +1081,14 @@ namespace
 
         // if it's currently being loaded, mark it for viewing when it arrives
 
-        found = loading_files.find(fullpath);
+        found = loading_files.find(id);
         if(found != loading_files.end()) {
             LOG_DEBUG(L"In progress {}", name);
+            metrics.joins += 1;
             requested_file = found->second;
+            requested_file->load_timer.reset();
+            file_scheduler.promote(requested_file, scheduler::priority_visible);
+            cancel_unwanted_loads(requested_file->index);
             return S_OK;
         }
 
@@ -714,41 +1098,40 @@ namespace
         // file_loader object is later transferred from loading_files to loaded_files
 
         LOG_INFO(L"Loading {}", name);
+        metrics.misses += 1;
 
-        image::image_file *fl = new image::image_file();
-        fl->filename = fullpath;
-        loading_files[fullpath] = fl;
+        image::image_file *fl = new_file_loader(fullpath, id, index, false);
 
         // when this file arrives, please display it
 
         requested_file = fl;
 
-        // ask the loader thread to load it
+        // and stop loading things which aren't wanted any more so they're not competing with it
+        // (if it's not in the current folder, that's everything else)
 
-        PostThreadMessage(file_loader_thread_id, WM_LOAD_FILE, 0, reinterpret_cast<LPARAM>(fl));
+        cancel_unwanted_loads(index);
 
-        // if it's coming from a new folder
+        // queue it ahead of any speculative loads
+
+        file_scheduler.add(fl, scheduler::priority_visible);
+
+        // if it's coming from a new folder (files in subfolders of the current scan aren't)
 
         bool is_new_folder;
         CHK_HR(file::paths_are_different(current_folder, folder, is_new_folder));
 
-        if(is_new_folder) {
+        if(is_new_folder && index == -1) {
 
             // if(_stricmp(current_folder.c_str(), folder.c_str()) != 0) {
 
-            // tell the scanner thread to scan this new folder
+            // scan this new folder on the thread pool
             // when it's done it will notify main thread with a windows message
 
             // TODO(chs): CLEAR THE CACHE HERE....
 
             current_folder = folder;
 
-            // sigh, manually marshall the filename for the message, the receiver is responsible for
-            // freeing it
-            wchar *fullpath_buffer = new wchar[fullpath.size() + 1];
-            memcpy(fullpath_buffer, fullpath.c_str(), (fullpath.size() + 1) * sizeof(wchar));
-
-            PostThreadMessageW(scanner_thread_id, WM_SCAN_FOLDER, 0, reinterpret_cast<LPARAM>(fullpath_buffer));
+            CHK_HR(start_folder_scan(fullpath));
         }
         return S_OK;
     }
@@ -855,6 +1238,33 @@ namespace
         return S_OK;
     }
 
+    //////////////////////////////////////////////////////////////////////
+    // subfolder or file type settings changed, scan again from the folder of the file being shown
+
+    void update_folder_scan()
+    {
+        if(current_folder_scan == null) {
+            return;
+        }
+
+        if(current_folder_scan->depth == get_scan_depth() &&
+           current_folder_scan->format_filter == static_cast<uint32>(get_format_filter())) {
+            return;
+        }
+
+        std::wstring file_path = current_folder_scan->path + L"\\";
+
+        if(current_file != null && !current_file->is_clipboard) {
+            std::wstring folder;
+            if(SUCCEEDED(file::get_path(current_file->filename, folder))) {
+                file_path = current_file->filename;
+                current_folder = folder;
+            }
+        }
+
+        start_folder_scan(file_path);
+    }
+
     //////////////////////////////////////////////////////////////////////
     // new settings have arrived, update stuff which isn't automatically
     // picked up by the renderer
@@ -862,6 +1272,9 @@ namespace
     void on_new_settings()
     {
         setup_window_text();
+        update_cache_budget();
+        resort_files();
+        update_folder_scan();
     }
 
     //////////////////////////////////////////////////////////////////////
@@ -992,30 +1405,13 @@ namespace
     }
 
     //////////////////////////////////////////////////////////////////////
-    //
-    // copy_selection_to_texture
-    //
-    // This is all rather involved due to the idiotic decision to keep
-    // the original image untransformed and apply transformations (flip/rotate)
-    // when drawing it so we have to 'untransform' the selection rectangle, then
-    // copy the resulting piece, then apply the transform back to the copied bit.
-    // Most of which could be avoided by just modifying the image when
-    // flip/rotate are applied. But... hey ho, who knows what strange problems
-    // that might entail...
+    // where a pixel of the view (the flipped/rotated image) is in the image's pixels
+    // this is what get_texture_transform does when the image is drawn
 
-    HRESULT copy_selection_to_texture(ID3D11Texture2D **texture)
+    POINT view_to_image_pixel(POINT p)
     {
-        vec2 t = vec2(sub_point(POINT{ texture_width, texture_height }, { 1, 1 }));
-
-        vec2 tl{ 0, 0 };
-        vec2 br{ static_cast<float>(texture_width) - 1, static_cast<float>(texture_height) - 1 };
-
-        if(select_active) {
-            tl = select_anchor;
-            br = select_current;
-        }
-
-        // unfsck the selection rect
+        LONG tx = texture_width - 1;
+        LONG ty = texture_height - 1;
 
         bool fh = flip_horiz;
         bool fv = flip_vert;
@@ -1025,204 +1421,107 @@ namespace
         }
 
         if(fh) {
-            tl.x = t.x - tl.x;
-            br.x = t.x - br.x;
+            p.x = tx - p.x;
         }
 
         if(fv) {
-            tl.y = t.y - tl.y;
-            br.y = t.y - br.y;
+            p.y = ty - p.y;
         }
 
         switch(rotation) {
 
         case rotate_90:
-            tl = { tl.y, t.x - tl.x };
-            br = { br.y, t.x - br.x };
+            p = { p.y, tx - p.x };
             break;
 
         case rotate_180:
-            tl = { t.x - tl.x, t.y - tl.y };
-            br = { t.x - br.x, t.y - br.y };
+            p = { tx - p.x, ty - p.y };
             break;
 
         case rotate_270:
-            tl = { t.y - tl.y, tl.x };
-            br = { t.y - br.y, br.x };
+            p = { ty - p.y, p.x };
             break;
         }
+        return p;
+    }
 
-        vec2 ntl = vec2::min(tl, br);
-        vec2 nbr = vec2::max(tl, br);
+    //////////////////////////////////////////////////////////////////////
+    // cut the selection (or the whole image if there isn't one) out of the current image's pixels,
+    // flipped and rotated the way it's being viewed
+    // no gpu involved, the rows are copied on the thread pool
 
-        tl = ntl;
-        br = nbr;
+    HRESULT get_selection_pixels(std::vector<byte> &pixels, image::image_t &img)
+    {
+        if(current_file == null || !current_file->is_decoded()) {
+            return E_NOT_VALID_STATE;
+        }
 
-        // 1. Copy region into a texture
+        POINT tl{ 0, 0 };
+        POINT br{ texture_width - 1, texture_height - 1 };
 
-        // TODO (chs): transform the selection by some version of current flip/rotate matrix
+        if(select_active) {
 
-        D3D11_BOX copy_box;
-        copy_box.left = (int)tl.x;
-        copy_box.right = std::min(actual_texture_width, (int)br.x + 1);
-        copy_box.top = (int)tl.y;
-        copy_box.bottom = std::min(actual_texture_height, (int)br.y + 1);
-        copy_box.back = 1;
-        copy_box.front = 0;
+            vec2 a = vec2::min(select_anchor, select_current);
+            vec2 b = vec2::max(select_anchor, select_current);
 
-        int copy_w = copy_box.right - copy_box.left;
-        int copy_h = copy_box.bottom - copy_box.top;
+            tl = { std::max(0l, static_cast<LONG>(a.x)), std::max(0l, static_cast<LONG>(a.y)) };
+            br = { std::min(br.x, static_cast<LONG>(b.x)), std::min(br.y, static_cast<LONG>(b.y)) };
+        }
 
-        if(copy_w < 1 || copy_h < 1) {
+        if(br.x < tl.x || br.y < tl.y) {
             return E_BOUNDS;
         }
 
-        D3D11_TEXTURE2D_DESC desc;
-        image_texture->GetDesc(&desc);
+        uint w = static_cast<uint>(br.x - tl.x + 1);
+        uint h = static_cast<uint>(br.y - tl.y + 1);
 
-        desc.Width = copy_w;
-        desc.Height = copy_h;
-        desc.MipLevels = 1;
-        desc.ArraySize = 1;
-        desc.SampleDesc.Count = 1;
-        desc.SampleDesc.Quality = 0;
-        desc.Usage = D3D11_USAGE_DEFAULT;
-        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-        desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-        desc.MiscFlags = 0;
+        // one pixel right and one pixel down in the view, where are those in the image
 
-        ComPtr<ID3D11Texture2D> tex;
-        CHK_HR(d3d_device->CreateTexture2D(&desc, null, &tex));
-        D3D_SET_NAME(tex);
+        POINT origin = view_to_image_pixel(tl);
+        POINT right = view_to_image_pixel({ tl.x + 1, tl.y });
+        POINT down = view_to_image_pixel({ tl.x, tl.y + 1 });
 
-        d3d_context->CopySubresourceRegion(tex.Get(), 0, 0, 0, 0, image_texture.Get(), 0, &copy_box);
+        POINT x_step{ right.x - origin.x, right.y - origin.y };
+        POINT y_step{ down.x - origin.x, down.y - origin.y };
 
-        // get dimensions of source texture
+        pixels.resize(static_cast<size_t>(w) * 4 * h);
 
-        D3D11_TEXTURE2D_DESC source_desc;
+        img = { pixels.data(), w, h, w * 4 };
 
-        tex->GetDesc(&source_desc);
+        CHK_HR(pixel_convert::extract(current_file->img, origin, x_step, y_step, img));
 
-        // swap w/h if rotated 90/270 degrees
-
-        uint w = source_desc.Width;
-        uint h = source_desc.Height;
-
-        if(rotation == rotate_90 || rotation == rotate_270) {
-            std::swap(w, h);
-        }
-
-        // create staging texture for grabbing it into
-
-        ComPtr<ID3D11Texture2D> staging_texture;
-
-        CD3D11_TEXTURE2D_DESC staging_texture_desc(
-            DXGI_FORMAT_B8G8R8A8_UNORM, w, h, 1, 1, 0, D3D11_USAGE_STAGING, D3D11_CPU_ACCESS_READ);
+        return S_OK;
+    }
 
-        CHK_HR(d3d_device->CreateTexture2D(&staging_texture_desc, null, staging_texture.GetAddressOf()));
+    //////////////////////////////////////////////////////////////////////
+    // put some pixels in the clipboard as CF_DIBV5, CF_DIB and PNG
+    // this is called on a worker thread, copy_id says whether it's still the most recent copy
 
-        // create dest texture and rtv
+    HRESULT copy_pixels_to_clipboard(image::image_t const &img, uint copy_id)
+    {
+        std::lock_guard lock(clipboard_mutex);
 
-        CD3D11_TEXTURE2D_DESC texture_desc(
-            DXGI_FORMAT_B8G8R8A8_UNORM, w, h, 1, 1, D3D11_BIND_RENDER_TARGET, D3D11_USAGE_DEFAULT, 0);
+        if(copy_id != clipboard_copy_id) {
+            return S_FALSE;
+        }
 
-        ComPtr<ID3D11Texture2D> tex_2d;
+        int w = img.width;
+        int h = img.height;
 
-        CHK_HR(d3d_device->CreateTexture2D(&texture_desc, null, tex_2d.GetAddressOf()));
+        size_t pixel_size = 4llu;
+        size_t pixel_buffer_size = pixel_size * (size_t)w * h;
 
-        ComPtr<ID3D11RenderTargetView> rtv_2d;
+        // create CF_DIBV5 clipformat
 
-        CD3D11_RENDER_TARGET_VIEW_DESC rtv_desc(D3D11_RTV_DIMENSION_TEXTURE2D, DXGI_FORMAT_B8G8R8A8_UNORM);
-
-        CHK_HR(d3d_device->CreateRenderTargetView(tex_2d.Get(), &rtv_desc, rtv_2d.GetAddressOf()));
-
-        // create srv for source texture
-
-        CD3D11_SHADER_RESOURCE_VIEW_DESC srv_desc(tex.Get(), D3D11_SRV_DIMENSION_TEXTURE2D, DXGI_FORMAT_B8G8R8A8_UNORM);
-
-        ComPtr<ID3D11ShaderResourceView> srv;
-        CHK_HR(d3d_device->CreateShaderResourceView(tex.Get(), &srv_desc, srv.GetAddressOf()));
-
-        // setup query so we know when the copy is finished
-
-        // CD3D11_QUERY_DESC query_desc(D3D11_QUERY_EVENT);
-        // ComPtr<ID3D11Query> query;
-
-        // CHK_HR(d3d_device->CreateQuery(&query_desc, query.GetAddressOf()));
-
-        // copy it
-
-        CD3D11_VIEWPORT viewport(tex_2d.Get(), rtv_2d.Get());
-
-        d3d_context->OMSetRenderTargets(1, rtv_2d.GetAddressOf(), null);
-        d3d_context->RSSetViewports(1, &viewport);
-        d3d_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-        d3d_context->VSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
-        d3d_context->VSSetShader(vertex_shader.Get(), null, 0);
-        d3d_context->PSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
-        d3d_context->PSSetShader(copy_texture_shader.Get(), null, 0);
-        d3d_context->PSSetShaderResources(0, 1, srv.GetAddressOf());
-        d3d_context->PSSetSamplers(0, 1, sampler_state.GetAddressOf());
-        d3d_context->RSSetState(rasterizer_state.Get());
-        d3d_context->OMSetBlendState(null, null, 0xffffffff);
-
-        shader.texture_transform = get_texture_transform();
-
-        draw_rectangle({ 0, 0, static_cast<float>(w), static_cast<float>(h) }, viewport);
-
-        // d3d_context->End(query.Get());
-
-        // uint32 query_result;
-
-        // while(d3d_context->GetData(query.Get(), &query_result, sizeof(uint32), 0) != S_OK) {
-        //    // Sleep(0);
-        //}
-
-        d3d_context->CopyResource(staging_texture.Get(), tex_2d.Get());
-
-        *texture = staging_texture.Detach();
-
-        return S_OK;
-    }
-
-    //////////////////////////////////////////////////////////////////////
-    // copy the current selection into clipboard as a DIBV5
-
-    HRESULT copy_selection()
-    {
-        ComPtr<ID3D11Texture2D> tex;
-        CHK_HR(copy_selection_to_texture(tex.GetAddressOf()));
-
-        D3D11_TEXTURE2D_DESC desc;
-        tex->GetDesc(&desc);
-
-        int w = desc.Width;
-        int h = desc.Height;
-
-        // copy the pixels
-
-        D3D11_MAPPED_SUBRESOURCE mapped_resource{};
-        CHK_HR(d3d_context->Map(tex.Get(), 0, D3D11_MAP_READ, 0, &mapped_resource));
-        DEFER(d3d_context->Unmap(tex.Get(), 0));
-
-        uint32 pitch = mapped_resource.RowPitch;
-
-        size_t pixel_size = 4llu;
-        size_t pixel_buffer_size = pixel_size * (size_t)w * h;
-
-        byte *src = reinterpret_cast<byte *>(mapped_resource.pData);
-
-        // create CF_DIBV5 clipformat
-
-        size_t dibv5_buffer_size = sizeof(BITMAPV5HEADER) + pixel_buffer_size;
-        HANDLE dibv5_data = GlobalAlloc(GHND | GMEM_SHARE, dibv5_buffer_size);
-        if(dibv5_data == null) {
-            return HRESULT_FROM_WIN32(ERROR_OUTOFMEMORY);
-        }
-        byte *dibv5_buffer = reinterpret_cast<byte *>(GlobalLock(dibv5_data));
-        if(dibv5_buffer == null) {
-            return HRESULT_FROM_WIN32(GetLastError());
-        }
+        size_t dibv5_buffer_size = sizeof(BITMAPV5HEADER) + pixel_buffer_size;
+        HANDLE dibv5_data = GlobalAlloc(GHND | GMEM_SHARE, dibv5_buffer_size);
+        if(dibv5_data == null) {
+            return HRESULT_FROM_WIN32(ERROR_OUTOFMEMORY);
+        }
+        byte *dibv5_buffer = reinterpret_cast<byte *>(GlobalLock(dibv5_data));
+        if(dibv5_buffer == null) {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
 
         BITMAPV5HEADER *bmiv5 = reinterpret_cast<BITMAPV5HEADER *>(dibv5_buffer);
         mem_clear(bmiv5);
@@ -1242,26 +1541,9 @@ namespace
 
         byte *pixels = dibv5_buffer + sizeof(BITMAPV5HEADER);
 
-        // copy into the DIB for the clipboard, swapping R, B channels
-        byte *row = pixels;
-        for(int y = 0; y < h; ++y) {
-            uint32 *s = reinterpret_cast<uint32 *>(src);
-            uint32 *d = reinterpret_cast<uint32 *>(row);
-            for(int x = 0; x < w; ++x) {
-                uint32 p = *s++;
-                uint32 r = (p >> 0) & 0xff;
-                uint32 g = (p >> 8) & 0xff;
-                uint32 b = (p >> 16) & 0xff;
-                uint32 a = (p >> 24) & 0xff;
-                r <<= 0;
-                g <<= 8;
-                b <<= 16;
-                a <<= 24;
-                *d++ = a | b | g | r;
-            }
-            src += pitch;
-            row += w * 4llu;
-        }
+        // the pixels are BGRA which is what the masks say
+
+        pixel_convert::copy_bgra(img, pixels, w * 4);
 
         GlobalUnlock(dibv5_data);
 
@@ -1293,23 +1575,7 @@ namespace
 
         byte *dib_pixels = dib_buffer + sizeof(BITMAPINFOHEADER);
 
-        byte *dib_row = dib_pixels;
-        byte *dib_src = reinterpret_cast<byte *>(mapped_resource.pData);
-        for(int y = 0; y < h; ++y) {
-            uint32 *s = reinterpret_cast<uint32 *>(dib_src);
-            byte *d = dib_row;
-            for(int x = 0; x < w; ++x) {
-                uint32 p = *s++;
-                byte r = (p >> 0) & 0xff;
-                byte g = (p >> 8) & 0xff;
-                byte b = (p >> 16) & 0xff;
-                *d++ = r;
-                *d++ = g;
-                *d++ = b;
-            }
-            dib_src += mapped_resource.RowPitch;
-            dib_row += stride;
-        }
+        pixel_convert::bgra_to_bgr(img, dib_pixels, stride);
 
         GlobalUnlock(dib_data);
 
@@ -1325,27 +1591,40 @@ namespace
             CHK_BOOL(SetClipboardData(CF_DIB, dib_data));
         }
 
-        // encoding a PNG into the clipboard take ages for big images
-        // so do it in a separate thread to avoid an even more massive stall
+        // encoding a PNG takes ages for big images, the DIBs are available while it's going
+        // and there's no point if another copy has come along in the meantime
 
-        auto pixels_copy = std::make_shared<byte[]>(pixel_buffer_size);
-        memcpy(pixels_copy.get(), pixels, pixel_buffer_size);
+        if(copy_id != clipboard_copy_id) {
+            return S_FALSE;
+        }
 
-        std::thread(
-            [](std::shared_ptr<byte[]> pixels_buffer, int w, int h) {
+        CHK_HR(image::copy_pixels_as_png(img.pixels, w, h));
 
-                // returning an error does nothing here but at least it can be logged
-                CHK_HR(image::copy_pixels_as_png(pixels_buffer.get(), w, h));
-                return S_OK;
+        return S_OK;
+    }
 
-            },
-            pixels_copy,
-            w,
-            h)
-            .detach();
+    //////////////////////////////////////////////////////////////////////
+    // copy the current selection into clipboard
+    // the pixels are cut out here, the clipboard stuff is done on a worker which owns them
+
+    HRESULT copy_selection()
+    {
+        auto pixels = std::make_shared<std::vector<byte>>();
+        image::image_t img;
+
+        CHK_HR(get_selection_pixels(*pixels, img));
+
+        uint copy_id = ++clipboard_copy_id;
+
+        CHK_HR(thread_pool.add_job([pixels, img, copy_id]() {
+
+            // returning an error does nothing here but at least it can be logged
+            CHK_HR(copy_pixels_to_clipboard(img, copy_id));
+            return S_OK;
+        }));
 
         // TODO (chs): localize 'x'
-        set_message(std::format(L"{} {}x{}", localize(IDS_COPIED), w, h), 3);
+        set_message(std::format(L"{} {}x{}", localize(IDS_COPIED), img.width, img.height), 3);
 
         copy_flashing = true;
         copy_flash_timer.reset();
@@ -1459,6 +1738,27 @@ namespace
         return add_point(current_rect.top_left(), texels_to_pixels(vec2::floor(pos)));
     }
 
+    //////////////////////////////////////////////////////////////////////
+    // window pixel pos to texture coordinates (0..1 across the actual texture) the way vs_rectangle does it
+    // texture pos above is in the flipped/rotated image, this isn't
+
+    vec2 screen_to_uv(vec2 pos)
+    {
+        vec2 p = div_point(sub_point(pos, current_rect.top_left()), current_rect.size());
+        XMVECTOR uv = XMVector4Transform(XMVectorSet(p.x, p.y, 0, 1), get_texture_transform());
+        return { XMVectorGetX(uv), XMVectorGetY(uv) };
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // and back
+
+    vec2 uv_to_screen(vec2 uv)
+    {
+        matrix m = XMMatrixInverse(null, get_texture_transform());
+        XMVECTOR p = XMVector4Transform(XMVectorSet(uv.x, uv.y, 0, 1), m);
+        return add_point(current_rect.top_left(), mul_point({ XMVectorGetX(p), XMVectorGetY(p) }, current_rect.size()));
+    }
+
     //////////////////////////////////////////////////////////////////////
     // set the current mouse cursor
 
@@ -1743,11 +2043,6 @@ namespace
         CHK_HR(d3d_device->CreatePixelShader(ps_texture_bin, sizeof(ps_texture_bin), null, &texture_shader));
         D3D_SET_NAME(texture_shader);
 
-        CHK_HR(d3d_device->CreatePixelShader(
-            ps_copy_texture_bin, sizeof(ps_copy_texture_bin), null, &copy_texture_shader));
-
-        D3D_SET_NAME(copy_texture_shader);
-
         CHK_HR(d3d_device->CreatePixelShader(ps_stripe_bin, sizeof(ps_stripe_bin), null, &stripe_shader));
         D3D_SET_NAME(stripe_shader);
 
@@ -2002,145 +2297,821 @@ namespace
     }
 
     //////////////////////////////////////////////////////////////////////
-    // scan a folder - this runs in the folder_scanner_thread
-    // results are sent to the main thread with SendMessage
-
-    HRESULT do_folder_scan(wchar const *folder_path)
+    // scan a folder - this runs on the thread pool
+    // results are sent to the main thread with SendMessage, big folders in batches
+
+    HRESULT do_folder_scan(std::wstring const &file_path,
+                           uint scan_id,
+                           file::scan_folder_sort_field sort_field,
+                           file::scan_folder_sort_order order,
+                           image::format_t format,
+                           uint max_depth,
+                           HANDLE cancel_event)
     {
         LOG_CONTEXT("folder_scan");
 
-        std::wstring path;
+        (void)CoInitializeEx(null, COINIT_APARTMENTTHREADED);
+        DEFER(CoUninitialize());
 
-        CHK_HR(file::get_path(folder_path, path));
+        std::wstring path;
 
-        delete[] folder_path;
+        CHK_HR(file::get_path(file_path, path));
 
         LOG_INFO(L"Scan folder {}", path);
 
-        file::scan_folder_sort_field sort_field = file::scan_folder_sort_field::name;
-        file::scan_folder_sort_order order = file::scan_folder_sort_order::ascending;
+        auto send = [scan_id](file::folder_scan_result *results) {
+            WaitForSingleObject(window_created_event, INFINITE);
+            SendMessage(window, app::WM_FOLDER_SCAN_COMPLETE, scan_id, reinterpret_cast<LPARAM>(results));
+        };
+
+        // if there's an up to date saved index, send that right away and rescan in the background
+        // to catch anything the change stamp doesn't (files being modified in place)
+        // the stamp doesn't see changes in subfolders so recursive scans aren't saved
+
+        uint32 format_filter = static_cast<uint32>(format);
+
+        uint64 change_stamp = 0;
+        bool have_stamp = max_depth == 0 && SUCCEEDED(folder_index::get_change_stamp(path, change_stamp));
 
-        file::folder_scan_result *results;
+        bool sent_index = false;
 
-        CHK_HR(scan_folder(path, sort_field, order, &results, quit_event));
+        if(have_stamp) {
+            file::folder_scan_result *index;
+            if(SUCCEEDED(folder_index::load(path, change_stamp, sort_field, order, format_filter, &index))) {
+                index->complete = false;
+                send(index);
+                sent_index = true;
+            }
+        }
 
         // send the results to the window, it will forward them to the app
-        WaitForSingleObject(window_created_event, INFINITE);
-        SendMessage(window, app::WM_FOLDER_SCAN_COMPLETE, 0, reinterpret_cast<LPARAM>(results));
+        // partial results are no use if the index has been sent already
+
+        // the files of other types are dropped here, except the one being opened so there's
+        // somewhere to step from
+
+        std::wstring opened = file_path.substr(file_path.find_last_of(L'\\') + 1);
+
+        auto send_results = [&](file::folder_scan_result *results) {
+            if(!results->complete) {
+                if(sent_index) {
+                    delete results;
+                    return;
+                }
+            } else if(have_stamp) {
+                results->change_stamp = change_stamp;    // main thread saves it once the metadata is in
+            }
+            results->format_filter = format_filter;
+            if(format != image::format_t::none) {
+                results->filter([&](file::info const &f) {
+                    return passes_format_filter(f.name, format_filter) || _wcsicmp(f.name.c_str(), opened.c_str()) == 0;
+                });
+            }
+            send(results);
+        };
+
+        HRESULT hr = scan_folder(path, sort_field, order, max_depth, send_results, cancel_event);
+
+        if(hr == E_ABORT) {
+            LOG_DEBUG(L"Scan of {} cancelled", path);
+            return hr;
+        }
+        CHK_HR(hr);
 
         return S_OK;
     }
 
     //////////////////////////////////////////////////////////////////////
-    // file_loader_thread waits for file load requests and kicks off
-    // threads for each one
+    // if loaded file is in the current folder, find index with list of files
 
-    void file_loader_function()
+    HRESULT update_file_index(image::image_file *f)
     {
-        MSG msg;
+        if(current_folder_scan == null || f == null || f->is_clipboard) {
+            return E_INVALIDARG;
+        }
 
-        // respond to requests from main thread, quit if quit_event gets set
-        while(MsgWaitForMultipleObjects(1, &quit_event, false, INFINITE, QS_POSTMESSAGE) != WAIT_OBJECT_0) {
-            if(PeekMessage(&msg, null, 0, 0, PM_REMOVE) != 0) {
-                switch(msg.message) {
-                case WM_LOAD_FILE:
-                    start_file_loader(reinterpret_cast<image::image_file *>(msg.lParam));
-                    break;
-                }
+        if(f->id.volume != current_folder_scan->volume) {
+            return E_CHANGED_STATE;
+        }
+
+        int i = current_folder_scan->find_id(f->id.index);
+
+        if(i == -1) {
+            return E_NOT_SET;
+        }
+
+        f->index = i;
+        LOG_DEBUG(L"{} is at index {}", f->filename, i);
+        if(current_file_cursor == -1) {
+            current_file_cursor = f->index;
+        }
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // the file list changed, find where all the cached files are in it now
+
+    void reindex_files()
+    {
+        auto reindex = [&](image::image_file *f) {
+            f->index = -1;
+            if(f->id.volume == current_folder_scan->volume) {
+                f->index = current_folder_scan->find_id(f->id.index);
             }
+        };
+
+        for(auto const &l : loaded_files) {
+            reindex(l.second);
+        }
+
+        for(auto const &l : loading_files) {
+            reindex(l.second);
+        }
+
+        if(current_file != null && !current_file->is_clipboard) {
+            reindex(current_file);
         }
-        LOG_INFO(L"File loader thread exit");
     }
 
     //////////////////////////////////////////////////////////////////////
-    // file_scanner_thread waits for scan requests and processes them
-    // in this thread
+    // folder scan complete (or a batch of results from a big one)
 
-    void scanner_function()
+    void on_folder_scanned(file::folder_scan_result *scan_result, uint scan_id)
     {
-        LOG_CONTEXT("folder_scan");
+        if(scan_id != folder_scan_id) {
+            LOG_DEBUG(L"Ignoring stale scan of {}", scan_result->path);
+            delete scan_result;
+            return;
+        }
 
-        CoInitialize(null);
+        LOG_INFO(L"{} images found in {}{}",
+                 scan_result->files.size(),
+                 scan_result->path,
+                 scan_result->complete ? L"" : L" so far");
 
-        bool quit = false;
-        MSG msg;
+        // a later batch is a superset of the previous one in a new order, keep the cursor on the same file
 
-        // respond to requests from main thread
-        while(!quit) {
-            switch(MsgWaitForMultipleObjects(1, &quit_event, false, INFINITE, QS_POSTMESSAGE | QS_ALLPOSTMESSAGE)) {
-            case WAIT_OBJECT_0:
-                quit = true;
-                break;
-            case WAIT_OBJECT_0 + 1:
-                if(GetMessage(&msg, null, 0, 0) != 0) {
-                    switch(msg.message) {
+        bool have_cursor = current_folder_scan != null && current_file_cursor >= 0 &&
+                           current_file_cursor < (int)current_folder_scan->files.size();
+
+        file::id_t cursor_id;
+        if(have_cursor) {
+            cursor_id = current_folder_scan->file_id(current_file_cursor);
+        }
+
+        // keep any metadata which has been read already for files which haven't changed
+
+        bool got_metadata = false;
 
-                    case WM_SCAN_FOLDER:
-                        do_folder_scan(reinterpret_cast<wchar const *>(msg.lParam));
-                        break;
+        if(current_folder_scan != null && current_folder_scan->path == scan_result->path) {
+
+            for(auto &f : scan_result->files) {
+
+                int i = current_folder_scan->find_id(f.index);
+
+                if(i != -1) {
+                    file::info const &old = current_folder_scan->files[i];
+                    if(old.has_metadata && !f.has_metadata && old.date == f.date && old.size == f.size) {
+                        f.capture_date = old.capture_date;
+                        f.width = old.width;
+                        f.height = old.height;
+                        f.has_metadata = true;
+                        got_metadata = true;
                     }
-                    break;
                 }
             }
         }
-        LOG_INFO(L"Scanner thread exit");
+
+        current_folder_scan.reset(scan_result);
+
+        // the sort settings might have changed since the scan started, or it was sorted without the metadata
+
+        if(scan_result->sort_field != get_sort_field() || scan_result->sort_order != get_sort_order() ||
+           (got_metadata && file::sort_needs_metadata(scan_result->sort_field))) {
+
+            scan_result->sort(get_sort_field(), get_sort_order());
+        }
+
+        reindex_files();
+
+        int cursor = -1;
+
+        if(have_cursor && cursor_id.volume == scan_result->volume) {
+            cursor = scan_result->find_id(cursor_id.index);
+        }
+
+        // the cursor can be ahead of the current file while navigation is being coalesced
+
+        if(cursor == -1 || !navigation_pending) {
+            if(current_file != null && current_file->index != -1) {
+                cursor = current_file->index;
+            }
+        }
+        current_file_cursor = cursor;
+
+        // once it's all there, keep it up to date
+
+        if(scan_result->complete) {
+
+            auto post_changes = [scan_id](folder_watcher::folder_changes *changes) {
+                if(!PostMessage(window, app::WM_FOLDER_CHANGED, scan_id, reinterpret_cast<LPARAM>(changes))) {
+                    delete changes;
+                }
+            };
+
+            HRESULT hr = folder_watcher::start(scan_result->path, scan_result->depth != 0, post_changes);
+            if(FAILED(hr)) {
+                LOG_ERROR(L"Can't watch {}: {}", scan_result->path, windows_error_message(hr));
+            }
+
+            start_metadata_indexer();
+        }
+
+        cache_queue.set_cursor(current_file_cursor, navigation_direction);
+
+        warm_cache();
     }
 
     //////////////////////////////////////////////////////////////////////
-    // if loaded file is in the current folder, find index with list of files
+    // sort the current file list according to the settings, keeping the cursor on the same file
 
-    HRESULT update_file_index(image::image_file *f)
+    void sort_current_folder()
     {
-        if(current_folder_scan == null || f == null) {
-            return E_INVALIDARG;
+        file::folder_scan_result &scan = *current_folder_scan;
+
+        int num_files = static_cast<int>(scan.files.size());
+
+        bool have_cursor = current_file_cursor >= 0 && current_file_cursor < num_files;
+
+        uint64 cursor_index = 0;
+        if(have_cursor) {
+            cursor_index = scan.files[current_file_cursor].index;
         }
-        std::wstring folder;
-        CHK_HR(file::get_path(f->filename, folder));
 
-        if(_wcsicmp(folder.c_str(), current_folder_scan->path.c_str()) != 0) {
-            return E_CHANGED_STATE;
+        scan.sort(get_sort_field(), get_sort_order());
+
+        reindex_files();
+
+        if(have_cursor) {
+            current_file_cursor = scan.find_id(cursor_index);
         }
 
-        std::wstring name;
-        CHK_HR(file::get_filename(f->filename, name));
-        int id = 0;
-        for(auto &ff : current_folder_scan->files) {
-            if(_wcsicmp(ff.name.c_str(), name.c_str()) == 0) {
-                f->index = id;
-                LOG_DEBUG(L"{} is at index {}", name, id);
-                if(current_file_cursor == -1) {
-                    current_file_cursor = f->index;
+        cache_queue.set_cursor(current_file_cursor, navigation_direction);
+
+        warm_cache();
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // sort settings changed, put the current file list in the new order
+
+    void resort_files()
+    {
+        if(current_folder_scan == null) {
+            return;
+        }
+
+        if(current_folder_scan->sort_field != get_sort_field() || current_folder_scan->sort_order != get_sort_order()) {
+            sort_current_folder();
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // save the current file list (with whatever metadata it's got) so it opens quickly next time
+    // it's copied so the saving can happen on the thread pool
+
+    void save_folder_index()
+    {
+        if(current_folder_scan == null || current_folder_scan->change_stamp == 0 ||
+           current_folder_scan->files.size() < folder_index::min_files) {
+            return;
+        }
+
+        auto scan = std::make_shared<file::folder_scan_result>(*current_folder_scan);
+
+        thread_pool.add_job([scan]() { folder_index::save(*scan, scan->change_stamp); });
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // read the metadata of any files in the current folder which don't have it yet
+
+    void start_metadata_indexer()
+    {
+        std::vector<metadata_indexer::file_t> files;
+
+        for(auto const &f : current_folder_scan->files) {
+            if(!f.has_metadata) {
+                files.push_back({ f.index, f.name });
+            }
+        }
+
+        // it's started even if they've all got it, so the watcher has something to add files to
+
+        if(files.empty()) {
+            save_folder_index();
+        }
+
+        uint scan_id = folder_scan_id;
+
+        auto post_results = [scan_id](metadata_indexer::results_t *results) {
+            if(!PostMessage(window, app::WM_METADATA_INDEXED, scan_id, reinterpret_cast<LPARAM>(results))) {
+                delete results;
+            }
+        };
+
+        HRESULT hr = metadata_indexer::start(current_folder_scan->path, std::move(files), post_results);
+        if(FAILED(hr)) {
+            LOG_ERROR(L"Can't index {}: {}", current_folder_scan->path, windows_error_message(hr));
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // forget the detail texture and ignore any request which is in flight
+
+    void clear_detail()
+    {
+        detail_texture.Reset();
+        detail_texture_view.Reset();
+        detail_pixels.clear();
+        detail_image = {};
+        detail_request_id += 1;
+        detail_request_pending = false;
+        detail_failed = false;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // where the detail texture is on the screen
+
+    rect_f get_detail_rect()
+    {
+        return rect_f(uv_to_screen(detail_uv.top_left()), uv_to_screen(detail_uv.bottom_right()));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // if the image was shrunk to fit in a texture and it's zoomed in past that, decode the bit
+    // that's on screen from the file at the size it's being drawn (up to 1:1)
+    // called when the view has stopped moving
+
+    void update_detail()
+    {
+        image::image_file *f = current_file;
+
+        if(f == null || f->is_clipboard || !f->is_decoded() || image_texture.Get() == null) {
+            return;
+        }
+
+        if(f->full_width <= f->img.width || texture_width == 0) {
+            return;
+        }
+
+        // screen pixels per texel, no need for it unless the texture is being stretched
+
+        float zoom = current_rect.w / texture_width;
+
+        if(zoom <= 1.0f) {
+            detail_texture.Reset();
+            detail_texture_view.Reset();
+            detail_pixels.clear();
+            detail_image = {};
+            return;
+        }
+
+        float scale = std::min(1.0f, zoom * f->img.width / f->full_width);
+
+        // the visible part of the image
+
+        vec2 a = screen_to_uv({ 0, 0 });
+        vec2 b = screen_to_uv(window_size());
+
+        vec2 zero{ 0, 0 };
+        vec2 one{ 1, 1 };
+
+        vec2 tl = vec2::clamp(zero, vec2::min(a, b), one);
+        vec2 br = vec2::clamp(zero, vec2::max(a, b), one);
+
+        if(tl.x >= br.x || tl.y >= br.y) {
+            return;
+        }
+
+        // got it already?
+
+        if(detail_texture.Get() != null && detail_scale >= scale * 0.99f) {
+
+            vec2 dtl = detail_uv.top_left();
+            vec2 dbr = detail_uv.bottom_right();
+
+            if(tl.x >= dtl.x && tl.y >= dtl.y && br.x <= dbr.x && br.y <= dbr.y) {
+                return;
+            }
+        }
+
+        if(detail_request_pending || detail_failed) {
+            return;
+        }
+
+        // get a bit more than is visible so a small drag doesn't need another one
+
+        vec2 margin = mul_point(sub_point(br, tl), { 0.25f, 0.25f });
+
+        tl = vec2::clamp(zero, sub_point(tl, margin), one);
+        br = vec2::clamp(zero, add_point(br, margin), one);
+
+        float fw = static_cast<float>(f->full_width);
+        float fh = static_cast<float>(f->full_height);
+
+        RECT rect{ static_cast<LONG>(floorf(tl.x * fw)),
+                   static_cast<LONG>(floorf(tl.y * fh)),
+                   static_cast<LONG>(ceilf(br.x * fw)),
+                   static_cast<LONG>(ceilf(br.y * fh)) };
+
+        if(rect.right <= rect.left || rect.bottom <= rect.top) {
+            return;
+        }
+
+        // where the whole pixels are in the texture
+
+        rect_f uv{ rect.left / fw, rect.top / fh, (rect.right - rect.left) / fw, (rect.bottom - rect.top) / fh };
+
+        std::wstring filename = f->filename;
+        uint request_id = detail_request_id;
+
+        LOG_DEBUG(L"Detail for {} at {:.3f}: {},{} - {},{}",
+                  filename,
+                  scale,
+                  rect.left,
+                  rect.top,
+                  rect.right,
+                  rect.bottom);
+
+        HRESULT hr = thread_pool.add_job([=]() {
+
+            // Need to call this in any thread which uses Windows Imaging Component
+            (void)CoInitializeEx(null, COINIT_APARTMENTTHREADED);
+
+            auto region = new detail_region_t{ request_id, uv, scale, {}, {}, S_OK };
+
+            region->hr = image::decode_region(filename, rect, scale, region->pixels, region->img);
+
+            CoUninitialize();
+
+            if(!PostMessageW(window, app::WM_REGION_DECODED, 0, reinterpret_cast<LPARAM>(region))) {
+                delete region;
+            }
+        });
+
+        detail_request_pending = SUCCEEDED(hr);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a detail region arrived, maybe for an image which isn't being shown any more
+
+    void on_region_decoded(detail_region_t *region)
+    {
+        std::unique_ptr<detail_region_t> r(region);
+
+        if(r->request_id != detail_request_id) {
+            return;
+        }
+
+        detail_request_pending = false;
+
+        if(FAILED(r->hr)) {
+
+            // don't keep trying
+
+            LOG_ERROR(L"Can't decode detail: {}", windows_error_message(r->hr));
+            detail_failed = true;
+            return;
+        }
+
+        ComPtr<ID3D11Texture2D> new_texture;
+        ComPtr<ID3D11ShaderResourceView> new_srv;
+
+        HRESULT hr = create_texture(d3d_device.Get(), d3d_context.Get(), &new_texture, &new_srv, r->img, {});
+
+        if(FAILED(hr)) {
+            detail_failed = true;
+            return;
+        }
+
+        detail_texture.Attach(new_texture.Detach());
+        detail_texture_view.Attach(new_srv.Detach());
+
+        D3D_SET_NAME(detail_texture);
+        D3D_SET_NAME(detail_texture_view);
+
+        detail_uv = r->uv;
+        detail_scale = r->scale;
+
+        // moving the vector keeps the same buffer so img still points at it
+
+        detail_pixels = std::move(r->pixels);
+        detail_image = r->img;
+
+        frames.invalidate();
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // some metadata arrived, if the files are sorted by it they need sorting again
+
+    void on_metadata_indexed(metadata_indexer::results_t *results, uint scan_id)
+    {
+        DEFER(delete results);
+
+        if(scan_id != folder_scan_id || current_folder_scan == null) {
+            return;
+        }
+
+        file::folder_scan_result &scan = *current_folder_scan;
+
+        for(auto const &r : results->files) {
+
+            int i = scan.find_id(r.index);
+
+            if(i != -1) {
+                file::info &f = scan.files[i];
+                f.capture_date = r.metadata.capture_date;
+                f.width = r.metadata.width;
+                f.height = r.metadata.height;
+                f.has_metadata = true;
+            }
+        }
+
+        if(file::sort_needs_metadata(scan.sort_field)) {
+            sort_current_folder();
+        }
+
+        if(results->complete) {
+            save_folder_index();
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a file was added to or removed from the folder at `from`, move the indices after it
+
+    void shift_file_indices(int from, int delta)
+    {
+        auto shift = [=](image::image_file *f) {
+            if(f->index >= from) {
+                f->index += delta;
+            }
+        };
+
+        for(auto const &l : loaded_files) {
+            shift(l.second);
+        }
+
+        for(auto const &l : loading_files) {
+            shift(l.second);
+        }
+
+        if(current_file_cursor >= from) {
+            current_file_cursor += delta;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // set the index of a file in the cache (or being loaded)
+
+    void set_file_index(file::id_t const &id, int index)
+    {
+        auto loaded = loaded_files.find(id);
+        if(loaded != loaded_files.end()) {
+            loaded->second->index = index;
+        }
+
+        auto loading = loading_files.find(id);
+        if(loading != loading_files.end()) {
+            loading->second->index = index;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // throw away anything cached or loading for a file which has changed on disk
+    // the one being shown is taken out of the cache but kept until its replacement
+    // arrives, returns true if that happened
+
+    bool forget_file(file::id_t const &id)
+    {
+        bool forgot_current = false;
+
+        auto loaded = loaded_files.find(id);
+        if(loaded != loaded_files.end()) {
+
+            image::image_file *f = loaded->second;
+
+            if(f == current_file) {
+
+                cache_queue.remove(f);
+                cache_in_use -= f->total_size();
+                loaded_files.erase(loaded);
+
+                if(stale_current_file != null) {
+                    delete stale_current_file;
                 }
-                return S_OK;
+                stale_current_file = f;
+                forgot_current = true;
+
+            } else {
+                evict_file(f);
             }
-            id += 1;
         }
-        return E_NOT_SET;
+
+        auto loading = loading_files.find(id);
+        if(loading != loading_files.end() && loading->second != requested_file) {
+            cancel_file_load(loading->second);
+        }
+        return forgot_current;
     }
 
     //////////////////////////////////////////////////////////////////////
-    // folder scan complete
+    // apply a batch of changes from the folder watcher to the file list
+    // finding where each one goes is a binary search (when sorted by name)
 
-    void on_folder_scanned(file::folder_scan_result *scan_result)
+    void on_folder_changed(folder_watcher::folder_changes *changes, uint watch_id)
     {
-        LOG_INFO(L"{} images found in {}", scan_result->files.size(), scan_result->path);
+        DEFER(delete changes);
 
-        current_folder_scan.reset(scan_result);
+        if(watch_id != folder_scan_id || current_folder_scan == null) {
+            return;
+        }
+
+        file::folder_scan_result &scan = *current_folder_scan;
 
-        if(current_file != null && current_file->index == -1) {
-            update_file_index(current_file);
+        // lost track, start again
+
+        if(changes->overflow) {
+            start_folder_scan(scan.path + L"\\");
+            return;
         }
 
+        bool reload_current = false;
+        bool rescan = false;
+        std::vector<metadata_indexer::file_t> need_metadata;    // added or changed, the indexer hasn't seen them
+
+        for(auto const &c : changes->changes) {
+
+            int pos = scan.find(c.name);
+
+            // subfolders are watched all the way down, but only files within the scan depth are wanted
+
+            if(static_cast<uint>(std::count(c.name.begin(), c.name.end(), L'\\')) > scan.depth) {
+                continue;
+            }
+
+            // a subfolder went away (or was renamed), it's simplest to scan again
+
+            if(pos == -1 && scan.depth != 0 && c.action == folder_watcher::action_t::removed) {
+
+                std::wstring prefix = c.name + L"\\";
+
+                rescan = std::any_of(scan.files.begin(), scan.files.end(), [&](file::info const &f) {
+                    return _wcsnicmp(f.name.c_str(), prefix.c_str(), prefix.size()) == 0;
+                });
+
+                if(rescan) {
+                    break;
+                }
+            }
+
+            switch(c.action) {
+
+            case folder_watcher::action_t::added:
+                if(pos == -1 && passes_format_filter(c.name, scan.format_filter)) {
+                    pos = scan.insert(file::info(c.name, c.date, c.size, c.index));
+                    shift_file_indices(pos, 1);
+
+                    // a rename is removed + added with the same id, anything cached for it is still good
+
+                    file::id_t id = scan.file_id(pos);
+                    set_file_index(id, pos);
+
+                    std::wstring filename = std::format(L"{}\\{}", scan.path, c.name);
+
+                    auto loaded = loaded_files.find(id);
+                    if(loaded != loaded_files.end()) {
+                        loaded->second->filename = filename;
+                    }
+
+                    if(current_file != null && current_file->id == id) {
+                        current_file->filename = filename;
+                        current_file_cursor = pos;
+                    }
+                    need_metadata.push_back({ c.index, c.name });
+                    LOG_DEBUG(L"{} added at {}", c.name, pos);
+                }
+                break;
+
+            case folder_watcher::action_t::removed:
+                if(pos != -1) {
+                    set_file_index(scan.file_id(pos), -1);
+                    scan.remove(pos);
+
+                    // if it was the current one, the cursor stays put (on the next one)
+
+                    shift_file_indices(pos + 1, -1);
+                    if(current_file_cursor == pos) {
+                        current_file_cursor = std::min(pos, static_cast<int>(scan.files.size()) - 1);
+                    }
+                    LOG_DEBUG(L"{} removed from {}", c.name, pos);
+                }
+                break;
+
+            case folder_watcher::action_t::modified:
+                if(pos != -1 && scan.files[pos].date != c.date) {
+
+                    reload_current |= forget_file(scan.file_id(pos));
+
+                    // a new date might mean it goes somewhere else
+
+                    bool was_cursor = current_file_cursor == pos;
+
+                    file::info f = scan.files[pos];
+                    f.date = c.date;
+                    f.size = c.size;
+                    f.index = c.index;
+
+                    // the old metadata is used for sorting until it's been read again
+                    f.has_metadata = false;
+                    need_metadata.push_back({ c.index, c.name });
+
+                    set_file_index(scan.file_id(pos), -1);
+                    scan.remove(pos);
+                    shift_file_indices(pos + 1, -1);
+
+                    int new_pos = scan.insert(f);
+                    shift_file_indices(new_pos, 1);
+                    set_file_index(scan.file_id(new_pos), new_pos);
+
+                    if(was_cursor) {
+                        current_file_cursor = new_pos;
+                    }
+                    LOG_DEBUG(L"{} changed", c.name);
+                }
+                break;
+            }
+        }
+
+        if(rescan) {
+            start_folder_scan(scan.path + L"\\");
+        } else if(!need_metadata.empty() && FAILED(metadata_indexer::add(std::move(need_metadata)))) {
+            start_metadata_indexer();
+        }
+
+        if(reload_current) {
+            load_image(stale_current_file->filename);
+        }
+
+        cache_queue.set_cursor(current_file_cursor, navigation_direction);
+
         warm_cache();
     }
 
+    //////////////////////////////////////////////////////////////////////
+    // cursor moved during key repeat, show the file there if it's cached
+    // but don't start loading it, that waits until the cursor settles
+
+    void coalesce_navigation()
+    {
+        auto found = loaded_files.find(current_folder_scan->file_id(current_file_cursor));
+        if(found != loaded_files.end()) {
+            display_image(found->second);
+        } else if(settings.show_filename != show_filename_never) {
+            set_message(current_folder_scan->files[current_file_cursor].name, 2);
+        }
+
+        // whatever was asked for before has been skipped, let it finish as a cache load if it's still nearby
+
+        if(requested_file != null) {
+            requested_file->is_cache_load = true;
+            requested_file = null;
+        }
+        cancel_unwanted_loads(current_file_cursor);
+
+        navigation_pending = true;
+        SetTimer(window, timer_id_navigation_settle, navigation_settle_ms, null);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // load the file under the cursor
+
+    void settle_navigation()
+    {
+        if(current_folder_scan == null || current_file_cursor < 0 ||
+           current_file_cursor >= (int)current_folder_scan->files.size()) {
+            navigation_pending = false;
+            KillTimer(window, timer_id_navigation_settle);
+            return;
+        }
+        std::wstring const &name = current_folder_scan->files[current_file_cursor].name;
+        load_image(std::format(L"{}\\{}", current_folder_scan->path, name));
+    }
+
     //////////////////////////////////////////////////////////////////////
     // move to another file in the folder
 
     void move_file_cursor(int movement)
     {
-        // can't key left/right while folder is still being scanned
-        // TODO(chs): remember the moves and apply them when the scan is complete?
+        // can't key left/right until the first batch of the folder scan arrives
         if(current_folder_scan == null || current_file_cursor == -1) {
             return;
         }
@@ -2148,9 +3119,19 @@ namespace
         int new_file_cursor = std::clamp(current_file_cursor + movement, 0, (int)current_folder_scan->files.size() - 1);
 
         if(new_file_cursor != current_file_cursor) {
+            navigation_timer.update();
+            prefetch.add_navigation(navigation_timer.delta());
+            navigation_direction = sgn(movement);
             current_file_cursor = new_file_cursor;
-            std::wstring const &name = current_folder_scan->files[current_file_cursor].name;
-            load_image(std::format(L"{}\\{}", current_folder_scan->path, name));
+            navigation_key = command_key;
+
+            // if they're holding the key down, only the file they stop on gets loaded
+
+            if(navigation_timer.delta() < navigation_repeat_seconds) {
+                coalesce_navigation();
+            } else {
+                settle_navigation();
+            }
         }
     }
 
@@ -2164,15 +3145,42 @@ namespace
     {
         LOG_DEBUG(L"LOADED {}", f->filename);
 
+        // it might have been cancelled (and maybe re-requested) while it was loading
+
+        bool was_cancelled = false;
+
+        if(f->cancel_event != null) {
+            was_cancelled = WaitForSingleObject(f->cancel_event, 0) == WAIT_OBJECT_0;
+            CloseHandle(f->cancel_event);
+            f->cancel_event = null;
+        }
+
+        auto found = loading_files.find(f->id);
+        if(found != loading_files.end() && found->second == f) {
+            loading_files.erase(found);
+        }
+
+        if(was_cancelled) {
+            delete f;
+            return;
+        }
+
         if(FAILED(f->hresult)) {
             set_message(std::format(L"{} {}", f->filename, windows_error_message(f->hresult)), 5);
+            if(f == requested_file) {
+                requested_file = null;
+            }
             delete f;
             return;
         }
 
         // transfer from loading to loaded
-        loading_files.erase(f->filename);
-        loaded_files[f->filename] = f;
+        loaded_files[f->id] = f;
+
+        prefetch.add_load(f->read_seconds + f->decode_seconds, f->bytes.size(), f->total_size());
+
+        metrics.read.add(f->read_seconds * 1000.0);
+        metrics.decode.add(f->decode_seconds * 1000.0);
 
         std::lock_guard lock(cache_mutex);
 
@@ -2183,8 +3191,17 @@ namespace
 
         update_file_index(f);
 
+        cache_queue.add(f);
+
         // if it's most recently requested, show it
         if(f == requested_file) {
+            f->load_timer.update();
+            double latency_ms = f->load_timer.wall_time() * 1000.0;
+            metrics.visible.add(latency_ms);
+            LOG_INFO(L"{} arrived {:.1f}ms after it was requested ({} other loads in flight)",
+                     f->filename,
+                     latency_ms,
+                     loading_files.size());
             requested_file = null;
             display_image(f);
             current_file_cursor = f->index;
@@ -2324,6 +3341,8 @@ namespace
 
         static auto check_fixedgrid = []() -> uint { return settings.fixed_checkerboard ? MFS_CHECKED : 0; };
 
+        static auto check_debug_overlay = []() -> uint { return show_debug_overlay ? MFS_CHECKED : 0; };
+
         static std::unordered_map<UINT, std::function<uint()>> menu_process_table = {
             { ID_COPY, got_selection },
             { ID_SELECT_ALL, got_image },
@@ -2335,6 +3354,7 @@ namespace
             { ID_VIEW_ALPHA, check_alpha },
             { ID_VIEW_FULLSCREEN, check_fullscreen },
             { ID_VIEW_FIXEDGRID, check_fixedgrid },
+            { ID_VIEW_DEBUG_OVERLAY, check_debug_overlay },
             { ID_ZOOM_1, got_image },
             { ID_ZOOM_ALL, got_image },
             { ID_ZOOM_CENTER, got_image },
@@ -2821,13 +3841,12 @@ namespace
             return E_NOT_VALID_STATE;
         }
 
-        ComPtr<ID3D11Texture2D> tex;
-        CHK_HR(copy_selection_to_texture(tex.GetAddressOf()));
+        // cut it out before clearing anything, it might be cropping the clipboard image again
 
-        D3D11_TEXTURE2D_DESC desc;
-        tex->GetDesc(&desc);
-        int width = desc.Width;
-        int height = desc.Height;
+        std::vector<byte> pixels;
+        image::image_t img;
+
+        CHK_HR(get_selection_pixels(pixels, img));
 
         select_active = false;
 
@@ -2836,24 +3855,20 @@ namespace
         f.is_clipboard = true;
         f.bytes.clear();
         f.pixels.clear();
+        f.mip_pixels.clear();
+        f.mips.clear();
+        f.full_width = img.width;
+        f.full_height = img.height;
         f.filename = localize(IDS_CROPPED_FILENAME);
         f.hresult = S_OK;
         f.index = -1;
         f.is_cache_load = true;
         f.view_count = 0;
 
-        D3D11_MAPPED_SUBRESOURCE mapped_resource{};
-        CHK_HR(d3d_context->Map(tex.Get(), 0, D3D11_MAP_READ, 0, &mapped_resource));
-        DEFER(d3d_context->Unmap(tex.Get(), 0));
-
-        f.pixels.resize(static_cast<size_t>(mapped_resource.RowPitch) * height);
-
-        memcpy(f.pixels.data(), mapped_resource.pData, f.pixels.size());
+        f.pixels = std::move(pixels);
 
+        f.img = img;
         f.img.pixels = f.pixels.data();
-        f.img.width = width;
-        f.img.height = height;
-        f.img.row_pitch = mapped_resource.RowPitch;
 
         clear_selection();
 
@@ -2987,6 +4002,19 @@ namespace
             draw_string(std::format(L"{}x{}", sw, sh), label_format.Get(), s_br, { 0, 0 }, 1.0f, 2, 2);
         }
 
+        if(show_debug_overlay) {
+
+            vec2 pos{ dpi_scale(12.0f), dpi_scale(12.0f) };
+
+            draw_string(metrics.overlay_text(get_resident(), prefetch_depth()),
+                        label_format.Get(),
+                        pos,
+                        { 0.0f, 0.0f },
+                        1.0f,
+                        dpi_scale(3.0f),
+                        dpi_scale(3.0f));
+        }
+
         if(!current_message.empty()) {
 
             float elapsed = static_cast<float>(app_timer.wall_time() - message_timestamp);
@@ -3026,221 +4054,298 @@ namespace
     //////////////////////////////////////////////////////////////////////
     // render a frame
 
-    HRESULT render()
+    //////////////////////////////////////////////////////////////////////
+    // work out what's in this frame, the gpu draws it in render() and the software renderer can draw it too
+    // has_image is whether there's a texture (or for render_to_file, a decoded current_file)
+
+    void get_frame(software_renderer::frame_t &frame, bool has_image)
     {
-        // create d3d stuff if necessary
+        frame.border_color = color_from_uint32(settings.border_color);
+        frame.overlays.clear();
 
-        if(d3d_device.Get() == null) {
-            CHK_HR(create_device());
+        frame.draw_image = has_image;
+        frame.draw_detail = false;
+
+        if(!frame.draw_image) {
+            return;
         }
 
-        if(rendertarget_view.Get() == null) {
-            CHK_HR(create_resources());
+        frame.image = {};
+        frame.mips.clear();
+        if(current_file != null && current_file->is_decoded()) {
+            frame.image = current_file->img;
+            frame.mips = current_file->mips;
         }
 
-        // setup rendertarget and viewport
+        frame.image_rect = current_rect;
 
-        d3d_context->OMSetRenderTargets(1, rendertarget_view.GetAddressOf(), null);
+        frame.draw_detail = detail_image.pixels != null;
 
-        CD3D11_VIEWPORT viewport(0.0f, 0.0f, static_cast<float>(window_width), static_cast<float>(window_height));
+        if(frame.draw_detail) {
+            frame.detail = detail_image;
+            frame.detail_rect = get_detail_rect();
+        }
 
-        d3d_context->RSSetViewports(1, &viewport);
+        // setup UV transform based on flip/rotate
 
-        // clear screen
+        frame.texture_transform = get_texture_transform();
 
-        vec4 border_color = color_from_uint32(settings.border_color);
-        d3d_context->ClearRenderTargetView(rendertarget_view.Get(), reinterpret_cast<float *>(&border_color));
+        // setup checkerboard or background color
 
-        // all the image related stuff
+        vec4 g1;
+        vec4 g2;
 
-        if(image_texture.Get() != null) {
+        if(!settings.checkerboard_enabled) {
 
-            // draw texture with optional checkerboard background
+            g1 = color_from_uint32(settings.background_color);
+            g2 = g1;
 
-            // setup UV transform based on flip/rotate
+        } else {
+
+            g1 = color_from_uint32(settings.grid_color_1);
+            g2 = color_from_uint32(settings.grid_color_2);
 
-            shader.texture_transform = get_texture_transform();
+            // setup checkerboard offset
 
-            // setup checkerboard or background color
+            frame.checkerboard_offset = { 0, 0 };
 
-            vec4 g1;
-            vec4 g2;
+            if(!settings.fixed_checkerboard) {
 
-            if(!settings.checkerboard_enabled) {
+                frame.checkerboard_offset = { -current_rect.x, -current_rect.y };
+            }
 
-                g1 = color_from_uint32(settings.background_color);
-                g2 = g1;
+            // setup checkerboard size
 
-            } else {
+            uint gs = settings.grid_size * (1 << settings.grid_multiplier);
+            frame.checkerboard_scale = 1.0f / std::max(4u, gs);
+        }
 
-                g1 = color_from_uint32(settings.grid_color_1);
-                g2 = color_from_uint32(settings.grid_color_2);
+        frame.checkerboard_colors[0] = g1;
+        frame.checkerboard_colors[1] = g2;
+        frame.checkerboard_colors[2] = g2;
+        frame.checkerboard_colors[3] = g1;
 
-                // setup checkerboard offset
+        // selection overlay and selection outline
 
-                shader.checkerboard_offset = { 0, 0 };
+        uint32 select_color = settings.select_fill_color;
+        bool draw_selection = select_active;
 
-                if(!settings.fixed_checkerboard) {
+        vec2 tl = vec2::min(select_anchor, select_current);
+        vec2 br = vec2::max(select_anchor, select_current);
 
-                    shader.checkerboard_offset = { -current_rect.x, -current_rect.y };
-                }
+        if(!select_active) {
+            tl = vec2{ 0, 0 };
+            br = texture_size();
+            select_color = 0x00000000;
+        }
+
+        double const select_flash_time = settings.copy_flash_time / 10.0;
+
+        if(copy_flashing) {
 
-                // setup checkerboard size
+            copy_flash_timer.update();
+            double since = copy_flash_timer.wall_time();
+
+            if(since <= select_flash_time) {
+
+                draw_selection = true;
+                int lerp = static_cast<int>((since / select_flash_time) * 255.0);
+                select_color = color_lerp(settings.copy_flash_color, select_color, lerp);
+
+            } else {
 
-                uint gs = settings.grid_size * (1 << settings.grid_multiplier);
-                shader.check_strip_size = 1.0f / std::max(4u, gs);
+                copy_flashing = false;
             }
+        }
 
-            shader.colors[0] = g1;
-            shader.colors[1] = g2;
-            shader.colors[2] = g2;
-            shader.colors[3] = g1;
+        if(draw_selection) {
 
-            // draw the image
+            // first the solid rectangle selection overlay
 
-            d3d_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+            br = add_point(br, { 1.0f, 1.0f });
 
-            d3d_context->VSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
-            d3d_context->VSSetShader(vertex_shader.Get(), null, 0);
+            // TODO (chs): fix the rounding errors which can happen in here
 
-            d3d_context->PSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
-            d3d_context->PSSetShader(texture_shader.Get(), null, 0);
-            d3d_context->PSSetShaderResources(0, 1, image_texture_view.GetAddressOf());
-            d3d_context->PSSetSamplers(0, 1, sampler_state.GetAddressOf());
+            tl = texture_to_screen_pos_unclamped(tl);
+            br = texture_to_screen_pos_unclamped(br);
 
-            d3d_context->RSSetState(rasterizer_state.Get());
+            software_renderer::overlay_t fill{};
+            fill.rect = { tl.x, tl.y, br.x - tl.x, br.y - tl.y };
+            fill.colors[0] = color_from_uint32(select_color);
+            frame.overlays.push_back(fill);
 
-            d3d_context->OMSetBlendState(null, null, 0xffffffff);
+            if(select_active) {
+
+                // then the stripey outline
+
+                software_renderer::overlay_t outline{};
+
+                outline.colors[0] = color_from_uint32(settings.select_outline_color1);
+                outline.colors[1] = color_from_uint32(settings.select_outline_color2);
+
+                outline.stripe_scale = 1.0f / settings.dash_length;
+
+                // NOTE: dodgy fix for the stripe-near-zero problem is to add stripe * max(window_width,
+                // window_height) to the frame count so it doesn't wrap near the origin
 
-            draw_rectangle(current_rect, viewport);
+                outline.stripe_frame =
+                    fmodf(settings.dash_anim_speed * frame_count / 10.0f, settings.dash_length * -2.0f) +
+                    settings.dash_length * std::max(window_width, window_height);
 
-            // draw selection overlay and selection outline
+                float bw = static_cast<float>(settings.select_border_width);
 
-            uint32 select_color = settings.select_fill_color;
-            bool draw_selection = select_active;
+                // top
+                outline.rect = { tl.x - bw, tl.y - bw, (br.x - tl.x) + bw * 2.0f, bw };
+                frame.overlays.push_back(outline);
 
-            vec2 tl = vec2::min(select_anchor, select_current);
-            vec2 br = vec2::max(select_anchor, select_current);
+                // bottom
+                outline.rect.y = br.y;
+                frame.overlays.push_back(outline);
 
-            if(!select_active) {
-                tl = vec2{ 0, 0 };
-                br = texture_size();
-                select_color = 0x00000000;
+                // left
+                outline.rect = { tl.x - bw, tl.y, bw, br.y - tl.y };
+                frame.overlays.push_back(outline);
+
+                // right
+                outline.rect.x = br.x;
+                frame.overlays.push_back(outline);
             }
+        }
 
-            double const select_flash_time = settings.copy_flash_time / 10.0;
+        // crosshairs
 
-            if(copy_flashing) {
+        if(crosshairs_active) {
 
-                copy_flash_timer.update();
-                double since = copy_flash_timer.wall_time();
+            software_renderer::overlay_t crosshair{};
 
-                if(since <= select_flash_time) {
+            crosshair.colors[0] = color_from_uint32(settings.crosshair_color1);
+            crosshair.colors[1] = color_from_uint32(settings.crosshair_color2);
 
-                    draw_selection = true;
-                    int lerp = static_cast<int>((since / select_flash_time) * 255.0);
-                    select_color = color_lerp(settings.copy_flash_color, select_color, lerp);
+            crosshair.stripe_scale = 1.0f / settings.crosshair_dash_length;
 
-                } else {
+            // NOTE: same dodgy fix for the stripe-near-zero problem
 
-                    copy_flashing = false;
-                }
-            }
+            crosshair.stripe_frame = fmodf(settings.crosshair_dash_anim_speed * frame_count / 10.0f,
+                                           settings.crosshair_dash_length * -2.0f) +
+                                     settings.crosshair_dash_length * std::max(window_width, window_height);
+
+            // get screen position of center of texel under cursor
+
+            vec2 p = clamp_to_texture(screen_to_texture_pos(cur_mouse_pos));
+            vec2 c = mul_point(texel_size(), { 0.5f, 0.5f });
+            c = add_point(texture_to_screen_pos(p), c);
 
-            if(draw_selection) {
+            float bw = static_cast<float>(settings.crosshair_width);
+            float hbw = bw / 2.0f;
 
-                // first the solid rectangle selection overlay
+            // horizontal across the whole screen
+            crosshair.rect = { 0, c.y - hbw, static_cast<float>(window_width), bw };
+            frame.overlays.push_back(crosshair);
 
-                d3d_context->PSSetShader(solid_shader.Get(), null, 0);
-                d3d_context->OMSetBlendState(blend_state.Get(), null, 0xffffffff);
+            // top vertical bit
+            crosshair.rect = { c.x - hbw, 0, bw, c.y - hbw };
+            frame.overlays.push_back(crosshair);
 
-                br = add_point(br, { 1.0f, 1.0f });
+            // botton vertical bit
+            crosshair.rect.y = c.y + hbw;
+            crosshair.rect.h = window_height - crosshair.rect.y;
+            frame.overlays.push_back(crosshair);
+        }
+    }
 
-                // TODO (chs): fix the rounding errors which can happen in here
+    //////////////////////////////////////////////////////////////////////
 
-                tl = texture_to_screen_pos_unclamped(tl);
-                br = texture_to_screen_pos_unclamped(br);
+    HRESULT render()
+    {
+        // create d3d stuff if necessary
 
-                shader.colors[0] = color_from_uint32(select_color);
+        if(d3d_device.Get() == null) {
+            CHK_HR(create_device());
+        }
 
-                CHK_HR(draw_rectangle({ tl.x, tl.y, br.x - tl.x, br.y - tl.y }, viewport));
+        if(rendertarget_view.Get() == null) {
+            CHK_HR(create_resources());
+        }
 
-                if(select_active) {
+        get_frame(current_frame, image_texture.Get() != null);
 
-                    // then the stripey outline
+        // setup rendertarget and viewport
 
-                    d3d_context->PSSetShader(stripe_shader.Get(), null, 0);
+        d3d_context->OMSetRenderTargets(1, rendertarget_view.GetAddressOf(), null);
 
-                    shader.colors[0] = color_from_uint32(settings.select_outline_color1);
-                    shader.colors[1] = color_from_uint32(settings.select_outline_color2);
+        CD3D11_VIEWPORT viewport(0.0f, 0.0f, static_cast<float>(window_width), static_cast<float>(window_height));
 
-                    shader.check_strip_size = 1.0f / settings.dash_length;
+        d3d_context->RSSetViewports(1, &viewport);
 
-                    // NOTE: dodgy fix for the stripe-near-zero problem is to add stripe * max(window_width,
-                    // window_height) to the frame count so it doesn't wrap near the origin
+        // clear screen
 
-                    shader.frame = fmodf(settings.dash_anim_speed * frame_count / 10.0f, settings.dash_length * -2.0f) +
-                                   settings.dash_length * std::max(window_width, window_height);
+        d3d_context->ClearRenderTargetView(rendertarget_view.Get(),
+                                           reinterpret_cast<float *>(&current_frame.border_color));
 
-                    float bw = static_cast<float>(settings.select_border_width);
+        // all the image related stuff
 
-                    // top
-                    rect_f horiz{ tl.x - bw, tl.y - bw, (br.x - tl.x) + bw * 2.0f, bw };
-                    CHK_HR(draw_rectangle(horiz, viewport));
+        if(current_frame.draw_image) {
 
-                    // bottom
-                    horiz.y = br.y;
-                    CHK_HR(draw_rectangle(horiz, viewport));
+            // draw texture with optional checkerboard background
 
-                    // left
-                    rect_f vert{ vert.x = tl.x - bw, tl.y, bw, br.y - tl.y };
-                    CHK_HR(draw_rectangle(vert, viewport));
+            shader.texture_transform = current_frame.texture_transform;
 
-                    // right
-                    vert.x = br.x;
-                    CHK_HR(draw_rectangle(vert, viewport));
-                }
+            for(int i = 0; i < 4; ++i) {
+                shader.colors[i] = current_frame.checkerboard_colors[i];
             }
 
-            // draw crosshairs
+            shader.checkerboard_offset = current_frame.checkerboard_offset;
+            shader.check_strip_size = current_frame.checkerboard_scale;
+
+            // draw the image
+
+            d3d_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+            d3d_context->VSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
+            d3d_context->VSSetShader(vertex_shader.Get(), null, 0);
+
+            d3d_context->PSSetConstantBuffers(0, 1, constant_buffer.GetAddressOf());
+            d3d_context->PSSetShader(texture_shader.Get(), null, 0);
+            d3d_context->PSSetShaderResources(0, 1, image_texture_view.GetAddressOf());
+            d3d_context->PSSetSamplers(0, 1, sampler_state.GetAddressOf());
+
+            d3d_context->RSSetState(rasterizer_state.Get());
+
+            d3d_context->OMSetBlendState(null, null, 0xffffffff);
+
+            draw_rectangle(current_frame.image_rect, viewport);
+
+            // the sharper part of a huge image on top of that
+
+            if(current_frame.draw_detail && detail_texture_view.Get() != null) {
 
-            if(crosshairs_active) {
+                d3d_context->PSSetShaderResources(0, 1, detail_texture_view.GetAddressOf());
 
-                d3d_context->PSSetShader(stripe_shader.Get(), null, 0);
-                d3d_context->OMSetBlendState(blend_state.Get(), null, 0xffffffff);
+                CHK_HR(draw_rectangle(current_frame.detail_rect, viewport));
+            }
 
-                shader.colors[0] = color_from_uint32(settings.crosshair_color1);
-                shader.colors[1] = color_from_uint32(settings.crosshair_color2);
+            // then the selection and crosshairs over it
 
-                shader.check_strip_size = 1.0f / settings.crosshair_dash_length;
+            d3d_context->OMSetBlendState(blend_state.Get(), null, 0xffffffff);
 
-                // NOTE: same dodgy fix for the stripe-near-zero problem
+            for(auto const &overlay : current_frame.overlays) {
 
-                shader.frame = fmodf(settings.crosshair_dash_anim_speed * frame_count / 10.0f,
-                                     settings.crosshair_dash_length * -2.0f) +
-                               settings.crosshair_dash_length * std::max(window_width, window_height);
+                if(overlay.stripe_scale == 0) {
 
-                // get screen position of center of texel under cursor
+                    d3d_context->PSSetShader(solid_shader.Get(), null, 0);
 
-                vec2 p = clamp_to_texture(screen_to_texture_pos(cur_mouse_pos));
-                vec2 c = mul_point(texel_size(), { 0.5f, 0.5f });
-                c = add_point(texture_to_screen_pos(p), c);
+                } else {
 
-                float bw = static_cast<float>(settings.crosshair_width);
-                float hbw = bw / 2.0f;
+                    d3d_context->PSSetShader(stripe_shader.Get(), null, 0);
 
-                // horizontal across the whole screen
-                rect_f horiz{ 0, c.y - hbw, static_cast<float>(window_width), bw };
-                CHK_HR(draw_rectangle(horiz, viewport));
+                    shader.colors[1] = overlay.colors[1];
+                    shader.check_strip_size = overlay.stripe_scale;
+                    shader.frame = overlay.stripe_frame;
+                }
 
-                // top vertical bit
-                rect_f vert{ c.x - hbw, 0, bw, c.y - hbw };
-                CHK_HR(draw_rectangle(vert, viewport));
+                shader.colors[0] = overlay.colors[0];
 
-                // botton vertical bit
-                vert.y = c.y + hbw;
-                vert.h = window_height - vert.y;
-                CHK_HR(draw_rectangle(vert, viewport));
+                CHK_HR(draw_rectangle(overlay.rect, viewport));
             }
         }
 
@@ -3263,7 +4368,7 @@ namespace
     }
 
     //////////////////////////////////////////////////////////////////////
-    // call this repeatedly when there are no windows messages available
+    // draw a frame, called when the frame scheduler says one is due
 
     HRESULT update()
     {
@@ -3271,24 +4376,36 @@ namespace
         crosshairs_active = current_file != null && (GetKeyState(VK_MENU) & 0x8000) != 0;
 
         app_timer.update();
+        frame_timer.update();
 
-        float delta_t = static_cast<float>(std::min(app_timer.delta(), 0.25));
+        double now = frame_timer.wall_time();
+
+        float delta_t = static_cast<float>(frames.begin_frame(now));
+
+        // returns true if it's still moving
 
         auto lerp = [=](float &a, float &b) {
             float d = b - a;
             if(fabsf(d) <= 1.0f) {
                 a = b;
-            } else {
-                a += d * 20 * delta_t;
+                return false;
             }
+            a += d * std::min(1.0f, 20 * delta_t);
+            return true;
         };
 
         // update image position/zoom towards target
 
-        lerp(current_rect.x, target_rect.x);
-        lerp(current_rect.y, target_rect.y);
-        lerp(current_rect.w, target_rect.w);
-        lerp(current_rect.h, target_rect.h);
+        bool moving = false;
+
+        moving |= lerp(current_rect.x, target_rect.x);
+        moving |= lerp(current_rect.y, target_rect.y);
+        moving |= lerp(current_rect.w, target_rect.w);
+        moving |= lerp(current_rect.h, target_rect.h);
+
+        if(!moving) {
+            update_detail();
+        }
 
         // reset mouse to original click position in zoom mode
 
@@ -3321,10 +4438,38 @@ namespace
             CHK_HR(render());
         }
 
-        settings_ui::update();
-
         frame_count += 1;
 
+        // keep drawing while anything's moving, the stripey selection and crosshairs are always moving
+
+        if(moving || select_active || crosshairs_active || copy_flashing || show_debug_overlay) {
+            frames.animate();
+        }
+
+        if(settings_ui::update()) {
+            frames.animate();
+        }
+
+        // messages are drawn as they are until they start to fade
+
+        if(!current_message.empty() && message_fade_time != 0) {
+
+            double elapsed = app_timer.wall_time() - message_timestamp;
+            double fade_start = message_fade_time * message_fade_start;
+
+            if(elapsed < fade_start) {
+                frames.wake_at(now + fade_start - elapsed);
+            } else if(elapsed < message_fade_time) {
+                frames.animate();
+            }
+        }
+
+        // the window is shown after 1/4 second if the file is slow to arrive
+
+        if(!IsWindowVisible(window)) {
+            frames.wake_at(now + std::max(0.0, 0.25 - app_timer.wall_time()));
+        }
+
         return S_OK;
     }
 
@@ -3383,6 +4528,23 @@ namespace
             settings_ui::new_settings_update();
             break;
 
+        case ID_VIEW_DEBUG_OVERLAY:
+            show_debug_overlay = !show_debug_overlay;
+            break;
+
+        case ID_VIEW_DUMP_STATS: {
+            wchar temp_path[MAX_PATH + 1];
+            if(GetTempPathW(_countof(temp_path), temp_path) != 0) {
+                std::wstring filename = std::format(L"{}imageview_stats.json", temp_path);
+                HRESULT hr = metrics.save(filename, get_resident(), prefetch_depth());
+                if(FAILED(hr)) {
+                    set_message(std::format(L"{} - {}", filename, windows_error_message(hr)), 5);
+                } else {
+                    set_message(std::format(L"{} {}", localize(IDS_STATS_SAVED), filename), 5);
+                }
+            }
+        } break;
+
         case ID_VIEW_GRIDSIZE:
             settings.grid_multiplier = (settings.grid_multiplier + 1) & 7;
             settings_ui::new_settings_update();
@@ -3548,6 +4710,8 @@ namespace
 
         SetEvent(window_created_event);
 
+        SetTimer(hwnd, timer_id_cache_governor, cache_governor_interval_ms, null);
+
         file_dropper.InitializeDragDropHelper(window);
 
         setup_window_text();
@@ -3975,6 +5139,12 @@ namespace
             snap_mode = snap_mode_t::none;
             break;
         }
+
+        // navigation key released after auto-repeat, don't wait for the timer
+
+        if(navigation_pending && navigation_key != 0 && vk == navigation_key) {
+            settle_navigation();
+        }
     }
 
     //////////////////////////////////////////////////////////////////////
@@ -3990,11 +5160,32 @@ namespace
 
     //////////////////////////////////////////////////////////////////////
 
+    void OnTimer(HWND hwnd, UINT id)
+    {
+        switch(id) {
+
+        case timer_id_cache_governor:
+            update_cache_budget();
+            break;
+
+        case timer_id_navigation_settle:
+            if(navigation_pending) {
+                settle_navigation();
+                frames.invalidate();
+            }
+            break;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
     void OnDestroy(HWND hwnd)
     {
         if(!settings.fullscreen) {
             GetWindowPlacement(window, &settings.window_placement);
         }
+        KillTimer(hwnd, timer_id_cache_governor);
+        KillTimer(hwnd, timer_id_navigation_settle);
         PostQuitMessage(0);
     }
 
@@ -4160,6 +5351,7 @@ namespace
             HANDLE_MSG(hwnd, WM_EXITSIZEMOVE, OnExitSizeMove);
             HANDLE_MSG(hwnd, WM_POWERBROADCAST, OnPowerBroadcast);
             HANDLE_MSG(hwnd, WM_SYSCOMMAND, OnSysCommand);
+            HANDLE_MSG(hwnd, WM_TIMER, OnTimer);
 
             //////////////////////////////////////////////////////////////////////
 
@@ -4169,8 +5361,25 @@ namespace
 
             //////////////////////////////////////////////////////////////////////
 
+        // this one is sent, not posted, so the main loop doesn't see it
+
         case app::WM_FOLDER_SCAN_COMPLETE:
-            on_folder_scanned(reinterpret_cast<file::folder_scan_result *>(lParam));
+            on_folder_scanned(reinterpret_cast<file::folder_scan_result *>(lParam), static_cast<uint>(wParam));
+            frames.invalidate();
+            break;
+
+            //////////////////////////////////////////////////////////////////////
+
+        case app::WM_FOLDER_CHANGED:
+            on_folder_changed(reinterpret_cast<folder_watcher::folder_changes *>(lParam), static_cast<uint>(wParam));
+            break;
+
+        case app::WM_METADATA_INDEXED:
+            on_metadata_indexed(reinterpret_cast<metadata_indexer::results_t *>(lParam), static_cast<uint>(wParam));
+            break;
+
+        case app::WM_REGION_DECODED:
+            on_region_decoded(reinterpret_cast<detail_region_t *>(lParam));
             break;
 
             //////////////////////////////////////////////////////////////////////
@@ -4205,6 +5414,11 @@ namespace
 
         current_file = f;
 
+        if(stale_current_file != null && stale_current_file != f) {
+            delete stale_current_file;
+            stale_current_file = null;
+        }
+
         FILETIME now;
         GetSystemTimeAsFileTime(&now);
 
@@ -4222,7 +5436,10 @@ namespace
 
         // or hresult from create_texture
         if(SUCCEEDED(hr)) {
-            hr = create_texture(d3d_device.Get(), d3d_context.Get(), &new_texture, &new_srv, f->img);
+            timer_t upload_timer;
+            hr = create_texture(d3d_device.Get(), d3d_context.Get(), &new_texture, &new_srv, f->img, f->mips);
+            upload_timer.update();
+            metrics.upload.add(upload_timer.wall_time() * 1000.0);
         }
 
         // set texture as current
@@ -4239,6 +5456,8 @@ namespace
                 }
             }
 
+            clear_detail();
+
             image_texture.Attach(new_texture.Detach());
             image_texture_view.Attach(new_srv.Detach());
 
@@ -4296,6 +5515,95 @@ namespace
         return hr;
     }
 
+    //////////////////////////////////////////////////////////////////////
+    // draw an image the way the window would with the software renderer and save it,
+    // no window or d3d device, `imageview --render-to-file in out [width height]`
+    // width and height are the window size, 0 means the size of the image
+
+    HRESULT render_to_file(std::wstring const &in_filename, std::wstring const &out_filename, uint w, uint h)
+    {
+        image::image_file f;
+        f.filename = in_filename;
+
+        CHK_HR(file::load(f.filename, f.bytes));
+        CHK_HR(image::decode(&f));
+
+        current_file = &f;
+        DEFER(current_file = null);
+
+        actual_texture_width = f.img.width;
+        actual_texture_height = f.img.height;
+
+        window_width = static_cast<int>(w != 0 ? w : f.img.width);
+        window_height = static_cast<int>(h != 0 ? h : f.img.height);
+
+        reset_transform();
+
+        software_renderer::frame_t frame;
+        get_frame(frame, true);
+
+        software_renderer::target_t target;
+        target.width = static_cast<uint>(window_width);
+        target.height = static_cast<uint>(window_height);
+        target.row_pitch = target.width * 4;
+
+        std::vector<byte> pixels(static_cast<size_t>(target.row_pitch) * target.height);
+        target.pixels = pixels.data();
+
+        CHK_HR(software_renderer::render(frame, target, thread_pool));
+
+        CHK_HR(image::save(
+            out_filename, pixels.data(), target.width, target.height, target.row_pitch, false, false, rotate_0));
+
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // if the command line is --render-to-file then do that instead of running the app
+    // `handled` is false for any other command line
+
+    HRESULT headless_command_line(std::wstring const &cmd_line, bool &handled)
+    {
+        handled = false;
+
+        int argc;
+        wchar **argv = CommandLineToArgvW(cmd_line.c_str(), &argc);
+
+        if(argv == null) {
+            return S_OK;
+        }
+
+        DEFER(LocalFree(argv));
+
+        if(argc < 2 || _wcsicmp(argv[1], L"--render-to-file") != 0) {
+            return S_OK;
+        }
+
+        handled = true;
+
+        if(argc != 4 && argc != 6) {
+            return E_INVALIDARG;
+        }
+
+        uint w{ 0 };
+        uint h{ 0 };
+
+        if(argc == 6) {
+            w = static_cast<uint>(_wtoi(argv[4]));
+            h = static_cast<uint>(_wtoi(argv[5]));
+            if(w == 0 || h == 0) {
+                return E_INVALIDARG;
+            }
+        }
+
+        CHK_HR(thread_pool.init(static_cast<int>(std::thread::hardware_concurrency())));
+        DEFER(thread_pool.cleanup());
+
+        CHK_HR(render_to_file(argv[2], argv[3], w, h));
+
+        return S_OK;
+    }
+
     //////////////////////////////////////////////////////////////////////
 
     HRESULT main()
@@ -4348,6 +5656,15 @@ namespace
 
         main_stopwatch.report(L"GetCommandLine");
 
+        // --render-to-file doesn't make a window
+
+        bool headless;
+        CHK_HR(headless_command_line(cmd_line, headless));
+
+        if(headless) {
+            return S_OK;
+        }
+
         // if single window mode
 
         if(settings.reuse_window) {
@@ -4391,6 +5708,12 @@ namespace
 
         LOG_INFO(L"System has {}GB of memory", app::system_memory_gb);
 
+        // size the cache from it
+
+        CHK_HR(cache_governor.init());
+
+        update_cache_budget();
+
         main_stopwatch.report(L"get system memory");
 
         // load/create/init some things
@@ -4401,11 +5724,13 @@ namespace
 
         CHK_NULL(quit_event = CreateEvent(null, true, false, null));
 
-        CHK_HR(thread_pool.init());
+        // file reads mostly wait for the disk so give them their own workers on top of one per core
 
-        CHK_HR(thread_pool.create_thread_with_message_pump(&scanner_thread_id, []() { scanner_function(); }));
+        int num_cores = static_cast<int>(std::thread::hardware_concurrency());
 
-        CHK_HR(thread_pool.create_thread_with_message_pump(&file_loader_thread_id, []() { file_loader_function(); }));
+        CHK_HR(thread_pool.init(num_cores + scheduler::load_scheduler::max_reads));
+
+        CHK_HR(file_scheduler.init(thread_pool, file_read_job, file_decode_job, file_load_done));
 
         main_stopwatch.report(L"create some threads");
 
@@ -4474,17 +5799,40 @@ namespace
         MSG msg;
         msg.message = WM_NULL;
 
+        // draw frames when something has changed or is animating, otherwise sleep until a message arrives
+
         while(msg.message != WM_QUIT) {
 
             if(PeekMessageW(&msg, null, 0, 0, PM_REMOVE)) {
 
-                if(msg.hwnd != window || !TranslateAcceleratorW(window, hotkeys::accelerators, &msg)) {
+                // accelerators send the WM_COMMAND from in here so this says which key it came from
+
+                bool is_key = msg.message == WM_KEYDOWN || msg.message == WM_SYSKEYDOWN;
+                command_key = is_key ? static_cast<uint>(msg.wParam) : 0;
+
+                bool translated = msg.hwnd == window && TranslateAcceleratorW(window, hotkeys::accelerators, &msg);
+
+                command_key = 0;
+
+                if(!translated) {
 
                     TranslateMessage(&msg);
                     DispatchMessageW(&msg);
                 }
 
-            } else {
+                // timers invalidate for themselves if they need to (the cache governor doesn't)
+
+                if(msg.message != WM_TIMER) {
+                    frames.invalidate();
+                }
+                continue;
+            }
+
+            frame_timer.update();
+
+            double wait = frames.wait_seconds(frame_timer.wall_time());
+
+            if(wait == 0) {
 
                 HRESULT hr = update();
                 if(FAILED(hr)) {
@@ -4492,6 +5840,11 @@ namespace
                     error_message_box(localize(IDS_FATAL_ERROR), hr);
                     break;
                 }
+
+            } else {
+
+                DWORD wait_ms = wait < 0 ? INFINITE : static_cast<DWORD>(ceil(wait * 1000.0));
+                MsgWaitForMultipleObjectsEx(0, null, wait_ms, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
             }
         }
 
@@ -4504,10 +5857,41 @@ namespace
 
         SetEvent(quit_event);
 
+        cancel_folder_scan();
+        folder_watcher::stop();
+        metadata_indexer::stop();
+
+        // cancel what's loading so the scheduler doesn't have to wait for it, then
+        // every load comes back through file_load_done which can't post to the window now
+
+        for(auto const &l : loading_files) {
+            if(l.second->cancel_event != null) {
+                SetEvent(l.second->cancel_event);
+            }
+        }
+
+        file_scheduler.cleanup();
+
+        loading_files.clear();
+
+        for(auto f : orphaned_files) {
+            if(f->cancel_event != null) {
+                CloseHandle(f->cancel_event);
+            }
+            delete f;
+        }
+        orphaned_files.clear();
+
         recent_files::wait_for_recent_files();
 
         thread_pool.cleanup();
 
+        cache_governor.cleanup();
+
+        metrics.report();
+
+        file_scheduler.report();
+
         CloseHandle(quit_event);
         CloseHandle(window_created_event);
 
@@ -4532,6 +5916,5 @@ namespace
 
 int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nShowCmd)
 {
-    main();
-    return 0;
+    return FAILED(main()) ? 1 : 0;
 }
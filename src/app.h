@@ -44,15 +44,23 @@ namespace imageview::app
 
     extern HMODULE instance;
 
+    //////////////////////////////////////////////////////////////////////
+    // the worker threads, for anything which wants to run in the background or parallel_for
+
+    extern thread_pool_t thread_pool;
+
     //////////////////////////////////////////////////////////////////////
     // WM_USER messages for main window
 
     enum user_message_t : uint
     {
         WM_FILE_LOAD_COMPLETE = WM_USER,          // a file load completed (lparam -> file_loader *)
-        WM_FOLDER_SCAN_COMPLETE = WM_USER + 1,    // a folder scan completed (lparam -> folder_scan_results *)
+        WM_FOLDER_SCAN_COMPLETE = WM_USER + 1,    // folder scan results, maybe partial (lparam -> folder_scan_result *)
         WM_NEW_SETTINGS = WM_USER + 2,            // here (lparam is a copy of dialog settings) are some new settings
         WM_RELAUNCH_AS_ADMIN = WM_USER + 3,       // please relaunch the application with admin privileges
+        WM_FOLDER_CHANGED = WM_USER + 4,          // files in the current folder changed (lparam -> folder_changes *)
+        WM_METADATA_INDEXED = WM_USER + 5,        // metadata for some files (lparam -> metadata_indexer::results_t *)
+        WM_REGION_DECODED = WM_USER + 6,          // part of a huge image decoded (lparam -> detail_region_t *)
     };
 
     //////////////////////////////////////////////////////////////////////
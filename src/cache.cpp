@@ -0,0 +1,362 @@
+//////////////////////////////////////////////////////////////////////
+
+#include "pch.h"
+
+LOG_CONTEXT("cache");
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    uint64 constexpr one_mb = 1048576llu;
+
+    // automatic budget is this fraction of physical memory
+
+    uint64 constexpr auto_budget_divisor = 8;
+
+    // but not more than this
+
+    uint64 constexpr max_auto_budget = 16384 * one_mb;
+
+    // and never less than this, even under pressure
+
+    uint64 constexpr min_budget = 16 * one_mb;
+
+    // leave at least this much physical memory free for everyone else
+
+    uint64 constexpr min_reserve = 512 * one_mb;
+
+    // when pressure clears, grow back by at most this fraction of the full budget per update
+
+    uint64 constexpr growth_divisor = 4;
+
+    // budget to use if the memory status can't be had before there's ever been a proper one
+
+    uint64 constexpr fallback_budget = 1024 * one_mb;
+
+    // prefetch depth limits
+
+    int constexpr min_prefetch_depth = 4;
+    int constexpr max_prefetch_depth = 64;
+
+    // weight of each new sample in the moving averages
+
+    double constexpr ewma_weight = 0.25;
+
+    // navigation gaps longer than this are just the user looking at a picture
+
+    double constexpr idle_navigation_seconds = 2.0;
+
+    // when there's time to spare, prefetch about this much decoding (per decoder) ahead
+
+    double constexpr prefetch_work_seconds = 4.0;
+
+    // size in the cache / size of the file until some have been loaded, about right
+    // for a camera jpeg decoded to BGRA32 with its mips
+
+    double constexpr default_expansion = 16.0;
+
+    double ewma(double average, double sample)
+    {
+        if(average == 0) {
+            return sample;
+        }
+        return average + (sample - average) * ewma_weight;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::cache
+{
+    //////////////////////////////////////////////////////////////////////
+    // if not moving, ahead and behind are equally valuable
+
+    int score(int index, int cursor, int direction)
+    {
+        if(index < 0 || cursor < 0) {
+            return not_in_folder_score;
+        }
+
+        int distance = index - cursor;
+
+        if(direction == 0) {
+            return std::abs(distance) * ahead_weight;
+        }
+
+        if(sgn(distance) == sgn(direction)) {
+            return std::abs(distance) * ahead_weight;
+        }
+        return std::abs(distance) * behind_weight;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // merge the ahead and behind sequences by score, ahead wins ties
+
+    void get_prefetch_order(int cursor, int direction, int file_count, int max_files, std::vector<int> &indices)
+    {
+        indices.clear();
+
+        if(cursor < 0 || cursor >= file_count) {
+            return;
+        }
+
+        int ahead = direction < 0 ? -1 : 1;
+
+        int a = cursor + ahead;
+        int b = cursor - ahead;
+
+        while(static_cast<int>(indices.size()) < max_files) {
+
+            bool a_valid = a >= 0 && a < file_count;
+            bool b_valid = b >= 0 && b < file_count;
+
+            if(!a_valid && !b_valid) {
+                break;
+            }
+
+            if(a_valid && (!b_valid || score(a, cursor, direction) <= score(b, cursor, direction))) {
+                indices.push_back(a);
+                a += ahead;
+            } else {
+                indices.push_back(b);
+                b -= ahead;
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void eviction_queue::add(image::image_file *f)
+    {
+        remove(f);
+        int s = score(f->index, current_cursor, current_direction);
+        scores[f] = s;
+        by_score.emplace(s, f);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void eviction_queue::remove(image::image_file *f)
+    {
+        auto found = scores.find(f);
+        if(found != scores.end()) {
+            by_score.erase({ found->second, f });
+            scores.erase(found);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void eviction_queue::clear()
+    {
+        by_score.clear();
+        scores.clear();
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void eviction_queue::set_cursor(int cursor, int direction)
+    {
+        current_cursor = cursor;
+        current_direction = direction;
+
+        by_score.clear();
+
+        for(auto &s : scores) {
+            s.second = score(s.first->index, cursor, direction);
+            by_score.emplace(s.second, s.first);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    image::image_file *eviction_queue::worst() const
+    {
+        if(by_score.empty()) {
+            return null;
+        }
+        return by_score.rbegin()->second;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    int eviction_queue::get_score(image::image_file *f) const
+    {
+        auto found = scores.find(f);
+        if(found == scores.end()) {
+            return not_in_folder_score;
+        }
+        return found->second;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void prefetch_estimator::add_load(double seconds, uint64 bytes, uint64 size)
+    {
+        load_seconds = ewma(load_seconds, seconds);
+        file_size = ewma(file_size, static_cast<double>(size));
+        if(bytes != 0) {
+            expansion = ewma(expansion, static_cast<double>(size) / bytes);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    uint64 prefetch_estimator::cache_size(uint64 bytes) const
+    {
+        double e = expansion != 0 ? expansion : default_expansion;
+        return static_cast<uint64>(static_cast<double>(bytes) * e);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void prefetch_estimator::add_navigation(double seconds)
+    {
+        navigation_seconds = ewma(navigation_seconds, std::min(seconds, idle_navigation_seconds));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // enough files ahead that the next one is ready before the user gets there,
+    // plus as many more as a few seconds of decoding buys when they're cheap,
+    // but no more than fit in the budget
+
+    int prefetch_estimator::depth(uint64 budget, int parallel_loads) const
+    {
+        // nothing measured yet
+
+        if(load_seconds == 0) {
+            return min_prefetch_depth * 3;
+        }
+
+        double nav = navigation_seconds != 0 ? navigation_seconds : idle_navigation_seconds;
+
+        // files ahead needed to stay in front of the user, and the ones behind
+        // which come with them in the prefetch order
+
+        double ahead = ceil(load_seconds / nav) + 1;
+        double needed = ahead + ceil(ahead * ahead_weight / behind_weight);
+
+        // how many a few seconds of decoding is worth
+
+        double affordable = prefetch_work_seconds * std::max(1, parallel_loads) / load_seconds;
+
+        double result = std::max(needed, std::min(affordable, static_cast<double>(max_prefetch_depth)));
+
+        // and they've all got to fit (leaving room for the current one)
+
+        if(file_size > 0) {
+            result = std::min(result, static_cast<double>(budget) / file_size - 1);
+        }
+
+        return std::clamp(static_cast<int>(result), min_prefetch_depth, max_prefetch_depth);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT governor::init()
+    {
+        CHK_NULL(low_memory_notification = CreateMemoryResourceNotification(LowMemoryResourceNotification));
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void governor::cleanup()
+    {
+        if(low_memory_notification != null) {
+            CloseHandle(low_memory_notification);
+            low_memory_notification = null;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // full budget comes from physical memory (or the setting)
+    // then it's clamped so that available memory doesn't drop below the reserve
+
+    bool governor::update(uint64 cache_in_use, bool automatic, uint64 manual_budget)
+    {
+        MEMORYSTATUSEX status;
+        status.dwLength = sizeof(status);
+
+        if(!GlobalMemoryStatusEx(&status)) {
+
+            LOG_ERROR(L"GlobalMemoryStatusEx failed: {}", windows_error_message(GetLastError()));
+
+            // keep the last budget, but don't leave it at 0 (which would empty the cache)
+
+            if(current_budget != 0) {
+                return false;
+            }
+
+            current_budget = fallback_budget;
+
+            if(!automatic) {
+                current_budget = std::max(min_budget, std::min(fallback_budget, manual_budget));
+            }
+            return true;
+        }
+
+        uint64 total = status.ullTotalPhys;
+        uint64 available = status.ullAvailPhys;
+
+        uint64 full_budget = manual_budget;
+
+        if(automatic) {
+            full_budget = std::min(max_auto_budget, total / auto_budget_divisor);
+        }
+
+        full_budget = std::max(min_budget, std::min(full_budget, total / 2));
+
+        // how much more could we use before eating into the reserve (might be negative)
+
+        uint64 reserve = std::max(min_reserve, total / auto_budget_divisor);
+
+        int64 headroom = static_cast<int64>(available) - static_cast<int64>(reserve);
+
+        int64 allowed = static_cast<int64>(cache_in_use) + headroom;
+
+        uint64 new_budget = std::clamp(static_cast<uint64>(std::max<int64>(allowed, 0)), min_budget, full_budget);
+
+        // the system says memory is low, give back half of what we're holding when it starts
+        // while it stays low don't halve again (the memory has been given back already), just don't grow
+
+        BOOL low_memory = FALSE;
+        if(low_memory_notification != null && !QueryMemoryResourceNotification(low_memory_notification, &low_memory)) {
+            low_memory = FALSE;
+        }
+
+        if(low_memory) {
+
+            if(!was_low_memory) {
+                new_budget = std::max(min_budget, std::min(new_budget, cache_in_use / 2));
+            } else if(current_budget != 0) {
+                new_budget = std::min(new_budget, current_budget);
+            }
+        }
+
+        was_low_memory = low_memory != FALSE;
+
+        // shrink at once, grow back gradually so it doesn't oscillate
+
+        if(current_budget != 0 && new_budget > current_budget) {
+            new_budget = std::min(new_budget, current_budget + full_budget / growth_divisor);
+        }
+
+        if(new_budget == current_budget) {
+            return false;
+        }
+
+        LOG_INFO(L"Cache budget {}MB -> {}MB (in use {}MB, {}MB of {}MB available, load {}%{})",
+                 current_budget / one_mb,
+                 new_budget / one_mb,
+                 cache_in_use / one_mb,
+                 available / one_mb,
+                 total / one_mb,
+                 status.dwMemoryLoad,
+                 low_memory ? L", low memory" : L"");
+
+        current_budget = new_budget;
+        return true;
+    }
+}
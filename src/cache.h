@@ -0,0 +1,118 @@
+//////////////////////////////////////////////////////////////////////
+// cache policy - which files to prefetch and which to throw away
+//
+// none of this touches the app globals so it can be poked at in isolation
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::cache
+{
+    //////////////////////////////////////////////////////////////////////
+    // files ahead of the direction of travel are worth this much more than files behind
+
+    int constexpr ahead_weight = 1;
+    int constexpr behind_weight = 3;
+
+    // score for files which aren't in the current folder, they go first
+
+    int constexpr not_in_folder_score = INT_MAX;
+
+    //////////////////////////////////////////////////////////////////////
+    // how costly is it to keep `index` around when the cursor is at `cursor`
+    // and moving in `direction` (-1, 0 or 1). Lower is more valuable
+
+    int score(int index, int cursor, int direction);
+
+    //////////////////////////////////////////////////////////////////////
+    // get up to `max_files` indices around `cursor`, most valuable first
+    // `cursor` itself is not included
+
+    void get_prefetch_order(int cursor, int direction, int file_count, int max_files, std::vector<int> &indices);
+
+    //////////////////////////////////////////////////////////////////////
+    // loaded files ordered by score so eviction is O(log n) per file
+    // rather than a scan of all the loaded files for each one
+
+    struct eviction_queue
+    {
+        void add(image::image_file *f);
+        void remove(image::image_file *f);
+        void clear();
+
+        // cursor moved (or indices changed), rescore everything
+        void set_cursor(int cursor, int direction);
+
+        // least valuable file or null if empty
+        image::image_file *worst() const;
+
+        // score of a file in the queue (or not_in_folder_score if it isn't)
+        int get_score(image::image_file *f) const;
+
+        size_t size() const
+        {
+            return scores.size();
+        }
+
+    private:
+        using entry = std::pair<int, image::image_file *>;
+
+        std::set<entry> by_score;
+        std::unordered_map<image::image_file *, int> scores;
+
+        int current_cursor{ -1 };
+        int current_direction{ 0 };
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // how many files to prefetch - from moving averages of how long a file takes
+    // to load and decode, how big files are and how fast the user is moving
+    // through the folder
+
+    struct prefetch_estimator
+    {
+        // a file of `bytes` took `seconds` to read and decode and is `size` bytes in the cache
+        void add_load(double seconds, uint64 bytes, uint64 size);
+
+        // the cursor moved `seconds` after the previous move
+        void add_navigation(double seconds);
+
+        // how many files to prefetch, `parallel_loads` is how many can decode at once
+        int depth(uint64 budget, int parallel_loads) const;
+
+        // guess how much room a file of `bytes` will take in the cache
+        uint64 cache_size(uint64 bytes) const;
+
+        double load_seconds{ 0 };
+        double file_size{ 0 };
+        double expansion{ 0 };    // size in the cache / size of the file
+        double navigation_seconds{ 0 };
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // cache governor - sizes the cache budget from physical memory and
+    // shrinks it while the system is short of memory
+
+    struct governor
+    {
+        HRESULT init();
+        void cleanup();
+
+        // check memory status and recalculate the budget
+        // automatic: size from physical memory, otherwise manual_budget is the upper limit
+        // returns true if the budget changed
+
+        bool update(uint64 cache_in_use, bool automatic, uint64 manual_budget);
+
+        uint64 budget() const
+        {
+            return current_budget;
+        }
+
+    private:
+        HANDLE low_memory_notification{ null };
+        uint64 current_budget{ 0 };
+        bool was_low_memory{ false };    // so the budget is halved once when memory gets low, not every update
+    };
+}
@@ -0,0 +1,189 @@
+//////////////////////////////////////////////////////////////////////
+
+#include "pch.h"
+
+LOG_CONTEXT("extension_table");
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    //////////////////////////////////////////////////////////////////////
+    // extensions are ascii, anything else can't match so doesn't need lowercasing properly
+
+    wchar lower(wchar c)
+    {
+        return (c >= L'A' && c <= L'Z') ? static_cast<wchar>(c + (L'a' - L'A')) : c;
+    }
+
+    // the string is only hashed once, 64 bits so different extensions don't end up the same
+
+    uint64 hash(wchar const *ext, size_t length)
+    {
+        uint64 h = 0xcbf29ce484222325llu;
+        for(size_t i = 0; i < length; ++i) {
+            h = (h ^ lower(ext[i])) * 0x100000001b3llu;
+        }
+        return h;
+    }
+
+    // then mixed with a seed for the bucket or the slot
+
+    uint32 mix(uint64 h, uint32 seed)
+    {
+        h ^= seed * 0x9e3779b97f4a7c15llu;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdllu;
+        h ^= h >> 33;
+        return static_cast<uint32>(h);
+    }
+
+    // seed 0 picks the bucket, a bucket's seed is never 0
+
+    uint32 constexpr bucket_seed = 0;
+
+    // give up on a bucket (and try a bigger table) after this many seeds
+
+    uint32 constexpr max_seed = 100000;
+}
+
+namespace imageview::image
+{
+    //////////////////////////////////////////////////////////////////////
+    // biggest buckets first while there's lots of room, find a seed for each which
+    // puts all its extensions in free slots
+
+    HRESULT extension_table_t::build(std::vector<std::pair<std::wstring, format_t>> const &extensions)
+    {
+        std::vector<std::pair<std::wstring, format_t> const *> valid;
+        for(auto const &e : extensions) {
+            if(!e.first.empty() && e.first.size() <= max_length) {
+                valid.push_back(&e);
+            }
+        }
+
+        uint32 size = 8;
+        while(size < valid.size() * 2) {
+            size *= 2;
+        }
+
+        for(; size <= 65536; size *= 2) {
+
+            // about 2 extensions per bucket
+
+            uint32 num_buckets = size / 4;
+
+            std::vector<std::vector<std::pair<uint64, std::pair<std::wstring, format_t> const *>>> buckets(num_buckets);
+            for(auto e : valid) {
+                uint64 h = hash(e->first.data(), e->first.size());
+                buckets[mix(h, bucket_seed) & (num_buckets - 1)].emplace_back(h, e);
+            }
+
+            std::vector<uint32> order(num_buckets);
+            for(uint32 i = 0; i < num_buckets; ++i) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&](uint32 a, uint32 b) {
+                return buckets[a].size() > buckets[b].size();
+            });
+
+            std::vector<slot_t> table(size);
+            std::vector<uint32> table_seeds(num_buckets, 1);
+            std::vector<uint32> placed;
+            bool full = false;
+
+            for(uint32 b : order) {
+
+                auto const &bucket = buckets[b];
+                if(bucket.empty()) {
+                    break;
+                }
+
+                // the same extension twice would never fit
+
+                for(size_t i = 0; i < bucket.size(); ++i) {
+                    for(size_t j = i + 1; j < bucket.size(); ++j) {
+                        if(bucket[i].second->first == bucket[j].second->first) {
+                            return E_INVALIDARG;
+                        }
+                    }
+                }
+
+                uint32 seed = 1;
+                for(; seed < max_seed; ++seed) {
+                    placed.clear();
+                    for(auto const &e : bucket) {
+                        uint32 slot = mix(e.first, seed) & (size - 1);
+                        if(table[slot].length != 0 || std::find(placed.begin(), placed.end(), slot) != placed.end()) {
+                            break;
+                        }
+                        placed.push_back(slot);
+                    }
+                    if(placed.size() == bucket.size()) {
+                        break;
+                    }
+                }
+
+                if(seed == max_seed) {
+                    full = true;
+                    break;
+                }
+
+                for(size_t i = 0; i < bucket.size(); ++i) {
+                    slot_t &slot = table[placed[i]];
+                    auto const &[ext, format] = *bucket[i].second;
+                    slot.length = static_cast<uint32>(ext.size());
+                    slot.format = format;
+                    std::copy(ext.begin(), ext.end(), slot.ext);
+                }
+                table_seeds[b] = seed;
+            }
+
+            if(!full) {
+                slots = std::move(table);
+                seeds = std::move(table_seeds);
+                mask = size - 1;
+                LOG_DEBUG(L"{} extensions in {} slots", valid.size(), size);
+                return S_OK;
+            }
+        }
+        return E_FAIL;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    format_t extension_table_t::find(wchar const *ext, size_t length) const
+    {
+        if(slots.empty() || length == 0 || length > max_length) {
+            return format_t::none;
+        }
+        uint64 h = hash(ext, length);
+        uint32 seed = seeds[mix(h, bucket_seed) & (seeds.size() - 1)];
+        slot_t const &slot = slots[mix(h, seed) & mask];
+        if(slot.length != length) {
+            return format_t::none;
+        }
+        for(size_t i = 0; i < length; ++i) {
+            if(lower(ext[i]) != slot.ext[i]) {
+                return format_t::none;
+            }
+        }
+        return slot.format;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    format_t extension_table_t::find_in_name(wchar const *name, size_t length) const
+    {
+        for(size_t i = length; i != 0; --i) {
+            wchar c = name[i - 1];
+            if(c == L'.') {
+                return find(name + i - 1, length - i + 1);
+            }
+            if(c == L'\\' || c == L'/' || c == L':') {
+                break;
+            }
+        }
+        return format_t::none;
+    }
+}
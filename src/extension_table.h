@@ -0,0 +1,68 @@
+//////////////////////////////////////////////////////////////////////
+// loadable extensions in a perfect hash table, built once from the codec list
+// so checking a filename is a hash and one compare, no allocations or locale stuff
+// folder scans check every file in the folder with this
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::image
+{
+    //////////////////////////////////////////////////////////////////////
+    // what sort of file it is going by the extension, so the file list can be limited to one sort
+
+    enum class format_t : uint32
+    {
+        none,    // can't load it
+        jpeg,
+        png,
+        gif,
+        bmp,
+        tiff,
+        webp,
+        heif,
+        other    // there's a codec for it but it's not one of those
+    };
+
+    //////////////////////////////////////////////////////////////////////
+
+    struct extension_table_t
+    {
+        // longest extension (including the dot) that can be matched, longer ones aren't images
+        static size_t constexpr max_length = 16;
+
+        struct slot_t
+        {
+            uint32 length{ 0 };
+            format_t format{ format_t::none };
+            wchar ext[max_length];
+        };
+
+        // hash and displace: the first hash picks a bucket, the bucket's seed picks the slot
+        // every bucket has a seed which puts its extensions in free slots, so each one gets a slot
+        // of its own with the table only twice the size of the list
+
+        std::vector<slot_t> slots;
+        std::vector<uint32> seeds;
+        uint32 mask{ 0 };
+
+        // extensions are lowercase with the dot (".jpg"), E_INVALIDARG if one is repeated
+        // E_FAIL if there are too many to fit
+
+        HRESULT build(std::vector<std::pair<std::wstring, format_t>> const &extensions);
+
+        // an extension (with the dot) in any case
+
+        format_t find(wchar const *ext, size_t length) const;
+
+        // the extension of a filename or path, from the last dot in the last component, same as _wsplitpath
+
+        format_t find_in_name(wchar const *name, size_t length) const;
+
+        bool contains(wchar const *ext, size_t length) const
+        {
+            return find(ext, length) != format_t::none;
+        }
+    };
+}
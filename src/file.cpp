@@ -19,6 +19,115 @@ namespace
         }
         return S_OK;
     }
+
+    // file loads are issued in chunks of this size, cancel_event is checked between them
+
+    DWORD constexpr load_chunk_size = 4 * 1048576;
+
+    // big folder scans send partial results when they've found this many files, then
+    // every time that doubles (so the total cost of sorting the snapshots stays n log n)
+
+    size_t constexpr first_scan_batch_size = 2048;
+
+    //////////////////////////////////////////////////////////////////////
+
+    bool is_dot_or_dotdot(wchar const *name, size_t length)
+    {
+        return (length == 1 && name[0] == L'.') || (length == 2 && name[0] == L'.' && name[1] == L'.');
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // add the loadable files in one folder to `files`, names prefixed with `prefix` (the relative path)
+    // if `subfolders` isn't null, its subfolders are added to that (also prefixed)
+    // links, hidden and system folders are skipped, links can go round in circles or off to another volume
+    // on_block, if there is one, is called after each block of directory entries
+
+    HRESULT scan_one_folder(HANDLE dir_handle,
+                            std::wstring const &prefix,
+                            std::vector<imageview::file::info> &files,
+                            std::vector<std::wstring> *subfolders,
+                            HANDLE cancel_event,
+                            std::function<void()> const &on_block)
+    {
+        using namespace imageview;
+
+        DWORD constexpr not_file = FILE_ATTRIBUTE_DEVICE | FILE_ATTRIBUTE_VIRTUAL | FILE_ATTRIBUTE_OFFLINE;
+        DWORD constexpr skip_folder = FILE_ATTRIBUTE_REPARSE_POINT | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM;
+
+        FILE_INFO_BY_HANDLE_CLASS info_class = FileIdBothDirectoryRestartInfo;
+
+        // 64k for file info buffer should hold at least a few entries
+        std::vector<byte> dir_info(65536);
+
+        while(true) {
+
+            if(!GetFileInformationByHandleEx(dir_handle, info_class, dir_info.data(), (DWORD)dir_info.size())) {
+
+                DWORD err = GetLastError();
+
+                if(err == ERROR_MORE_DATA) {
+
+                    dir_info.resize(dir_info.size() * 2);
+                    continue;
+                }
+
+                if(err == ERROR_NO_MORE_FILES) {
+                    break;
+                }
+                return HRESULT_FROM_WIN32(err);
+            }
+
+            info_class = FileIdBothDirectoryInfo;
+
+            PFILE_ID_BOTH_DIR_INFO f = reinterpret_cast<PFILE_ID_BOTH_DIR_INFO>(dir_info.data());
+
+            while(true) {
+
+#if SLOW_THINGS_DOWN    // artifically slow down folder scanning
+                DWORD x = WaitForSingleObject(cancel_event, (std::rand() % 200) + 200);
+                if(x == WAIT_OBJECT_0) {
+                    return E_ABORT;
+                }
+#endif
+                // scan folder can be cancelled
+                if(WaitForSingleObject(cancel_event, 0) == WAIT_OBJECT_0) {
+                    return E_ABORT;
+                }
+
+                size_t name_length = f->FileNameLength / sizeof(wchar);
+
+                if((f->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+
+                    if(subfolders != null && (f->FileAttributes & skip_folder) == 0 &&
+                       !is_dot_or_dotdot(f->FileName, name_length)) {
+
+                        subfolders->push_back(prefix + std::wstring(f->FileName, name_length));
+                    }
+
+                } else if((f->FileAttributes & not_file) == 0 && image::can_load_filename(f->FileName, name_length)) {
+
+                    // it's something we can load, add it to the vector of files
+                    files.emplace_back(prefix + std::wstring(f->FileName, name_length),
+                                       f->LastWriteTime.QuadPart,
+                                       f->EndOfFile.QuadPart,
+                                       f->FileId.QuadPart);
+                }
+
+                // break out if there are no more in this block
+                if(f->NextEntryOffset == 0) {
+                    break;
+                }
+
+                // skip to next entry in this block
+                f = reinterpret_cast<PFILE_ID_BOTH_DIR_INFO>(reinterpret_cast<byte *>(f) + f->NextEntryOffset);
+            }
+
+            if(on_block) {
+                on_block();
+            }
+        }
+        return S_OK;
+    }
 }
 
 namespace imageview::file
@@ -27,6 +136,7 @@ namespace imageview::file
     // loads a file, size is limited to 4GB or less
     // buffer will be cleared in case of any error, on success contains file contents
     // set cancel_event to cancel the load, it will return E_ABORT in that case
+    // the file is read in chunks and cancel_event is checked between them
     // cancel_event can be null, in which case the load can't be cancelled
     // NOTE: this function suppresses the expected update of LastAccessTime
 
@@ -79,15 +189,6 @@ namespace imageview::file
         }
         DEFER(CloseHandle(overlapped.hEvent));
 
-        // issue the file read
-        if(!ReadFile(file_handle, buffer.data(), file_size.LowPart, null, &overlapped) &&
-           GetLastError() != ERROR_IO_PENDING) {
-
-            return HRESULT_FROM_WIN32(GetLastError());
-        }
-
-        // wait for the file read to complete or cancel signal
-        DWORD bytes_loaded;
         HANDLE handles[2] = { overlapped.hEvent, cancel_event };
         DWORD handle_count = 1;
         if(cancel_event != null) {
@@ -97,44 +198,110 @@ namespace imageview::file
 #if SLOW_THINGS_DOWN    // artifically slow down file loading
         DWORD x = WaitForSingleObject(cancel_event, (std::rand() % 2000) + 1000);
         if(x == WAIT_OBJECT_0) {
-            CancelIo(file_handle);
             return E_ABORT;
         }
 #endif
 
-        switch(WaitForMultipleObjects(handle_count, handles, false, INFINITE)) {
+        // read it in chunks so a cancel gets noticed between them
+
+        DWORD offset = 0;
 
-        // io completed, check we got it all
-        case WAIT_OBJECT_0:
+        while(offset < file_size.LowPart) {
 
-            CHK_BOOL(GetOverlappedResult(file_handle, &overlapped, &bytes_loaded, false));
+            DWORD bytes_to_load = std::min(load_chunk_size, file_size.LowPart - offset);
 
-            if(bytes_loaded != file_size.LowPart) {
+            overlapped.Offset = offset;
+            overlapped.OffsetHigh = 0;
 
-                // didn't get it all, not sure how to find out what went wrong? GetLastError isn't it...
-                // this shouldn't happen because FILE_SHARE_READ but... who knows?
-                return HRESULT_FROM_WIN32(ERROR_IO_INCOMPLETE);
+            // issue the file read
+            if(!ReadFile(file_handle, buffer.data() + offset, bytes_to_load, null, &overlapped) &&
+               GetLastError() != ERROR_IO_PENDING) {
+
+                return HRESULT_FROM_WIN32(GetLastError());
             }
-            // don't clean up the buffer, it's full of good stuff now
-            cleanup_buffer.cancel();
-            return S_OK;
-
-        // cancel requested, cancel the IO and return operation aborted
-        case WAIT_OBJECT_0 + 1:
-            // don't check for CancelIo error status
-            // if it fails, there's nothing we can do about it anyway
-            // and we want to return E_ABORT
-            CancelIo(file_handle);
-            return E_ABORT;
 
-        // this should not be possible
-        case WAIT_ABANDONED:
-            return E_UNEXPECTED;
+            // wait for the file read to complete or cancel signal
+            DWORD bytes_loaded;
+
+            switch(WaitForMultipleObjects(handle_count, handles, false, INFINITE)) {
+
+            // io completed, check we got it all
+            case WAIT_OBJECT_0:
+
+                CHK_BOOL(GetOverlappedResult(file_handle, &overlapped, &bytes_loaded, false));
+
+                if(bytes_loaded != bytes_to_load) {
+
+                    // didn't get it all, not sure how to find out what went wrong? GetLastError isn't it...
+                    // this shouldn't happen because FILE_SHARE_READ but... who knows?
+                    return HRESULT_FROM_WIN32(ERROR_IO_INCOMPLETE);
+                }
+                offset += bytes_loaded;
+                break;
+
+            // cancel requested, cancel the IO and return operation aborted
+            case WAIT_OBJECT_0 + 1:
+                // don't check for CancelIoEx error status
+                // if it fails, there's nothing we can do about it anyway
+                // and we want to return E_ABORT
+                // but do wait for it to finish before the buffer goes away
+                CancelIoEx(file_handle, &overlapped);
+                GetOverlappedResult(file_handle, &overlapped, &bytes_loaded, true);
+                return E_ABORT;
+
+            // this should not be possible
+            case WAIT_ABANDONED:
+                return E_UNEXPECTED;
+
+            // error in WaitForMultipleObjects
+            default:
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+        }
+
+        // don't clean up the buffer, it's full of good stuff now
+        cleanup_buffer.cancel();
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // get volume serial and file id, the same ones scan_folder gets
+
+    HRESULT get_id(std::wstring const &filename, id_t &id)
+    {
+        uint64 date;
+        uint64 size;
+        DWORD attributes;
+        return get_id_and_info(filename, id, date, size, attributes);
+    }
+
+    //////////////////////////////////////////////////////////////////////
 
-        // error in WaitForMultipleObjects
-        default:
+    HRESULT get_id_and_info(std::wstring const &filename, id_t &id, uint64 &date, uint64 &size, DWORD &attributes)
+    {
+        HANDLE h = CreateFileW(filename.c_str(),
+                               FILE_READ_ATTRIBUTES,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               null,
+                               OPEN_EXISTING,
+                               FILE_FLAG_BACKUP_SEMANTICS,
+                               null);
+
+        if(h == INVALID_HANDLE_VALUE) {
             return HRESULT_FROM_WIN32(GetLastError());
         }
+        DEFER(CloseHandle(h));
+
+        BY_HANDLE_FILE_INFORMATION file_info;
+        CHK_BOOL(GetFileInformationByHandle(h, &file_info));
+
+        id.volume = file_info.dwVolumeSerialNumber;
+        id.index = (static_cast<uint64>(file_info.nFileIndexHigh) << 32) | file_info.nFileIndexLow;
+        date = (static_cast<uint64>(file_info.ftLastWriteTime.dwHighDateTime) << 32) |
+               file_info.ftLastWriteTime.dwLowDateTime;
+        size = (static_cast<uint64>(file_info.nFileSizeHigh) << 32) | file_info.nFileSizeLow;
+        attributes = file_info.dwFileAttributes;
+        return S_OK;
     }
 
     //////////////////////////////////////////////////////////////////////
@@ -142,10 +309,11 @@ namespace imageview::file
     HRESULT scan_folder(std::wstring const &path,
                         scan_folder_sort_field sort_field,
                         scan_folder_sort_order order,
-                        folder_scan_result **result,
+                        uint max_depth,
+                        scan_folder_callback const &on_results,
                         HANDLE cancel_event)
     {
-        if(result == null) {
+        if(!on_results) {
             return HRESULT_FROM_WIN32(ERROR_BAD_ARGUMENTS);
         }
 
@@ -165,118 +333,91 @@ namespace imageview::file
             return HRESULT_FROM_WIN32(ERROR_BAD_PATHNAME);
         }
 
-        FILE_INFO_BY_HANDLE_CLASS info_class = FileIdBothDirectoryRestartInfo;
-
-        // 64k for file info buffer should hold at least a few entries
-        std::vector<byte> dir_info(65536);
-
-        auto r = new folder_scan_result();
-
-        CHK_HR(file::get_full_path(path, r->path));
+        std::wstring full_path;
+        CHK_HR(file::get_full_path(path, full_path));
 
-        std::vector<file::info> &files = r->files;
+        std::vector<file::info> files;
 
-        while(true) {
-
-            if(!GetFileInformationByHandleEx(dir_handle, info_class, dir_info.data(), (DWORD)dir_info.size())) {
-
-                DWORD err = GetLastError();
+        size_t next_batch_size = first_scan_batch_size;
 
-                if(err == ERROR_MORE_DATA) {
+        auto is_cancelled = [&]() { return WaitForSingleObject(cancel_event, 0) == WAIT_OBJECT_0; };
 
-                    dir_info.resize(dir_info.size() * 2);
-                    continue;
-                }
+        // send a sorted copy of what's been found so far
 
-                if(err == ERROR_NO_MORE_FILES) {
-                    break;
-                }
-                return HRESULT_FROM_WIN32(err);
+        auto publish = [&](bool complete) {
+            auto r = new folder_scan_result();
+            r->path = full_path;
+            r->volume = main_dir_info.dwVolumeSerialNumber;
+            r->depth = max_depth;
+            r->complete = complete;
+            r->sort_field = sort_field;
+            r->sort_order = order;
+            if(complete) {
+                r->files = std::move(files);
+            } else {
+                r->files = files;
             }
+            sort_files(r->files, sort_field, order);
+            on_results(r);
+        };
 
-            info_class = FileIdBothDirectoryInfo;
-
-            PFILE_ID_BOTH_DIR_INFO f = reinterpret_cast<PFILE_ID_BOTH_DIR_INFO>(dir_info.data());
-
-            while(true) {
-
-#if SLOW_THINGS_DOWN    // artifically slow down folder scanning
-                DWORD x = WaitForSingleObject(cancel_event, (std::rand() % 200) + 200);
-                if(x == WAIT_OBJECT_0) {
-                    return E_ABORT;
-                }
-#endif
-                // scan folder can be cancelled
-                if(WaitForSingleObject(cancel_event, 0) == WAIT_OBJECT_0) {
-                    return E_ABORT;
-                }
-
-                // if it's a normal file
+        // sorting a big batch takes a while, don't bother if nobody wants it
 
-                if((f->FileAttributes & (FILE_ATTRIBUTE_DEVICE | FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_VIRTUAL |
-                                         FILE_ATTRIBUTE_OFFLINE)) == 0) {
-
-                    std::wstring filename = std::wstring(f->FileName, f->FileNameLength / sizeof(wchar));
-
-                    std::wstring extension;
-                    CHK_HR(get_extension(filename, extension));
+        auto publish_batch = [&]() {
+            if(files.size() >= next_batch_size && !is_cancelled()) {
+                publish(false);
+                next_batch_size = files.size() * 2;
+            }
+        };
 
-                    bool supported;
-                    CHK_HR(image::can_load_file_extension(extension, supported));
-                    if(supported) {
+        // the folder itself
 
-                        // it's something we can load, add it to the vector of files
-                        files.emplace_back(filename, f->LastWriteTime.QuadPart);
-                    }
-                }
+        std::vector<std::wstring> folders;
 
-                // break out if there are no more in this block
-                if(f->NextEntryOffset == 0) {
-                    break;
-                }
+        HRESULT hr = scan_one_folder(
+            dir_handle, std::wstring(), files, max_depth != 0 ? &folders : null, cancel_event, publish_batch);
 
-                // skip to next entry in this block
-                f = reinterpret_cast<PFILE_ID_BOTH_DIR_INFO>(reinterpret_cast<byte *>(f) + f->NextEntryOffset);
-            }
+        if(FAILED(hr)) {
+            return hr;
         }
 
-        // sort the files according to the order/field parameters
-        std::sort(files.begin(), files.end(), [=](file::info const &a, file::info const &b) {
+        // then the subfolders, on the thread pool
+
+        auto read_folder = [&](std::wstring const &folder,
+                               std::vector<file::info> &found_files,
+                               std::vector<std::wstring> *found_folders) -> HRESULT {
+            HANDLE subfolder_handle = CreateFileW(std::format(L"{}\\{}", full_path, folder).c_str(),
+                                                  FILE_LIST_DIRECTORY,
+                                                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                                  null,
+                                                  OPEN_EXISTING,
+                                                  FILE_FLAG_BACKUP_SEMANTICS,
+                                                  null);
 
-            // either ascending
-            file::info const *pa = &a;
-            file::info const *pb = &b;
+            // folders which can't be read (no access, gone already) are skipped
 
-            // or descending
-            if(order == scan_folder_sort_order::descending) {
-                pa = &b;
-                pb = &a;
+            if(subfolder_handle == INVALID_HANDLE_VALUE) {
+                return HRESULT_FROM_WIN32(GetLastError());
             }
+            DEFER(CloseHandle(subfolder_handle));
 
-            // by name
-            uint64 fa = 0;
-            uint64 fb = 0;
+            return scan_one_folder(subfolder_handle, folder + L"\\", found_files, found_folders, cancel_event, null);
+        };
 
-            // or date
-            if(sort_field == scan_folder_sort_field::date) {
-                fa = pa->date;
-                fb = pb->date;
-            }
+        hr = scan_subfolders(folders, max_depth, read_folder, files, publish_batch);
 
-            int64_t diff = fa - fb;
+        if(FAILED(hr)) {
+            return hr;
+        }
 
-            // if date the same (or name ordering), compare names
-            if(diff == 0) {
-                diff = StrCmpLogicalW(pa->name.c_str(), pb->name.c_str());
-            }
-            return diff <= 0;
-        });
+        if(is_cancelled()) {
+            return E_ABORT;
+        }
 
-        *result = r;
+        publish(true);
 
         return S_OK;
     }
-
     //////////////////////////////////////////////////////////////////////
 
     BOOL exists(std::wstring const &name)
@@ -17,12 +17,43 @@ namespace imageview::file
     HRESULT path_from_shortcut(std::wstring const &shortcut_filename, std::wstring &path);
     BOOL exists(std::wstring const &name);
 
+    //////////////////////////////////////////////////////////////////////
+    // identifies a file no matter which path (or case) was used to reach it
+
+    struct id_t
+    {
+        uint32 volume{ 0 };    // volume serial number
+        uint64 index{ 0 };     // file id on that volume
+
+        bool operator==(id_t const &) const = default;
+    };
+
+    struct id_hash
+    {
+        size_t operator()(id_t const &id) const
+        {
+            return static_cast<size_t>((id.index ^ (static_cast<uint64>(id.volume) << 32)) * 0x9e3779b97f4a7c15llu);
+        }
+    };
+
+    HRESULT get_id(std::wstring const &filename, id_t &id);
+
+    // get id, last write time, size and attributes in one go
+    HRESULT get_id_and_info(std::wstring const &filename, id_t &id, uint64 &date, uint64 &size, DWORD &attributes);
+
+    // key which sorts about the way StrCmpLogicalW does with a plain compare - case insensitive, digit runs
+    // by value, punctuation before numbers before letters (it doesn't ignore hyphens or apostrophes though)
+    std::wstring natural_sort_key(std::wstring const &name);
+
     //////////////////////////////////////////////////////////////////////
 
     enum class scan_folder_sort_field
     {
         name,
         date,
+        size,
+        captured,     // exif capture date (or date if there isn't one), needs metadata
+        dimensions    // width * height, needs metadata
     };
 
     enum class scan_folder_sort_order
@@ -33,23 +64,178 @@ namespace imageview::file
 
     struct info
     {
-        info(std::wstring const &n, uint64 d) throw() : name(n), date(d)
+        // not noexcept, making the sort key allocates
+        info(std::wstring const &n, uint64 d, uint64 s, uint64 i)
+            : name(n), sort_key(natural_sort_key(n)), date(d), size(s), index(i)
         {
         }
 
         std::wstring name;
+        std::wstring sort_key;    // see natural_sort_key
         uint64 date;
+        uint64 size;
+        uint64 index;    // file id, see id_t
+
+        // from the metadata indexer, only valid if has_metadata
+        uint64 capture_date{ 0 };
+        uint32 width{ 0 };
+        uint32 height{ 0 };
+        bool has_metadata{ false };
+    };
+
+    // does sorting this way need the metadata
+    inline bool sort_needs_metadata(scan_folder_sort_field field)
+    {
+        return field == scan_folder_sort_field::captured || field == scan_folder_sort_field::dimensions;
+    }
+
+    // big lists are sorted on the thread pool
+    void sort_files(std::vector<info> &files, scan_folder_sort_field field, scan_folder_sort_order order);
+
+    //////////////////////////////////////////////////////////////////////
+    // file ids in the same order as a list of files, so when one goes in or out the ones after
+    // it don't all have to be renumbered. It's an order statistic tree (a treap ordered by
+    // position), finding the position of an id and inserting or removing at a position are O(log n)
+
+    struct position_tree
+    {
+        // all of them at once, O(n)
+        void build(std::vector<info> const &files);
+
+        void clear();
+
+        // position of a file id or -1
+        int find(uint64 id) const;
+
+        // `id` goes in at `pos`, the ones from there on move up one
+        void insert(int pos, uint64 id);
+
+        // the one at `pos` goes, the ones after it move down one
+        void remove(int pos);
+
+        int size() const
+        {
+            return count(root);
+        }
+
+    private:
+        struct node_t
+        {
+            uint64 id;
+            uint32 priority;    // parents have higher priority than their children
+            int count;          // nodes in this subtree
+            int parent;
+            int left;
+            int right;
+        };
+
+        int count(int n) const
+        {
+            return n == -1 ? 0 : nodes[n].count;
+        }
+
+        int new_node(uint64 id);
+
+        // set count and the children's parent from the children
+        void update(int n);
+
+        void split(int n, int k, int &l, int &r);
+        int merge(int l, int r);
+
+        // freed nodes are reused
+        std::vector<node_t> nodes;
+        std::vector<int> free_nodes;
+
+        std::unordered_map<uint64, int> node_of_id;
+
+        int root{ -1 };
+
+        uint32 random_state{ 0x9e3779b9 };
     };
 
     struct folder_scan_result
     {
         std::wstring path;
-        std::vector<info> files;
+        uint32 volume{ 0 };
+        std::vector<info> files;    // names are relative to path (so include subfolders if depth > 0)
+        uint depth{ 0 };            // how many levels of subfolders were scanned
+        uint64 change_stamp{ 0 };   // of the folder before it was scanned, for folder_index (0 if not saving it)
+        bool complete{ false };     // false if the scan is still going and more will follow
+
+        scan_folder_sort_field sort_field{ scan_folder_sort_field::name };
+        scan_folder_sort_order sort_order{ scan_folder_sort_order::ascending };
+
+        uint32 format_filter{ 0 };    // only files of this image::format_t, 0 (none) for all of them
+
+        id_t file_id(int i) const
+        {
+            return { volume, files[i].index };
+        }
+
+        // index of a file by name (case insensitive) or -1
+        int find(std::wstring const &name) const;
+
+        // index of a file by id (just the index part, they're all on the same volume) or -1
+        int find_id(uint64 index) const;
+
+        // add a file in the right place, returns where it went
+        int insert(info const &f);
+
+        void remove(int i);
+
+        // sort it again some other way
+        void sort(scan_folder_sort_field field, scan_folder_sort_order order);
+
+        // drop the files `keep` says no to, the rest stay in the same order
+        void filter(std::function<bool(info const &)> const &keep);
+
+    private:
+        // the lookup tables are built the first time they're needed, then insert/remove keep
+        // them up to date (sort just redoes positions) so once files has been filled in
+        // they're the way to change it
+
+        // file id -> index in files, only valid if positions_valid is set
+        mutable position_tree positions;
+        mutable bool positions_valid{ false };
+
+        // lower case name -> file id, only valid if ids_by_name_valid is set
+        mutable std::unordered_map<std::wstring, uint64> ids_by_name;
+        mutable bool ids_by_name_valid{ false };
     };
 
+    // called with a sorted snapshot of the files found so far, which it then owns
+    // the last one (and only one for small folders) is marked complete
+
+    using scan_folder_callback = std::function<void(folder_scan_result *result)>;
+
+    //////////////////////////////////////////////////////////////////////
+    // read one folder (`folder` is relative to the root of the scan): add its images to `files`
+    // and, if `subfolders` isn't null, its subfolders to that (also relative to the root)
+    // E_ABORT stops the whole scan, any other error just skips the folder (what it found before that is kept)
+
+    using read_folder_function = std::function<HRESULT(
+        std::wstring const &folder, std::vector<info> &files, std::vector<std::wstring> *subfolders)>;
+
+    // read `folders` (level 1) and everything under them down to max_depth, adding the images to `files`
+    // each folder goes on the thread pool as soon as it's found, not a level at a time, so a big or slow
+    // folder doesn't hold up the rest of the tree, and the calling thread reads folders too
+    // on_progress, if there is one, is called on the calling thread with the lock on `files` held
+
+    HRESULT scan_subfolders(std::vector<std::wstring> const &folders,
+                            uint max_depth,
+                            read_folder_function const &read_folder,
+                            std::vector<info> &files,
+                            std::function<void()> const &on_progress);
+
+    //////////////////////////////////////////////////////////////////////
+    // max_depth is how many levels of subfolders to include, 0 for just the folder itself
+    // subfolders are scanned on the thread pool (see scan_subfolders)
+    // cancel_event is checked for each entry and before each batch, E_ABORT if it's set
+
     HRESULT scan_folder(std::wstring const &path,
                         scan_folder_sort_field sort_field,
                         scan_folder_sort_order order,
-                        folder_scan_result **result,
+                        uint max_depth,
+                        scan_folder_callback const &on_results,
                         HANDLE cancel_event);
 }
@@ -0,0 +1,653 @@
+//////////////////////////////////////////////////////////////////////
+// sorting a list of files and finding files in it, and walking a folder tree on the thread pool
+// nothing in here touches the file system
+
+#include "pch.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    // sort this many or more files on the thread pool
+
+    size_t constexpr min_parallel_sort_size = 16384;
+
+    // in a natural sort key, a digit run is this then its length then the digits (leading zeros removed)
+    // ascii punctuation is moved down below it (see sort_key_char) so, like StrCmpLogicalW,
+    // punctuation and spaces sort before numbers and numbers sort before letters
+
+    wchar constexpr sort_key_number = L'0';
+
+    //////////////////////////////////////////////////////////////////////
+    // a scan_subfolders in progress, shared with the jobs it queues
+    // a job which starts after the scan has finished does nothing, so it's fine
+    // for them to outlive it (read_folder and files aren't touched then)
+
+    struct tree_scan_t
+    {
+        std::mutex mutex;
+        std::condition_variable changed;
+
+        // folders waiting to be read, and their depth
+        std::deque<std::pair<std::wstring, uint>> todo;
+
+        int reading{ 0 };
+        bool finished{ false };
+        HRESULT hr{ S_OK };
+
+        uint max_depth{ 0 };
+        imageview::file::read_folder_function const *read_folder{ null };
+        std::vector<imageview::file::info> *files{ null };
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // read a folder off the list if there is one, returns how many subfolders were added (-1 if none was read)
+    // `lock` is held before and after
+
+    int read_next_folder(tree_scan_t &scan, std::unique_lock<std::mutex> &lock)
+    {
+        if(scan.todo.empty() || scan.finished || FAILED(scan.hr)) {
+            return -1;
+        }
+
+        auto [folder, depth] = std::move(scan.todo.front());
+        scan.todo.pop_front();
+        scan.reading += 1;
+
+        lock.unlock();
+
+        std::vector<imageview::file::info> found_files;
+        std::vector<std::wstring> found_folders;
+
+        HRESULT hr = (*scan.read_folder)(folder, found_files, depth < scan.max_depth ? &found_folders : null);
+
+        lock.lock();
+
+        scan.reading -= 1;
+
+        int added = 0;
+
+        if(hr == E_ABORT) {
+            scan.hr = E_ABORT;
+        } else {
+            scan.files->insert(scan.files->end(),
+                               std::make_move_iterator(found_files.begin()),
+                               std::make_move_iterator(found_files.end()));
+
+            for(auto &f : found_folders) {
+                scan.todo.emplace_back(std::move(f), depth + 1);
+            }
+            added = static_cast<int>(found_folders.size());
+        }
+
+        scan.changed.notify_all();
+        return added;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a job for each folder added, whoever gets to the list first reads it
+    // if the pool is stopping the calling thread does them all
+
+    void queue_folder_jobs(std::shared_ptr<tree_scan_t> const &scan, int count)
+    {
+        for(int i = 0; i < count; ++i) {
+
+            HRESULT hr = imageview::app::thread_pool.add_job([scan]() {
+                std::unique_lock lock(scan->mutex);
+                int added = read_next_folder(*scan, lock);
+                lock.unlock();
+                queue_folder_jobs(scan, added);
+            });
+
+            if(FAILED(hr)) {
+                break;
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // strict weak ordering (std::sort needs one) - ties are broken by the exact name
+
+    bool file_less(imageview::file::info const &a,
+                   imageview::file::info const &b,
+                   imageview::file::scan_folder_sort_field sort_field,
+                   imageview::file::scan_folder_sort_order order)
+    {
+        using namespace imageview;
+
+        // either ascending
+        file::info const *pa = &a;
+        file::info const *pb = &b;
+
+        // or descending
+        if(order == file::scan_folder_sort_order::descending) {
+            pa = &b;
+            pb = &a;
+        }
+
+        // by date, size etc first
+        uint64 fa = 0;
+        uint64 fb = 0;
+
+        switch(sort_field) {
+
+        case file::scan_folder_sort_field::date:
+            fa = pa->date;
+            fb = pb->date;
+            break;
+
+        case file::scan_folder_sort_field::size:
+            fa = pa->size;
+            fb = pb->size;
+            break;
+
+        case file::scan_folder_sort_field::captured:
+            fa = pa->capture_date != 0 ? pa->capture_date : pa->date;
+            fb = pb->capture_date != 0 ? pb->capture_date : pb->date;
+            break;
+
+        case file::scan_folder_sort_field::dimensions:
+            fa = static_cast<uint64>(pa->width) * pa->height;
+            fb = static_cast<uint64>(pb->width) * pb->height;
+            break;
+
+        default:
+            break;
+        }
+
+        if(fa != fb) {
+            return fa < fb;
+        }
+
+        // then name
+        int diff = pa->sort_key.compare(pb->sort_key);
+        if(diff == 0) {
+            diff = pa->name.compare(pb->name);
+        }
+        return diff < 0;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    std::wstring lower_case(std::wstring const &s)
+    {
+        std::wstring lower(s);
+        CharLowerBuffW(lower.data(), static_cast<DWORD>(lower.size()));
+        return lower;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // squash the four runs of ascii punctuation into 1..34 (keeping their order) so they're all
+    // below sort_key_number, letters and everything past ascii stay where they are
+
+    wchar sort_key_char(wchar c)
+    {
+        if(c >= L' ' && c < L'0') {
+            return static_cast<wchar>(c - 31);    // space to / -> 1..16
+        }
+        if(c > L'9' && c < L'A') {
+            return static_cast<wchar>(c - 41);    // : to @ -> 17..23
+        }
+        if(c > L'Z' && c < L'a') {
+            return static_cast<wchar>(c - 67);    // [ to ` -> 24..29
+        }
+        if(c > L'z' && c < 128) {
+            return static_cast<wchar>(c - 93);    // { to del -> 30..34
+        }
+        return c;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::file
+{
+    //////////////////////////////////////////////////////////////////////
+    // a treap built from the sorted files in one go - each node pops the lower priority
+    // ones off the right spine and they become its left subtree. A node is finished
+    // (its count can be worked out) when it's popped
+
+    void position_tree::build(std::vector<info> const &files)
+    {
+        clear();
+
+        nodes.reserve(files.size());
+        node_of_id.reserve(files.size());
+
+        std::vector<int> spine;
+
+        for(auto const &f : files) {
+
+            int n = new_node(f.index);
+            int last = -1;
+
+            while(!spine.empty() && nodes[spine.back()].priority < nodes[n].priority) {
+                last = spine.back();
+                spine.pop_back();
+                update(last);
+            }
+
+            nodes[n].left = last;
+
+            if(!spine.empty()) {
+                nodes[spine.back()].right = n;
+            }
+            spine.push_back(n);
+        }
+
+        while(!spine.empty()) {
+            root = spine.back();
+            spine.pop_back();
+            update(root);
+        }
+
+        if(root != -1) {
+            nodes[root].parent = -1;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void position_tree::clear()
+    {
+        nodes.clear();
+        free_nodes.clear();
+        node_of_id.clear();
+        root = -1;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // count the nodes before it on the way up to the root
+
+    int position_tree::find(uint64 id) const
+    {
+        auto found = node_of_id.find(id);
+        if(found == node_of_id.end()) {
+            return -1;
+        }
+
+        int n = found->second;
+        int pos = count(nodes[n].left);
+
+        for(int parent = nodes[n].parent; parent != -1; n = parent, parent = nodes[n].parent) {
+            if(nodes[parent].right == n) {
+                pos += count(nodes[parent].left) + 1;
+            }
+        }
+        return pos;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void position_tree::insert(int pos, uint64 id)
+    {
+        int n = new_node(id);
+
+        int l;
+        int r;
+        split(root, pos, l, r);
+
+        root = merge(merge(l, n), r);
+        nodes[root].parent = -1;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void position_tree::remove(int pos)
+    {
+        int l;
+        int m;
+        int r;
+        split(root, pos, l, m);
+        split(m, 1, m, r);
+
+        if(m != -1) {
+
+            // if an id was added twice, the map is for the newer one
+
+            auto found = node_of_id.find(nodes[m].id);
+            if(found != node_of_id.end() && found->second == m) {
+                node_of_id.erase(found);
+            }
+            free_nodes.push_back(m);
+        }
+
+        root = merge(l, r);
+
+        if(root != -1) {
+            nodes[root].parent = -1;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    int position_tree::new_node(uint64 id)
+    {
+        // xorshift, the priorities only have to be spread out
+
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+
+        node_t node{ id, random_state, 1, -1, -1, -1 };
+
+        int n;
+
+        if(free_nodes.empty()) {
+            n = static_cast<int>(nodes.size());
+            nodes.push_back(node);
+        } else {
+            n = free_nodes.back();
+            free_nodes.pop_back();
+            nodes[n] = node;
+        }
+
+        node_of_id[id] = n;
+        return n;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void position_tree::update(int n)
+    {
+        node_t &node = nodes[n];
+
+        node.count = 1 + count(node.left) + count(node.right);
+
+        if(node.left != -1) {
+            nodes[node.left].parent = n;
+        }
+        if(node.right != -1) {
+            nodes[node.right].parent = n;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // first k nodes of the tree at n into l, the rest into r
+
+    void position_tree::split(int n, int k, int &l, int &r)
+    {
+        if(n == -1) {
+            l = -1;
+            r = -1;
+            return;
+        }
+
+        int left_count = count(nodes[n].left);
+
+        if(left_count < k) {
+            split(nodes[n].right, k - left_count - 1, nodes[n].right, r);
+            l = n;
+        } else {
+            split(nodes[n].left, k, l, nodes[n].left);
+            r = n;
+        }
+        update(n);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // everything in l comes before everything in r, higher priority goes on top
+
+    int position_tree::merge(int l, int r)
+    {
+        if(l == -1) {
+            return r;
+        }
+        if(r == -1) {
+            return l;
+        }
+
+        if(nodes[l].priority > nodes[r].priority) {
+            int right = merge(nodes[l].right, r);
+            nodes[l].right = right;
+            update(l);
+            return l;
+        }
+
+        int left = merge(l, nodes[r].left);
+        nodes[r].left = left;
+        update(r);
+        return r;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // big lists are sorted in chunks on the thread pool, then the chunks are merged in pairs
+
+    void sort_files(std::vector<info> &files, scan_folder_sort_field sort_field, scan_folder_sort_order order)
+    {
+        auto less = [=](info const &a, info const &b) { return file_less(a, b, sort_field, order); };
+
+        thread_pool_t &pool = app::thread_pool;
+
+        size_t num_files = files.size();
+
+        int num_chunks = static_cast<int>(std::min<size_t>(pool.worker_count(), num_files / min_parallel_sort_size));
+
+        if(num_chunks < 2) {
+            std::sort(files.begin(), files.end(), less);
+            return;
+        }
+
+        std::vector<size_t> bounds(num_chunks + 1);
+        for(int i = 0; i <= num_chunks; ++i) {
+            bounds[i] = num_files * i / num_chunks;
+        }
+
+        auto begin = files.begin();
+
+        pool.parallel_for(num_chunks, 1, [&](int from, int to) {
+            for(int i = from; i < to; ++i) {
+                std::sort(begin + bounds[i], begin + bounds[i + 1], less);
+            }
+        });
+
+        for(int width = 1; width < num_chunks; width *= 2) {
+
+            int num_merges = (num_chunks + width * 2 - 1) / (width * 2);
+
+            pool.parallel_for(num_merges, 1, [&](int from, int to) {
+                for(int i = from; i < to; ++i) {
+                    int lo = i * width * 2;
+                    int mid = std::min(lo + width, num_chunks);
+                    int hi = std::min(lo + width * 2, num_chunks);
+                    if(mid < hi) {
+                        std::inplace_merge(begin + bounds[lo], begin + bounds[mid], begin + bounds[hi], less);
+                    }
+                }
+            });
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // the calling thread reads folders too until the list is empty and nobody's reading one
+    // (so it works from inside a job, or with no workers)
+
+    HRESULT scan_subfolders(std::vector<std::wstring> const &folders,
+                            uint max_depth,
+                            read_folder_function const &read_folder,
+                            std::vector<info> &files,
+                            std::function<void()> const &on_progress)
+    {
+        if(folders.empty() || max_depth == 0) {
+            return S_OK;
+        }
+
+        auto scan = std::make_shared<tree_scan_t>();
+        scan->max_depth = max_depth;
+        scan->read_folder = &read_folder;
+        scan->files = &files;
+
+        for(auto const &f : folders) {
+            scan->todo.emplace_back(f, 1);
+        }
+
+        queue_folder_jobs(scan, static_cast<int>(folders.size()));
+
+        std::unique_lock lock(scan->mutex);
+
+        while(true) {
+
+            if(on_progress) {
+                on_progress();
+            }
+
+            int added = read_next_folder(*scan, lock);
+
+            if(added > 0) {
+                lock.unlock();
+                queue_folder_jobs(scan, added);
+                lock.lock();
+                continue;
+            }
+
+            if(added == 0) {
+                continue;
+            }
+
+            if(scan->reading == 0) {
+                break;
+            }
+
+            scan->changed.wait(lock);
+        }
+
+        scan->finished = true;
+
+        return scan->hr;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // names -> ids -> positions, so it's the same whichever way the files are sorted
+
+    int folder_scan_result::find(std::wstring const &name) const
+    {
+        if(!ids_by_name_valid) {
+
+            ids_by_name.clear();
+            ids_by_name.reserve(files.size());
+
+            for(auto const &f : files) {
+                ids_by_name[lower_case(f.name)] = f.index;
+            }
+            ids_by_name_valid = true;
+        }
+
+        auto found = ids_by_name.find(lower_case(name));
+        if(found == ids_by_name.end()) {
+            return -1;
+        }
+        return find_id(found->second);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    int folder_scan_result::find_id(uint64 index) const
+    {
+        if(!positions_valid) {
+            positions.build(files);
+            positions_valid = true;
+        }
+        return positions.find(index);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    int folder_scan_result::insert(info const &f)
+    {
+        auto less = [this](info const &a, info const &b) { return file_less(a, b, sort_field, sort_order); };
+
+        auto where = std::upper_bound(files.begin(), files.end(), f, less);
+
+        // insert can reallocate so begin() has to be after it
+
+        auto inserted = files.insert(where, f);
+
+        int pos = static_cast<int>(inserted - files.begin());
+
+        if(positions_valid) {
+            positions.insert(pos, f.index);
+        }
+
+        if(ids_by_name_valid) {
+            ids_by_name[lower_case(f.name)] = f.index;
+        }
+        return pos;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void folder_scan_result::remove(int i)
+    {
+        if(positions_valid) {
+            positions.remove(i);
+        }
+
+        if(ids_by_name_valid) {
+            ids_by_name.erase(lower_case(files[i].name));
+        }
+
+        files.erase(files.begin() + i);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // the names don't change so ids_by_name is still good
+
+    void folder_scan_result::sort(scan_folder_sort_field field, scan_folder_sort_order order)
+    {
+        sort_field = field;
+        sort_order = order;
+        positions_valid = false;
+        sort_files(files, field, order);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void folder_scan_result::filter(std::function<bool(info const &)> const &keep)
+    {
+        std::erase_if(files, [&](info const &f) { return !keep(f); });
+        positions_valid = false;
+        ids_by_name_valid = false;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // "IMG_0012.jpg" -> "img" 28 '0' 2 "12" 15 "jpg"
+
+    std::wstring natural_sort_key(std::wstring const &name)
+    {
+        std::wstring lower = lower_case(name);
+
+        std::wstring key;
+        key.reserve(lower.size() + 8);
+
+        auto is_digit = [&](size_t n) { return lower[n] >= L'0' && lower[n] <= L'9'; };
+
+        size_t len = lower.size();
+        size_t i = 0;
+
+        while(i < len) {
+
+            if(!is_digit(i)) {
+                key += sort_key_char(lower[i]);
+                i += 1;
+                continue;
+            }
+
+            size_t start = i;
+            while(i < len && is_digit(i)) {
+                i += 1;
+            }
+
+            // skip leading zeros, but "0" is still a number
+            while(start < i - 1 && lower[start] == L'0') {
+                start += 1;
+            }
+
+            size_t digits = std::min<size_t>(i - start, 0xffff);
+
+            key += sort_key_number;
+            key += static_cast<wchar>(digits);
+            key.append(lower, start, digits);
+        }
+        return key;
+    }
+}
@@ -0,0 +1,331 @@
+//////////////////////////////////////////////////////////////////////
+// index file layout, all little endian
+//
+//  header_t
+//  entry_t[num_files]      in sorted order, with metadata if it had been read when it was saved
+//  wchar[path_length]      the folder
+//  wchar[names_length]     all the filenames, entries point into this
+//
+// so loading it is one mapped view and a pass over the entries
+
+#include "pch.h"
+
+LOG_CONTEXT("folder_index");
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    uint32 constexpr index_magic = 0x58494649;    // 'IFIX'
+    uint32 constexpr index_version = 5;
+
+    // keep this many, the least recently saved ones are deleted
+
+    size_t constexpr max_index_files = 64;
+
+    //////////////////////////////////////////////////////////////////////
+
+    struct header_t
+    {
+        uint32 magic;
+        uint32 version;
+        uint64 change_stamp;
+        uint32 volume;
+        uint32 sort_field;
+        uint32 sort_order;
+        uint32 format_filter;
+        uint32 num_files;
+        uint32 path_length;
+        uint32 names_length;
+    };
+
+    uint32 constexpr entry_has_metadata = 1;
+
+    struct entry_t
+    {
+        uint64 index;
+        uint64 date;
+        uint64 size;
+        uint64 capture_date;
+        uint32 width;
+        uint32 height;
+        uint32 flags;          // entry_has_metadata
+        uint32 name_offset;    // in wchars from the start of the names
+        uint32 name_length;
+        uint32 reserved;
+    };
+
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT get_index_folder(std::wstring &folder)
+    {
+        PWSTR local_app_data;
+        CHK_HR(SHGetKnownFolderPath(FOLDERID_LocalAppData, KF_FLAG_DEFAULT, null, &local_app_data));
+        DEFER(CoTaskMemFree(local_app_data));
+
+        folder = std::format(L"{}\\ImageView\\folder_index", local_app_data);
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // index files are named after a hash of the (lowercased) folder path
+
+    HRESULT get_index_filename(std::wstring const &path, std::wstring &filename)
+    {
+        std::wstring folder;
+        CHK_HR(get_index_folder(folder));
+
+        uint64 hash = 0xcbf29ce484222325llu;
+        for(wchar c : make_lowercase(path)) {
+            hash = (hash ^ c) * 0x100000001b3llu;
+        }
+        filename = std::format(L"{}\\{:016x}.idx", folder, hash);
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // delete the oldest indexes if there are too many
+
+    void prune_index_files(std::wstring const &folder)
+    {
+        std::vector<std::pair<uint64, std::wstring>> index_files;
+
+        WIN32_FIND_DATAW find_data;
+        HANDLE f = FindFirstFileExW(std::format(L"{}\\*.idx", folder).c_str(),
+                                    FindExInfoBasic,
+                                    &find_data,
+                                    FindExSearchNameMatch,
+                                    null,
+                                    0);
+
+        if(f == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        DEFER(FindClose(f));
+
+        do {
+            uint64 date = (static_cast<uint64>(find_data.ftLastWriteTime.dwHighDateTime) << 32) |
+                          find_data.ftLastWriteTime.dwLowDateTime;
+            index_files.emplace_back(date, find_data.cFileName);
+        } while(FindNextFileW(f, &find_data));
+
+        if(index_files.size() <= max_index_files) {
+            return;
+        }
+
+        std::sort(index_files.begin(), index_files.end());
+
+        for(size_t i = 0; i < index_files.size() - max_index_files; ++i) {
+            LOG_DEBUG(L"Deleting old index {}", index_files[i].second);
+            DeleteFileW(std::format(L"{}\\{}", folder, index_files[i].second).c_str());
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::folder_index
+{
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT get_change_stamp(std::wstring const &path, uint64 &stamp)
+    {
+        file::id_t id;
+        uint64 size;
+        DWORD attributes;
+        return file::get_id_and_info(path, id, stamp, size, attributes);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT load(std::wstring const &path,
+                 uint64 change_stamp,
+                 file::scan_folder_sort_field sort_field,
+                 file::scan_folder_sort_order sort_order,
+                 uint32 format_filter,
+                 file::folder_scan_result **result)
+    {
+        if(result == null) {
+            return E_INVALIDARG;
+        }
+
+        std::wstring filename;
+        CHK_HR(get_index_filename(path, filename));
+
+        // not having one is normal, so no noisy CHK_xxx for that
+
+        HANDLE file_handle = CreateFileW(
+            filename.c_str(), GENERIC_READ, FILE_SHARE_READ, null, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, null);
+
+        if(file_handle == INVALID_HANDLE_VALUE) {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+        DEFER(CloseHandle(file_handle));
+
+        LARGE_INTEGER file_size;
+        CHK_BOOL(GetFileSizeEx(file_handle, &file_size));
+
+        if(file_size.QuadPart < static_cast<LONGLONG>(sizeof(header_t)) || file_size.HighPart != 0) {
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+
+        HANDLE mapping = CreateFileMappingW(file_handle, null, PAGE_READONLY, 0, 0, null);
+        CHK_NULL(mapping);
+        DEFER(CloseHandle(mapping));
+
+        byte const *view = reinterpret_cast<byte const *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        CHK_NULL(view);
+        DEFER(UnmapViewOfFile(view));
+
+        header_t const &header = *reinterpret_cast<header_t const *>(view);
+
+        if(header.magic != index_magic || header.version != index_version) {
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+
+        if(header.change_stamp != change_stamp || header.sort_field != static_cast<uint32>(sort_field) ||
+           header.sort_order != static_cast<uint32>(sort_order) || header.format_filter != format_filter) {
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+
+        uint64 expected_size = sizeof(header_t) + static_cast<uint64>(header.num_files) * sizeof(entry_t) +
+                               (static_cast<uint64>(header.path_length) + header.names_length) * sizeof(wchar);
+
+        if(expected_size != static_cast<uint64>(file_size.QuadPart)) {
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+
+        entry_t const *entries = reinterpret_cast<entry_t const *>(view + sizeof(header_t));
+        wchar const *index_path = reinterpret_cast<wchar const *>(entries + header.num_files);
+        wchar const *names = index_path + header.path_length;
+
+        // different folders could have the same hash
+
+        if(header.path_length != path.size() || _wcsnicmp(index_path, path.c_str(), path.size()) != 0) {
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+
+        auto r = std::make_unique<file::folder_scan_result>();
+
+        r->path = path;
+        r->volume = header.volume;
+        r->change_stamp = change_stamp;
+        r->sort_field = sort_field;
+        r->sort_order = sort_order;
+        r->format_filter = format_filter;
+        r->complete = true;
+
+        r->files.reserve(header.num_files);
+
+        for(uint32 i = 0; i < header.num_files; ++i) {
+
+            entry_t const &e = entries[i];
+
+            if(static_cast<uint64>(e.name_offset) + e.name_length > header.names_length) {
+                return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+            }
+            file::info &f =
+                r->files.emplace_back(std::wstring(names + e.name_offset, e.name_length), e.date, e.size, e.index);
+
+            if((e.flags & entry_has_metadata) != 0) {
+                f.capture_date = e.capture_date;
+                f.width = e.width;
+                f.height = e.height;
+                f.has_metadata = true;
+            }
+        }
+
+        LOG_INFO(L"Loaded index of {} ({} files)", path, header.num_files);
+
+        *result = r.release();
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT save(file::folder_scan_result const &result, uint64 change_stamp)
+    {
+        std::wstring folder;
+        CHK_HR(get_index_folder(folder));
+
+        int err = SHCreateDirectoryExW(null, folder.c_str(), null);
+        if(err != ERROR_SUCCESS && err != ERROR_ALREADY_EXISTS) {
+            return HRESULT_FROM_WIN32(err);
+        }
+
+        std::wstring filename;
+        CHK_HR(get_index_filename(result.path, filename));
+
+        // build it all in memory and write it in one go
+
+        std::vector<entry_t> entries;
+        entries.reserve(result.files.size());
+
+        std::wstring names;
+
+        for(auto const &f : result.files) {
+            entries.push_back({ f.index,
+                                f.date,
+                                f.size,
+                                f.capture_date,
+                                f.width,
+                                f.height,
+                                f.has_metadata ? entry_has_metadata : 0,
+                                static_cast<uint32>(names.size()),
+                                static_cast<uint32>(f.name.size()),
+                                0 });
+            names += f.name;
+        }
+
+        header_t header{};
+        header.magic = index_magic;
+        header.version = index_version;
+        header.change_stamp = change_stamp;
+        header.volume = result.volume;
+        header.sort_field = static_cast<uint32>(result.sort_field);
+        header.sort_order = static_cast<uint32>(result.sort_order);
+        header.format_filter = result.format_filter;
+        header.num_files = static_cast<uint32>(entries.size());
+        header.path_length = static_cast<uint32>(result.path.size());
+        header.names_length = static_cast<uint32>(names.size());
+
+        std::vector<byte> buffer;
+
+        auto append = [&](void const *data, size_t size) {
+            byte const *p = reinterpret_cast<byte const *>(data);
+            buffer.insert(buffer.end(), p, p + size);
+        };
+
+        append(&header, sizeof(header));
+        append(entries.data(), entries.size() * sizeof(entry_t));
+        append(result.path.data(), result.path.size() * sizeof(wchar));
+        append(names.data(), names.size() * sizeof(wchar));
+
+        // write to a temp file and rename it so a reader never sees half of one
+
+        std::wstring temp_filename = filename + L".tmp";
+
+        {
+            HANDLE file_handle = CreateFileW(
+                temp_filename.c_str(), GENERIC_WRITE, 0, null, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, null);
+
+            if(file_handle == INVALID_HANDLE_VALUE) {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+            DEFER(CloseHandle(file_handle));
+
+            DWORD wrote;
+            CHK_BOOL(WriteFile(file_handle, buffer.data(), static_cast<DWORD>(buffer.size()), &wrote, null));
+        }
+
+        CHK_BOOL(MoveFileExW(temp_filename.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING));
+
+        LOG_INFO(L"Saved index of {} ({} files, {} bytes)", result.path, result.files.size(), buffer.size());
+
+        prune_index_files(folder);
+
+        return S_OK;
+    }
+}
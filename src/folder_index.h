@@ -0,0 +1,27 @@
+//////////////////////////////////////////////////////////////////////
+// sorted folder scan results saved in LocalAppData so a big folder
+// can be shown straight away next time it's opened
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::folder_index
+{
+    // don't bother saving folders with fewer files than this, scanning them is quick anyway
+    size_t constexpr min_files = 1000;
+
+    // get the change stamp of a folder (the last write time, which changes when files are added/removed/renamed)
+    HRESULT get_change_stamp(std::wstring const &path, uint64 &stamp);
+
+    // load a saved index, fails if there isn't one or it's out of date or sorted or filtered differently
+    HRESULT load(std::wstring const &path,
+                 uint64 change_stamp,
+                 file::scan_folder_sort_field sort_field,
+                 file::scan_folder_sort_order sort_order,
+                 uint32 format_filter,
+                 file::folder_scan_result **result);
+
+    // save a complete scan
+    HRESULT save(file::folder_scan_result const &result, uint64 change_stamp);
+}
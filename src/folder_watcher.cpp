@@ -0,0 +1,127 @@
+//////////////////////////////////////////////////////////////////////
+
+#include "pch.h"
+
+LOG_CONTEXT("folder_watcher");
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    std::thread watch_thread;
+
+    std::unique_ptr<folder_watcher::backend_t> backend;
+
+    //////////////////////////////////////////////////////////////////////
+    // fill in id and date of a file which has appeared or changed
+    // returns false if it's not interesting (gone already, a folder, not an image)
+
+    bool get_file_details(folder_watcher::backend_t *watcher, folder_watcher::change_t &change)
+    {
+        if(!image::can_load_filename(change.name.data(), change.name.size())) {
+            return false;
+        }
+        return watcher->get_details(change);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void watch(folder_watcher::backend_t *watcher,
+               std::wstring path,
+               bool subtree,
+               folder_watcher::changes_callback on_changes)
+    {
+        std::vector<folder_watcher::event_t> events;
+
+        while(true) {
+
+            auto changes = new folder_watcher::folder_changes();
+
+            events.clear();
+
+            if(!watcher->wait(events, changes->overflow)) {
+                delete changes;
+                return;
+            }
+
+            if(changes->overflow) {
+                LOG_INFO(L"Too many changes in {}", path);
+            }
+
+            for(auto const &e : events) {
+
+                folder_watcher::change_t change;
+                change.action = e.action;
+                change.name = e.name;
+
+                switch(e.action) {
+
+                // a folder turning up in the tree means a bunch of files nobody was told about
+
+                case folder_watcher::action_t::added:
+                    if(e.is_folder) {
+                        changes->overflow |= subtree;
+                    } else if(get_file_details(watcher, change)) {
+                        changes->changes.push_back(change);
+                    }
+                    break;
+
+                case folder_watcher::action_t::removed:
+                    changes->changes.push_back(change);
+                    break;
+
+                case folder_watcher::action_t::modified:
+                    if(!e.is_folder && get_file_details(watcher, change)) {
+                        changes->changes.push_back(change);
+                    }
+                    break;
+                }
+            }
+
+            if(changes->changes.empty() && !changes->overflow) {
+                delete changes;
+                continue;
+            }
+
+            LOG_DEBUG(L"{} changes in {}", changes->changes.size(), path);
+
+            on_changes(changes);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::folder_watcher
+{
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT start(std::wstring const &path, bool subtree, changes_callback const &on_changes)
+    {
+        stop();
+
+        HRESULT hr = create_backend(path, subtree, backend);
+        if(FAILED(hr)) {
+            return hr;
+        }
+
+        LOG_INFO(L"Watching {}{}", path, subtree ? L" and subfolders" : L"");
+
+        watch_thread = std::thread(watch, backend.get(), path, subtree, on_changes);
+
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void stop()
+    {
+        if(watch_thread.joinable()) {
+            backend->stop();
+            watch_thread.join();
+        }
+        backend.reset();
+    }
+}
@@ -0,0 +1,80 @@
+//////////////////////////////////////////////////////////////////////
+// watch the current folder for files being added, removed, renamed or changed
+// changes are gathered on a thread of its own and handed over in batches
+// the OS specific part is a backend - ReadDirectoryChangesW on Windows, inotify on Linux
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::folder_watcher
+{
+    enum class action_t
+    {
+        added,       // new file (or the new name of a renamed one)
+        removed,     // file went away (or the old name of a renamed one)
+        modified     // contents or timestamp changed
+    };
+
+    //////////////////////////////////////////////////////////////////////
+
+    struct change_t
+    {
+        action_t action{ action_t::added };
+        std::wstring name;    // no path
+        uint64 index{ 0 };    // file id (not for removed)
+        uint64 date{ 0 };     // last write time (not for removed)
+        uint64 size{ 0 };     // (not for removed)
+    };
+
+    //////////////////////////////////////////////////////////////////////
+
+    struct folder_changes
+    {
+        std::vector<change_t> changes;
+        bool overflow{ false };    // too many changes to keep track of, rescan the folder
+    };
+
+    // called on the watcher thread, it owns the changes
+    // it mustn't wait for the main thread (which might be waiting in stop()) so PostMessage, not SendMessage
+    using changes_callback = std::function<void(folder_changes *changes)>;
+
+    // start watching a folder (stops watching any previous one)
+    // with subtree, changes in subfolders are included and their names are relative paths
+    HRESULT start(std::wstring const &path, bool subtree, changes_callback const &on_changes);
+
+    // stop watching and wait for the thread to finish
+    void stop();
+
+    //////////////////////////////////////////////////////////////////////
+    // what a backend says happened, before it's been checked to see if it's an image
+
+    struct event_t
+    {
+        action_t action{ action_t::added };
+        std::wstring name;        // relative to the folder being watched
+        bool is_folder{ false };  // it's a folder (only matters for added, when watching subfolders)
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // the part which talks to the OS, there's one of these per folder being watched
+    // wait() is called on the watcher thread, stop() on any thread
+
+    struct backend_t
+    {
+        virtual ~backend_t() = default;
+
+        // block until something happens, false if stop() was called (or it broke)
+        // overflow means some events were lost, so the folder has to be scanned again
+        virtual bool wait(std::vector<event_t> &events, bool &overflow) = 0;
+
+        // fill in the index, date and size of `change.name`, false if it's not a file (any more)
+        virtual bool get_details(change_t &change) = 0;
+
+        // make wait() return false
+        virtual void stop() = 0;
+    };
+
+    // folder_watcher_win32.cpp or folder_watcher_inotify.cpp, depending on the build
+    HRESULT create_backend(std::wstring const &path, bool subtree, std::unique_ptr<backend_t> &backend);
+}
@@ -0,0 +1,268 @@
+//////////////////////////////////////////////////////////////////////
+// folder_watcher backend for Linux, inotify with an eventfd to wake it up
+// the app only builds on Windows, this is here so the watcher can be tested anywhere (see tests/)
+
+#include "pch.h"
+
+#if defined(__linux__)
+
+#include <dirent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    // what ReadDirectoryChangesW is asked for - names coming and going and files being written
+
+    uint32 constexpr watch_mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE;
+
+    // seconds from 1601 (FILETIME) to 1970 (unix time)
+
+    uint64 constexpr filetime_epoch_seconds = 11644473600llu;
+
+    //////////////////////////////////////////////////////////////////////
+    // file names are utf8 on Linux
+
+    std::string to_utf8(std::wstring const &s)
+    {
+        std::string r;
+        for(wchar_t w : s) {
+            uint32 c = static_cast<uint32>(w);
+            if(c < 0x80) {
+                r += static_cast<char>(c);
+            } else if(c < 0x800) {
+                r += static_cast<char>(0xc0 | (c >> 6));
+                r += static_cast<char>(0x80 | (c & 0x3f));
+            } else if(c < 0x10000) {
+                r += static_cast<char>(0xe0 | (c >> 12));
+                r += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+                r += static_cast<char>(0x80 | (c & 0x3f));
+            } else {
+                r += static_cast<char>(0xf0 | (c >> 18));
+                r += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+                r += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+                r += static_cast<char>(0x80 | (c & 0x3f));
+            }
+        }
+        return r;
+    }
+
+    std::wstring from_utf8(std::string const &s)
+    {
+        std::wstring r;
+        for(size_t i = 0; i < s.size();) {
+            uint32 c = static_cast<byte>(s[i]);
+            int extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+            c &= extra == 0 ? 0x7f : (0x3f >> extra);
+            i += 1;
+            for(int n = 0; n < extra && i < s.size(); ++n, ++i) {
+                c = (c << 6) | (static_cast<byte>(s[i]) & 0x3f);
+            }
+            r += static_cast<wchar_t>(c);
+        }
+        return r;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // inotify doesn't do subtrees, each folder gets a watch of its own
+
+    struct inotify_backend : folder_watcher::backend_t
+    {
+        std::string path;
+        bool subtree{ false };
+
+        int inotify_fd{ -1 };
+        int wake_fd{ -1 };
+
+        // watch descriptor -> folder relative to path ("" or "sub/folder/")
+        std::unordered_map<int, std::string> folders;
+
+        std::vector<byte> buffer;
+
+        ~inotify_backend()
+        {
+            if(wake_fd != -1) {
+                close(wake_fd);
+            }
+            if(inotify_fd != -1) {
+                close(inotify_fd);
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////
+
+        HRESULT init()
+        {
+            inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+            if(inotify_fd == -1 || wake_fd == -1) {
+                return E_FAIL;
+            }
+
+            if(!add_folder(std::string())) {
+                return E_FAIL;
+            }
+
+            buffer.resize(65536);
+            return S_OK;
+        }
+
+        //////////////////////////////////////////////////////////////////////
+        // watch a folder, and the ones in it if it's a subtree watch
+
+        bool add_folder(std::string const &relative)
+        {
+            std::string full = relative.empty() ? path : path + "/" + relative;
+
+            int wd = inotify_add_watch(inotify_fd, full.c_str(), watch_mask | IN_ONLYDIR);
+            if(wd == -1) {
+                return false;
+            }
+
+            folders[wd] = relative.empty() ? std::string() : relative + "/";
+
+            if(!subtree) {
+                return true;
+            }
+
+            DIR *dir = opendir(full.c_str());
+            if(dir == null) {
+                return true;
+            }
+            DEFER(closedir(dir));
+
+            while(dirent *d = readdir(dir)) {
+                std::string name = d->d_name;
+                if(d->d_type == DT_DIR && name != "." && name != "..") {
+                    add_folder(relative.empty() ? name : relative + "/" + name);
+                }
+            }
+            return true;
+        }
+
+        //////////////////////////////////////////////////////////////////////
+
+        bool wait(std::vector<folder_watcher::event_t> &events, bool &overflow) override
+        {
+            while(events.empty() && !overflow) {
+
+                pollfd fds[2] = { { inotify_fd, POLLIN, 0 }, { wake_fd, POLLIN, 0 } };
+
+                if(poll(fds, 2, -1) == -1) {
+                    if(errno == EINTR) {
+                        continue;
+                    }
+                    return false;
+                }
+
+                if((fds[1].revents & POLLIN) != 0) {
+                    return false;
+                }
+
+                ssize_t got = read(inotify_fd, buffer.data(), buffer.size());
+
+                if(got <= 0) {
+                    continue;
+                }
+
+                for(ssize_t i = 0; i < got;) {
+
+                    auto const *n = reinterpret_cast<inotify_event const *>(buffer.data() + i);
+                    i += sizeof(inotify_event) + n->len;
+
+                    if((n->mask & IN_Q_OVERFLOW) != 0) {
+                        overflow = true;
+                        continue;
+                    }
+
+                    auto folder = folders.find(n->wd);
+
+                    if((n->mask & IN_IGNORED) != 0) {
+                        if(folder != folders.end()) {
+                            folders.erase(folder);
+                        }
+                        continue;
+                    }
+
+                    if(folder == folders.end() || n->len == 0) {
+                        continue;
+                    }
+
+                    std::string relative = folder->second + n->name;
+
+                    folder_watcher::event_t e;
+                    e.name = from_utf8(relative);
+                    e.is_folder = (n->mask & IN_ISDIR) != 0;
+
+                    if((n->mask & (IN_CREATE | IN_MOVED_TO)) != 0) {
+                        e.action = folder_watcher::action_t::added;
+                        if(e.is_folder && subtree) {
+                            add_folder(relative);
+                        }
+                    } else if((n->mask & (IN_DELETE | IN_MOVED_FROM)) != 0) {
+                        e.action = folder_watcher::action_t::removed;
+                    } else {
+                        e.action = folder_watcher::action_t::modified;
+                    }
+                    events.push_back(e);
+                }
+            }
+            return true;
+        }
+
+        //////////////////////////////////////////////////////////////////////
+        // the inode is the file id, the date is a FILETIME like on Windows
+
+        bool get_details(folder_watcher::change_t &change) override
+        {
+            struct stat s;
+            if(stat((path + "/" + to_utf8(change.name)).c_str(), &s) != 0 || !S_ISREG(s.st_mode)) {
+                return false;
+            }
+
+            change.index = static_cast<uint64>(s.st_ino);
+            change.size = static_cast<uint64>(s.st_size);
+            change.date = (static_cast<uint64>(s.st_mtim.tv_sec) + filetime_epoch_seconds) * 10000000llu +
+                          static_cast<uint64>(s.st_mtim.tv_nsec) / 100;
+            return true;
+        }
+
+        //////////////////////////////////////////////////////////////////////
+
+        void stop() override
+        {
+            uint64 one = 1;
+            (void)write(wake_fd, &one, sizeof(one));
+        }
+    };
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::folder_watcher
+{
+    HRESULT create_backend(std::wstring const &path, bool subtree, std::unique_ptr<backend_t> &backend)
+    {
+        auto b = std::make_unique<inotify_backend>();
+        b->path = to_utf8(path);
+        b->subtree = subtree;
+
+        HRESULT hr = b->init();
+        if(FAILED(hr)) {
+            return hr;
+        }
+
+        backend = std::move(b);
+        return S_OK;
+    }
+}
+
+#endif
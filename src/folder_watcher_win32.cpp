@@ -0,0 +1,213 @@
+//////////////////////////////////////////////////////////////////////
+// folder_watcher backend for Windows, ReadDirectoryChangesW on an overlapped folder handle
+
+#include "pch.h"
+
+LOG_CONTEXT("folder_watcher");
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    // new names, deletes and writes (a file being written can cause lots of these)
+
+    DWORD constexpr notify_filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE;
+
+    // when watching subfolders too, folders being added/removed/renamed matter
+
+    DWORD constexpr notify_subtree_filter = notify_filter | FILE_NOTIFY_CHANGE_DIR_NAME;
+
+    // if more changes than fit in here happen between reads, the folder gets rescanned
+
+    DWORD constexpr notify_buffer_size = 65536;
+
+    //////////////////////////////////////////////////////////////////////
+
+    struct win32_backend : folder_watcher::backend_t
+    {
+        std::wstring path;
+        bool subtree{ false };
+
+        HANDLE dir_handle{ INVALID_HANDLE_VALUE };
+        HANDLE stop_event{ null };
+        OVERLAPPED overlapped{};
+
+        // FILE_NOTIFY_INFORMATION needs to be DWORD aligned
+
+        std::vector<DWORD> buffer;
+
+        ~win32_backend()
+        {
+            if(overlapped.hEvent != null) {
+                CloseHandle(overlapped.hEvent);
+            }
+            if(stop_event != null) {
+                CloseHandle(stop_event);
+            }
+            if(dir_handle != INVALID_HANDLE_VALUE) {
+                CloseHandle(dir_handle);
+            }
+        }
+
+        //////////////////////////////////////////////////////////////////////
+
+        HRESULT init()
+        {
+            dir_handle = CreateFileW(path.c_str(),
+                                     FILE_LIST_DIRECTORY,
+                                     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                     null,
+                                     OPEN_EXISTING,
+                                     FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                                     null);
+
+            if(dir_handle == INVALID_HANDLE_VALUE) {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+
+            stop_event = CreateEventW(null, true, false, null);
+            if(stop_event == null) {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+
+            overlapped.hEvent = CreateEventW(null, true, false, null);
+            if(overlapped.hEvent == null) {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+
+            buffer.resize(notify_buffer_size / sizeof(DWORD));
+            return S_OK;
+        }
+
+        //////////////////////////////////////////////////////////////////////
+
+        bool wait(std::vector<folder_watcher::event_t> &events, bool &overflow) override
+        {
+            if(!ReadDirectoryChangesW(dir_handle,
+                                      buffer.data(),
+                                      notify_buffer_size,
+                                      subtree,
+                                      subtree ? notify_subtree_filter : notify_filter,
+                                      null,
+                                      &overlapped,
+                                      null)) {
+
+                LOG_ERROR(L"Can't watch {}: {}", path, windows_error_message(GetLastError()));
+                return false;
+            }
+
+            DWORD got;
+
+            HANDLE handles[2] = { stop_event, overlapped.hEvent };
+
+            if(WaitForMultipleObjects(2, handles, false, INFINITE) != WAIT_OBJECT_0 + 1) {
+                CancelIoEx(dir_handle, &overlapped);
+                GetOverlappedResult(dir_handle, &overlapped, &got, true);
+                return false;
+            }
+
+            if(!GetOverlappedResult(dir_handle, &overlapped, &got, false)) {
+                LOG_ERROR(L"Error watching {}: {}", path, windows_error_message(GetLastError()));
+                return false;
+            }
+
+            // zero bytes means the changes didn't fit in the buffer and have been lost
+
+            if(got == 0) {
+                overflow = true;
+                return true;
+            }
+
+            byte const *p = reinterpret_cast<byte const *>(buffer.data());
+
+            while(true) {
+
+                auto const *n = reinterpret_cast<FILE_NOTIFY_INFORMATION const *>(p);
+
+                folder_watcher::event_t e;
+                e.name = std::wstring(n->FileName, n->FileNameLength / sizeof(wchar));
+
+                switch(n->Action) {
+
+                case FILE_ACTION_ADDED:
+                case FILE_ACTION_RENAMED_NEW_NAME:
+                    e.action = folder_watcher::action_t::added;
+                    e.is_folder = subtree && is_folder(e.name);
+                    events.push_back(e);
+                    break;
+
+                case FILE_ACTION_REMOVED:
+                case FILE_ACTION_RENAMED_OLD_NAME:
+                    e.action = folder_watcher::action_t::removed;
+                    events.push_back(e);
+                    break;
+
+                case FILE_ACTION_MODIFIED:
+                    e.action = folder_watcher::action_t::modified;
+                    events.push_back(e);
+                    break;
+                }
+
+                if(n->NextEntryOffset == 0) {
+                    break;
+                }
+                p += n->NextEntryOffset;
+            }
+            return true;
+        }
+
+        //////////////////////////////////////////////////////////////////////
+
+        bool get_details(folder_watcher::change_t &change) override
+        {
+            file::id_t id;
+            DWORD attributes;
+            std::wstring filename = std::format(L"{}\\{}", path, change.name);
+
+            if(FAILED(file::get_id_and_info(filename, id, change.date, change.size, attributes))) {
+                return false;
+            }
+
+            if((attributes & (FILE_ATTRIBUTE_DIRECTORY | FILE_ATTRIBUTE_DEVICE)) != 0) {
+                return false;
+            }
+
+            change.index = id.index;
+            return true;
+        }
+
+        //////////////////////////////////////////////////////////////////////
+
+        void stop() override
+        {
+            SetEvent(stop_event);
+        }
+
+        //////////////////////////////////////////////////////////////////////
+
+        bool is_folder(std::wstring const &name) const
+        {
+            DWORD attributes = GetFileAttributesW(std::format(L"{}\\{}", path, name).c_str());
+            return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        }
+    };
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::folder_watcher
+{
+    HRESULT create_backend(std::wstring const &path, bool subtree, std::unique_ptr<backend_t> &backend)
+    {
+        auto b = std::make_unique<win32_backend>();
+        b->path = path;
+        b->subtree = subtree;
+
+        CHK_HR(b->init());
+
+        backend = std::move(b);
+        return S_OK;
+    }
+}
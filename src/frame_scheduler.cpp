@@ -0,0 +1,75 @@
+//////////////////////////////////////////////////////////////////////
+
+#include "pch.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview
+{
+    //////////////////////////////////////////////////////////////////////
+
+    void frame_scheduler_t::invalidate()
+    {
+        dirty = true;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void frame_scheduler_t::animate()
+    {
+        animating = true;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void frame_scheduler_t::wake_at(double time)
+    {
+        if(wake_time < 0 || time < wake_time) {
+            wake_time = time;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    bool frame_scheduler_t::frame_due(double now) const
+    {
+        return dirty || animating || (wake_time >= 0 && now >= wake_time);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    double frame_scheduler_t::wait_seconds(double now) const
+    {
+        if(frame_due(now)) {
+            return 0;
+        }
+        if(wake_time < 0) {
+            return -1;
+        }
+        return wake_time - now;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    double frame_scheduler_t::begin_frame(double now)
+    {
+        // if the last frame wasn't animating, the time since then was spent waiting, not animating
+
+        double delta = idle_frame_seconds;
+
+        if(was_animating) {
+            delta = std::clamp(now - last_frame_time, 0.0, max_frame_seconds);
+        }
+
+        was_animating = animating;
+        last_frame_time = now;
+
+        dirty = false;
+        animating = false;
+
+        if(wake_time >= 0 && now >= wake_time) {
+            wake_time = -1;
+        }
+        return delta;
+    }
+}
@@ -0,0 +1,46 @@
+//////////////////////////////////////////////////////////////////////
+// decides when a frame needs drawing so the main loop can wait for messages
+// the rest of the time instead of redrawing at the refresh rate forever
+// no windows stuff in here, times are just seconds from any clock
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview
+{
+    struct frame_scheduler_t
+    {
+        // used as the frame time for the first frame after being idle so animations don't jump
+        static constexpr double idle_frame_seconds = 1.0 / 60.0;
+
+        // longest frame time handed to animations
+        static constexpr double max_frame_seconds = 0.25;
+
+        // something changed, draw the next frame
+        void invalidate();
+
+        // something is animating, draw the next frame too (ask again every frame while it's going)
+        void animate();
+
+        // draw a frame at this time even if nothing else happens
+        void wake_at(double time);
+
+        // should a frame be drawn now
+        bool frame_due(double now) const;
+
+        // seconds until a frame is due, 0 if one is due now, < 0 if nothing is pending (wait for messages)
+        double wait_seconds(double now) const;
+
+        // starting a frame, returns seconds since the last one for animations
+        // requests which were due are cleared, the frame renews them if it's still animating
+        double begin_frame(double now);
+
+    private:
+        bool dirty{ true };
+        bool animating{ false };
+        bool was_animating{ false };
+        double wake_time{ -1 };    // < 0 means none
+        double last_frame_time{ 0 };
+    };
+}
@@ -89,6 +89,79 @@ namespace
         return (width * bits_per_pixel + 7u) / 8u;
     }
 
+    //////////////////////////////////////////////////////////////////////
+    // where to find exif DateTimeOriginal, jpeg has it in app1, tiff based formats at the top
+
+    wchar const *exif_date_queries[] = { L"/app1/ifd/exif/{ushort=36867}", L"/ifd/exif/{ushort=36867}" };
+
+    //////////////////////////////////////////////////////////////////////
+    // exif dates are "YYYY:MM:DD HH:MM:SS", cameras write all sorts of junk in there so check it
+    // it's local time with no zone, assume it's this one so it can be compared with file times (which are UTC)
+
+    bool parse_exif_date(char const *text, uint64 &date)
+    {
+        int year, month, day, hour, minute, second;
+
+        if(sscanf_s(text, "%d:%d:%d %d:%d:%d", &year, &month, &day, &hour, &minute, &second) != 6) {
+            return false;
+        }
+
+        SYSTEMTIME st{};
+        st.wYear = static_cast<WORD>(year);
+        st.wMonth = static_cast<WORD>(month);
+        st.wDay = static_cast<WORD>(day);
+        st.wHour = static_cast<WORD>(hour);
+        st.wMinute = static_cast<WORD>(minute);
+        st.wSecond = static_cast<WORD>(second);
+
+        SYSTEMTIME utc;
+        if(!TzSpecificLocalTimeToSystemTime(null, &st, &utc)) {
+            return false;
+        }
+
+        FILETIME ft;
+        if(!SystemTimeToFileTime(&utc, &ft)) {
+            return false;
+        }
+
+        date = (static_cast<uint64>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+        return true;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // decode in bands of this many rows, checking for cancel between them
+
+    uint constexpr decode_band_height = 256;
+
+    //////////////////////////////////////////////////////////////////////
+
+    bool is_cancelled(HANDLE cancel_event)
+    {
+        return cancel_event != null && WaitForSingleObject(cancel_event, 0) == WAIT_OBJECT_0;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // CopyPixels a band at a time so a decode can be abandoned part way through
+    // returns E_ABORT if cancel_event gets set
+
+    HRESULT copy_pixels_in_bands(
+        IWICBitmapSource *src, uint width, uint height, uint pitch, byte *pixels, HANDLE cancel_event)
+    {
+        for(uint y = 0; y < height; y += decode_band_height) {
+
+            if(is_cancelled(cancel_event)) {
+                return E_ABORT;
+            }
+
+            uint rows = std::min(decode_band_height, height - y);
+
+            WICRect rc{ 0, static_cast<INT>(y), static_cast<INT>(width), static_cast<INT>(rows) };
+
+            CHK_HR(src->CopyPixels(&rc, pitch, pitch * rows, pixels + static_cast<size_t>(pitch) * y));
+        }
+        return S_OK;
+    }
+
     //////////////////////////////////////////////////////////////////////
     // get new width and height where neither exceeds max_texture_size
 
@@ -98,6 +171,65 @@ namespace
         return { static_cast<LONG>(s.cx * f), static_cast<LONG>(s.cy * f) };
     }
 
+    //////////////////////////////////////////////////////////////////////
+    // get the EXIF orientation of a frame as a WIC transform
+
+    WICBitmapTransformOptions get_orientation(IWICBitmapFrameDecode *frame)
+    {
+        WICBitmapTransformOptions transform = WICBitmapTransformRotate0;
+
+        ComPtr<IWICMetadataQueryReader> mqr;
+        if(SUCCEEDED(frame->GetMetadataQueryReader(&mqr))) {
+
+            wchar const *orientation_flag = L"/app1/ifd/{ushort=274}";
+
+            PROPVARIANT var;
+            PropVariantInit(&var);
+
+            if(SUCCEEDED(mqr->GetMetadataByName(orientation_flag, &var))) {
+                if(var.vt == VT_UI2) {
+                    transform = convert_exif_to_wic_transform(var.uiVal);
+                }
+            }
+        }
+        return transform;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // put a format converter on the end of a chain if it's not 32bpp BGRA already
+
+    HRESULT convert_to_bgra(IWICImagingFactory *wic, ComPtr<IWICBitmapSource> &bmp_src)
+    {
+        // Force 32 bpp BGRA dest format
+        WICPixelFormatGUID dst_format = GUID_WICPixelFormat32bppBGRA;
+
+        // get source pixel format
+        WICPixelFormatGUID src_format;
+        CHK_HR(bmp_src->GetPixelFormat(&src_format));
+
+        if(dst_format == src_format) {
+            return S_OK;
+        }
+
+        ComPtr<IWICFormatConverter> fmt_converter;
+        CHK_HR(wic->CreateFormatConverter(&fmt_converter));
+
+        // some formats have > 4 channels, in which case we're out of luck
+
+        BOOL can_convert = FALSE;
+        CHK_HR(fmt_converter->CanConvert(src_format, dst_format, &can_convert));
+        if(!can_convert) {
+            return HRESULT_FROM_WIN32(ERROR_UNSUPPORTED_TYPE);
+        }
+
+        WICBitmapDitherType dither = WICBitmapDitherTypeErrorDiffusion;
+        WICBitmapPaletteType palette = WICBitmapPaletteTypeMedianCut;
+        CHK_HR(fmt_converter->Initialize(bmp_src.Get(), dst_format, dither, null, 0, palette));
+
+        bmp_src.Attach(fmt_converter.Detach());
+        return S_OK;
+    }
+
     //////////////////////////////////////////////////////////////////////
     // scan WIC supported file types for Decode or Encode
 
@@ -217,6 +349,36 @@ namespace
 
         return S_OK;
     }
+
+    //////////////////////////////////////////////////////////////////////
+    // which of the formats the file list can be limited to a codec is for
+
+    imageview::image::format_t format_of(GUID const &container_format)
+    {
+        using imageview::image::format_t;
+
+        static std::pair<GUID const *, format_t> const formats[] = {
+            { &GUID_ContainerFormatJpeg, format_t::jpeg },
+            { &GUID_ContainerFormatPng, format_t::png },
+            { &GUID_ContainerFormatGif, format_t::gif },
+            { &GUID_ContainerFormatBmp, format_t::bmp },
+            { &GUID_ContainerFormatTiff, format_t::tiff },
+            { &GUID_ContainerFormatWebp, format_t::webp },
+            { &GUID_ContainerFormatHeif, format_t::heif },
+        };
+
+        for(auto const &f : formats) {
+            if(memcmp(f.first, &container_format, sizeof(GUID)) == 0) {
+                return f.second;
+            }
+        }
+        return format_t::other;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // can_load_filename checks every file in a folder scan against this
+
+    imageview::image::extension_table_t load_extensions;
 }
 
 namespace imageview::image
@@ -231,6 +393,12 @@ namespace imageview::image
         CHK_HR(enum_codecs(WICEncoder, save_filetypes));
         CHK_HR(enum_codecs(WICDecoder, load_filetypes));
 
+        std::vector<std::pair<std::wstring, format_t>> extensions;
+        for(auto const &f : load_filetypes.container_formats) {
+            extensions.emplace_back(f.first, format_of(f.second));
+        }
+        CHK_HR(load_extensions.build(extensions));
+
         return S_OK;
     }
 
@@ -272,6 +440,66 @@ namespace imageview::image
         return S_OK;
     }
 
+    //////////////////////////////////////////////////////////////////////
+    // dimensions and capture date, for sorting
+    // this gets called for every file in a folder, plenty of which will be broken, so no CHK_HR noise
+
+    HRESULT get_metadata(std::wstring const &filename, metadata_t &metadata)
+    {
+        auto wic = get_wic();
+
+        if(wic == null) {
+            return E_NOINTERFACE;
+        }
+
+        ComPtr<IWICBitmapDecoder> decoder;
+        HRESULT hr = wic->CreateDecoderFromFilename(
+            filename.c_str(), null, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder);
+
+        if(FAILED(hr)) {
+            return hr;
+        }
+
+        ComPtr<IWICBitmapFrameDecode> frame;
+        hr = decoder->GetFrame(0, &frame);
+
+        if(FAILED(hr)) {
+            return hr;
+        }
+
+        uint w, h;
+        hr = frame->GetSize(&w, &h);
+
+        if(FAILED(hr)) {
+            return hr;
+        }
+
+        metadata.width = w;
+        metadata.height = h;
+        metadata.capture_date = 0;
+
+        ComPtr<IWICMetadataQueryReader> mqr;
+        if(SUCCEEDED(frame->GetMetadataQueryReader(&mqr))) {
+
+            for(wchar const *query : exif_date_queries) {
+
+                PROPVARIANT var;
+                PropVariantInit(&var);
+
+                if(SUCCEEDED(mqr->GetMetadataByName(query, &var))) {
+
+                    bool got_date = var.vt == VT_LPSTR && parse_exif_date(var.pszVal, metadata.capture_date);
+                    PropVariantClear(&var);
+
+                    if(got_date) {
+                        break;
+                    }
+                }
+            }
+        }
+        return S_OK;
+    }
+
     /////////////////////////////////////////////////////////////////////
     // copy image as a png to the clipboard
 
@@ -354,8 +582,9 @@ namespace imageview::image
 
     //////////////////////////////////////////////////////////////////////
     // Decode an image into a pixel buffer and get dimensions
+    // set cancel_event to abandon the decode, it will return E_ABORT in that case
 
-    HRESULT decode(image_file *file)
+    HRESULT decode(image_file *file, HANDLE cancel_event)
     {
         LOG_DEBUG(L"DECODE {}", file->filename);
 
@@ -406,22 +635,7 @@ namespace imageview::image
 
         // get EXIF tag for image orientation
 
-        WICBitmapTransformOptions transform = WICBitmapTransformRotate0;
-
-        ComPtr<IWICMetadataQueryReader> mqr;
-        if(SUCCEEDED(frame->GetMetadataQueryReader(&mqr))) {
-
-            wchar const *orientation_flag = L"/app1/ifd/{ushort=274}";
-
-            PROPVARIANT var;
-            PropVariantInit(&var);
-
-            if(SUCCEEDED(mqr->GetMetadataByName(orientation_flag, &var))) {
-                if(var.vt == VT_UI2) {
-                    transform = convert_exif_to_wic_transform(var.uiVal);
-                }
-            }
-        }
+        WICBitmapTransformOptions transform = get_orientation(frame.Get());
 
         // line up any necessary transforms:
 
@@ -435,8 +649,13 @@ namespace imageview::image
 
         CHK_HR(bmp_src->GetSize(&w, &h));
 
-        SIZE dst_size{ static_cast<LONG>(w), static_cast<LONG>(h) };
-        SIZE src_size = constrain_dimensions(dst_size);
+        SIZE src_size{ static_cast<LONG>(w), static_cast<LONG>(h) };
+        SIZE dst_size = constrain_dimensions(src_size);
+
+        bool swap_dimensions = transform == WICBitmapTransformRotate90 || transform == WICBitmapTransformRotate270;
+
+        uint full_w = swap_dimensions ? h : w;
+        uint full_h = swap_dimensions ? w : h;
 
         if(dst_size.cx != src_size.cx || dst_size.cy != src_size.cy) {
 
@@ -451,38 +670,55 @@ namespace imageview::image
 
         // 2. convert pixel format if necessary
 
-        // Force 32 bpp BGRA dest format
-        WICPixelFormatGUID dst_format = GUID_WICPixelFormat32bppBGRA;
+        HRESULT hr = convert_to_bgra(wic, bmp_src);
 
-        // get source pixel format
-        WICPixelFormatGUID src_format;
-        CHK_HR(bmp_src->GetPixelFormat(&src_format));
+        if(FAILED(hr)) {
+            return hr;
+        }
+
+        // 3. get final size, exif rotate swaps width and height
 
-        if(dst_format != src_format) {
+        CHK_HR(bmp_src->GetSize(&w, &h));
 
-            ComPtr<IWICFormatConverter> fmt_converter;
-            CHK_HR(wic->CreateFormatConverter(&fmt_converter));
+        if(w == 0 || h == 0) {
+            return E_UNEXPECTED;
+        }
 
-            // some formats have > 4 channels, in which case we're out of luck
+        uint out_w = swap_dimensions ? h : w;
+        uint out_h = swap_dimensions ? w : h;
 
-            BOOL can_convert = FALSE;
-            CHK_HR(fmt_converter->CanConvert(src_format, dst_format, &can_convert));
-            if(!can_convert) {
-                return HRESULT_FROM_WIN32(ERROR_UNSUPPORTED_TYPE);
-            }
+        // allocate output buffer
 
-            WICBitmapDitherType dither = WICBitmapDitherTypeErrorDiffusion;
-            WICBitmapPaletteType palette = WICBitmapPaletteTypeMedianCut;
-            CHK_HR(fmt_converter->Initialize(bmp_src.Get(), dst_format, dither, null, 0, palette));
+        uint64 t_row_pitch = bytes_per_row(out_w);
+        uint64 total_bytes = t_row_pitch * out_h;
 
-            bmp_src.Attach(fmt_converter.Detach());
+        if(total_bytes > UINT32_MAX) {
+            return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
         }
 
-        // 3. apply exif transform if necessary
+        file->pixels.resize((size_t)total_bytes);
 
-        if(transform != WICBitmapTransformRotate0) {
+        // if CopyPixels fails, free the buffer on exit
 
-            // pre-decode the pixels as recommended here
+        auto release_pixels = defer::deferred([&]() { file->pixels.clear(); });
+
+        // actually get the pixels
+
+        LOG_DEBUG(L"DECODE {}", file->filename);
+
+        if(transform == WICBitmapTransformRotate0) {
+
+            hr = copy_pixels_in_bands(bmp_src.Get(), w, h, (uint32)t_row_pitch, file->pixels.data(), cancel_event);
+
+            if(FAILED(hr)) {
+                return hr;
+            }
+
+        } else {
+
+            // 4. apply exif transform - decode the pixels as-is and flip/rotate them here
+
+            // this used to use IWICBitmapFlipRotator with a pre-decode as recommended here
             // https://docs.microsoft.com/en-us/windows/win32/api/wincodec/nn-wincodec-iwicbitmapfliprotator
 
             // "IWICBitmapFipRotator requests data on a per-pixel basis, while WIC codecs provide data
@@ -491,83 +727,152 @@ namespace imageview::image
             // an entire scanline to be decoded in the file. It is recommended that you buffer the image
             // using IWICBitmap, or flip/rotate the image using Direct2D."
 
-            // TODO(chs): ditch this and just maintain the transform as a member of the image struct,
-            // although that makes drawing/copying from it more of a hassle
+            // but it's still a pixel at a time, so do it in bands on the thread pool instead
 
-            uint64 pitch = bytes_per_row(dst_size.cx);
+            uint64 src_pitch = bytes_per_row(w);
 
-            if(pitch * dst_size.cx >= UINT32_MAX) {
+            if(src_pitch * h > UINT32_MAX) {
                 return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
             }
 
-            ComPtr<IWICBitmap> decoded_src;
-            CHK_HR(
-                wic_factory->CreateBitmap(dst_size.cx, dst_size.cy, dst_format, WICBitmapCacheOnDemand, &decoded_src));
+            std::vector<byte> decoded((size_t)(src_pitch * h));
 
-            // decode the image as-is into decoded_src
-            {
-                ComPtr<IWICBitmapLock> lock;
-                CHK_HR(decoded_src->Lock(null, WICBitmapLockWrite, &lock));
+            hr = copy_pixels_in_bands(bmp_src.Get(), w, h, (uint32)src_pitch, decoded.data(), cancel_event);
 
-                uint buffer_size;
-                WICInProcPointer data;
-                CHK_HR(lock->GetDataPointer(&buffer_size, &data));
+            if(FAILED(hr)) {
+                return hr;
+            }
 
-                assert(data != null);    // satisfy the analyzer...
+            image_t decoded_img{ decoded.data(), w, h, (uint32)src_pitch };
 
-                CHK_HR(bmp_src->CopyPixels(null, (uint32)pitch, buffer_size, data));
-            }
+            CHK_HR(pixel_convert::transform(
+                decoded_img, transform, { file->pixels.data(), out_w, out_h, (uint32)t_row_pitch }));
+        }
 
-            // add in the transformer from the decoded pixels
+        // 5. the rest of the mip chain while we're on a worker, gamma correct unlike GenerateMips
 
-            ComPtr<IWICBitmapFlipRotator> flip_rotater;
-            CHK_HR(wic->CreateBitmapFlipRotator(&flip_rotater));
+        image_t img{ file->pixels.data(), out_w, out_h, (uint32)t_row_pitch };
 
-            flip_rotater->Initialize(decoded_src.Get(), transform);
+        hr = mip_chain::build(img, file->mip_pixels, file->mips, cancel_event);
 
-            bmp_src.Attach(flip_rotater.Detach());
+        if(FAILED(hr)) {
+            return hr;
         }
 
-        // transforms are all lined up, get final size because rotate might have swapped width, height
+        // don't free the buffer now, it's full of good stuff
 
-        CHK_HR(bmp_src->GetSize(&w, &h));
+        release_pixels.cancel();
 
-        if(w == 0 || h == 0) {
-            return E_UNEXPECTED;
+        // return dimensions to caller
+
+        file->img = img;
+        file->full_width = full_w;
+        file->full_height = full_h;
+
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // WIC only asks the decoder for the rows (and columns, for tiled formats) which overlap the clip
+    // rectangle, so this reads the bits of the file it needs rather than the whole thing
+
+    HRESULT decode_region(std::wstring const &filename,
+                          RECT const &rect,
+                          float scale,
+                          std::vector<byte> &pixels,
+                          image_t &img,
+                          HANDLE cancel_event)
+    {
+        if(rect.right <= rect.left || rect.bottom <= rect.top || scale <= 0 || scale > 1) {
+            return E_INVALIDARG;
         }
 
-        // allocate output buffer
+        auto wic = get_wic();
 
-        uint64 t_row_pitch = bytes_per_row(w);
-        uint64 total_bytes = t_row_pitch * h;
+        if(!wic) {
+            return E_NOINTERFACE;
+        }
 
-        if(total_bytes > UINT32_MAX) {
-            return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+        ComPtr<IWICBitmapDecoder> decoder;
+        CHK_HR(wic->CreateDecoderFromFilename(
+            filename.c_str(), null, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder));
+
+        ComPtr<IWICBitmapFrameDecode> frame;
+        CHK_HR(decoder->GetFrame(0, &frame));
+
+        WICBitmapTransformOptions transform = get_orientation(frame.Get());
+
+        uint w, h;
+        CHK_HR(frame->GetSize(&w, &h));
+
+        // rect is in the transformed image, find it in the file
+
+        RECT s = pixel_convert::source_rect(rect, w, h, transform);
+        WICRect src{ s.left, s.top, s.right - s.left, s.bottom - s.top };
+
+        if(src.X < 0 || src.Y < 0 || static_cast<uint>(src.X + src.Width) > w ||
+           static_cast<uint>(src.Y + src.Height) > h) {
+            return E_BOUNDS;
         }
 
-        file->pixels.resize((size_t)total_bytes);
+        ComPtr<IWICBitmapClipper> clipper;
+        CHK_HR(wic->CreateBitmapClipper(&clipper));
+        CHK_HR(clipper->Initialize(frame.Get(), &src));
 
-        // if CopyPixels fails, free the buffer on exit
+        ComPtr<IWICBitmapSource> bmp_src;
+        CHK_HR(clipper.As(&bmp_src));
 
-        auto release_pixels = defer::deferred([&]() { file->pixels.clear(); });
+        uint src_w = std::max(1u, static_cast<uint>(lrintf(src.Width * scale)));
+        uint src_h = std::max(1u, static_cast<uint>(lrintf(src.Height * scale)));
 
-        // actually get the pixels
+        if(src_w != static_cast<uint>(src.Width) || src_h != static_cast<uint>(src.Height)) {
 
-        LOG_DEBUG(L"DECODE {}", file->filename);
+            ComPtr<IWICBitmapScaler> scaler;
+            CHK_HR(wic->CreateBitmapScaler(&scaler));
+            CHK_HR(scaler->Initialize(bmp_src.Get(), src_w, src_h, WICBitmapInterpolationModeFant));
 
-        CHK_HR(bmp_src->CopyPixels(null, (uint32)t_row_pitch, (uint32)total_bytes, file->pixels.data()));
+            bmp_src.Attach(scaler.Detach());
+        }
 
-        // don't free the buffer now, it's full of good stuff
+        HRESULT hr = convert_to_bgra(wic, bmp_src);
 
-        release_pixels.cancel();
+        if(FAILED(hr)) {
+            return hr;
+        }
 
-        // return dimensions to caller
+        uint32 src_pitch = static_cast<uint32>(bytes_per_row(src_w));
 
-        file->img.width = w;
-        file->img.height = h;
-        file->img.row_pitch = (uint32)t_row_pitch;
+        bool swap_dimensions = transform == WICBitmapTransformRotate90 || transform == WICBitmapTransformRotate270;
 
-        file->img.pixels = file->pixels.data();
+        uint out_w = swap_dimensions ? src_h : src_w;
+        uint out_h = swap_dimensions ? src_w : src_h;
+        uint32 out_pitch = static_cast<uint32>(bytes_per_row(out_w));
+
+        if(transform == WICBitmapTransformRotate0) {
+
+            pixels.resize(static_cast<size_t>(src_pitch) * src_h);
+
+            hr = copy_pixels_in_bands(bmp_src.Get(), src_w, src_h, src_pitch, pixels.data(), cancel_event);
+
+        } else {
+
+            std::vector<byte> decoded(static_cast<size_t>(src_pitch) * src_h);
+
+            hr = copy_pixels_in_bands(bmp_src.Get(), src_w, src_h, src_pitch, decoded.data(), cancel_event);
+
+            if(SUCCEEDED(hr)) {
+                pixels.resize(static_cast<size_t>(out_pitch) * out_h);
+                hr = pixel_convert::transform(
+                    { decoded.data(), src_w, src_h, src_pitch }, transform, { pixels.data(), out_w, out_h, out_pitch });
+            }
+        }
+
+        if(FAILED(hr)) {
+            pixels.clear();
+            return hr;
+        }
+
+        img = { pixels.data(), out_w, out_h, out_pitch };
 
         return S_OK;
     }
@@ -708,7 +1013,8 @@ namespace imageview::image
                            ID3D11DeviceContext *d3d_context,
                            ID3D11Texture2D **texture,
                            ID3D11ShaderResourceView **srv,
-                           image_t &image)
+                           image_t const &image,
+                           std::vector<image_t> const &mips)
     {
         if(d3d_device == null || d3d_context == null || texture == null || srv == null) {
             return E_INVALIDARG;
@@ -753,6 +1059,24 @@ namespace imageview::image
             id = null;
         }
 
+        // if the decoder made the mip chain, upload it all at once
+
+        std::vector<D3D11_SUBRESOURCE_DATA> levels;
+
+        if(!mips.empty()) {
+
+            autogen = false;
+
+            levels.push_back(initData);
+            for(auto const &m : mips) {
+                levels.push_back({ m.pixels, m.row_pitch, static_cast<uint>(m.size()) });
+            }
+
+            desc.MipLevels = static_cast<uint>(levels.size());
+            SRVDesc.Texture2D.MipLevels = desc.MipLevels;
+            id = levels.data();
+        }
+
         ComPtr<ID3D11Texture2D> tex;
         CHK_HR(d3d_device->CreateTexture2D(&desc, id, &tex));
 
@@ -774,16 +1098,27 @@ namespace imageview::image
 
     HRESULT can_load_file_extension(std::wstring const &extension, bool &is_supported)
     {
-        std::wstring ext = make_lowercase(extension);
-
-        auto found = load_filetypes.container_formats.find(ext);
-        is_supported = found != load_filetypes.container_formats.end();
+        is_supported = load_extensions.contains(extension.data(), extension.size());
 
         return S_OK;
     }
 
     //////////////////////////////////////////////////////////////////////
 
+    bool can_load_filename(wchar const *name, size_t length)
+    {
+        return get_format(name, length) != format_t::none;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    format_t get_format(wchar const *name, size_t length)
+    {
+        return load_extensions.find_in_name(name, length);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
     HRESULT image_flip_horizontal(image_t &image)
     {
         return S_OK;
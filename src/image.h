@@ -58,14 +58,23 @@ namespace imageview::image
 
     struct image_file
     {
-        std::wstring filename;           // file path, use this as key for map
+        std::wstring filename;           // file path
+        file::id_t id;                   // volume + file id, use this as key for map
         std::vector<byte> bytes;         // file contents, once it has been loaded
         HRESULT hresult{ E_PENDING };    // error code or S_OK from load_file()
         int index{ -1 };                 // position in the list of files
         int view_count{ 0 };             // how many times this has been viewed since being loaded
         bool is_cache_load{ false };     // true if being loaded just for cache (don't call warm_cache when it arrives)
         std::vector<byte> pixels;        // decoded pixels from the file, format is always BGRA32
+        std::vector<byte> mip_pixels;    // the rest of the mip chain, built along with the decode
+        std::vector<image_t> mips;       // levels 1..n in mip_pixels, empty means the gpu has to make them
+        uint full_width{ 0 };            // size of the image in the file, bigger than img if it had to be
+        uint full_height{ 0 };           // shrunk to fit in a texture
         bool is_clipboard{ false };      // is it the dummy clipboard image_file?
+        HANDLE cancel_event{ null };     // set this to abandon the load/decode, closed when the load completes
+        timer_t load_timer;              // started when the load was requested
+        double read_seconds{ 0 };        // time spent reading it (not waiting)
+        double decode_seconds{ 0 };      // time spent decoding it
 
         image_t img{};
 
@@ -79,7 +88,7 @@ namespace imageview::image
             if(!is_decoded()) {
                 return 0;
             }
-            return bytes.size() + img.size();
+            return bytes.size() + img.size() + mip_pixels.size();
         }
     };
 
@@ -89,17 +98,48 @@ namespace imageview::image
                            ID3D11DeviceContext *d3d_context,
                            ID3D11Texture2D **texture,
                            ID3D11ShaderResourceView **srv,
-                           image_t &image);
+                           image_t const &image,
+                           std::vector<image_t> const &mips);
 
     //////////////////////////////////////////////////////////////////////
 
     HRESULT can_load_file_extension(std::wstring const &extension, bool &is_supported);
 
+    // check a filename (or path) without copying it, e.g. straight out of a directory listing
+    bool can_load_filename(wchar const *name, size_t length);
+
+    //////////////////////////////////////////////////////////////////////
+    // what sort of file it is going by the extension (format_t is in extension_table.h)
+
+    format_t get_format(wchar const *name, size_t length);
+
     HRESULT init_filetypes();
 
     HRESULT get_size(std::wstring const &filename, uint32 &width, uint32 &height, uint64 &total_size);
 
-    HRESULT decode(image_file *file);
+    //////////////////////////////////////////////////////////////////////
+    // what can be found out about an image file from its headers, without decoding it
+
+    struct metadata_t
+    {
+        uint32 width{ 0 };
+        uint32 height{ 0 };
+        uint64 capture_date{ 0 };    // exif DateTimeOriginal as a UTC FILETIME, 0 if there isn't one
+    };
+
+    HRESULT get_metadata(std::wstring const &filename, metadata_t &metadata);
+
+    HRESULT decode(image_file *file, HANDLE cancel_event = null);
+
+    // decode part of an image file, `rect` is in pixels of the full size image (after any exif rotation)
+    // and it's scaled by `scale` (0 < scale <= 1), only the tiles/strips/rows it overlaps are decoded
+
+    HRESULT decode_region(std::wstring const &filename,
+                          RECT const &rect,
+                          float scale,
+                          std::vector<byte> &pixels,
+                          image_t &img,
+                          HANDLE cancel_event = null);
 
     HRESULT copy_pixels_as_png(byte const *pixels, uint w, uint h);
 
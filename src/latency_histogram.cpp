@@ -0,0 +1,73 @@
+//////////////////////////////////////////////////////////////////////
+// telemetry::latency_histogram counting, the text and json are in telemetry.cpp
+
+#include "pch.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    //////////////////////////////////////////////////////////////////////
+    // bucket i is [2^i, 2^(i+1)) ms except bucket 0 starts at 0 and the last one has no top
+
+    double bucket_low(int bucket)
+    {
+        return bucket == 0 ? 0.0 : static_cast<double>(1llu << bucket);
+    }
+
+    double bucket_high(int bucket)
+    {
+        return static_cast<double>(1llu << (bucket + 1));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::telemetry
+{
+    //////////////////////////////////////////////////////////////////////
+
+    void latency_histogram::add(double milliseconds)
+    {
+        int bucket = 0;
+        while(bucket < num_buckets - 1 && milliseconds >= bucket_high(bucket)) {
+            bucket += 1;
+        }
+        buckets[bucket] += 1;
+        min_ms = (count == 0) ? milliseconds : std::min(min_ms, milliseconds);
+        max_ms = std::max(max_ms, milliseconds);
+        count += 1;
+        total_ms += milliseconds;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // find the bucket the p'th sample is in and how far through it, then
+    // go that far between the bucket's bounds
+
+    double latency_histogram::percentile(double p) const
+    {
+        if(count == 0) {
+            return 0;
+        }
+        double rank = static_cast<double>(count) * std::clamp(p, 0.0, 100.0) / 100.0;
+        double below = 0;
+        for(int i = 0; i < num_buckets; ++i) {
+
+            if(buckets[i] == 0) {
+                continue;
+            }
+
+            double in_bucket = static_cast<double>(buckets[i]);
+
+            if(below + in_bucket >= rank) {
+
+                double high = (i == num_buckets - 1) ? max_ms : std::min(max_ms, bucket_high(i));
+                double low = std::clamp(min_ms, bucket_low(i), high);
+
+                return low + (high - low) * (rank - below) / in_bucket;
+            }
+            below += in_bucket;
+        }
+        return max_ms;
+    }
+}
@@ -0,0 +1,152 @@
+//////////////////////////////////////////////////////////////////////
+
+#include "pch.h"
+
+LOG_CONTEXT("metadata");
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    // results are sent when this many have been read, then every time that doubles
+    // so the list gets resorted log(n) times rather than n times
+
+    size_t constexpr first_batch_size = 64;
+
+    std::thread index_thread;
+
+    // files waiting to be read, start() fills it and add() tops it up
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_changed;
+    std::deque<metadata_indexer::file_t> queue;
+    bool quit{ false };
+
+    //////////////////////////////////////////////////////////////////////
+    // read whatever's queued, send the results, wait for more
+
+    void index_files(std::wstring path, metadata_indexer::results_callback on_results)
+    {
+        // background mode lowers io and memory priority as well as cpu so it doesn't get in the way of loading
+
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+        DEFER(SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END));
+
+        (void)CoInitializeEx(null, COINIT_APARTMENTTHREADED);
+        DEFER(CoUninitialize());
+
+        LOG_INFO(L"Indexing {}", path);
+
+        imageview::timer_t timer;
+
+        auto results = new metadata_indexer::results_t();
+
+        size_t batch_size = first_batch_size;
+        size_t done = 0;
+
+        auto send = [&](bool complete) {
+            results->complete = complete;
+            on_results(results);
+            results = new metadata_indexer::results_t();
+        };
+
+        while(true) {
+
+            metadata_indexer::file_t f;
+
+            {
+                std::unique_lock lock(queue_mutex);
+                queue_changed.wait(lock, [] { return quit || !queue.empty(); });
+                if(quit) {
+                    delete results;
+                    return;
+                }
+                f = std::move(queue.front());
+                queue.pop_front();
+            }
+
+            metadata_indexer::result_t r;
+            r.index = f.index;
+
+            if(FAILED(image::get_metadata(path + L"\\" + f.name, r.metadata))) {
+                r.metadata = {};
+            }
+
+            results->files.push_back(r);
+            done += 1;
+
+            // stop() empties the queue too, that's not the end of the files
+
+            bool idle;
+            {
+                std::lock_guard lock(queue_mutex);
+                idle = queue.empty() && !quit;
+            }
+
+            if(idle) {
+                timer.update();
+                LOG_INFO(L"Indexed {} files in {:.2f}s", done, timer.wall_time());
+                send(true);
+            } else if(results->files.size() >= batch_size) {
+                send(false);
+                batch_size *= 2;
+            }
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::metadata_indexer
+{
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT start(std::wstring const &path, std::vector<file_t> &&files, results_callback const &on_results)
+    {
+        stop();
+
+        {
+            std::lock_guard lock(queue_mutex);
+            quit = false;
+            queue.assign(std::make_move_iterator(files.begin()), std::make_move_iterator(files.end()));
+        }
+
+        index_thread = std::thread(index_files, path, on_results);
+
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT add(std::vector<file_t> &&files)
+    {
+        if(!index_thread.joinable()) {
+            return E_NOT_VALID_STATE;
+        }
+
+        {
+            std::lock_guard lock(queue_mutex);
+            queue.insert(queue.end(), std::make_move_iterator(files.begin()), std::make_move_iterator(files.end()));
+        }
+        queue_changed.notify_one();
+
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void stop()
+    {
+        if(index_thread.joinable()) {
+            {
+                std::lock_guard lock(queue_mutex);
+                quit = true;
+                queue.clear();
+            }
+            queue_changed.notify_one();
+            index_thread.join();
+        }
+    }
+}
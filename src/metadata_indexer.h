@@ -0,0 +1,46 @@
+//////////////////////////////////////////////////////////////////////
+// read the metadata (dimensions, capture date) of the files in the current folder
+// on a low priority thread of its own so sorting by them doesn't need every file opened up front
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::metadata_indexer
+{
+    struct file_t
+    {
+        uint64 index{ 0 };    // file id, results are matched up with this
+        std::wstring name;    // relative to the folder
+    };
+
+    //////////////////////////////////////////////////////////////////////
+
+    struct result_t
+    {
+        uint64 index{ 0 };
+        image::metadata_t metadata;    // all zeros if it couldn't be read
+    };
+
+    struct results_t
+    {
+        std::vector<result_t> files;
+        bool complete{ false };    // that's all of the ones queued so far
+    };
+
+    // called on the indexer thread, it owns the results
+    // it mustn't wait for the main thread (which might be waiting in stop()) so PostMessage, not SendMessage
+    using results_callback = std::function<void(results_t *results)>;
+
+    // start reading metadata for some files in a folder (stops any previous one)
+    // the thread waits for more files once it's done those, until stop() or the next start()
+    HRESULT start(std::wstring const &path, std::vector<file_t> &&files, results_callback const &on_results);
+
+    // queue some more files from the folder it was started on, they're read after the ones already queued
+    // this doesn't wait for the thread so it's fine to call whenever the watcher sees a change
+    // E_NOT_VALID_STATE if it hasn't been started
+    HRESULT add(std::vector<file_t> &&files);
+
+    // stop and wait for the thread to finish
+    void stop();
+}
@@ -0,0 +1,218 @@
+//////////////////////////////////////////////////////////////////////
+
+#include "pch.h"
+
+LOG_CONTEXT("mip_chain");
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    // rows per parallel_for chunk
+
+    int constexpr rows_per_job = 16;
+
+    // linear -> sRGB lookup resolution, plenty for 8 bit output even in the dark end
+
+    int constexpr linear_table_size = 16384;
+
+    float srgb_to_linear_table[256];
+    byte linear_to_srgb_table[linear_table_size + 1];
+
+    std::once_flag tables_once;
+
+    //////////////////////////////////////////////////////////////////////
+
+    void init_tables()
+    {
+        for(int i = 0; i < 256; ++i) {
+            float c = i / 255.0f;
+            srgb_to_linear_table[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        for(int i = 0; i <= linear_table_size; ++i) {
+            float c = static_cast<float>(i) / linear_table_size;
+            float s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+            linear_to_srgb_table[i] = static_cast<byte>(std::clamp(lrintf(s * 255.0f), 0l, 255l));
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a BGRA pixel as linear { b * a, g * a, r * a, a }
+
+    __m128 load_linear(byte const *p)
+    {
+        __m128 c = _mm_setr_ps(srgb_to_linear_table[p[0]], srgb_to_linear_table[p[1]], srgb_to_linear_table[p[2]], 1);
+        return _mm_mul_ps(c, _mm_set1_ps(p[3] / 255.0f));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // and back again
+
+    void store_srgb(__m128 c, byte *p)
+    {
+        alignas(16) float f[4];
+        _mm_store_ps(f, c);
+
+        float a = f[3];
+
+        if(a <= 0) {
+            memset(p, 0, 4);
+            return;
+        }
+
+        __m128 s = _mm_mul_ps(c, _mm_set1_ps(linear_table_size / a));
+        s = _mm_min_ps(_mm_max_ps(s, _mm_setzero_ps()), _mm_set1_ps(static_cast<float>(linear_table_size)));
+
+        alignas(16) int32 i[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(i), _mm_cvtps_epi32(s));
+
+        p[0] = linear_to_srgb_table[i[0]];
+        p[1] = linear_to_srgb_table[i[1]];
+        p[2] = linear_to_srgb_table[i[2]];
+        p[3] = static_cast<byte>(std::min(lrintf(a * 255.0f), 255l));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void downsample(image::image_t const &src, image::image_t const &dst)
+    {
+        std::vector<mip_chain::taps_t> x_taps = mip_chain::get_taps(src.width, dst.width);
+        std::vector<mip_chain::taps_t> y_taps = mip_chain::get_taps(src.height, dst.height);
+
+        byte *dst_pixels = const_cast<byte *>(dst.pixels);
+
+        app::thread_pool.parallel_for(static_cast<int>(dst.height), rows_per_job, [&](int y0, int y1) {
+
+            for(int y = y0; y < y1; ++y) {
+
+                mip_chain::taps_t const &ty = y_taps[y];
+
+                byte *out = dst_pixels + static_cast<size_t>(dst.row_pitch) * y;
+
+                for(uint x = 0; x < dst.width; ++x) {
+
+                    mip_chain::taps_t const &tx = x_taps[x];
+
+                    __m128 sum = _mm_setzero_ps();
+
+                    for(int j = 0; j < ty.count; ++j) {
+
+                        byte const *row = src.pixels + static_cast<size_t>(src.row_pitch) * (ty.first + j);
+                        byte const *p = row + tx.first * 4llu;
+
+                        __m128 row_sum = _mm_setzero_ps();
+
+                        for(int i = 0; i < tx.count; ++i) {
+                            __m128 weight = _mm_set1_ps(tx.weights[i]);
+                            row_sum = _mm_add_ps(row_sum, _mm_mul_ps(load_linear(p + i * 4), weight));
+                        }
+                        sum = _mm_add_ps(sum, _mm_mul_ps(row_sum, _mm_set1_ps(ty.weights[j])));
+                    }
+
+                    store_srgb(sum, out + x * 4llu);
+                }
+            }
+        });
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::mip_chain
+{
+    //////////////////////////////////////////////////////////////////////
+    // a level is half the size rounded down so for odd sizes it's a bit over 2, never more than 3 pixels
+
+    std::vector<taps_t> get_taps(uint src_size, uint dst_size)
+    {
+        std::vector<taps_t> taps(dst_size);
+
+        double scale = static_cast<double>(src_size) / dst_size;
+
+        for(uint i = 0; i < dst_size; ++i) {
+
+            double from = i * scale;
+            double to = std::min(static_cast<double>(src_size), (i + 1) * scale);
+
+            taps_t &t = taps[i];
+            t.first = static_cast<int>(floor(from));
+            t.count = 0;
+
+            for(int p = t.first; p < to && t.count < 3; ++p) {
+                double overlap = std::min<double>(to, p + 1) - std::max<double>(from, p);
+                t.weights[t.count++] = static_cast<float>(overlap / scale);
+            }
+        }
+        return taps;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT build(image::image_t const &image,
+                  std::vector<byte> &pixels,
+                  std::vector<image::image_t> &levels,
+                  HANDLE cancel_event)
+    {
+        pixels.clear();
+        levels.clear();
+
+        if(image.pixels == null || image.width == 0 || image.height == 0) {
+            return E_INVALIDARG;
+        }
+
+        std::call_once(tables_once, init_tables);
+
+        // sizes are the same as d3d's, half rounded down but at least 1
+
+        std::vector<size_t> offsets;
+
+        size_t total_size = 0;
+        uint w = image.width;
+        uint h = image.height;
+
+        while(w > 1 || h > 1) {
+
+            w = std::max(1u, w / 2);
+            h = std::max(1u, h / 2);
+
+            levels.push_back({ null, w, h, w * 4 });
+            offsets.push_back(total_size);
+
+            total_size += static_cast<size_t>(w) * 4 * h;
+        }
+
+        pixels.resize(total_size);
+
+        for(size_t i = 0; i < levels.size(); ++i) {
+            levels[i].pixels = pixels.data() + offsets[i];
+        }
+
+        timer_t timer;
+
+        image::image_t const *src = &image;
+
+        for(auto const &level : levels) {
+
+            if(cancel_event != null && WaitForSingleObject(cancel_event, 0) == WAIT_OBJECT_0) {
+                pixels.clear();
+                levels.clear();
+                return E_ABORT;
+            }
+
+            downsample(*src, level);
+            src = &level;
+        }
+
+        timer.update();
+        LOG_DEBUG(L"{} mip levels for {}x{} in {:.1f}ms",
+                  levels.size(),
+                  image.width,
+                  image.height,
+                  timer.wall_time() * 1000.0);
+
+        return S_OK;
+    }
+}
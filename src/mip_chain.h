@@ -0,0 +1,30 @@
+//////////////////////////////////////////////////////////////////////
+// build the mip chain for an image on the cpu so the texture can be created with all the levels
+// in one go instead of GenerateMips on the ui thread (which filters in sRGB space, so it gets darker)
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::mip_chain
+{
+    // the source pixels one destination pixel covers along an axis and how much of each
+
+    struct taps_t
+    {
+        int first;
+        int count;
+        float weights[3];
+    };
+
+    std::vector<taps_t> get_taps(uint src_size, uint dst_size);
+
+    // levels 1..n (down to 1x1) of the chain for an image, level 0 is the image itself
+    // they're all in `pixels`, `levels` point into it
+    // each level is made from the one above with a box filter in linear light, weighted by alpha
+
+    HRESULT build(image::image_t const &image,
+                  std::vector<byte> &pixels,
+                  std::vector<image::image_t> &levels,
+                  HANDLE cancel_event = null);
+}
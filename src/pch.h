@@ -97,6 +97,8 @@ using Microsoft::WRL::ComPtr;
 
 #include <stdio.h>
 #include <math.h>
+#include <emmintrin.h>
+#include <tmmintrin.h>
 
 //////////////////////////////////////////////////////////////////////
 // New std lib
@@ -111,6 +113,10 @@ using Microsoft::WRL::ComPtr;
 #include <map>
 #include <unordered_map>
 #include <stack>
+#include <deque>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
 #include <numbers>
 
 //////////////////////////////////////////////////////////////////////
@@ -130,12 +136,23 @@ using Microsoft::WRL::ComPtr;
 #include "defer.h"
 #include "rect.h"
 #include "file.h"
+#include "folder_watcher.h"
+#include "folder_index.h"
 #include "dialogs.h"
 #include "drag_drop.h"
 #include "font_loader.h"
 #include "timer.h"
+#include "frame_scheduler.h"
 #include "thread_pool.h"
+#include "extension_table.h"
 #include "image.h"
+#include "mip_chain.h"
+#include "pixel_convert.h"
+#include "metadata_indexer.h"
+#include "software_renderer.h"
+#include "telemetry.h"
+#include "cache.h"
+#include "scheduler.h"
 #include "settings.h"
 #include "hotkeys.h"
 #include "scrollbar.h"
@@ -0,0 +1,330 @@
+//////////////////////////////////////////////////////////////////////
+
+#include "pch.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    // rows per parallel_for chunk
+
+    int constexpr rows_per_job = 64;
+
+    // when extract walks down columns of the source, it does this many pixels of each row in a chunk
+    // before moving on so the source cache lines get used by all the rows in it
+
+    uint constexpr column_tile_width = 64;
+
+    //////////////////////////////////////////////////////////////////////
+
+    bool has_ssse3()
+    {
+        static bool const ssse3 = IsProcessorFeaturePresent(PF_SSSE3_INSTRUCTIONS_AVAILABLE) != FALSE;
+        return ssse3;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void bgra_to_bgr_row(byte const *src, byte *dst, uint width)
+    {
+        for(uint x = 0; x < width; ++x) {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+            src += 4;
+            dst += 3;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // 4 x 4 pixels -> 3 x 16 bytes, stragglers done one at a time
+
+    void bgra_to_bgr_row_ssse3(byte const *src, byte *dst, uint width)
+    {
+        __m128i const pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+        uint x = 0;
+
+        for(; x + 16 <= width; x += 16) {
+
+            __m128i const *s = reinterpret_cast<__m128i const *>(src);
+
+            // 12 bytes in the bottom of each
+
+            __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(s + 0), pack);
+            __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(s + 1), pack);
+            __m128i c = _mm_shuffle_epi8(_mm_loadu_si128(s + 2), pack);
+            __m128i d = _mm_shuffle_epi8(_mm_loadu_si128(s + 3), pack);
+
+            __m128i *o = reinterpret_cast<__m128i *>(dst);
+
+            _mm_storeu_si128(o + 0, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+            _mm_storeu_si128(o + 1, _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+            _mm_storeu_si128(o + 2, _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+
+            src += 64;
+            dst += 48;
+        }
+
+        bgra_to_bgr_row(src, dst, width - x);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // 4 pixels at a time backwards
+
+    void reverse_row(byte const *src, byte *dst, uint width)
+    {
+        uint x = 0;
+
+        for(; x + 4 <= width; x += 4) {
+            __m128i p = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src - 12));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_shuffle_epi32(p, _MM_SHUFFLE(0, 1, 2, 3)));
+            src -= 16;
+            dst += 16;
+        }
+
+        for(; x < width; ++x) {
+            memcpy(dst, src, 4);
+            src -= 4;
+            dst += 4;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // check the corners of an extract are all in the source and work out the strides in bytes
+
+    HRESULT get_extract_strides(image::image_t const &src,
+                                POINT origin,
+                                POINT x_step,
+                                POINT y_step,
+                                image::image_t const &dst,
+                                int64 &x_stride,
+                                int64 &y_stride)
+    {
+        if(src.pixels == null || dst.pixels == null || dst.width == 0 || dst.height == 0) {
+            return E_INVALIDARG;
+        }
+
+        // steps have to be one pixel along different axes
+
+        if(abs(x_step.x) + abs(x_step.y) != 1 || abs(y_step.x) + abs(y_step.y) != 1 ||
+           x_step.x * y_step.x + x_step.y * y_step.y != 0) {
+            return E_INVALIDARG;
+        }
+
+        int64 w = dst.width - 1ll;
+        int64 h = dst.height - 1ll;
+
+        for(int64 corner = 0; corner < 4; ++corner) {
+
+            int64 cx = (corner & 1) ? w : 0;
+            int64 cy = (corner & 2) ? h : 0;
+
+            int64 x = origin.x + cx * x_step.x + cy * y_step.x;
+            int64 y = origin.y + cx * x_step.y + cy * y_step.y;
+
+            if(x < 0 || y < 0 || x >= src.width || y >= src.height) {
+                return E_BOUNDS;
+            }
+        }
+
+        int64 pitch = src.row_pitch;
+
+        x_stride = x_step.x * 4ll + x_step.y * pitch;
+        y_stride = y_step.x * 4ll + y_step.y * pitch;
+
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    template <typename F> void for_each_row(image::image_t const &src, byte *dst, uint dst_pitch, F row_fn)
+    {
+        app::thread_pool.parallel_for(static_cast<int>(src.height), rows_per_job, [&](int y0, int y1) {
+
+            for(int y = y0; y < y1; ++y) {
+                byte const *s = src.pixels + static_cast<size_t>(src.row_pitch) * y;
+                byte *d = dst + static_cast<size_t>(dst_pitch) * y;
+                row_fn(s, d, src.width);
+            }
+        });
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::pixel_convert
+{
+    //////////////////////////////////////////////////////////////////////
+
+    void copy_bgra(image::image_t const &src, byte *dst, uint dst_pitch)
+    {
+        for_each_row(src, dst, dst_pitch, [](byte const *s, byte *d, uint width) { memcpy(d, s, width * 4llu); });
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void bgra_to_bgr(image::image_t const &src, byte *dst, uint dst_pitch)
+    {
+        if(has_ssse3()) {
+            for_each_row(src, dst, dst_pitch, bgra_to_bgr_row_ssse3);
+        } else {
+            for_each_row(src, dst, dst_pitch, bgra_to_bgr_row);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT extract(image::image_t const &src, POINT origin, POINT x_step, POINT y_step, image::image_t const &dst)
+    {
+        int64 x_stride;
+        int64 y_stride;
+
+        HRESULT hr = get_extract_strides(src, origin, x_step, y_step, dst, x_stride, y_stride);
+
+        if(FAILED(hr)) {
+            return hr;
+        }
+
+        byte const *first = src.pixels + origin.y * static_cast<int64>(src.row_pitch) + origin.x * 4ll;
+
+        byte *dst_pixels = const_cast<byte *>(dst.pixels);
+
+        uint width = dst.width;
+
+        app::thread_pool.parallel_for(static_cast<int>(dst.height), rows_per_job, [&](int y0, int y1) {
+
+            // along a row of the source, copy or reverse whole rows
+
+            if(x_stride == 4 || x_stride == -4) {
+
+                for(int y = y0; y < y1; ++y) {
+
+                    byte const *s = first + y * y_stride;
+                    byte *d = dst_pixels + static_cast<size_t>(dst.row_pitch) * y;
+
+                    if(x_stride == 4) {
+                        memcpy(d, s, width * 4llu);
+                    } else {
+                        reverse_row(s, d, width);
+                    }
+                }
+                return;
+            }
+
+            // down a column of the source (rotated 90/270), in tiles
+
+            for(uint x0 = 0; x0 < width; x0 += column_tile_width) {
+
+                uint x1 = std::min(width, x0 + column_tile_width);
+
+                for(int y = y0; y < y1; ++y) {
+
+                    byte const *s = first + y * y_stride + x0 * x_stride;
+                    uint32 *d = reinterpret_cast<uint32 *>(dst_pixels + static_cast<size_t>(dst.row_pitch) * y) + x0;
+
+                    for(uint x = x0; x < x1; ++x) {
+                        *d++ = *reinterpret_cast<uint32 const *>(s);
+                        s += x_stride;
+                    }
+                }
+            }
+        });
+
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // dst pixel (x, y) comes from where in src, for each of them
+
+    HRESULT transform(image::image_t const &src, WICBitmapTransformOptions options, image::image_t const &dst)
+    {
+        LONG right = static_cast<LONG>(src.width) - 1;
+        LONG bottom = static_cast<LONG>(src.height) - 1;
+
+        switch(options) {
+        case WICBitmapTransformRotate0:
+            return extract(src, { 0, 0 }, { 1, 0 }, { 0, 1 }, dst);
+        case WICBitmapTransformRotate90:
+            return extract(src, { 0, bottom }, { 0, -1 }, { 1, 0 }, dst);
+        case WICBitmapTransformRotate180:
+            return extract(src, { right, bottom }, { -1, 0 }, { 0, -1 }, dst);
+        case WICBitmapTransformRotate270:
+            return extract(src, { right, 0 }, { 0, 1 }, { -1, 0 }, dst);
+        case WICBitmapTransformFlipHorizontal:
+            return extract(src, { right, 0 }, { -1, 0 }, { 0, 1 }, dst);
+        case WICBitmapTransformFlipVertical:
+            return extract(src, { 0, bottom }, { 1, 0 }, { 0, -1 }, dst);
+        default:
+            return E_INVALIDARG;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    RECT source_rect(RECT const &r, uint src_w, uint src_h, WICBitmapTransformOptions options)
+    {
+        LONG w = static_cast<LONG>(src_w);
+        LONG h = static_cast<LONG>(src_h);
+
+        switch(options) {
+        case WICBitmapTransformRotate90:
+            return { r.top, h - r.right, r.bottom, h - r.left };
+        case WICBitmapTransformRotate270:
+            return { w - r.bottom, r.left, w - r.top, r.right };
+        case WICBitmapTransformRotate180:
+            return { w - r.right, h - r.bottom, w - r.left, h - r.top };
+        case WICBitmapTransformFlipHorizontal:
+            return { w - r.right, r.top, w - r.left, r.bottom };
+        case WICBitmapTransformFlipVertical:
+            return { r.left, h - r.bottom, r.right, h - r.top };
+        default:
+            return r;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void reference::bgra_to_bgr(image::image_t const &src, byte *dst, uint dst_pitch)
+    {
+        for(uint y = 0; y < src.height; ++y) {
+            byte const *s = src.pixels + static_cast<size_t>(src.row_pitch) * y;
+            byte *d = dst + static_cast<size_t>(dst_pitch) * y;
+            bgra_to_bgr_row(s, d, src.width);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT reference::extract(image::image_t const &src,
+                               POINT origin,
+                               POINT x_step,
+                               POINT y_step,
+                               image::image_t const &dst)
+    {
+        int64 x_stride;
+        int64 y_stride;
+
+        HRESULT hr = get_extract_strides(src, origin, x_step, y_step, dst, x_stride, y_stride);
+
+        if(FAILED(hr)) {
+            return hr;
+        }
+
+        for(uint y = 0; y < dst.height; ++y) {
+
+            byte *d = const_cast<byte *>(dst.pixels) + static_cast<size_t>(dst.row_pitch) * y;
+
+            for(uint x = 0; x < dst.width; ++x) {
+
+                int64 sx = origin.x + static_cast<int64>(x) * x_step.x + static_cast<int64>(y) * y_step.x;
+                int64 sy = origin.y + static_cast<int64>(x) * x_step.y + static_cast<int64>(y) * y_step.y;
+
+                memcpy(d + x * 4llu, src.pixels + sy * src.row_pitch + sx * 4, 4);
+            }
+        }
+        return S_OK;
+    }
+}
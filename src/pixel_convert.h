@@ -0,0 +1,44 @@
+//////////////////////////////////////////////////////////////////////
+// converting BGRA32 pixels into the layouts the clipboard wants, cutting bits out of images
+// and turning them the way their exif orientation says
+// rows are split up across the thread pool
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::pixel_convert
+{
+    // BGRA32 -> BGRA32 with a different row pitch (CF_DIBV5 with an alpha mask takes them as they are)
+
+    void copy_bgra(image::image_t const &src, byte *dst, uint dst_pitch);
+
+    // BGRA32 -> BGR24 (CF_DIB), alpha is dropped, 16 pixels at a time with SSSE3 if it's there
+
+    void bgra_to_bgr(image::image_t const &src, byte *dst, uint dst_pitch);
+
+    // copy a rectangle of BGRA32 pixels out of src in any of the 8 flip/rotate orders
+    // dst pixel (x, y) is src pixel origin + x * x_step + y * y_step, the steps are one pixel along an axis
+    // E_BOUNDS if any of that is outside src
+
+    HRESULT extract(image::image_t const &src, POINT origin, POINT x_step, POINT y_step, image::image_t const &dst);
+
+    // flip/rotate a whole image with one of the transforms an exif orientation turns into (so not the
+    // flip + rotate ones), dst is src.height x src.width for 90/270
+
+    HRESULT transform(image::image_t const &src, WICBitmapTransformOptions options, image::image_t const &dst);
+
+    // where a rectangle of the transformed image is in the source (which is src_w x src_h)
+    // so a part of it can be decoded and transformed and come out the same as that part of the whole
+
+    RECT source_rect(RECT const &r, uint src_w, uint src_h, WICBitmapTransformOptions options);
+
+    // one pixel at a time, what the fast ones should match exactly
+
+    namespace reference
+    {
+        void bgra_to_bgr(image::image_t const &src, byte *dst, uint dst_pitch);
+
+        HRESULT extract(image::image_t const &src, POINT origin, POINT x_step, POINT y_step, image::image_t const &dst);
+    }
+}
@@ -0,0 +1,409 @@
+//////////////////////////////////////////////////////////////////////
+
+#include "pch.h"
+
+LOG_CONTEXT("scheduler");
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview::scheduler;
+
+    wchar const *priority_names[num_priorities] = { L"visible", L"next", L"speculative" };
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::scheduler
+{
+    //////////////////////////////////////////////////////////////////////
+
+    void load_scheduler::stage_t::push(image::image_file *f, priority_t priority)
+    {
+        queues[priority].push_back(f);
+        max_depth = std::max(max_depth, depth());
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    bool load_scheduler::stage_t::pop(image::image_file *&f, priority_t &priority, bool only_visible)
+    {
+        for(int p = 0; p < num_priorities; ++p) {
+
+            if(queues[p].empty()) {
+                continue;
+            }
+
+            if(only_visible && p != priority_visible) {
+                return false;
+            }
+
+            // a visible job can always go one over the limit
+
+            int limit = max_running + ((p == priority_visible) ? 1 : 0);
+
+            if(running >= limit) {
+                return false;
+            }
+
+            if(p == priority_speculative && speculative_running >= max_speculative) {
+                return false;
+            }
+
+            f = queues[p].front();
+            queues[p].pop_front();
+            priority = static_cast<priority_t>(p);
+
+            running += 1;
+            if(priority == priority_speculative) {
+                speculative_running += 1;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    bool load_scheduler::stage_t::remove(image::image_file *f)
+    {
+        for(auto &q : queues) {
+            auto it = std::find(q.begin(), q.end(), f);
+            if(it != q.end()) {
+                q.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void load_scheduler::stage_t::release(priority_t priority)
+    {
+        running -= 1;
+        if(priority == priority_speculative) {
+            speculative_running -= 1;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    size_t load_scheduler::stage_t::depth() const
+    {
+        size_t total = 0;
+        for(auto const &q : queues) {
+            total += q.size();
+        }
+        return total;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // reads mostly sit waiting for the disk so they don't count against the cores
+
+    HRESULT load_scheduler::init(thread_pool_t &thread_pool, job_function read, job_function decode, job_function done)
+    {
+        pool = &thread_pool;
+
+        done_function = done;
+
+        read_stage.name = L"read";
+        read_stage.function = read;
+        read_stage.max_running = max_reads;
+        read_stage.max_speculative = max_reads;
+
+        decode_stage.name = L"decode";
+        decode_stage.function = decode;
+        decode_stage.max_running = std::max(1, pool->worker_count() - max_reads);
+        decode_stage.max_speculative = std::max(1, decode_stage.max_running - 1);
+
+        uptime.reset();
+
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    //////////////////////////////////////////////////////////////////////
+    // queued files go back through done_function so whoever owns them can free them
+
+    void load_scheduler::cleanup()
+    {
+        std::vector<image::image_file *> dropped;
+
+        AcquireSRWLockExclusive(&lock);
+
+        quit = true;
+
+        for(stage_t *stage : { &read_stage, &decode_stage }) {
+            for(auto &q : stage->queues) {
+                for(auto f : q) {
+                    dropped.push_back(f);
+                    in_flight.erase(f);
+                    finishing += 1;
+                }
+                q.clear();
+            }
+        }
+
+        decode_queue_bytes = 0;
+
+        ReleaseSRWLockExclusive(&lock);
+
+        LOG_INFO(L"{} queued loads dropped", dropped.size());
+
+        for(auto f : dropped) {
+            f->hresult = E_ABORT;
+            finish(f);
+        }
+
+        // the running ones (and ones given to the pool which haven't started) finish by themselves
+
+        AcquireSRWLockExclusive(&lock);
+
+        while(!is_idle()) {
+            SleepConditionVariableSRW(&idle, &lock, INFINITE, 0);
+        }
+
+        ReleaseSRWLockExclusive(&lock);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void load_scheduler::add(image::image_file *f, priority_t priority)
+    {
+        LOG_DEBUG(L"Queue {} ({})", f->filename, priority_names[priority]);
+
+        AcquireSRWLockExclusive(&lock);
+        in_flight[f] = priority;
+        read_stage.push(f, priority);
+        ReleaseSRWLockExclusive(&lock);
+
+        pump();
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    bool load_scheduler::promote(image::image_file *f, priority_t priority)
+    {
+        bool found = false;
+        bool moved = false;
+
+        AcquireSRWLockExclusive(&lock);
+
+        auto it = in_flight.find(f);
+
+        if(it != in_flight.end()) {
+
+            found = true;
+
+            if(priority < it->second) {
+
+                it->second = priority;
+
+                if(read_stage.remove(f)) {
+                    read_stage.push(f, priority);
+                    moved = true;
+                } else if(decode_stage.remove(f)) {
+                    decode_stage.push(f, priority);
+                    moved = true;
+                }
+            }
+        }
+
+        ReleaseSRWLockExclusive(&lock);
+
+        if(moved) {
+            LOG_DEBUG(L"Promote {} ({})", f->filename, priority_names[priority]);
+            pump();
+        }
+        return found;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // work out what to start with the lock held, then start it without
+
+    void load_scheduler::pump()
+    {
+        struct start_t
+        {
+            stage_t *stage;
+            image::image_file *f;
+            priority_t priority;
+        };
+
+        std::vector<start_t> to_start;
+
+        AcquireSRWLockExclusive(&lock);
+
+        if(!quit) {
+
+            image::image_file *f{ null };
+            priority_t priority{ priority_speculative };
+
+            // backpressure - if decoding is behind, only the visible one gets read
+
+            bool decode_is_full = decode_queue_bytes >= max_decode_queue_bytes;
+
+            while(read_stage.pop(f, priority, decode_is_full)) {
+                to_start.push_back({ &read_stage, f, priority });
+            }
+
+            while(decode_stage.pop(f, priority, false)) {
+                decode_queue_bytes -= f->bytes.size();
+                to_start.push_back({ &decode_stage, f, priority });
+            }
+
+            active += static_cast<int>(to_start.size());
+        }
+
+        ReleaseSRWLockExclusive(&lock);
+
+        for(auto const &s : to_start) {
+            if(FAILED(pool->add_job([this, s]() { run(*s.stage, s.f, s.priority); }))) {
+                abandon(*s.stage, s.f, s.priority);
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void load_scheduler::abandon(stage_t &stage, image::image_file *f, priority_t priority)
+    {
+        LOG_WARN(L"Can't start {} for {}", stage.name, f->filename);
+
+        AcquireSRWLockExclusive(&lock);
+
+        stage.release(priority);
+        in_flight.erase(f);
+        finishing += 1;
+        active -= 1;
+
+        ReleaseSRWLockExclusive(&lock);
+
+        f->hresult = E_ABORT;
+        finish(f);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    bool load_scheduler::is_idle() const
+    {
+        return in_flight.empty() && finishing == 0 && active == 0;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void load_scheduler::finish(image::image_file *f)
+    {
+        done_function(f);
+
+        AcquireSRWLockExclusive(&lock);
+
+        finishing -= 1;
+
+        if(is_idle()) {
+            WakeAllConditionVariable(&idle);
+        }
+
+        ReleaseSRWLockExclusive(&lock);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // speculative jobs run in background mode which lowers
+    // the i/o priority as well as the cpu priority of the thread
+
+    void load_scheduler::run(stage_t &stage, image::image_file *f, priority_t priority)
+    {
+        bool background = priority == priority_speculative;
+
+        if(background) {
+            SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+        }
+
+        timer_t job_timer;
+
+        stage.function(f);
+
+        job_timer.update();
+
+        if(background) {
+            SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+        }
+
+        bool finished = true;
+
+        AcquireSRWLockExclusive(&lock);
+
+        stage.release(priority);
+        stage.jobs += 1;
+        stage.busy_seconds += job_timer.wall_time();
+
+        if(&stage == &read_stage) {
+            f->read_seconds += job_timer.wall_time();
+        } else {
+            f->decode_seconds += job_timer.wall_time();
+        }
+
+        // read went ok, queue it for decoding at whatever priority it has now
+
+        if(&stage == &read_stage && SUCCEEDED(f->hresult) && !quit) {
+
+            decode_stage.push(f, in_flight[f]);
+            decode_queue_bytes += f->bytes.size();
+            finished = false;
+        }
+
+        if(finished) {
+            in_flight.erase(f);
+            finishing += 1;
+        }
+
+        ReleaseSRWLockExclusive(&lock);
+
+        if(finished) {
+            finish(f);
+        }
+
+        pump();
+
+        // cleanup can return once this has let go of the lock
+
+        AcquireSRWLockExclusive(&lock);
+
+        active -= 1;
+
+        if(is_idle()) {
+            WakeAllConditionVariable(&idle);
+        }
+
+        ReleaseSRWLockExclusive(&lock);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void load_scheduler::stage_t::report(double elapsed_seconds) const
+    {
+        LOG_INFO(L"{} stage: {} jobs, max queue depth {}, utilization {:.1f}% of {} slots",
+                 name,
+                 jobs,
+                 max_depth,
+                 100.0 * busy_seconds / (std::max(0.001, elapsed_seconds) * max_running),
+                 max_running);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void load_scheduler::report()
+    {
+        AcquireSRWLockExclusive(&lock);
+
+        uptime.update();
+
+        read_stage.report(uptime.wall_time());
+        decode_stage.report(uptime.wall_time());
+
+        ReleaseSRWLockExclusive(&lock);
+    }
+}
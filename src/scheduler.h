@@ -0,0 +1,136 @@
+//////////////////////////////////////////////////////////////////////
+// load scheduler - runs file load/decode jobs on the thread pool
+// in priority order so the file the user asked for doesn't queue up
+// behind a dozen speculative cache loads
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::scheduler
+{
+    //////////////////////////////////////////////////////////////////////
+    // lower value is more important
+
+    enum priority_t : int
+    {
+        priority_visible = 0,        // the user is waiting for it
+        priority_next = 1,           // next one in the direction of travel
+        priority_speculative = 2,    // might be wanted later
+
+        num_priorities
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // loads go through two stages, read (file bytes) then decode (pixels)
+    // each stage has its own priority queues and limit on how many run at once
+    // read bytes waiting to be decoded are capped so reads can't run away from decoding
+
+    struct load_scheduler
+    {
+        using job_function = std::function<void(image::image_file *)>;
+
+        // reads in flight (a visible load can go one over)
+        static int constexpr max_reads = 2;
+
+        // stop starting reads while this many bytes are waiting to be decoded (visible reads excepted)
+        static uint64 constexpr max_decode_queue_bytes = 256 * 1048576llu;
+
+        // read: load the file contents, decode: make the pixels, done: it's finished (or failed or was cancelled)
+        // they're all called on thread pool workers
+        HRESULT init(thread_pool_t &pool, job_function read, job_function decode, job_function done);
+
+        // jobs which haven't started are finished with E_ABORT (done is called for them)
+        // then it waits for the ones which are running, call it before the pool's cleanup
+        void cleanup();
+
+        // queue a file to be loaded
+        void add(image::image_file *f, priority_t priority);
+
+        // move a file up to `priority` (never down)
+        // if it's being read, the decode gets the new priority
+        // returns false if it's not being loaded (already finished)
+        bool promote(image::image_file *f, priority_t priority);
+
+        // log queue depth and utilization of each stage
+        void report();
+
+    private:
+        struct stage_t
+        {
+            wchar const *name{ null };
+
+            job_function function;
+
+            std::deque<image::image_file *> queues[num_priorities];
+
+            int running{ 0 };
+            int max_running{ 1 };
+
+            // speculative jobs are limited so there's always room for a visible one
+            int speculative_running{ 0 };
+            int max_speculative{ 1 };
+
+            // stats
+            size_t max_depth{ 0 };
+            uint64 jobs{ 0 };
+            double busy_seconds{ 0 };
+
+            void push(image::image_file *f, priority_t priority);
+
+            // get the most important job which is allowed to start now
+            bool pop(image::image_file *&f, priority_t &priority, bool only_visible);
+
+            bool remove(image::image_file *f);
+
+            // a job in this stage stopped running
+            void release(priority_t priority);
+
+            size_t depth() const;
+
+            void report(double elapsed_seconds) const;
+        };
+
+        // start whatever can be started in either stage
+        void pump();
+
+        // run a job in a stage, then pass it to the next one
+        void run(stage_t &stage, image::image_file *f, priority_t priority);
+
+        // a job couldn't be given to the pool (it's stopping), finish it with E_ABORT
+        void abandon(stage_t &stage, image::image_file *f, priority_t priority);
+
+        // call with the lock held
+        bool is_idle() const;
+
+        // call done_function for a file which has been taken out of in_flight (lock not held)
+        void finish(image::image_file *f);
+
+        thread_pool_t *pool{ null };
+
+        job_function done_function;
+
+        stage_t read_stage;
+        stage_t decode_stage;
+
+        // priority of files which are being read or decoded
+        std::unordered_map<image::image_file *, priority_t> in_flight;
+
+        uint64 decode_queue_bytes{ 0 };
+
+        timer_t uptime;
+
+        SRWLOCK lock = SRWLOCK_INIT;
+
+        // files out of in_flight whose done_function hasn't returned yet
+        int finishing{ 0 };
+
+        // jobs given to the pool whose run hasn't returned, run still pumps after its file is finished
+        int active{ 0 };
+
+        // signalled when in_flight is empty and nothing is finishing or active, cleanup waits for it
+        CONDITION_VARIABLE idle = CONDITION_VARIABLE_INIT;
+
+        bool quit{ false };
+    };
+}
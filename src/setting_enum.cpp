@@ -80,6 +80,37 @@ namespace imageview::settings_ui
         { startup_zoom_mode_option::startup_zoom_remember, IDS_ENUM_ZOOM_MODE_REMEMBER },
     };
 
+    // sort_field
+
+    enum_id_map enum_sort_field_map = {
+        { sort_field_option::sort_by_name, IDS_ENUM_SORT_FIELD_NAME },
+        { sort_field_option::sort_by_date, IDS_ENUM_SORT_FIELD_DATE },
+        { sort_field_option::sort_by_size, IDS_ENUM_SORT_FIELD_SIZE },
+        { sort_field_option::sort_by_capture_date, IDS_ENUM_SORT_FIELD_CAPTURED },
+        { sort_field_option::sort_by_dimensions, IDS_ENUM_SORT_FIELD_DIMENSIONS },
+    };
+
+    // sort_order
+
+    enum_id_map enum_sort_order_map = {
+        { sort_order_option::sort_ascending, IDS_ENUM_SORT_ORDER_ASCENDING },
+        { sort_order_option::sort_descending, IDS_ENUM_SORT_ORDER_DESCENDING },
+    };
+
+    // show_format
+
+    enum_id_map enum_show_format_map = {
+        { show_format_option::show_all_formats, IDS_ENUM_SHOW_FORMAT_ALL },
+        { show_format_option::show_jpeg, IDS_ENUM_SHOW_FORMAT_JPEG },
+        { show_format_option::show_png, IDS_ENUM_SHOW_FORMAT_PNG },
+        { show_format_option::show_gif, IDS_ENUM_SHOW_FORMAT_GIF },
+        { show_format_option::show_bmp, IDS_ENUM_SHOW_FORMAT_BMP },
+        { show_format_option::show_tiff, IDS_ENUM_SHOW_FORMAT_TIFF },
+        { show_format_option::show_webp, IDS_ENUM_SHOW_FORMAT_WEBP },
+        { show_format_option::show_heif, IDS_ENUM_SHOW_FORMAT_HEIF },
+        { show_format_option::show_other_formats, IDS_ENUM_SHOW_FORMAT_OTHER },
+    };
+
     //////////////////////////////////////////////////////////////////////
 
     void enum_setting::setup_controls(HWND hwnd)
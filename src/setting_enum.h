@@ -13,6 +13,9 @@ namespace imageview::settings_ui
     extern enum_id_map enum_exif_map;
     extern enum_id_map enum_zoom_mode_map;
     extern enum_id_map enum_startup_zoom_mode_map;
+    extern enum_id_map enum_sort_field_map;
+    extern enum_id_map enum_sort_order_map;
+    extern enum_id_map enum_show_format_map;
 
     INT_PTR setting_enum_dlgproc(HWND dlg, UINT msg, WPARAM wParam, LPARAM lParam);
 
@@ -58,6 +58,38 @@ namespace imageview
         shrink_to_fit
     };
 
+    // how to sort the files in a folder - these line up with file::scan_folder_sort_field/order
+
+    enum sort_field_option : uint
+    {
+        sort_by_name,
+        sort_by_date,
+        sort_by_size,
+        sort_by_capture_date,
+        sort_by_dimensions
+    };
+
+    enum sort_order_option : uint
+    {
+        sort_ascending,
+        sort_descending
+    };
+
+    // which files in a folder to show - these line up with image::format_t (all of them is none)
+
+    enum show_format_option : uint
+    {
+        show_all_formats,
+        show_jpeg,
+        show_png,
+        show_gif,
+        show_bmp,
+        show_tiff,
+        show_webp,
+        show_heif,
+        show_other_formats
+    };
+
     enum mouse_button_t : int
     {
         btn_min = 0,
@@ -278,11 +278,11 @@ namespace imageview::settings_ui
     //////////////////////////////////////////////////////////////////////
     // call this from main update() at frame rate
 
-    void update()
+    bool update()
     {
         if(settings_dlg == null || active_tabs.empty()) {
-            return;
+            return false;
         }
-        animate_settings_page(active_tabs[settings_page]->hwnd);
+        return animate_settings_page(active_tabs[settings_page]->hwnd);
     }
 }
@@ -6,5 +6,6 @@ namespace imageview::settings_ui
 
     void new_settings_update();
 
-    void update();
+    // call every frame, returns true if it wants another one (it's animating)
+    bool update();
 }
@@ -201,11 +201,33 @@ DECL_SETTING_BOOL(reload_last_file, IDS_SETTING_NAME_RELOAD_LAST_FILE, true);
 
 DECL_SETTING_RANGED(recent_files_count, IDS_SETTING_NAME_RECENT_FILES_COUNT, 10, 3, 20);
 
+// order of the files when stepping through a folder
+
+DECL_SETTING_ENUM(sort_field, IDS_SETTING_NAME_SORT_FIELD, sort_field_option, enum_sort_field_map, sort_by_name);
+
+DECL_SETTING_ENUM(sort_order, IDS_SETTING_NAME_SORT_ORDER, sort_order_option, enum_sort_order_map, sort_ascending);
+
+// only step through files of one type
+
+DECL_SETTING_ENUM(
+    show_format, IDS_SETTING_NAME_SHOW_FORMAT, show_format_option, enum_show_format_map, show_all_formats);
+
+// include files in subfolders, and how many levels down
+
+DECL_SETTING_BOOL(recursive_scan, IDS_SETTING_NAME_RECURSIVE_SCAN, false);
+
+DECL_SETTING_RANGED(recursive_scan_depth, IDS_SETTING_NAME_RECURSIVE_SCAN_DEPTH, 8, 1, 32);
+
 // what to do about exif metadata
 
 DECL_SETTING_ENUM(
     image_rotation_option, IDS_SETTING_NAME_EXIF_OPTION, exif_option, enum_exif_map, exif_option::exif_option_apply);
 
+// size the cache automatically from physical memory, otherwise cache_size_mb is used
+// either way it shrinks while the system is short of memory
+
+DECL_SETTING_BOOL(cache_size_auto, IDS_SETTING_NAME_CACHE_SIZE_AUTO, true);
+
 // how much memory to use for caching files and decoded images
 // TODO (chs): separate settings for file and uncompressed image caches?
 // or... ditch the uncompressed cache? help with exif prompt problem
@@ -0,0 +1,560 @@
+//////////////////////////////////////////////////////////////////////
+// pixels are BGRA32 so as a uint32 it's 0xAARRGGBB
+// blends are done 2 pixels at a time in 8 x 16 bit lanes, which is exact for 8 bit
+// colors and alphas (x * a / 255 rounded) so it matches the gpu's unorm output
+
+#include "pch.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+    using namespace imageview::software_renderer;
+
+    // rows per parallel_for chunk
+
+    int constexpr rows_per_job = 16;
+
+    //////////////////////////////////////////////////////////////////////
+    // the 8 bit color the gpu would write for a shader color
+
+    uint32 pack_color(vec4 color)
+    {
+        XMFLOAT4 c;
+        XMStoreFloat4(&c, XMVectorSaturate(color));
+
+        uint r = static_cast<uint>(lrintf(c.x * 255.0f));
+        uint g = static_cast<uint>(lrintf(c.y * 255.0f));
+        uint b = static_cast<uint>(lrintf(c.z * 255.0f));
+        uint a = static_cast<uint>(lrintf(c.w * 255.0f));
+
+        return (a << 24) | (r << 16) | (g << 8) | b;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // pixels whose centers are in [from, to) clipped to [0, limit), the rasterizer's top left rule
+
+    void pixel_span(float from, float to, uint limit, int &begin, int &end)
+    {
+        float l = static_cast<float>(limit);
+        begin = static_cast<int>(std::clamp(ceilf(from - 0.5f), 0.0f, l));
+        end = static_cast<int>(std::clamp(ceilf(to - 0.5f), 0.0f, l));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // x / 255 rounded for x in [0, 255 * 255]
+
+    __m128i div255(__m128i x)
+    {
+        x = _mm_add_epi16(x, _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // lerp(a, b, b.alpha) for 2 pixels in 16 bit lanes, which is what ps_texture does with the checkerboard
+
+    __m128i lerp_by_alpha(__m128i a, __m128i b)
+    {
+        __m128i t = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, 0xff), 0xff);
+        __m128i s = _mm_sub_epi16(_mm_set1_epi16(255), t);
+        return div255(_mm_add_epi16(_mm_mullo_epi16(a, s), _mm_mullo_epi16(b, t)));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a + (b - a) * weight / 256 for 4 pixels, blending two mip levels
+
+    __m128i lerp_pixels(__m128i a, __m128i b, int weight)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128i wb = _mm_set1_epi16(static_cast<int16>(weight));
+        __m128i wa = _mm_set1_epi16(static_cast<int16>(256 - weight));
+        __m128i round = _mm_set1_epi16(128);
+
+        auto lerp = [&](__m128i x, __m128i y) {
+            __m128i sum = _mm_add_epi16(_mm_mullo_epi16(x, wa), _mm_mullo_epi16(y, wb));
+            return _mm_srli_epi16(_mm_add_epi16(sum, round), 8);
+        };
+
+        __m128i lo = lerp(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi = lerp(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        return _mm_packus_epi16(lo, hi);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // floor for the texel coordinates, SSE2 only has truncate
+
+    __m128i floor_to_int(__m128 x)
+    {
+        __m128i i = _mm_cvttps_epi32(x);
+        return _mm_add_epi32(i, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(i), x)));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // the blend_state blend with a constant color for 2 pixels in 16 bit lanes
+    // rgb = dst * (255 - a) + src * a, alpha = src alpha (SrcBlendAlpha ONE, DestBlendAlpha ZERO)
+
+    struct blend_color_t
+    {
+        __m128i inverse;
+        __m128i premultiplied;
+
+        explicit blend_color_t(uint32 color)
+        {
+            uint a = color >> 24;
+            int16 ia = static_cast<int16>(255 - a);
+            int16 aa = static_cast<int16>(a * 255);
+            int16 r = static_cast<int16>(((color >> 16) & 0xff) * a);
+            int16 g = static_cast<int16>(((color >> 8) & 0xff) * a);
+            int16 b = static_cast<int16>((color & 0xff) * a);
+            inverse = _mm_setr_epi16(ia, ia, ia, 0, ia, ia, ia, 0);
+            premultiplied = _mm_setr_epi16(b, g, r, aa, b, g, r, aa);
+        }
+    };
+
+    __m128i blend(__m128i dst, __m128i inverse, __m128i premultiplied)
+    {
+        return div255(_mm_add_epi16(_mm_mullo_epi16(dst, inverse), premultiplied));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // the texture with 4 texels to sample at a time, border color (0) outside it
+
+    struct texture_t
+    {
+        byte const *pixels;
+        int width;
+        int height;
+        uint row_pitch;
+
+        uint32 texel(int x, int y) const
+        {
+            if(static_cast<uint>(x) >= static_cast<uint>(width) || static_cast<uint>(y) >= static_cast<uint>(height)) {
+                return 0;
+            }
+            return *reinterpret_cast<uint32 const *>(pixels + static_cast<size_t>(row_pitch) * y + x * 4llu);
+        }
+
+        // point sampling (D3D11_FILTER_xxx_MAG_POINT) at texel coordinates
+
+        __m128i point(__m128 u, __m128 v) const
+        {
+            alignas(16) int32 x[4];
+            alignas(16) int32 y[4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(x), floor_to_int(u));
+            _mm_store_si128(reinterpret_cast<__m128i *>(y), floor_to_int(v));
+            return _mm_setr_epi32(texel(x[0], y[0]), texel(x[1], y[1]), texel(x[2], y[2]), texel(x[3], y[3]));
+        }
+
+        // bilinear (MIN_LINEAR) at a texel coordinate
+
+        uint32 linear(float u, float v) const
+        {
+            // keep it in int range, anything this far out is all border anyway
+
+            float fu = std::clamp(u - 0.5f, -2.0f, width + 1.0f);
+            float fv = std::clamp(v - 0.5f, -2.0f, height + 1.0f);
+            float x0 = floorf(fu);
+            float y0 = floorf(fv);
+            int x = static_cast<int>(x0);
+            int y = static_cast<int>(y0);
+
+            auto load = [&](int tx, int ty) {
+                __m128i p = _mm_cvtsi32_si128(static_cast<int>(texel(tx, ty)));
+                __m128i zero = _mm_setzero_si128();
+                return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(p, zero), zero));
+            };
+
+            __m128 wx = _mm_set1_ps(fu - x0);
+            __m128 wy = _mm_set1_ps(fv - y0);
+
+            __m128 t0 = load(x, y);
+            __m128 t1 = load(x + 1, y);
+            __m128 b0 = load(x, y + 1);
+            __m128 b1 = load(x + 1, y + 1);
+
+            __m128 top = _mm_add_ps(t0, _mm_mul_ps(_mm_sub_ps(t1, t0), wx));
+            __m128 bottom = _mm_add_ps(b0, _mm_mul_ps(_mm_sub_ps(b1, b0), wx));
+            __m128 c = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), wy));
+
+            __m128i i = _mm_cvtps_epi32(c);
+            i = _mm_packs_epi32(i, i);
+            return static_cast<uint32>(_mm_cvtsi128_si32(_mm_packus_epi16(i, i)));
+        }
+
+        __m128i linear(__m128 u, __m128 v) const
+        {
+            alignas(16) float x[4];
+            alignas(16) float y[4];
+            _mm_store_ps(x, u);
+            _mm_store_ps(y, v);
+            return _mm_setr_epi32(linear(x[0], y[0]), linear(x[1], y[1]), linear(x[2], y[2]), linear(x[3], y[3]));
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // per frame setup of a textured quad (the image or the detail on top of it)
+
+    struct image_setup_t
+    {
+        bool active{ false };
+
+        int x0, x1, y0, y1;    // pixels it covers
+
+        // texel coordinate in the image at pixel center (x, y) = origin + x * dx + y * dy
+
+        float u_origin, u_dx, u_dy;
+        float v_origin, v_dx, v_dy;
+
+        bool minified;
+
+        // levels[0] is what's sampled (point if magnified, bilinear if not), levels[1] is the next mip
+        // blended in by level_blend / 256 (MIP_LINEAR), level_scale converts image texels to theirs
+
+        texture_t levels[2];
+        float level_scale_u[2];
+        float level_scale_v[2];
+        int level_blend;
+
+        uint32 checks[4];
+        float check_x;    // offset
+        float check_y;
+        float check_scale;
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // per frame setup of an overlay
+
+    struct overlay_setup_t
+    {
+        int x0, x1, y0, y1;
+
+        blend_color_t colors[2];
+
+        bool stripe;
+        float stripe_scale;
+        float stripe_frame;
+    };
+
+    //////////////////////////////////////////////////////////////////////
+
+    texture_t get_texture(image::image_t const &img)
+    {
+        // no pixels is a transparent texture, so just the checkerboard
+
+        if(img.pixels == null) {
+            return { null, 0, 0, 0 };
+        }
+        return { img.pixels, static_cast<int>(img.width), static_cast<int>(img.height), img.row_pitch };
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    image_setup_t setup_image(frame_t const &frame,
+                              image::image_t const &img,
+                              std::vector<image::image_t> const &mips,
+                              rect_f const &r,
+                              target_t const &target)
+    {
+        image_setup_t s{};
+
+        if(r.w <= 0 || r.h <= 0) {
+            return s;
+        }
+
+        pixel_span(r.x, r.x + r.w, target.width, s.x0, s.x1);
+        pixel_span(r.y, r.y + r.h, target.height, s.y0, s.y1);
+
+        s.active = s.x0 < s.x1 && s.y0 < s.y1;
+
+        texture_t texture = get_texture(img);
+
+        // vs_rectangle: texcoord = pos.x * m[0] + pos.y * m[1] + m[3] where pos is 0..1 across the rect
+        // so it's linear in screen x, y
+
+        XMFLOAT4X4 m;
+        XMStoreFloat4x4(&m, frame.texture_transform);
+
+        float tw = static_cast<float>(texture.width);
+        float th = static_cast<float>(texture.height);
+
+        s.u_dx = m._11 / r.w * tw;
+        s.u_dy = m._21 / r.h * tw;
+        s.u_origin = m._41 * tw - s.u_dx * r.x - s.u_dy * r.y;
+
+        s.v_dx = m._12 / r.w * th;
+        s.v_dy = m._22 / r.h * th;
+        s.v_origin = m._42 * th - s.v_dx * r.x - s.v_dy * r.y;
+
+        // more than one texel per pixel would be the min filter
+
+        float rho_x = sqrtf(s.u_dx * s.u_dx + s.v_dx * s.v_dx);
+        float rho_y = sqrtf(s.u_dy * s.u_dy + s.v_dy * s.v_dy);
+
+        float rho = std::max(rho_x, rho_y);
+
+        s.minified = rho > 1.0f;
+
+        s.levels[0] = texture;
+        s.levels[1] = texture;
+        s.level_scale_u[0] = s.level_scale_u[1] = 1;
+        s.level_scale_v[0] = s.level_scale_v[1] = 1;
+        s.level_blend = 0;
+
+        // the level of detail is log2(texels per pixel), between the two levels either side of that
+
+        if(s.minified && !mips.empty()) {
+
+            int last = static_cast<int>(mips.size());
+
+            float lod = std::min(log2f(rho), static_cast<float>(last));
+            int level = std::min(static_cast<int>(lod), last);
+
+            for(int i = 0; i < 2; ++i) {
+                int l = std::min(level + i, last);
+                image::image_t const &mip = l == 0 ? img : mips[l - 1];
+                s.levels[i] = get_texture(mip);
+                s.level_scale_u[i] = static_cast<float>(mip.width) / tw;
+                s.level_scale_v[i] = static_cast<float>(mip.height) / th;
+            }
+
+            if(level < last) {
+                s.level_blend = static_cast<int>(lrintf((lod - level) * 256.0f));
+            }
+        }
+
+        for(int i = 0; i < 4; ++i) {
+            s.checks[i] = pack_color(frame.checkerboard_colors[i]);
+        }
+        s.check_x = frame.checkerboard_offset.x;
+        s.check_y = frame.checkerboard_offset.y;
+        s.check_scale = frame.checkerboard_scale;
+
+        return s;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // ps_texture for [x0, x1) of row y
+
+    void draw_image_span(image_setup_t const &s, uint32 *row, int y, int x0, int x1)
+    {
+        float py = y + 0.5f;
+
+        __m128 lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+        __m128 u_dx = _mm_set1_ps(s.u_dx);
+        __m128 v_dx = _mm_set1_ps(s.v_dx);
+        __m128 u_row = _mm_set1_ps(s.u_origin + s.u_dy * py);
+        __m128 v_row = _mm_set1_ps(s.v_origin + s.v_dy * py);
+
+        // the shader truncates (int()) rather than floors
+
+        int check_row = (static_cast<int>((py + s.check_y) * s.check_scale) & 1) * 2;
+
+        __m128i check0 = _mm_set1_epi32(static_cast<int>(s.checks[check_row]));
+        __m128i check1 = _mm_set1_epi32(static_cast<int>(s.checks[check_row + 1]));
+
+        __m128 level_u0 = _mm_set1_ps(s.level_scale_u[0]);
+        __m128 level_v0 = _mm_set1_ps(s.level_scale_v[0]);
+        __m128 level_u1 = _mm_set1_ps(s.level_scale_u[1]);
+        __m128 level_v1 = _mm_set1_ps(s.level_scale_v[1]);
+
+        __m128 check_offset = _mm_set1_ps(s.check_x);
+        __m128 check_scale = _mm_set1_ps(s.check_scale);
+
+        __m128i one = _mm_set1_epi32(1);
+        __m128i zero = _mm_setzero_si128();
+
+        for(int x = x0; x < x1; x += 4) {
+
+            __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lanes);
+
+            __m128 u = _mm_add_ps(u_row, _mm_mul_ps(px, u_dx));
+            __m128 v = _mm_add_ps(v_row, _mm_mul_ps(px, v_dx));
+
+            __m128i texels;
+
+            if(!s.minified) {
+
+                texels = s.levels[0].point(u, v);
+
+            } else {
+
+                texels = s.levels[0].linear(_mm_mul_ps(u, level_u0), _mm_mul_ps(v, level_v0));
+
+                if(s.level_blend != 0) {
+                    __m128i next = s.levels[1].linear(_mm_mul_ps(u, level_u1), _mm_mul_ps(v, level_v1));
+                    texels = lerp_pixels(texels, next, s.level_blend);
+                }
+            }
+
+            __m128i cx = _mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(px, check_offset), check_scale));
+            __m128i odd = _mm_cmpeq_epi32(_mm_and_si128(cx, one), one);
+            __m128i check = _mm_or_si128(_mm_and_si128(odd, check1), _mm_andnot_si128(odd, check0));
+
+            __m128i lo = lerp_by_alpha(_mm_unpacklo_epi8(check, zero), _mm_unpacklo_epi8(texels, zero));
+            __m128i hi = lerp_by_alpha(_mm_unpackhi_epi8(check, zero), _mm_unpackhi_epi8(texels, zero));
+            __m128i result = _mm_packus_epi16(lo, hi);
+
+            if(x + 4 <= x1) {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(row + x), result);
+            } else {
+                alignas(16) uint32 tail[4];
+                _mm_store_si128(reinterpret_cast<__m128i *>(tail), result);
+                memcpy(row + x, tail, (x1 - x) * sizeof(uint32));
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // ps_solid or ps_stripe blended over [x0, x1) of row y
+
+    void draw_overlay_span(overlay_setup_t const &o, uint32 *row, int y, int x0, int x1)
+    {
+        __m128 lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        __m128 row_offset = _mm_set1_ps(y + 0.5f - o.stripe_frame);
+        __m128 scale = _mm_set1_ps(o.stripe_scale);
+
+        __m128i one = _mm_set1_epi32(1);
+        __m128i zero = _mm_setzero_si128();
+
+        for(int x = x0; x < x1; x += 4) {
+
+            int count = std::min(4, x1 - x);
+
+            alignas(16) uint32 pixels[4];
+            memcpy(pixels, row + x, count * sizeof(uint32));
+
+            __m128i dst = _mm_load_si128(reinterpret_cast<__m128i *>(pixels));
+            __m128i lo = _mm_unpacklo_epi8(dst, zero);
+            __m128i hi = _mm_unpackhi_epi8(dst, zero);
+
+            if(!o.stripe) {
+
+                lo = blend(lo, o.colors[0].inverse, o.colors[0].premultiplied);
+                hi = blend(hi, o.colors[0].inverse, o.colors[0].premultiplied);
+
+            } else {
+
+                // colors[int((p.x + p.y - frame) * scale) & 1]
+
+                __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lanes);
+                __m128i stripe = _mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(px, row_offset), scale));
+                __m128i odd = _mm_cmpeq_epi32(_mm_and_si128(stripe, one), one);
+
+                auto pick = [](__m128i mask, __m128i a, __m128i b) {
+                    return _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a));
+                };
+
+                // 32 bit mask per pixel -> 4 x 16 bit lanes per pixel
+
+                __m128i odd_lo = _mm_unpacklo_epi32(odd, odd);
+                __m128i odd_hi = _mm_unpackhi_epi32(odd, odd);
+
+                blend_color_t const &c0 = o.colors[0];
+                blend_color_t const &c1 = o.colors[1];
+
+                lo = blend(lo, pick(odd_lo, c0.inverse, c1.inverse), pick(odd_lo, c0.premultiplied, c1.premultiplied));
+                hi = blend(hi, pick(odd_hi, c0.inverse, c1.inverse), pick(odd_hi, c0.premultiplied, c1.premultiplied));
+            }
+
+            _mm_store_si128(reinterpret_cast<__m128i *>(pixels), _mm_packus_epi16(lo, hi));
+            memcpy(row + x, pixels, count * sizeof(uint32));
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::software_renderer
+{
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT render(frame_t const &frame, target_t const &target, thread_pool_t &pool)
+    {
+        if(target.pixels == null || target.row_pitch < target.width * 4llu) {
+            return E_INVALIDARG;
+        }
+
+        if(target.width == 0 || target.height == 0) {
+            return S_OK;
+        }
+
+        uint32 border = pack_color(frame.border_color);
+
+        image_setup_t image{};
+        image_setup_t detail{};
+
+        if(frame.draw_image) {
+
+            image = setup_image(frame, frame.image, frame.mips, frame.image_rect, target);
+
+            if(frame.draw_detail) {
+                detail = setup_image(frame, frame.detail, {}, frame.detail_rect, target);
+            }
+        }
+
+        std::vector<overlay_setup_t> overlays;
+        overlays.reserve(frame.overlays.size());
+
+        for(auto const &o : frame.overlays) {
+
+            // the rasterizer culls backfacing quads, which is what a negative size would be
+
+            if(o.rect.w <= 0 || o.rect.h <= 0) {
+                continue;
+            }
+
+            overlay_setup_t s{ 0,
+                               0,
+                               0,
+                               0,
+                               { blend_color_t(pack_color(o.colors[0])), blend_color_t(pack_color(o.colors[1])) },
+                               o.stripe_scale != 0,
+                               o.stripe_scale,
+                               o.stripe_frame };
+
+            pixel_span(o.rect.x, o.rect.x + o.rect.w, target.width, s.x0, s.x1);
+            pixel_span(o.rect.y, o.rect.y + o.rect.h, target.height, s.y0, s.y1);
+
+            if(s.x0 < s.x1 && s.y0 < s.y1) {
+                overlays.push_back(s);
+            }
+        }
+
+        int width = static_cast<int>(target.width);
+
+        pool.parallel_for(static_cast<int>(target.height), rows_per_job, [&](int from, int to) {
+
+            for(int y = from; y < to; ++y) {
+
+                uint32 *row = reinterpret_cast<uint32 *>(target.pixels + static_cast<size_t>(target.row_pitch) * y);
+
+                // the clear, then the image quad on top of it
+
+                if(image.active && y >= image.y0 && y < image.y1) {
+
+                    std::fill(row, row + image.x0, border);
+                    draw_image_span(image, row, y, image.x0, image.x1);
+                    std::fill(row + image.x1, row + width, border);
+
+                } else {
+
+                    std::fill(row, row + width, border);
+                }
+
+                if(detail.active && y >= detail.y0 && y < detail.y1) {
+                    draw_image_span(detail, row, y, detail.x0, detail.x1);
+                }
+
+                for(auto const &o : overlays) {
+                    if(y >= o.y0 && y < o.y1) {
+                        draw_overlay_span(o, row, y, o.x0, o.x1);
+                    }
+                }
+            }
+        });
+
+        return S_OK;
+    }
+}
@@ -0,0 +1,70 @@
+//////////////////////////////////////////////////////////////////////
+// draws what render() draws with the shaders but on the cpu, into a BGRA32 buffer
+// so a frame can be drawn without a gpu (or looked at without a window, see --render-to-file)
+//
+// 4 pixel spans with SSE2, rows are split up across the thread pool
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::software_renderer
+{
+    //////////////////////////////////////////////////////////////////////
+    // a rectangle drawn over the image, alpha blended like ps_solid/ps_stripe with blend_state
+
+    struct overlay_t
+    {
+        rect_f rect;                // screen pixels
+        vec4 colors[2];             // solid just uses colors[0]
+        float stripe_scale{ 0 };    // 1 / dash length, 0 for solid
+        float stripe_frame{ 0 };    // animation offset
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // everything which is drawn in a frame, render() draws from this on the gpu as well
+
+    struct frame_t
+    {
+        vec4 border_color;
+
+        // the image quad with the checkerboard behind it (ps_texture)
+
+        bool draw_image{ false };
+        image::image_t image{};               // what's in the texture, the cpu samples this
+        std::vector<image::image_t> mips;    // and the rest of its mip chain if there is one
+        rect_f image_rect{};
+        matrix texture_transform;    // flip/rotate from get_texture_transform
+        vec4 checkerboard_colors[4];
+        vec2 checkerboard_offset{ 0, 0 };
+        float checkerboard_scale{ 1 };    // 1 / grid size in screen pixels
+
+        // the sharper part of a huge image drawn on top, same transform and checkerboard
+
+        bool draw_detail{ false };
+        image::image_t detail{};
+        rect_f detail_rect{};
+
+        // selection, outline, crosshairs in the order they're drawn
+        std::vector<overlay_t> overlays;
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // a BGRA32 buffer to draw into
+
+    struct target_t
+    {
+        byte *pixels;
+        uint width;
+        uint height;
+        uint row_pitch;
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // draw a frame, bands of rows are done on the pool (and the calling thread)
+    // when the image is smaller on screen than it is it's sampled trilinear from the mip chain like the
+    // gpu does (the level of detail is worked out once per quad, it's the same everywhere on a rectangle)
+    // without a mip chain it's bilinear from the full size image
+
+    HRESULT render(frame_t const &frame, target_t const &target, thread_pool_t &pool);
+}
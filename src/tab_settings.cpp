@@ -566,8 +566,9 @@ namespace imageview::settings_ui
 
     //////////////////////////////////////////////////////////////////////
 
-    void animate_settings_page(HWND hwnd)
+    bool animate_settings_page(HWND hwnd)
     {
         update_sections(settings_container);
+        return sections_should_update;
     }
 }
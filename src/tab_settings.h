@@ -10,7 +10,8 @@ namespace imageview::settings_ui
 
     void post_new_settings();
 
-    void animate_settings_page(HWND hwnd);
+    // returns true if it's still animating
+    bool animate_settings_page(HWND hwnd);
 
     INT_PTR settings_dlgproc(HWND dlg, UINT msg, WPARAM wparam, LPARAM lparam);
 }
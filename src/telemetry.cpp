@@ -0,0 +1,222 @@
+//////////////////////////////////////////////////////////////////////
+
+#include "pch.h"
+
+LOG_CONTEXT("telemetry");
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    double constexpr one_mb = 1048576.0;
+
+    //////////////////////////////////////////////////////////////////////
+
+    std::wstring json_string(std::wstring const &s)
+    {
+        std::wstring r{ L"\"" };
+        for(wchar c : s) {
+            switch(c) {
+            case L'"':
+                r += L"\\\"";
+                break;
+            case L'\\':
+                r += L"\\\\";
+                break;
+            default:
+                if(c < 0x20) {
+                    r += std::format(L"\\u{:04x}", static_cast<uint>(c));
+                } else {
+                    r += c;
+                }
+                break;
+            }
+        }
+        r += L"\"";
+        return r;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::telemetry
+{
+    //////////////////////////////////////////////////////////////////////
+
+    std::wstring latency_histogram::summary() const
+    {
+        if(count == 0) {
+            return L"-";
+        }
+        return std::format(L"n {} mean {:.1f} p50 {:.1f} p90 {:.1f} max {:.1f}ms",
+                           count,
+                           total_ms / count,
+                           percentile(50),
+                           percentile(90),
+                           max_ms);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // bucket i counts samples >= 2^i ms (bucket 0 is everything under 2ms)
+
+    std::wstring latency_histogram::json() const
+    {
+        std::wstring b;
+        for(int i = 0; i < num_buckets; ++i) {
+            b += std::format(L"{}{}", i == 0 ? L"" : L",", buckets[i]);
+        }
+        return std::format(
+            L"{{\"count\":{},\"total_ms\":{:.3f},\"min_ms\":{:.3f},\"max_ms\":{:.3f},\"buckets_log2_ms\":[{}]}}",
+            count,
+            total_ms,
+            min_ms,
+            max_ms,
+            b);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void latency_histogram::report(wchar const *name) const
+    {
+        LOG_INFO(L"{} latency: {}", name, summary());
+
+        for(int i = 0; i < num_buckets; ++i) {
+            if(buckets[i] != 0) {
+                LOG_INFO(L"  {:5}ms+ : {}", i == 0 ? 0 : 1llu << i, buckets[i]);
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void cache_metrics::add_eviction(std::wstring const &filename, int distance, uint64 size)
+    {
+        evictions += 1;
+        recent_evictions.push_back({ filename, distance, size });
+        if(recent_evictions.size() > max_recent_evictions) {
+            recent_evictions.pop_front();
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // joins count as hits, the file was on its way
+
+    double cache_metrics::hit_rate() const
+    {
+        uint64 total = hits + misses + joins;
+        if(total == 0) {
+            return 0;
+        }
+        return 100.0 * static_cast<double>(hits + joins) / total;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    std::wstring cache_metrics::overlay_text(resident_t const &resident, int prefetch_depth) const
+    {
+        std::wstring text;
+
+        text += std::format(L"hits {} misses {} joins {} ({:.1f}%)\n", hits, misses, joins, hit_rate());
+
+        text += std::format(L"cached {} files, {:.1f}MB file + {:.1f}MB pixels of {:.1f}MB\n",
+                            resident.files_cached,
+                            resident.file_bytes / one_mb,
+                            resident.pixel_bytes / one_mb,
+                            resident.budget / one_mb);
+
+        text += std::format(L"loading {} files, texture {:.1f}MB, prefetch depth {}\n",
+                            resident.files_loading,
+                            resident.texture_bytes / one_mb,
+                            prefetch_depth);
+
+        text += std::format(L"read    {}\n", read.summary());
+        text += std::format(L"decode  {}\n", decode.summary());
+        text += std::format(L"upload  {}\n", upload.summary());
+        text += std::format(L"visible {}\n", visible.summary());
+
+        text += std::format(L"evictions {}", evictions);
+
+        if(!recent_evictions.empty()) {
+            eviction_t const &e = recent_evictions.back();
+            text += std::format(L", last at distance {} ({:.1f}MB)", e.distance, e.size / one_mb);
+        }
+        return text;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    HRESULT cache_metrics::save(std::wstring const &filename, resident_t const &resident, int prefetch_depth) const
+    {
+        std::wstring evicted;
+        for(auto const &e : recent_evictions) {
+            evicted += std::format(L"{}{{\"file\":{},\"distance\":{},\"size\":{}}}",
+                                   evicted.empty() ? L"" : L",",
+                                   json_string(e.filename),
+                                   e.distance,
+                                   e.size);
+        }
+
+        std::wstring json = std::format(
+            L"{{\n"
+            L"  \"hits\":{},\"misses\":{},\"joins\":{},\"hit_rate\":{:.2f},\n"
+            L"  \"evictions\":{},\"recent_evictions\":[{}],\n"
+            L"  \"resident\":{{\"files_cached\":{},\"files_loading\":{},\"file_bytes\":{},\"pixel_bytes\":{},"
+            L"\"texture_bytes\":{},\"budget\":{}}},\n"
+            L"  \"prefetch_depth\":{},\n"
+            L"  \"latency\":{{\n"
+            L"    \"read\":{},\n"
+            L"    \"decode\":{},\n"
+            L"    \"upload\":{},\n"
+            L"    \"visible\":{}\n"
+            L"  }}\n"
+            L"}}\n",
+            hits,
+            misses,
+            joins,
+            hit_rate(),
+            evictions,
+            evicted,
+            resident.files_cached,
+            resident.files_loading,
+            resident.file_bytes,
+            resident.pixel_bytes,
+            resident.texture_bytes,
+            resident.budget,
+            prefetch_depth,
+            read.json(),
+            decode.json(),
+            upload.json(),
+            visible.json());
+
+        std::string utf8_json = utf8(json);
+
+        HANDLE h = CreateFileW(filename.c_str(), GENERIC_WRITE, 0, null, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, null);
+        if(h == INVALID_HANDLE_VALUE) {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+        DEFER(CloseHandle(h));
+
+        DWORD wrote;
+        CHK_BOOL(WriteFile(h, utf8_json.data(), static_cast<DWORD>(utf8_json.size()), &wrote, null));
+
+        LOG_INFO(L"Saved stats to {}", filename);
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void cache_metrics::report() const
+    {
+        LOG_INFO(L"Cache: {} hits, {} misses, {} joins ({:.1f}%), {} evictions",
+                 hits,
+                 misses,
+                 joins,
+                 hit_rate(),
+                 evictions);
+
+        read.report(L"Read");
+        decode.report(L"Decode");
+        upload.report(L"Upload");
+        visible.report(L"Visible");
+    }
+}
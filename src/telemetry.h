@@ -0,0 +1,92 @@
+//////////////////////////////////////////////////////////////////////
+// cache/load metrics - what the debug overlay shows and the stats dump saves
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::telemetry
+{
+    //////////////////////////////////////////////////////////////////////
+    // latency histogram, buckets are powers of 2 milliseconds
+    // add and percentile are in latency_histogram.cpp which only needs the std lib
+
+    struct latency_histogram
+    {
+        static int constexpr num_buckets = 16;
+
+        void add(double milliseconds);
+
+        // estimated from the samples in a bucket being spread evenly across it
+        // (the lowest and highest buckets are narrowed to the min and max)
+        double percentile(double p) const;
+
+        void report(wchar const *name) const;
+
+        // one line summary for the overlay
+        std::wstring summary() const;
+
+        std::wstring json() const;
+
+        uint64 buckets[num_buckets]{};
+        uint64 count{ 0 };
+        double total_ms{ 0 };
+        double min_ms{ 0 };
+        double max_ms{ 0 };
+    };
+
+    //////////////////////////////////////////////////////////////////////
+
+    struct eviction_t
+    {
+        std::wstring filename;
+        int distance;    // from the cursor, -1 if it wasn't in the current folder
+        uint64 size;
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // bytes held at each stage, gathered when needed rather than tracked
+
+    struct resident_t
+    {
+        int files_cached{ 0 };
+        int files_loading{ 0 };
+        uint64 file_bytes{ 0 };       // encoded file contents
+        uint64 pixel_bytes{ 0 };      // decoded pixels
+        uint64 texture_bytes{ 0 };    // the current texture on the gpu (with mips)
+        uint64 budget{ 0 };
+    };
+
+    //////////////////////////////////////////////////////////////////////
+
+    struct cache_metrics
+    {
+        static size_t constexpr max_recent_evictions = 16;
+
+        // load_image found it in the cache, had to load it, or joined a load already in progress
+        uint64 hits{ 0 };
+        uint64 misses{ 0 };
+        uint64 joins{ 0 };
+
+        uint64 evictions{ 0 };
+        std::deque<eviction_t> recent_evictions;
+
+        latency_histogram read;       // file read
+        latency_histogram decode;     // decode
+        latency_histogram upload;     // create texture
+        latency_histogram visible;    // request to arrival for files which weren't cached
+
+        void add_eviction(std::wstring const &filename, int distance, uint64 size);
+
+        double hit_rate() const;
+
+        // lines of text for the debug overlay
+        std::wstring overlay_text(resident_t const &resident, int prefetch_depth) const;
+
+        // save everything as json
+        HRESULT save(std::wstring const &filename, resident_t const &resident, int prefetch_depth) const;
+
+        // log everything
+        void report() const;
+    };
+}
@@ -2,46 +2,273 @@
 
 #include "pch.h"
 
+LOG_CONTEXT("thread_pool");
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    // always have at least this many so a long job (folder scan say) doesn't stall everything
+
+    int constexpr min_workers = 2;
+
+    // which pool and worker (if any) is this thread
+
+    thread_local thread_pool_t *current_pool{ null };
+    thread_local int current_worker{ -1 };
+}
+
 //////////////////////////////////////////////////////////////////////
 
 namespace imageview
 {
+    //////////////////////////////////////////////////////////////////////
 
-    void thread_pool_t::increment_thread_count()
+    HRESULT thread_pool_t::init(int num_workers)
     {
-        InterlockedIncrement(&thread_count);
+        if(num_workers <= 0) {
+            num_workers = static_cast<int>(std::thread::hardware_concurrency());
+        }
+        num_workers = std::max(min_workers, num_workers);
+
+        // create all the deques before any worker starts looking for things to steal
+
+        {
+            std::lock_guard lock(sleep_mutex);
+
+            if(!workers.empty()) {
+                return E_UNEXPECTED;
+            }
+
+            LOG_INFO(L"Starting {} workers", num_workers);
+
+            quit = false;
+            jobs_queued = 0;
+            start_time = std::chrono::steady_clock::now();
+
+            for(int i = 0; i < num_workers; ++i) {
+                workers.push_back(std::make_unique<worker_t>());
+            }
+        }
+
+        for(int i = 0; i < num_workers; ++i) {
+            workers[i]->thread = std::thread([this, i]() { worker(i); });
+        }
+        return S_OK;
     }
 
     //////////////////////////////////////////////////////////////////////
 
-    HRESULT thread_pool_t::decrement_thread_count()
+    void thread_pool_t::cleanup()
     {
-        // The _ONLY_ thing you can do after decrementing thread_count is set thread_exit_event
-        InterlockedDecrement(&thread_count);
+        {
+            std::lock_guard lock(sleep_mutex);
+            quit = true;
+        }
+        wake.notify_all();
 
-        // also can't really check if this fails because that would involve other things
-        // happening in case of failure. Also, it won't fail. FLW.
-        SetEvent(thread_exit_event);
-        return S_OK;
+        for(auto &w : workers) {
+            w->thread.join();
+        }
+
+        LOG_INFO(L"Workers stopped, {} jobs dropped", jobs_queued.load());
+
+        // time since init can't be zero so no divide by zero here
+
+        for(size_t i = 0; i < workers.size(); ++i) {
+            LOG_INFO(L"  worker {}: {} jobs ({} stolen), busy {:.1f}%",
+                     i,
+                     workers[i]->jobs_run,
+                     workers[i]->jobs_stolen,
+                     100.0 * workers[i]->busy / (std::chrono::steady_clock::now() - start_time));
+        }
+
+        std::lock_guard lock(sleep_mutex);
+        workers.clear();
     }
 
     //////////////////////////////////////////////////////////////////////
 
-    HRESULT thread_pool_t::init()
+    int thread_pool_t::worker_count() const
     {
-        CHK_NULL(thread_exit_event = CreateEventW(null, true, true, null));
+        std::lock_guard lock(sleep_mutex);
+        return static_cast<int>(workers.size());
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // check and queue with sleep_mutex held so cleanup can't clear the workers in between
+    // and a worker can't miss the wakeup between checking jobs_queued and sleeping
+
+    HRESULT thread_pool_t::add_job(job_t job)
+    {
+        {
+            std::lock_guard lock(sleep_mutex);
+
+            if(quit || workers.empty()) {
+                return E_ABORT;
+            }
+
+            int target = current_worker;
+
+            if(current_pool != this) {
+                target = static_cast<int>(next_worker++ % workers.size());
+            }
+
+            {
+                std::lock_guard jobs_lock(workers[target]->jobs_mutex);
+                workers[target]->jobs.push_back(std::move(job));
+            }
+
+            jobs_queued += 1;
+        }
+
+        wake.notify_one();
+
         return S_OK;
     }
 
     //////////////////////////////////////////////////////////////////////
+    // newest from own deque (it's probably still in the cache), oldest from anyone else's
 
-    void thread_pool_t::cleanup()
+    bool thread_pool_t::get_job(int worker_index, job_t &job, bool &stolen)
     {
-        while(InterlockedCompareExchange(&thread_count, 0, 0) != 0) {
+        // workers can't change while there's a worker to call this
+
+        int num_workers = static_cast<int>(workers.size());
+
+        for(int i = 0; i < num_workers; ++i) {
+
+            int victim = (worker_index + i) % num_workers;
 
-            WaitForSingleObject(thread_exit_event, INFINITE);
+            worker_t &w = *workers[victim];
+
+            std::lock_guard lock(w.jobs_mutex);
+
+            if(!w.jobs.empty()) {
+
+                if(i == 0) {
+                    job = std::move(w.jobs.back());
+                    w.jobs.pop_back();
+                } else {
+                    job = std::move(w.jobs.front());
+                    w.jobs.pop_front();
+                }
+                stolen = i != 0;
+                jobs_queued -= 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void thread_pool_t::worker(int worker_index)
+    {
+        current_pool = this;
+        current_worker = worker_index;
+
+        worker_t &me = *workers[worker_index];
+
+        while(!quit) {
+
+            job_t job;
+            bool stolen{ false };
+
+            if(get_job(worker_index, job, stolen)) {
+
+                auto job_start = std::chrono::steady_clock::now();
+
+                job();
+
+                me.busy += std::chrono::steady_clock::now() - job_start;
+                me.jobs_run += 1;
+                me.jobs_stolen += stolen ? 1 : 0;
+                continue;
+            }
+
+            std::unique_lock lock(sleep_mutex);
+            wake.wait(lock, [this]() { return quit || jobs_queued > 0; });
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // helpers claim chunks with an atomic counter so a helper which starts
+    // late (or never) doesn't hold anything up, the caller just does
+    // the chunks itself. It only waits for chunks which are being run
+
+    void thread_pool_t::parallel_for(int count, int grain, range_function const &body)
+    {
+        if(count <= 0) {
+            return;
         }
 
-        CloseHandle(thread_exit_event);
+        grain = std::max(1, grain);
+
+        int num_chunks = (count + grain - 1) / grain;
+
+        int num_helpers = 0;
+
+        if(num_chunks > 1) {
+            std::lock_guard lock(sleep_mutex);
+            if(!quit) {
+                num_helpers = std::min(num_chunks - 1, static_cast<int>(workers.size()));
+            }
+        }
+
+        if(num_helpers == 0) {
+            body(0, count);
+            return;
+        }
+
+        struct progress_t
+        {
+            std::atomic<int> next{ 0 };
+            std::atomic<int> done{ 0 };
+        };
+
+        // helpers can outlive this call so the counters are shared, but they only
+        // touch body while they hold an unfinished chunk and that can't outlive it
+
+        auto progress = std::make_shared<progress_t>();
+
+        range_function const *fn = &body;
+
+        auto do_chunks = [progress, fn, count, grain, num_chunks]() {
+
+            int chunk;
+            while((chunk = progress->next++) < num_chunks) {
+
+                int begin = chunk * grain;
+                (*fn)(begin, std::min(count, begin + grain));
+                progress->done += 1;
+            }
+        };
+
+        // if the pool is stopping and a helper can't be added the caller does its chunks
+
+        for(int i = 0; i < num_helpers; ++i) {
+            add_job(do_chunks);
+        }
+
+        do_chunks();
+
+        // a worker waiting for the last chunks runs other queued jobs rather than spinning
+        // anything it picks up has to finish before this returns, so it's only ever a whole job
+
+        while(progress->done < num_chunks) {
+
+            job_t job;
+            bool stolen{ false };
+
+            if(current_pool == this && get_job(current_worker, job, stolen)) {
+                job();
+                continue;
+            }
+
+            std::this_thread::yield();
+        }
     }
-}
\ No newline at end of file
+}
@@ -1,5 +1,10 @@
 //////////////////////////////////////////////////////////////////////
-// noddy thread pool functions
+// fixed size work stealing thread pool
+//
+// each worker has its own deque, it takes its own newest job first and
+// when it runs dry it steals the oldest job from another worker
+//
+// only uses the std lib so it's not tied to Windows
 
 #pragma once
 
@@ -7,93 +12,62 @@
 
 namespace imageview
 {
-
     struct thread_pool_t
     {
-        HRESULT init();
-        void cleanup();
-
-        // NOTE: these create_thread... functions pass the args by value!!!
-
-        //////////////////////////////////////////////////////////////////////
-        // fire and forget a thread
+        using job_t = std::function<void()>;
+        using range_function = std::function<void(int, int)>;
 
-        template <class FUNC, class... Args> HRESULT create_thread(FUNC function, Args... arguments)
-        {
-            increment_thread_count();
-
-            std::thread(
+        // start `num_workers` threads, 0 means one per hardware thread
+        HRESULT init(int num_workers = 0);
 
-                [this, function](Args... args) {
-
-                    function(args...);
+        // drop any jobs which haven't started, wait for the running ones and join the workers
+        void cleanup();
 
-                    decrement_thread_count();
-                },
-                arguments...)
-                .detach();
+        // queue a job to be run on one of the workers
+        // if called from a worker it goes on that worker's deque, otherwise they're dealt out in turn
+        HRESULT add_job(job_t job);
 
-            return S_OK;
-        }
+        // call body(begin, end) for chunks of [0, count), `grain` at a time, and wait for them all
+        // the calling thread does chunks too so it's fine to call this from inside a job
+        // (and a worker runs other jobs while it waits for the last chunks)
+        void parallel_for(int count, int grain, range_function const &body);
 
-        //////////////////////////////////////////////////////////////////////
-        // force a message pump to be created before returning the thread_id
-        // so you can PostMessage to it safely as soon as this function returns
+        int worker_count() const;
 
-        template <class FUNC, class... Args>
-        HRESULT create_thread_with_message_pump(uint *thread_id, FUNC function, Args... arguments)
+    private:
+        struct worker_t
         {
-            if(thread_id == null) {
-                return E_INVALIDARG;
-            }
-
-            HANDLE msg_q_created;
-            CHK_NULL(msg_q_created = CreateEvent(null, false, false, null));
-
-            DEFER(CloseHandle(msg_q_created));
-
-            increment_thread_count();
+            std::mutex jobs_mutex;
+            std::deque<job_t> jobs;
 
-            std::thread thread = std::thread(
+            std::thread thread;
 
-                [this, function](HANDLE ev, Args... args) {
+            // only touched by the worker itself, read after it's joined
+            uint64 jobs_run{ 0 };
+            uint64 jobs_stolen{ 0 };
+            std::chrono::steady_clock::duration busy{ 0 };
+        };
 
-                    // calling PeekMessage causes a message queue to be created for this thread
-                    MSG msg;
-                    PeekMessage(&msg, (HWND)-1, 0, 0, PM_NOREMOVE);
+        void worker(int worker_index);
 
-                    // set the message_q_created event after creating the message queue
-                    SetEvent(ev);
+        // get a job from this worker's deque or steal one from another
+        bool get_job(int worker_index, job_t &job, bool &stolen);
 
-                    // do the actual thing
-                    function(args...);
+        // only changed with sleep_mutex held and no workers running
+        std::vector<std::unique_ptr<worker_t>> workers;
 
-                    // notify main thread that we're done
-                    decrement_thread_count();
-                },
-                msg_q_created,
-                arguments...);
+        // total jobs in all the deques, workers sleep when it's zero
+        std::atomic<int> jobs_queued{ 0 };
 
-            uint id;
-            CHK_BOOL(id = GetThreadId(thread.native_handle()));
+        // jobs from outside the pool are dealt to the workers in turn
+        std::atomic<uint> next_worker{ 0 };
 
-            // wait for the thread to create its message queue
-            if(WaitForSingleObject(msg_q_created, INFINITE) != WAIT_OBJECT_0) {
-                return HRESULT_FROM_WIN32(GetLastError());
-            }
+        // guards quit and workers for anyone outside the pool, workers sleep on it too
+        mutable std::mutex sleep_mutex;
+        std::condition_variable wake;
 
-            thread.detach();
-
-            *thread_id = id;
-
-            return S_OK;
-        }
-
-    private:
-        void increment_thread_count();
-        HRESULT decrement_thread_count();
+        std::atomic<bool> quit{ false };
 
-        LONG thread_count;
-        HANDLE thread_exit_event;
+        std::chrono::steady_clock::time_point start_time;
     };
-}
\ No newline at end of file
+}
@@ -56,10 +56,10 @@ namespace imageview
 
         //////////////////////////////////////////////////////////////////////
 
-        uint64 first_time;
-        uint64 last_time;
-        uint64 current_time;
-        uint64 frequency;
+        uint64 first_time{ 0 };
+        uint64 last_time{ 0 };
+        uint64 current_time{ 0 };
+        uint64 frequency{ 0 };
     };
 
     //////////////////////////////////////////////////////////////////////
@@ -0,0 +1,453 @@
+//////////////////////////////////////////////////////////////////////
+// cache policy - scores, prefetch order, the eviction queue and the prefetch estimator
+
+#include "pch.h"
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    //////////////////////////////////////////////////////////////////////
+    // standing still both sides are worth the same, moving the side behind costs more
+
+    void test_score()
+    {
+        CHECK(cache::score(5, 5, 0) == 0);
+        CHECK(cache::score(5, 5, 1) == 0);
+
+        CHECK(cache::score(7, 5, 0) == 2 * cache::ahead_weight);
+        CHECK(cache::score(3, 5, 0) == 2 * cache::ahead_weight);
+
+        CHECK(cache::score(7, 5, 1) == 2 * cache::ahead_weight);
+        CHECK(cache::score(3, 5, 1) == 2 * cache::behind_weight);
+
+        CHECK(cache::score(7, 5, -1) == 2 * cache::behind_weight);
+        CHECK(cache::score(3, 5, -1) == 2 * cache::ahead_weight);
+
+        // not in the folder, or no folder
+
+        CHECK(cache::score(-1, 5, 0) == cache::not_in_folder_score);
+        CHECK(cache::score(5, -1, 1) == cache::not_in_folder_score);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    std::vector<int> prefetch_order(int cursor, int direction, int file_count, int max_files)
+    {
+        std::vector<int> indices{ 999 };    // so it's clear it gets cleared
+        cache::get_prefetch_order(cursor, direction, file_count, max_files, indices);
+        return indices;
+    }
+
+    void test_prefetch_order()
+    {
+        // standing still ahead wins the ties, so it alternates starting forwards
+
+        CHECK(prefetch_order(10, 0, 100, 6) == std::vector<int>({ 11, 9, 12, 8, 13, 7 }));
+
+        // moving, three ahead for each one behind (with the weights 1 and 3) and ahead wins the ties
+
+        CHECK(prefetch_order(10, 1, 100, 8) == std::vector<int>({ 11, 12, 13, 9, 14, 15, 16, 8 }));
+        CHECK(prefetch_order(10, -1, 100, 8) == std::vector<int>({ 9, 8, 7, 11, 6, 5, 4, 12 }));
+
+        // cursor at either end, only one side to take from
+
+        CHECK(prefetch_order(0, 0, 100, 4) == std::vector<int>({ 1, 2, 3, 4 }));
+        CHECK(prefetch_order(0, -1, 100, 4) == std::vector<int>({ 1, 2, 3, 4 }));
+        CHECK(prefetch_order(99, 1, 100, 4) == std::vector<int>({ 98, 97, 96, 95 }));
+        CHECK(prefetch_order(99, 0, 100, 4) == std::vector<int>({ 98, 97, 96, 95 }));
+
+        // runs out of files before max_files
+
+        CHECK(prefetch_order(1, 1, 4, 10) == std::vector<int>({ 2, 3, 0 }));
+        CHECK(prefetch_order(0, 0, 1, 10).empty());
+
+        // cursor not in the folder
+
+        CHECK(prefetch_order(-1, 0, 100, 4).empty());
+        CHECK(prefetch_order(100, 0, 100, 4).empty());
+
+        // always in score order, never the cursor, never twice
+
+        for(int direction : { -1, 0, 1 }) {
+            for(int cursor : { 0, 1, 17, 48, 49 }) {
+
+                std::vector<int> order = prefetch_order(cursor, direction, 50, 50);
+                CHECK(order.size() == 49);
+
+                std::vector<bool> seen(50);
+                int previous = 0;
+                for(int i : order) {
+                    int s = cache::score(i, cursor, direction);
+                    CHECK(i != cursor);
+                    CHECK(!seen[i]);
+                    CHECK(s >= previous);
+                    seen[i] = true;
+                    previous = s;
+                }
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void test_eviction_queue()
+    {
+        cache::eviction_queue q;
+
+        CHECK(q.worst() == null);
+        CHECK(q.size() == 0);
+
+        std::vector<image::image_file> files(20);
+        for(int i = 0; i < 20; ++i) {
+            files[i].index = i;
+        }
+
+        q.set_cursor(10, 1);
+
+        for(auto &f : files) {
+            q.add(&f);
+        }
+        q.add(&files[3]);
+        CHECK(q.size() == 20);
+
+        // 0 is 10 behind
+
+        CHECK(q.worst() == &files[0]);
+        CHECK(q.get_score(&files[0]) == 10 * cache::behind_weight);
+        CHECK(q.get_score(&files[19]) == 9 * cache::ahead_weight);
+
+        // turning round rescores everything, now 19 is 9 behind
+
+        q.set_cursor(10, -1);
+
+        CHECK(q.worst() == &files[19]);
+        CHECK(q.get_score(&files[19]) == 9 * cache::behind_weight);
+        CHECK(q.get_score(&files[0]) == 10 * cache::ahead_weight);
+
+        // moving to the end
+
+        q.set_cursor(19, 1);
+
+        CHECK(q.worst() == &files[0]);
+        CHECK(q.get_score(&files[19]) == 0);
+
+        // a file which has left the folder goes first, once it's rescored
+
+        files[5].index = -1;
+        q.set_cursor(19, 1);
+
+        CHECK(q.worst() == &files[5]);
+        CHECK(q.get_score(&files[5]) == cache::not_in_folder_score);
+
+        q.remove(&files[5]);
+        q.remove(&files[5]);
+
+        CHECK(q.size() == 19);
+        CHECK(q.worst() == &files[0]);
+        CHECK(q.get_score(&files[5]) == cache::not_in_folder_score);
+
+        q.clear();
+
+        CHECK(q.size() == 0);
+        CHECK(q.worst() == null);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // evicting repeatedly while wandering about has to match the worst score found the slow way
+
+    void test_eviction_order()
+    {
+        std::mt19937 rng(1);
+
+        std::vector<image::image_file> files(200);
+        for(int i = 0; i < 200; ++i) {
+            files[i].index = i;
+        }
+
+        cache::eviction_queue q;
+
+        int cursor = 100;
+        int direction = 0;
+
+        for(int step = 0; step < 2000; ++step) {
+
+            int move = static_cast<int>(rng() % 7) - 3;
+            cursor = std::clamp(cursor + move, 0, 199);
+            direction = sgn(move);
+
+            q.set_cursor(cursor, direction);
+
+            q.add(&files[rng() % 200]);
+
+            if(rng() % 3 == 0) {
+                q.remove(&files[rng() % 200]);
+            }
+
+            if(q.size() > 32) {
+
+                image::image_file *worst = q.worst();
+                int worst_score = q.get_score(worst);
+                CHECK(worst_score == cache::score(worst->index, cursor, direction));
+
+                for(auto &f : files) {
+                    int s = q.get_score(&f);
+                    if(s != cache::not_in_folder_score) {
+                        CHECK(s <= worst_score);
+                    }
+                }
+                q.remove(worst);
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // replay a browsing session - look at a picture for a while, flick through a
+    // few quickly, now and then go back - against a simulated loader with a
+    // couple of decoders and count how often the file is there when the user
+    // gets to it. The estimator has to do better than prefetching a fixed few
+
+    struct trace_step
+    {
+        double gap;    // seconds since the previous move
+        int move;
+    };
+
+    std::vector<trace_step> make_trace()
+    {
+        std::mt19937 rng(2);
+
+        std::vector<trace_step> trace;
+        while(trace.size() < 400) {
+
+            // looking at one
+
+            trace.push_back({ 1.0 + (rng() % 3000) / 1000.0, 1 });
+
+            // then a burst
+
+            int burst = 3 + rng() % 10;
+            int move = rng() % 5 == 0 ? -1 : 1;
+            for(int i = 0; i < burst; ++i) {
+                trace.push_back({ 0.12 + (rng() % 100) / 1000.0, move });
+            }
+        }
+        return trace;
+    }
+
+    struct replay_result
+    {
+        int hits;
+        int misses;
+        int min_depth;
+        int max_depth;
+        uint64 max_in_use;
+    };
+
+    // fixed_depth 0 means use the estimator
+
+    replay_result replay(std::vector<trace_step> const &trace, int fixed_depth, uint64 budget)
+    {
+        int constexpr num_files = 2000;
+        int constexpr decoders = 2;
+        double constexpr tick = 0.005;
+
+        std::mt19937 rng(3);
+
+        // 2..6MB files which take about 100ms a MB, so two decoders can't keep up with a burst
+
+        std::vector<uint64> bytes(num_files);
+        std::vector<double> load_seconds(num_files);
+        for(int i = 0; i < num_files; ++i) {
+            bytes[i] = (2 + rng() % 5) << 20;
+            load_seconds[i] = (bytes[i] >> 20) * 0.1 * (0.8 + (rng() % 400) / 1000.0);
+        }
+
+        // a decoded file is 16 times bigger
+
+        auto size_in_cache = [&](int i) { return bytes[i] * 16; };
+
+        cache::prefetch_estimator estimator;
+
+        std::vector<bool> loaded(num_files);
+        std::vector<int> decoder_file(decoders, -1);
+        std::vector<double> decoder_done(decoders, 0);
+
+        replay_result result{ 0, 0, INT_MAX, 0, 0 };
+
+        int cursor = num_files / 2;
+        int direction = 0;
+        double now = 0;
+        double next_move = 0;
+        size_t step = 0;
+
+        std::vector<int> window;
+
+        while(step < trace.size()) {
+
+            // loads which finished
+
+            for(int d = 0; d < decoders; ++d) {
+                int f = decoder_file[d];
+                if(f != -1 && decoder_done[d] <= now) {
+                    loaded[f] = true;
+                    estimator.add_load(load_seconds[f], bytes[f], size_in_cache(f));
+                    decoder_file[d] = -1;
+                }
+            }
+
+            // the user moves
+
+            if(now >= next_move) {
+                trace_step const &s = trace[step++];
+                estimator.add_navigation(s.gap);
+                cursor = std::clamp(cursor + s.move, 0, num_files - 1);
+                direction = s.move;
+                if(loaded[cursor]) {
+                    result.hits += 1;
+                } else {
+                    result.misses += 1;
+                }
+                if(step < trace.size()) {
+                    next_move = now + trace[step].gap;
+                }
+            }
+
+            int depth = fixed_depth;
+            if(depth == 0) {
+                depth = estimator.depth(budget, decoders);
+            }
+            result.min_depth = std::min(result.min_depth, depth);
+            result.max_depth = std::max(result.max_depth, depth);
+
+            cache::get_prefetch_order(cursor, direction, num_files, depth, window);
+            window.insert(window.begin(), cursor);
+
+            // evict what's outside the window, cancel loads outside it
+
+            std::vector<bool> wanted(num_files);
+            for(int i : window) {
+                wanted[i] = true;
+            }
+
+            uint64 in_use = 0;
+            for(int i = 0; i < num_files; ++i) {
+                if(loaded[i] && !wanted[i]) {
+                    loaded[i] = false;
+                }
+                if(loaded[i]) {
+                    in_use += size_in_cache(i);
+                }
+            }
+            result.max_in_use = std::max(result.max_in_use, in_use);
+
+            for(int d = 0; d < decoders; ++d) {
+                if(decoder_file[d] != -1 && !wanted[decoder_file[d]]) {
+                    decoder_file[d] = -1;
+                }
+            }
+
+            // start loads on idle decoders, most valuable first
+
+            for(int i : window) {
+                if(loaded[i] || std::find(decoder_file.begin(), decoder_file.end(), i) != decoder_file.end()) {
+                    continue;
+                }
+                auto idle = std::find(decoder_file.begin(), decoder_file.end(), -1);
+                if(idle == decoder_file.end()) {
+                    break;
+                }
+                size_t d = idle - decoder_file.begin();
+                decoder_file[d] = i;
+                decoder_done[d] = now + load_seconds[i];
+            }
+
+            now += tick;
+        }
+        return result;
+    }
+
+    double hit_rate(replay_result const &r)
+    {
+        return r.hits * 100.0 / (r.hits + r.misses);
+    }
+
+    void test_prefetch_replay()
+    {
+        std::vector<trace_step> trace = make_trace();
+
+        uint64 constexpr budget = 4096llu << 20;
+
+        replay_result fixed = replay(trace, 4, budget);
+        replay_result estimated = replay(trace, 0, budget);
+
+        printf("prefetch replay, %zu moves: fixed depth 4 %.1f%% hits, estimator %.1f%% hits (depth %d..%d, %llu MB)\n",
+               trace.size(),
+               hit_rate(fixed),
+               hit_rate(estimated),
+               estimated.min_depth,
+               estimated.max_depth,
+               static_cast<unsigned long long>(estimated.max_in_use >> 20));
+
+        CHECK(hit_rate(estimated) > hit_rate(fixed));
+        CHECK(hit_rate(estimated) >= 90);
+        CHECK(estimated.min_depth >= 4);
+        CHECK(estimated.max_depth <= 64);
+
+        // a budget which only fits a few files keeps the depth down
+
+        uint64 constexpr small_budget = 512llu << 20;
+
+        replay_result small = replay(trace, 0, small_budget);
+
+        printf("with a %llu MB budget: %.1f%% hits (depth %d..%d, %llu MB)\n",
+               static_cast<unsigned long long>(small_budget >> 20),
+               hit_rate(small),
+               small.min_depth,
+               small.max_depth,
+               static_cast<unsigned long long>(small.max_in_use >> 20));
+
+        CHECK(small.max_depth < estimated.max_depth);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // before anything has loaded the size is a guess, after that it follows what loads take
+
+    void test_cache_size()
+    {
+        cache::prefetch_estimator estimator;
+
+        CHECK(estimator.cache_size(0) == 0);
+        CHECK(estimator.cache_size(1000) > 1000);
+
+        estimator.add_load(0.1, 1000, 5000);
+        CHECK(estimator.cache_size(2000) == 10000);
+
+        for(int i = 0; i < 50; ++i) {
+            estimator.add_load(0.1, 1000, 20000);
+        }
+        CHECK(estimator.cache_size(1000) > 19000 && estimator.cache_size(1000) <= 20000);
+
+        // a file which wasn't read (clipboard, say) doesn't count
+
+        estimator.add_load(0.1, 0, 1000000);
+        CHECK(estimator.cache_size(1000) > 19000 && estimator.cache_size(1000) <= 20000);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    test_score();
+    test_prefetch_order();
+    test_eviction_queue();
+    test_eviction_order();
+    test_prefetch_replay();
+    test_cache_size();
+
+    return imageview::test::result("cache_test");
+}
@@ -0,0 +1,336 @@
+//////////////////////////////////////////////////////////////////////
+// extension_table_t finds every extension it was built with, in any case, and nothing else
+// and how long checking a million names takes compared with how the folder scan used to do it
+
+#include "pch.h"
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    using image::format_t;
+
+    //////////////////////////////////////////////////////////////////////
+    // what WIC has on a Windows 11 machine with the HEIF, WebP and raw extensions installed
+    // (lowercased, like enum_codecs makes them)
+
+    std::vector<std::pair<std::wstring, format_t>> const windows_extensions = {
+        { L".jpg", format_t::jpeg },  { L".jpeg", format_t::jpeg }, { L".jpe", format_t::jpeg },
+        { L".jfif", format_t::jpeg }, { L".exif", format_t::jpeg }, { L".png", format_t::png },
+        { L".gif", format_t::gif },   { L".bmp", format_t::bmp },   { L".dib", format_t::bmp },
+        { L".rle", format_t::bmp },   { L".tif", format_t::tiff },  { L".tiff", format_t::tiff },
+        { L".webp", format_t::webp }, { L".heic", format_t::heif }, { L".heif", format_t::heif },
+        { L".hif", format_t::heif },  { L".avif", format_t::heif }, { L".ico", format_t::other },
+        { L".icon", format_t::other }, { L".wdp", format_t::other }, { L".jxr", format_t::other },
+        { L".dds", format_t::other }, { L".dng", format_t::other }, { L".3fr", format_t::other },
+        { L".ari", format_t::other }, { L".arw", format_t::other }, { L".bay", format_t::other },
+        { L".cap", format_t::other }, { L".cr2", format_t::other }, { L".cr3", format_t::other },
+        { L".crw", format_t::other }, { L".dcs", format_t::other }, { L".dcr", format_t::other },
+        { L".drf", format_t::other }, { L".eip", format_t::other }, { L".erf", format_t::other },
+        { L".fff", format_t::other }, { L".iiq", format_t::other }, { L".k25", format_t::other },
+        { L".kdc", format_t::other }, { L".mef", format_t::other }, { L".mos", format_t::other },
+        { L".mrw", format_t::other }, { L".nef", format_t::other }, { L".nrw", format_t::other },
+        { L".orf", format_t::other }, { L".ori", format_t::other }, { L".pef", format_t::other },
+        { L".ptx", format_t::other }, { L".pxn", format_t::other }, { L".raf", format_t::other },
+        { L".raw", format_t::other }, { L".rw2", format_t::other }, { L".rwl", format_t::other },
+        { L".sr2", format_t::other }, { L".srf", format_t::other }, { L".srw", format_t::other },
+        { L".x3f", format_t::other },
+    };
+
+    format_t find(image::extension_table_t const &table, std::wstring const &ext)
+    {
+        return table.find(ext.data(), ext.size());
+    }
+
+    format_t find_in_name(image::extension_table_t const &table, std::wstring const &name)
+    {
+        return table.find_in_name(name.data(), name.size());
+    }
+
+    size_t used_slots(image::extension_table_t const &table)
+    {
+        return std::count_if(table.slots.begin(), table.slots.end(), [](auto const &s) { return s.length != 0; });
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // every extension in every mix of upper and lower case, on its own and on the end of names and paths
+
+    void test_hits()
+    {
+        image::extension_table_t table;
+        CHECK(SUCCEEDED(table.build(windows_extensions)));
+
+        for(auto const &[ext, format] : windows_extensions) {
+
+            CHECK(find(table, ext) == format);
+            CHECK(table.contains(ext.data(), ext.size()));
+
+            // the dot doesn't have a case so that's 2^(length-1) of them
+
+            size_t letters = ext.size() - 1;
+            for(uint32 bits = 0; bits < (1u << letters); ++bits) {
+                std::wstring mixed = ext;
+                for(size_t i = 0; i < letters; ++i) {
+                    if((bits & (1u << i)) != 0) {
+                        mixed[i + 1] = static_cast<wchar>(towupper(mixed[i + 1]));
+                    }
+                }
+                CHECK(find(table, mixed) == format);
+            }
+
+            CHECK(find_in_name(table, L"IMG_0001" + ext) == format);
+            CHECK(find_in_name(table, L"a.b.c" + ext) == format);
+            CHECK(find_in_name(table, ext) == format);
+            CHECK(find_in_name(table, L"C:\\Users\\me\\Pictures\\holiday" + ext) == format);
+            CHECK(find_in_name(table, L"/home/me/some.folder/photo" + ext) == format);
+            CHECK(find_in_name(table, L"C:photo" + ext) == format);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // things which look a lot like an extension in the table but aren't
+
+    void test_near_misses()
+    {
+        image::extension_table_t table;
+        CHECK(SUCCEEDED(table.build(windows_extensions)));
+
+        std::set<std::wstring> known;
+        for(auto const &e : windows_extensions) {
+            known.insert(e.first);
+        }
+
+        // on the end of a name too, unless there's another dot making the extension something else
+
+        auto miss = [&](std::wstring const &s) {
+            if(known.count(s) == 0) {
+                CHECK(find(table, s) == format_t::none);
+                if(s.rfind(L'.') == 0) {
+                    CHECK(find_in_name(table, L"photo" + s) == format_t::none);
+                }
+            }
+        };
+
+        for(auto const &[ext, format] : windows_extensions) {
+
+            std::wstring name = ext.substr(1);
+
+            miss(ext.substr(0, ext.size() - 1));    // .jp
+            miss(ext + L"x");                       // .jpgx
+            miss(ext + L" ");                       // .jpg with a space on the end
+            miss(ext + L".");                       // .jpg.
+            miss(L"." + name.substr(1));            // .pg
+            miss(L".." + name);                     // ..jpg
+            miss(L"_" + name);                      // _jpg
+
+            // each letter changed for the next one, and for something with the same low byte
+
+            for(size_t i = 1; i < ext.size(); ++i) {
+                std::wstring changed = ext;
+                changed[i] = static_cast<wchar>(changed[i] + 1);
+                miss(changed);
+                changed[i] = static_cast<wchar>(ext[i] + 0x100);
+                miss(changed);
+            }
+
+            // no dot, or the dot isn't in the last part of the path
+
+            CHECK(find_in_name(table, name) == format_t::none);
+            CHECK(find_in_name(table, L"photo" + name) == format_t::none);
+            CHECK(find_in_name(table, L"folder" + ext + L"\\photo") == format_t::none);
+            CHECK(find_in_name(table, L"folder" + ext + L"/photo") == format_t::none);
+            CHECK(find_in_name(table, L"photo" + ext + L".txt") == format_t::none);
+        }
+
+        // only ascii letters are folded, things which look like them aren't
+
+        CHECK(find(table, L".jp\u0130") == format_t::none);    // dotted capital I
+        CHECK(find(table, L".\uff2a\uff30\uff27") == format_t::none);    // fullwidth JPG
+        CHECK(find(table, L".JP\u0047") == format_t::jpeg);
+
+        // empty, just a dot, too long to be one
+
+        CHECK(find(table, L"") == format_t::none);
+        CHECK(find(table, L".") == format_t::none);
+        CHECK(find_in_name(table, L"") == format_t::none);
+        CHECK(find_in_name(table, L"photo.") == format_t::none);
+        CHECK(find_in_name(table, L"photo.jpgjpgjpgjpgjpgjpgjpg") == format_t::none);
+        CHECK(find(table, std::wstring(image::extension_table_t::max_length + 1, L'j')) == format_t::none);
+
+        // nothing in it until it's built
+
+        image::extension_table_t empty;
+        CHECK(find(empty, L".jpg") == format_t::none);
+        CHECK(find_in_name(empty, L"photo.jpg") == format_t::none);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // every extension gets a slot of its own, for sets much bigger than WIC will ever have
+
+    void test_no_collisions()
+    {
+        image::extension_table_t table;
+        CHECK(SUCCEEDED(table.build(windows_extensions)));
+        CHECK(used_slots(table) == windows_extensions.size());
+
+        // too long ones are left out, not a reason to fail
+
+        auto with_long = windows_extensions;
+        with_long.emplace_back(L".thisisnotanextension", format_t::other);
+        CHECK(SUCCEEDED(table.build(with_long)));
+        CHECK(used_slots(table) == windows_extensions.size());
+        CHECK(find(table, L".thisisnotanextension") == format_t::none);
+
+        // the same one twice can't have a slot of its own, the table is left alone
+
+        auto twice = windows_extensions;
+        twice.emplace_back(L".jpg", format_t::jpeg);
+        CHECK(twice.size() == windows_extensions.size() + 1);
+        CHECK(table.build(twice) == E_INVALIDARG);
+        CHECK(find(table, L".jpg") == format_t::jpeg);
+
+        std::mt19937 rng(41);
+
+        for(size_t count : { 1, 2, 10, 100, 1000, 10000 }) {
+
+            std::set<std::wstring> unique;
+            while(unique.size() < count) {
+                std::wstring e = L".";
+                size_t length = 1 + rng() % 6;
+                for(size_t i = 0; i < length; ++i) {
+                    e += static_cast<wchar>(L'a' + rng() % 26);
+                }
+                unique.insert(e);
+            }
+
+            std::vector<std::pair<std::wstring, format_t>> extensions;
+            for(auto const &e : unique) {
+                extensions.emplace_back(e, static_cast<format_t>(1 + rng() % 8));
+            }
+
+            CHECK(SUCCEEDED(table.build(extensions)));
+            CHECK(used_slots(table) == count);
+            CHECK(table.slots.size() >= count * 2);
+            CHECK(table.slots.size() <= std::max<size_t>(8, count * 4));
+            CHECK(table.mask == table.slots.size() - 1);
+
+            for(auto const &[e, format] : extensions) {
+                CHECK(find(table, e) == format);
+            }
+
+            // and random ones which aren't in the set aren't found
+
+            for(int i = 0; i < 10000; ++i) {
+                std::wstring e = L".";
+                size_t length = 1 + rng() % 6;
+                for(size_t n = 0; n < length; ++n) {
+                    e += static_cast<wchar>(L'a' + rng() % 26);
+                }
+                if(unique.count(e) == 0) {
+                    CHECK(find(table, e) == format_t::none);
+                }
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a million names from a folder full of camera files, sidecars and other junk
+    // the table against what the folder scan did before: copy the name, split off the
+    // extension, lowercase it and look it up in the map from enum_codecs
+
+    void benchmark_names()
+    {
+        int constexpr num_names = 1000000;
+
+        std::mt19937 rng(1);
+
+        wchar const *others[] = { L".xmp", L".txt", L".json", L".mp4", L".mov", L".db", L".ini", L"" };
+
+        std::vector<std::wstring> names(num_names);
+        for(auto &name : names) {
+            wchar buffer[64];
+            swprintf(buffer, 64, L"IMG_%05u", rng() % 100000);
+            name = buffer;
+            if(rng() % 10 < 7) {
+                name += windows_extensions[rng() % windows_extensions.size()].first;
+                if(rng() % 2 == 0) {
+                    for(auto &c : name) {
+                        c = static_cast<wchar>(towupper(c));
+                    }
+                }
+            } else {
+                name += others[rng() % 8];
+            }
+        }
+
+        using clock = std::chrono::steady_clock;
+        using ms = std::chrono::duration<double, std::milli>;
+
+        auto start = clock::now();
+
+        image::extension_table_t table;
+        for(int i = 0; i < 1000; ++i) {
+            table.build(windows_extensions);
+        }
+
+        double build_ms = ms(clock::now() - start).count() / 1000;
+
+        start = clock::now();
+
+        size_t table_hits = 0;
+        for(auto const &name : names) {
+            table_hits += table.find_in_name(name.data(), name.size()) != format_t::none;
+        }
+
+        double table_ms = ms(clock::now() - start).count();
+
+        std::map<std::wstring, format_t> container_formats(windows_extensions.begin(), windows_extensions.end());
+
+        start = clock::now();
+
+        size_t map_hits = 0;
+        for(auto const &name : names) {
+            std::wstring filename(name.data(), name.size());
+            size_t dot = filename.find_last_of(L'.');
+            std::wstring extension = dot == std::wstring::npos ? std::wstring() : filename.substr(dot);
+            for(auto &c : extension) {
+                c = static_cast<wchar>(towlower(c));
+            }
+            map_hits += container_formats.find(extension) != container_formats.end();
+        }
+
+        double map_ms = ms(clock::now() - start).count();
+
+        CHECK(table_hits == map_hits);
+
+        printf("build: %zu extensions in %zu slots, %.1fus\n",
+               windows_extensions.size(),
+               table.slots.size(),
+               build_ms * 1000);
+
+        printf("%d names, %zu images: table %.1fms (%.1fns/name), copy+lowercase+map %.1fms (%.1fns/name), %.1fx\n",
+               num_names,
+               table_hits,
+               table_ms,
+               table_ms * 1e6 / num_names,
+               map_ms,
+               map_ms * 1e6 / num_names,
+               map_ms / table_ms);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    test_hits();
+    test_near_misses();
+    test_no_collisions();
+
+    benchmark_names();
+
+    return imageview::test::result("extension_table_test");
+}
@@ -0,0 +1,248 @@
+//////////////////////////////////////////////////////////////////////
+// position_tree and folder_scan_result lookups against a plain vector, and how long they take
+
+#include "pch.h"
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    // ids which aren't 0..n so nothing works by accident
+
+    uint64 make_id(uint64 i)
+    {
+        return i * 0x9e3779b97f4a7c15llu + 12345;
+    }
+
+    // IMG_0000012.jpg, or IMG_0000012a.jpg with a suffix
+
+    std::wstring make_name(int i, wchar const *suffix = L"")
+    {
+        wchar name[64];
+        swprintf(name, 64, L"IMG_%07d%ls.jpg", i, suffix);
+        return name;
+    }
+
+    std::vector<file::info> make_files(int count)
+    {
+        std::vector<file::info> files;
+        files.reserve(count);
+        for(int i = 0; i < count; ++i) {
+            files.emplace_back(make_name(i), 0, 0, make_id(i));
+        }
+        return files;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // random inserts and removes, the tree has to agree with a vector of the ids
+
+    void test_position_tree()
+    {
+        std::mt19937 rng(1);
+
+        for(int initial : { 0, 1, 2, 1000 }) {
+
+            std::vector<file::info> files = make_files(initial);
+
+            std::vector<uint64> ids;
+            for(auto const &f : files) {
+                ids.push_back(f.index);
+            }
+
+            file::position_tree tree;
+            tree.build(files);
+
+            uint64 next_id = initial;
+
+            for(int step = 0; step < 5000; ++step) {
+
+                int size = static_cast<int>(ids.size());
+
+                if(size == 0 || rng() % 2 == 0) {
+                    int pos = static_cast<int>(rng() % (size + 1));
+                    uint64 id = make_id(next_id++);
+                    ids.insert(ids.begin() + pos, id);
+                    tree.insert(pos, id);
+                } else {
+                    int pos = static_cast<int>(rng() % size);
+                    uint64 id = ids[pos];
+                    ids.erase(ids.begin() + pos);
+                    tree.remove(pos);
+                    CHECK(tree.find(id) == -1);
+                }
+
+                CHECK(tree.size() == static_cast<int>(ids.size()));
+
+                // all of them now and then, a few each time
+
+                if(step % 500 == 0) {
+                    for(int i = 0; i < static_cast<int>(ids.size()); ++i) {
+                        CHECK(tree.find(ids[i]) == i);
+                    }
+                } else if(!ids.empty()) {
+                    for(int i = 0; i < 4; ++i) {
+                        int pos = static_cast<int>(rng() % ids.size());
+                        CHECK(tree.find(ids[pos]) == pos);
+                    }
+                }
+            }
+
+            CHECK(tree.find(make_id(next_id)) == -1);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // folder_scan_result puts new files in sorted order and find_id follows them
+
+    void test_insert_remove()
+    {
+        file::folder_scan_result r;
+        r.files = make_files(100);
+
+        CHECK(r.find_id(r.files[10].index) == 10);
+        CHECK(r.find(L"img_0000042.JPG") == 42);
+
+        int pos = r.insert(file::info(L"IMG_0000010a.jpg", 0, 0, 1));
+        CHECK(pos == 11);
+        CHECK(r.find_id(1) == 11);
+        CHECK(r.find(L"IMG_0000042.jpg") == 43);
+
+        r.remove(0);
+        CHECK(r.find_id(1) == 10);
+        CHECK(r.find_id(make_id(0)) == -1);
+        CHECK(r.find(L"IMG_0000000.jpg") == -1);
+
+        for(int i = 0; i < static_cast<int>(r.files.size()); ++i) {
+            CHECK(r.find_id(r.files[i].index) == i);
+        }
+
+        // sorting the other way round redoes the positions
+
+        r.sort(file::scan_folder_sort_field::name, file::scan_folder_sort_order::descending);
+
+        CHECK(r.find_id(r.files[0].index) == 0);
+        CHECK(r.files[0].name == L"IMG_0000099.jpg");
+        CHECK(r.find(L"IMG_0000099.jpg") == 0);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a million files - find_id, and a watcher change (insert then remove at a random place) in the tree
+    // against renumbering everything after it in a map of id -> position, which is what it used to do
+    // then a few whole folder_scan_result changes, moving the files along in the vector is most of those
+
+    void benchmark_find_id()
+    {
+        int constexpr num_files = 1000000;
+        int constexpr lookups = 1000000;
+        int constexpr changes = 100000;
+        int constexpr renumbers = 100;
+        int constexpr scan_changes = 100;
+
+        using clock = std::chrono::steady_clock;
+        using ms = std::chrono::duration<double, std::milli>;
+
+        std::mt19937 rng(2);
+
+        file::folder_scan_result r;
+        r.files = make_files(num_files);
+
+        auto start = clock::now();
+
+        CHECK(r.find_id(r.files[0].index) == 0);
+
+        double build_ms = ms(clock::now() - start).count();
+
+        std::vector<uint64> ids(lookups);
+        for(auto &id : ids) {
+            id = make_id(rng() % num_files);
+        }
+
+        start = clock::now();
+
+        int64 total = 0;
+        for(uint64 id : ids) {
+            total += r.find_id(id);
+        }
+
+        double find_ms = ms(clock::now() - start).count();
+
+        CHECK(total > 0);
+
+        // the tree on its own
+
+        file::position_tree tree;
+        tree.build(r.files);
+
+        start = clock::now();
+
+        for(int i = 0; i < changes; ++i) {
+            int pos = static_cast<int>(rng() % num_files);
+            tree.insert(pos, make_id(num_files + i));
+            tree.remove(pos);
+        }
+
+        double tree_ms = ms(clock::now() - start).count();
+
+        CHECK(tree.size() == num_files);
+        CHECK(tree.find(r.files.back().index) == num_files - 1);
+
+        // the old way
+
+        std::unordered_map<uint64, int> positions;
+        for(int i = 0; i < num_files; ++i) {
+            positions[r.files[i].index] = i;
+        }
+
+        start = clock::now();
+
+        for(int i = 0; i < renumbers; ++i) {
+            int pos = static_cast<int>(rng() % num_files);
+            for(int j = pos; j < num_files; ++j) {
+                positions[r.files[j].index] = j + 1;
+            }
+            for(int j = pos; j < num_files; ++j) {
+                positions[r.files[j].index] = j;
+            }
+        }
+
+        double renumber_ms = ms(clock::now() - start).count();
+
+        // the whole thing
+
+        start = clock::now();
+
+        for(int i = 0; i < scan_changes; ++i) {
+            int pos = r.insert(file::info(make_name(static_cast<int>(rng() % num_files), L"a"), 0, 0, 1));
+            CHECK(r.find_id(1) == pos);
+            r.remove(pos);
+        }
+
+        double scan_ms = ms(clock::now() - start).count();
+
+        CHECK(r.find_id(r.files.back().index) == num_files - 1);
+
+        printf("find_id: %d files, build %.1fms, find %.0fns\n", num_files, build_ms, find_ms * 1e6 / lookups);
+        printf("insert + remove: tree %.2fus, renumbering a map %.2fms, folder_scan_result %.2fms\n",
+               tree_ms * 1e3 / changes,
+               renumber_ms / renumbers,
+               scan_ms / scan_changes);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    CHECK(SUCCEEDED(app::thread_pool.init(4)));
+
+    test_position_tree();
+    test_insert_remove();
+    benchmark_find_id();
+
+    app::thread_pool.cleanup();
+
+    return imageview::test::result("file_list_test");
+}
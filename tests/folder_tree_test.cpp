@@ -0,0 +1,412 @@
+//////////////////////////////////////////////////////////////////////
+// scan_subfolders on made up folder trees: everything found once, depth limits, errors, cancelling
+// and how long a million files takes, and trees with one slow folder, against a level at a time
+
+#include "pch.h"
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    using clock = std::chrono::steady_clock;
+    using ms = std::chrono::duration<double, std::milli>;
+
+    //////////////////////////////////////////////////////////////////////
+    // a folder tree in memory, reading a folder makes its file::infos like scan_one_folder does
+    // and `delay` stands in for the time the file system takes
+
+    struct folder_t
+    {
+        int num_files{ 0 };
+        std::vector<std::wstring> subfolders;
+        std::chrono::microseconds delay{ 0 };
+        HRESULT hr{ S_OK };
+    };
+
+    struct tree_t
+    {
+        std::unordered_map<std::wstring, folder_t> folders;
+
+        std::mutex mutex;
+        std::vector<std::wstring> read;
+
+        std::atomic<int> reading{ 0 };
+
+        // add `path` to its parent and return it
+
+        folder_t &add(std::wstring const &parent, std::wstring const &name, int num_files)
+        {
+            std::wstring path = parent.empty() ? name : parent + L"\\" + name;
+            folders[parent].subfolders.push_back(path);
+            folder_t &f = folders[path];
+            f.num_files = num_files;
+            return f;
+        }
+
+        file::read_folder_function reader()
+        {
+            return [this](std::wstring const &folder,
+                          std::vector<file::info> &files,
+                          std::vector<std::wstring> *subfolders) -> HRESULT {
+                reading += 1;
+
+                {
+                    std::lock_guard lock(mutex);
+                    read.push_back(folder);
+                }
+
+                folder_t const &f = folders.at(folder);
+
+                if(f.delay.count() != 0) {
+                    std::this_thread::sleep_for(f.delay);
+                }
+
+                // one which can't be opened has nothing in it
+
+                if(FAILED(f.hr) && f.hr != E_ABORT) {
+                    reading -= 1;
+                    return f.hr;
+                }
+
+                for(int i = 0; i < f.num_files; ++i) {
+                    wchar name[32];
+                    swprintf(name, 32, L"\\IMG_%04d.jpg", i);
+                    files.emplace_back(folder + name, 0, 0, 0);
+                }
+
+                if(subfolders != null) {
+                    subfolders->insert(subfolders->end(), f.subfolders.begin(), f.subfolders.end());
+                }
+                reading -= 1;
+                return f.hr;
+            };
+        }
+
+        std::vector<std::wstring> const &top() const
+        {
+            return folders.at(std::wstring()).subfolders;
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // `fanout` folders in each, `levels` deep, `num_files` in each folder
+
+    void make_tree(tree_t &tree, std::wstring const &parent, int fanout, int levels, int num_files)
+    {
+        if(levels == 0) {
+            return;
+        }
+        for(int i = 0; i < fanout; ++i) {
+            std::wstring name = L"folder" + std::to_wstring(i);
+            tree.add(parent, name, num_files);
+            make_tree(tree, parent.empty() ? name : parent + L"\\" + name, fanout, levels - 1, num_files);
+        }
+    }
+
+    int depth_of(std::wstring const &path)
+    {
+        return 1 + static_cast<int>(std::count(path.begin(), path.end(), L'\\'));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // how scan_folder did it before: parallel_for over each level, then the next level
+
+    HRESULT scan_levels(std::vector<std::wstring> folders,
+                        uint max_depth,
+                        file::read_folder_function const &read_folder,
+                        std::vector<file::info> &files)
+    {
+        for(uint depth = 1; depth <= max_depth && !folders.empty(); ++depth) {
+
+            std::vector<std::wstring> next_folders;
+            std::mutex results_mutex;
+            std::atomic<bool> cancelled{ false };
+
+            app::thread_pool.parallel_for(static_cast<int>(folders.size()), 1, [&](int from, int to) {
+                for(int i = from; i < to && !cancelled; ++i) {
+
+                    std::vector<file::info> found_files;
+                    std::vector<std::wstring> found_folders;
+
+                    HRESULT hr = read_folder(folders[i], found_files, depth < max_depth ? &found_folders : null);
+                    if(hr == E_ABORT) {
+                        cancelled = true;
+                        return;
+                    }
+
+                    std::lock_guard lock(results_mutex);
+                    files.insert(files.end(),
+                                 std::make_move_iterator(found_files.begin()),
+                                 std::make_move_iterator(found_files.end()));
+                    next_folders.insert(next_folders.end(), found_folders.begin(), found_folders.end());
+                }
+            });
+
+            if(cancelled) {
+                return E_ABORT;
+            }
+            folders = std::move(next_folders);
+        }
+        return S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // every folder down to max_depth read once and no deeper, every file in it found once
+
+    void test_depth()
+    {
+        tree_t tree;
+        make_tree(tree, std::wstring(), 3, 5, 4);
+
+        for(uint max_depth = 0; max_depth <= 6; ++max_depth) {
+
+            tree.read.clear();
+
+            std::vector<file::info> files;
+            int progress = 0;
+
+            CHECK(SUCCEEDED(file::scan_subfolders(tree.top(), max_depth, tree.reader(), files, [&]() {
+                progress += 1;
+            })));
+
+            std::set<std::wstring> expected_folders;
+            std::set<std::wstring> expected_files;
+            for(auto const &[path, f] : tree.folders) {
+                if(!path.empty() && depth_of(path) <= static_cast<int>(max_depth)) {
+                    expected_folders.insert(path);
+                    for(int i = 0; i < f.num_files; ++i) {
+                        wchar name[32];
+                        swprintf(name, 32, L"\\IMG_%04d.jpg", i);
+                        expected_files.insert(path + name);
+                    }
+                }
+            }
+
+            std::set<std::wstring> read(tree.read.begin(), tree.read.end());
+            CHECK(read.size() == tree.read.size());
+            CHECK(read == expected_folders);
+
+            std::set<std::wstring> found;
+            for(auto const &f : files) {
+                found.insert(f.name);
+            }
+            CHECK(found.size() == files.size());
+            CHECK(found == expected_files);
+
+            CHECK(max_depth == 0 || progress > 0);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a folder which can't be opened is left out, and what's under it, but nothing else
+
+    void test_errors()
+    {
+        tree_t tree;
+        make_tree(tree, std::wstring(), 2, 3, 2);
+
+        tree.folders[L"folder0"].hr = HRESULT_FROM_WIN32(5);    // access denied
+        tree.folders[L"folder1\\folder0"].hr = E_FAIL;
+
+        std::vector<file::info> files;
+        CHECK(SUCCEEDED(file::scan_subfolders(tree.top(), 3, tree.reader(), files, null)));
+
+        // 2 + 4 + 8 folders, less folder0's 6 subfolders and folder1\folder0's 2
+        // and the files in the 4 of them which could be read
+
+        CHECK(tree.read.size() == 6);
+        CHECK(files.size() == 8);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // E_ABORT from any folder stops it, and it doesn't return while a folder is still being read
+    // (read_folder and files belong to the caller)
+
+    void test_abort()
+    {
+        tree_t tree;
+        make_tree(tree, std::wstring(), 4, 4, 10);
+
+        for(auto &[path, f] : tree.folders) {
+            f.delay = std::chrono::microseconds(200);
+        }
+        tree.folders[L"folder2\\folder1"].hr = E_ABORT;
+
+        std::vector<file::info> files;
+        CHECK(file::scan_subfolders(tree.top(), 4, tree.reader(), files, null) == E_ABORT);
+        CHECK(tree.reading == 0);
+
+        size_t read = tree.read.size();
+        CHECK(read < tree.folders.size() - 1);
+
+        // jobs still queued do nothing
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK(tree.read.size() == read);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // from inside a job with one worker, nobody else is going to read the folders
+
+    void test_one_worker()
+    {
+        app::thread_pool.cleanup();
+        CHECK(SUCCEEDED(app::thread_pool.init(1)));
+
+        tree_t tree;
+        make_tree(tree, std::wstring(), 3, 3, 1);
+
+        std::mutex mutex;
+        std::condition_variable done_cv;
+        bool done = false;
+        size_t num_files = 0;
+
+        app::thread_pool.add_job([&]() {
+            std::vector<file::info> files;
+            file::scan_subfolders(tree.top(), 3, tree.reader(), files, null);
+            std::lock_guard lock(mutex);
+            num_files = files.size();
+            done = true;
+            done_cv.notify_all();
+        });
+
+        std::unique_lock lock(mutex);
+        CHECK(done_cv.wait_for(lock, std::chrono::seconds(10), [&] { return done; }));
+        CHECK(num_files == 3 + 9 + 27);
+        lock.unlock();
+
+        app::thread_pool.cleanup();
+        CHECK(SUCCEEDED(app::thread_pool.init(4)));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    template <typename F> double time_ms(F f)
+    {
+        auto start = clock::now();
+        f();
+        return ms(clock::now() - start).count();
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a million files in 1000 folders, 10 at the top with 100 in each, making the infos is all the work
+    // then trees where the file system is slow (delays instead of files), on a pool big enough to
+    // have a read going for each one it's waiting for, as it would be on a network drive
+
+    void benchmark_trees()
+    {
+        {
+            tree_t tree;
+            for(int i = 0; i < 10; ++i) {
+                std::wstring top = L"folder" + std::to_wstring(i);
+                tree.add(std::wstring(), top, 0);
+                for(int j = 0; j < 100; ++j) {
+                    tree.add(top, L"folder" + std::to_wstring(j), 1000);
+                }
+            }
+
+            std::vector<file::info> queued_files;
+            double queued = time_ms([&] { file::scan_subfolders(tree.top(), 2, tree.reader(), queued_files, null); });
+
+            std::vector<file::info> level_files;
+            double levels = time_ms([&] { scan_levels(tree.top(), 2, tree.reader(), level_files); });
+
+            CHECK(queued_files.size() == 1000000);
+            CHECK(level_files.size() == 1000000);
+
+            printf("1M files in 1000 folders, %d workers: %.0fms (%.0fk files/s), a level at a time %.0fms\n",
+                   app::thread_pool.worker_count(),
+                   queued,
+                   1e3 / queued * 1000,
+                   levels);
+        }
+
+        app::thread_pool.cleanup();
+        CHECK(SUCCEEDED(app::thread_pool.init(16)));
+
+        auto compare = [](char const *what, tree_t &tree, uint max_depth) {
+            std::vector<file::info> files;
+            double queued = time_ms([&] { file::scan_subfolders(tree.top(), max_depth, tree.reader(), files, null); });
+            size_t num_files = files.size();
+            files.clear();
+            double levels = time_ms([&] { scan_levels(tree.top(), max_depth, tree.reader(), files); });
+            CHECK(files.size() == num_files);
+            printf("%s: %.0fms, a level at a time %.0fms\n", what, queued, levels);
+            return std::make_pair(queued, levels);
+        };
+
+        // 8 folders, 4 levels, 2ms each (585 folders), lots to do at every level so both are fine
+
+        {
+            tree_t tree;
+            make_tree(tree, std::wstring(), 8, 3, 10);
+            for(auto &[path, f] : tree.folders) {
+                f.delay = std::chrono::milliseconds(2);
+            }
+            compare("wide tree, 2ms per folder", tree, 3);
+        }
+
+        // a camera dump: one huge folder which takes 300ms next to year\month\day folders 5ms each
+
+        {
+            tree_t tree;
+            tree.add(std::wstring(), L"DCIM", 100).delay = std::chrono::milliseconds(300);
+            for(int y = 0; y < 3; ++y) {
+                std::wstring year = std::to_wstring(2020 + y);
+                tree.add(std::wstring(), year, 0).delay = std::chrono::milliseconds(5);
+                for(int m = 0; m < 4; ++m) {
+                    std::wstring month = year + L"\\" + std::to_wstring(m + 1);
+                    tree.add(year, std::to_wstring(m + 1), 0).delay = std::chrono::milliseconds(5);
+                    for(int d = 0; d < 3; ++d) {
+                        tree.add(month, std::to_wstring(d + 1), 20).delay = std::chrono::milliseconds(5);
+                    }
+                }
+            }
+            auto [queued, levels] = compare("one slow folder and a year\\month\\day tree", tree, 3);
+            CHECK(queued < levels);
+        }
+
+        // deep and narrow: next to the slow folder, 4 chains 40 deep at 5ms a folder
+        // a level at a time the chains don't start until the slow folder is done
+
+        {
+            tree_t tree;
+            tree.add(std::wstring(), L"slow", 100).delay = std::chrono::milliseconds(200);
+            for(int c = 0; c < 4; ++c) {
+                std::wstring parent;
+                std::wstring name = L"chain" + std::to_wstring(c);
+                for(int d = 0; d < 40; ++d) {
+                    tree.add(parent, name, 5).delay = std::chrono::milliseconds(5);
+                    parent = parent.empty() ? name : parent + L"\\" + name;
+                    name = L"d";
+                }
+            }
+            auto [queued, levels] = compare("one slow folder and 4 chains 40 deep", tree, 40);
+            CHECK(queued < levels);
+        }
+
+        app::thread_pool.cleanup();
+        CHECK(SUCCEEDED(app::thread_pool.init(4)));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    CHECK(SUCCEEDED(app::thread_pool.init(4)));
+
+    test_depth();
+    test_errors();
+    test_abort();
+    test_one_worker();
+
+    benchmark_trees();
+
+    app::thread_pool.cleanup();
+
+    return imageview::test::result("folder_tree_test");
+}
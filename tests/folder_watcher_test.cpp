@@ -0,0 +1,300 @@
+//////////////////////////////////////////////////////////////////////
+// folder_watcher with the inotify backend - files coming, going, being renamed and
+// rewritten in a real folder, subfolders, and losing track when there are too many
+
+#include "pch.h"
+#include "test.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include <sys/stat.h>
+
+//////////////////////////////////////////////////////////////////////
+// image.cpp has the real list of extensions, these will do here
+
+namespace imageview::image
+{
+    bool can_load_filename(wchar const *name, size_t length)
+    {
+        std::wstring n(name, length);
+        return n.ends_with(L".jpg") || n.ends_with(L".png");
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    namespace fs = std::filesystem;
+
+    using folder_watcher::action_t;
+
+    //////////////////////////////////////////////////////////////////////
+    // the changes as they'd arrive at the main thread
+    // `hold` makes the callback wait, so the watcher thread stops reading
+
+    struct receiver
+    {
+        std::mutex mutex;
+        std::condition_variable arrived;
+        std::vector<folder_watcher::change_t> changes;
+        int batches{ 0 };
+        bool overflow{ false };
+
+        std::mutex hold;
+
+        folder_watcher::changes_callback callback()
+        {
+            return [this](folder_watcher::folder_changes *c) {
+                {
+                    std::lock_guard held(hold);
+                }
+                {
+                    std::lock_guard lock(mutex);
+                    changes.insert(changes.end(), c->changes.begin(), c->changes.end());
+                    overflow |= c->overflow;
+                    batches += 1;
+                }
+                arrived.notify_all();
+                delete c;
+            };
+        }
+
+        // wait for a change of some file, give up after a few seconds
+
+        bool wait_for(action_t action, std::wstring const &name, folder_watcher::change_t *found = null)
+        {
+            std::unique_lock lock(mutex);
+            return arrived.wait_for(lock, std::chrono::seconds(5), [&] {
+                for(auto const &c : changes) {
+                    if(c.action == action && c.name == name) {
+                        if(found != null) {
+                            *found = c;
+                        }
+                        return true;
+                    }
+                }
+                return false;
+            });
+        }
+
+        bool wait_for_overflow()
+        {
+            std::unique_lock lock(mutex);
+            return arrived.wait_for(lock, std::chrono::seconds(10), [&] { return overflow; });
+        }
+
+        bool any_for(std::wstring const &name)
+        {
+            std::lock_guard lock(mutex);
+            return std::any_of(changes.begin(), changes.end(), [&](auto const &c) { return c.name == name; });
+        }
+
+        bool overflowed()
+        {
+            std::lock_guard lock(mutex);
+            return overflow;
+        }
+
+        int batch_count()
+        {
+            std::lock_guard lock(mutex);
+            return batches;
+        }
+
+        void clear()
+        {
+            std::lock_guard lock(mutex);
+            changes.clear();
+            batches = 0;
+            overflow = false;
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////
+
+    fs::path make_folder()
+    {
+        fs::path folder = fs::temp_directory_path() / ("folder_watcher_test_" + std::to_string(std::random_device()()));
+        fs::create_directories(folder);
+        return folder;
+    }
+
+    std::wstring wide(fs::path const &p)
+    {
+        std::string s = p.string();
+        return std::wstring(s.begin(), s.end());
+    }
+
+    void write_file(fs::path const &p, size_t size)
+    {
+        std::ofstream f(p, std::ios::binary | std::ios::trunc);
+        std::string data(size, 'x');
+        f.write(data.data(), data.size());
+    }
+
+    uint64 inode_of(fs::path const &p)
+    {
+        struct stat s;
+        return stat(p.c_str(), &s) == 0 ? static_cast<uint64>(s.st_ino) : 0;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void test_changes()
+    {
+        fs::path folder = make_folder();
+
+        receiver r;
+
+        CHECK(FAILED(folder_watcher::start(wide(folder / "not_there"), false, r.callback())));
+
+        CHECK(SUCCEEDED(folder_watcher::start(wide(folder), false, r.callback())));
+
+        // a new file, with the details filled in
+
+        folder_watcher::change_t c;
+
+        write_file(folder / "a.jpg", 1000);
+        CHECK(r.wait_for(action_t::added, L"a.jpg", &c));
+        CHECK(c.index == inode_of(folder / "a.jpg"));
+
+        // rewritten (the first write finishing is a change as well)
+
+        CHECK(r.wait_for(action_t::modified, L"a.jpg"));
+        r.clear();
+
+        write_file(folder / "a.jpg", 2000);
+        CHECK(r.wait_for(action_t::modified, L"a.jpg", &c));
+        CHECK(c.size == 2000);
+        CHECK(c.date != 0);
+
+        // renamed is removed + added with the same id
+
+        uint64 id = inode_of(folder / "a.jpg");
+        fs::rename(folder / "a.jpg", folder / "b.jpg");
+        CHECK(r.wait_for(action_t::removed, L"a.jpg"));
+        CHECK(r.wait_for(action_t::added, L"b.jpg", &c));
+        CHECK(c.index == id);
+
+        // deleted
+
+        fs::remove(folder / "b.jpg");
+        CHECK(r.wait_for(action_t::removed, L"b.jpg"));
+
+        // not images, and a subfolder which isn't being watched
+
+        write_file(folder / "notes.txt", 10);
+        fs::create_directory(folder / "sub");
+        write_file(folder / "sub" / "c.jpg", 10);
+
+        write_file(folder / "last.png", 10);
+        CHECK(r.wait_for(action_t::added, L"last.png"));
+
+        CHECK(!r.any_for(L"notes.txt"));
+        CHECK(!r.any_for(L"sub"));
+        CHECK(!r.any_for(L"sub/c.jpg"));
+        CHECK(!r.overflowed());
+
+        // nothing after stop
+
+        folder_watcher::stop();
+
+        r.clear();
+        write_file(folder / "after.jpg", 10);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK(r.batch_count() == 0);
+
+        folder_watcher::stop();
+
+        std::error_code ec;
+        fs::remove_all(folder, ec);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // names in subfolders are relative, a new folder means a rescan (and it's watched from then on)
+
+    void test_subtree()
+    {
+        fs::path folder = make_folder();
+        fs::create_directories(folder / "sub" / "deeper");
+
+        receiver r;
+
+        CHECK(SUCCEEDED(folder_watcher::start(wide(folder), true, r.callback())));
+
+        write_file(folder / "sub" / "deeper" / "c.png", 10);
+        CHECK(r.wait_for(action_t::added, L"sub/deeper/c.png"));
+        CHECK(!r.overflowed());
+
+        fs::create_directory(folder / "new");
+        CHECK(r.wait_for_overflow());
+
+        write_file(folder / "new" / "d.jpg", 10);
+        CHECK(r.wait_for(action_t::added, L"new/d.jpg"));
+
+        folder_watcher::stop();
+
+        std::error_code ec;
+        fs::remove_all(folder, ec);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // if the main thread is slow and the queue fills up, it says so and the folder gets rescanned
+
+    void test_overflow()
+    {
+        int max_events = 16384;
+
+        std::ifstream limit("/proc/sys/fs/inotify/max_queued_events");
+        limit >> max_events;
+
+        // each new file is a create and a close
+
+        if(max_events > 100000) {
+            printf("max_queued_events is %d, not testing overflow\n", max_events);
+            return;
+        }
+
+        fs::path folder = make_folder();
+
+        receiver r;
+
+        CHECK(SUCCEEDED(folder_watcher::start(wide(folder), false, r.callback())));
+
+        {
+            std::unique_lock held(r.hold);
+
+            write_file(folder / "first.jpg", 10);
+
+            // let the watcher get stuck in the callback
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            for(int i = 0; i < max_events / 2 + 100; ++i) {
+                write_file(folder / ("flood_" + std::to_string(i) + ".jpg"), 1);
+            }
+        }
+
+        CHECK(r.wait_for_overflow());
+
+        folder_watcher::stop();
+
+        std::error_code ec;
+        fs::remove_all(folder, ec);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    test_changes();
+    test_subtree();
+    test_overflow();
+
+    return imageview::test::result("folder_watcher_test");
+}
@@ -0,0 +1,139 @@
+//////////////////////////////////////////////////////////////////////
+// tests for frame_scheduler_t, times are just made up seconds
+
+#include "pch.h"
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    bool near(double a, double b)
+    {
+        return std::fabs(a - b) < 1e-9;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // the first frame is due, then nothing until something asks for one
+
+    void test_invalidate()
+    {
+        frame_scheduler_t s;
+
+        CHECK(s.frame_due(0));
+        CHECK(s.wait_seconds(0) == 0);
+
+        s.begin_frame(0);
+
+        CHECK(!s.frame_due(1));
+        CHECK(s.wait_seconds(1) < 0);
+
+        s.invalidate();
+
+        CHECK(s.frame_due(1));
+        CHECK(s.wait_seconds(1) == 0);
+
+        s.begin_frame(1);
+
+        CHECK(!s.frame_due(2));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // animate only lasts one frame, it has to be asked for again
+
+    void test_animate()
+    {
+        frame_scheduler_t s;
+        s.begin_frame(0);
+
+        s.animate();
+        CHECK(s.frame_due(0.01));
+
+        s.begin_frame(0.01);
+        CHECK(!s.frame_due(0.02));
+
+        s.animate();
+        s.begin_frame(0.02);
+        s.animate();
+        CHECK(s.wait_seconds(0.03) == 0);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // the earliest wake time wins and it's cleared by the frame which was due for it
+
+    void test_wake_at()
+    {
+        frame_scheduler_t s;
+        s.begin_frame(0);
+
+        s.wake_at(5);
+        s.wake_at(3);
+        s.wake_at(4);
+
+        CHECK(!s.frame_due(1));
+        CHECK(near(s.wait_seconds(1), 2));
+        CHECK(s.frame_due(3));
+        CHECK(s.wait_seconds(3.5) == 0);
+
+        // a frame before it's due leaves it alone
+
+        s.invalidate();
+        s.begin_frame(2);
+        CHECK(near(s.wait_seconds(2), 1));
+
+        // the one which is due clears it
+
+        s.begin_frame(3);
+        CHECK(!s.frame_due(10));
+        CHECK(s.wait_seconds(10) < 0);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // after being idle the delta is one nominal frame, while animating it's the real
+    // time since the last frame but never more than max_frame_seconds (or less than 0)
+
+    void test_begin_frame_delta()
+    {
+        frame_scheduler_t s;
+
+        CHECK(near(s.begin_frame(100), frame_scheduler_t::idle_frame_seconds));
+
+        // idle for ages then start animating
+
+        s.animate();
+        CHECK(near(s.begin_frame(200), frame_scheduler_t::idle_frame_seconds));
+
+        s.animate();
+        CHECK(near(s.begin_frame(200.02), 0.02));
+
+        // a long stall is clamped
+
+        s.animate();
+        CHECK(near(s.begin_frame(210), frame_scheduler_t::max_frame_seconds));
+
+        // time going backwards is clamped too
+
+        s.animate();
+        CHECK(near(s.begin_frame(209), 0));
+
+        // stopped animating, the next frame is nominal again
+
+        s.begin_frame(209.01);
+        s.invalidate();
+        CHECK(near(s.begin_frame(300), frame_scheduler_t::idle_frame_seconds));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    test_invalidate();
+    test_animate();
+    test_wake_at();
+    test_begin_frame_delta();
+
+    return imageview::test::result("frame_scheduler_test");
+}
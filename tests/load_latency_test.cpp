@@ -0,0 +1,520 @@
+//////////////////////////////////////////////////////////////////////
+// how long the file the user asked for takes to arrive while other loads are in flight
+//
+// the load scheduler, thread pool, prefetch order and latency histogram are the real ones
+// and viewer_t does what app.cpp's load_image, warm_cache, cancel_unwanted_loads and
+// move_file_cursor (with coalescing during key repeat) do
+// the disk is simulated (one chunk at a time, first come first served) and decoding is
+// a fixed amount of arithmetic per band so it competes for the cores like a real decode
+
+#include "pch.h"
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    //////////////////////////////////////////////////////////////////////
+    // a file is read in chunks and decoded in bands, cancelling is checked between them
+
+    int constexpr read_chunks = 8;
+    int constexpr decode_bands = 8;
+
+    struct cost_t
+    {
+        char const *name;
+        int chunk_ms;
+        double band_ms;
+    };
+
+    // a phone photo, and a big camera jpeg which takes a lot longer to decode than to read
+
+    cost_t constexpr light_file{ "40ms files", 2, 3.0 };
+    cost_t constexpr heavy_file{ "190ms files", 4, 20.0 };
+
+    int constexpr folder_size = 1000;
+    int constexpr prefetch_depth = 12;
+
+    // windows key repeat at its fastest
+    auto constexpr repeat_time = std::chrono::milliseconds(33);
+
+    //////////////////////////////////////////////////////////////////////
+    // chunks are served in the order they're asked for, so concurrent reads share the disk
+
+    struct disk_t
+    {
+        std::chrono::milliseconds chunk_time{ 0 };
+
+        std::mutex mutex;
+        std::condition_variable served;
+        uint64 next_ticket{ 0 };
+        uint64 now_serving{ 0 };
+
+        void read_chunk()
+        {
+            std::unique_lock lock(mutex);
+            uint64 ticket = next_ticket++;
+            served.wait(lock, [&]() { return now_serving == ticket; });
+            lock.unlock();
+
+            std::this_thread::sleep_for(chunk_time);
+
+            lock.lock();
+            now_serving += 1;
+            served.notify_all();
+        }
+    };
+
+    disk_t disk;
+
+    //////////////////////////////////////////////////////////////////////
+    // iterations of the busy loop which take a millisecond on one core, and a band
+
+    double iterations_per_ms = 0;
+    uint64 band_iterations = 0;
+
+    void set_cost(cost_t const &cost)
+    {
+        disk.chunk_time = std::chrono::milliseconds(cost.chunk_ms);
+        band_iterations = static_cast<uint64>(iterations_per_ms * cost.band_ms);
+    }
+
+    uint32 busy(uint64 iterations)
+    {
+        uint32 x = 1;
+        for(uint64 i = 0; i < iterations; ++i) {
+            x = x * 1664525u + 1013904223u;
+        }
+        return x;
+    }
+
+    std::atomic<uint32> busy_result{ 0 };
+
+    void calibrate()
+    {
+        uint64 iterations = 1 << 16;
+        while(true) {
+            auto start = std::chrono::steady_clock::now();
+            busy_result += busy(iterations);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if(elapsed.count() > 20) {
+                iterations_per_ms = iterations / elapsed.count();
+                return;
+            }
+            iterations *= 2;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    struct test_file : image::image_file
+    {
+        std::atomic<bool> cancelled{ false };
+    };
+
+    void read_job(image::image_file *f)
+    {
+        test_file *t = static_cast<test_file *>(f);
+        for(int i = 0; i < read_chunks; ++i) {
+            if(t->cancelled) {
+                t->hresult = E_ABORT;
+                return;
+            }
+            disk.read_chunk();
+        }
+        t->hresult = S_OK;
+    }
+
+    void decode_job(image::image_file *f)
+    {
+        test_file *t = static_cast<test_file *>(f);
+        for(int i = 0; i < decode_bands; ++i) {
+            if(t->cancelled) {
+                t->hresult = E_ABORT;
+                return;
+            }
+            busy_result += busy(band_iterations);
+        }
+        t->hresult = S_OK;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // the bits of app.cpp which decide what gets loaded, with the ui thread's state under a mutex
+    // the cache has no budget so nothing is evicted
+
+    struct viewer_t
+    {
+        bool cancel_unwanted{ true };
+        bool coalesce{ true };
+
+        scheduler::load_scheduler file_scheduler;
+
+        std::mutex mutex;
+        std::condition_variable arrived;
+
+        std::map<int, test_file *> loading_files;
+        std::set<int> loaded_files;
+
+        test_file *requested_file{ null };
+        int direction{ 0 };
+        bool navigation_pending{ false };
+
+        void init(thread_pool_t &pool)
+        {
+            file_scheduler.init(pool, read_job, decode_job, [this](image::image_file *f) {
+                on_file_load_complete(static_cast<test_file *>(f));
+            });
+        }
+
+        void cleanup()
+        {
+            file_scheduler.cleanup();
+        }
+
+        test_file *new_file_loader(int index)
+        {
+            test_file *f = new test_file();
+            f->index = index;
+            loading_files[index] = f;
+            return f;
+        }
+
+        void cancel_unwanted_loads(int cursor)
+        {
+            if(!cancel_unwanted) {
+                return;
+            }
+            std::vector<int> window;
+            cache::get_prefetch_order(cursor, direction, folder_size, prefetch_depth, window);
+            std::sort(window.begin(), window.end());
+
+            for(auto it = loading_files.begin(); it != loading_files.end();) {
+                test_file *f = it->second;
+                if(f != requested_file && f->index != cursor &&
+                   !std::binary_search(window.begin(), window.end(), f->index)) {
+                    f->cancelled = true;
+                    it = loading_files.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        void warm_cache(int cursor)
+        {
+            if(navigation_pending) {
+                return;
+            }
+
+            cancel_unwanted_loads(cursor);
+
+            std::vector<int> indices;
+            cache::get_prefetch_order(cursor, direction, folder_size, prefetch_depth, indices);
+
+            for(int y : indices) {
+
+                scheduler::priority_t priority = scheduler::priority_speculative;
+                if(cache::score(y, cursor, direction) <= cache::ahead_weight) {
+                    priority = scheduler::priority_next;
+                }
+
+                auto loading = loading_files.find(y);
+                if(loading != loading_files.end()) {
+                    file_scheduler.promote(loading->second, priority);
+                    continue;
+                }
+                if(loaded_files.count(y) != 0) {
+                    continue;
+                }
+                file_scheduler.add(new_file_loader(y), priority);
+            }
+        }
+
+        // load_image, returns true if it was already there
+
+        bool load_image(int index)
+        {
+            std::lock_guard lock(mutex);
+            return load_image_locked(index);
+        }
+
+        bool load_image_locked(int index)
+        {
+            navigation_pending = false;
+
+            if(loaded_files.count(index) != 0) {
+                warm_cache(index);
+                return true;
+            }
+
+            auto found = loading_files.find(index);
+            if(found != loading_files.end()) {
+                requested_file = found->second;
+                file_scheduler.promote(requested_file, scheduler::priority_visible);
+                cancel_unwanted_loads(index);
+                return false;
+            }
+
+            requested_file = new_file_loader(index);
+            cancel_unwanted_loads(index);
+            file_scheduler.add(requested_file, scheduler::priority_visible);
+            return false;
+        }
+
+        // a step of key repeat, with coalescing the file isn't loaded until the key is released
+
+        void repeat_step(int cursor)
+        {
+            std::lock_guard lock(mutex);
+
+            if(!coalesce) {
+                load_image_locked(cursor);
+                return;
+            }
+
+            // whatever was asked for before carries on as a cache load if it's still nearby
+
+            requested_file = null;
+            cancel_unwanted_loads(cursor);
+            navigation_pending = true;
+        }
+
+        void key_up(int cursor)
+        {
+            if(coalesce) {
+                load_image(cursor);
+            }
+        }
+
+        void on_file_load_complete(test_file *f)
+        {
+            std::lock_guard lock(mutex);
+
+            auto found = loading_files.find(f->index);
+            if(found != loading_files.end() && found->second == f) {
+                loading_files.erase(found);
+            }
+
+            if(!f->cancelled && SUCCEEDED(f->hresult)) {
+                loaded_files.insert(f->index);
+                if(f == requested_file) {
+                    requested_file = null;
+                    warm_cache(f->index);
+                }
+                arrived.notify_all();
+            }
+            delete f;
+        }
+
+        void wait_for(int index)
+        {
+            std::unique_lock lock(mutex);
+            arrived.wait(lock, [&]() { return loaded_files.count(index) != 0; });
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // sitting on file 10 with the prefetches around it just queued, jump to file 900
+
+    double jump(thread_pool_t &pool, bool cancel_unwanted)
+    {
+        viewer_t viewer;
+        viewer.cancel_unwanted = cancel_unwanted;
+        viewer.init(pool);
+        viewer.direction = 1;
+
+        viewer.load_image(10);
+        viewer.wait_for(10);
+
+        auto start = std::chrono::steady_clock::now();
+
+        viewer.load_image(900);
+        viewer.wait_for(900);
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        viewer.cleanup();
+
+        return elapsed.count();
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void measure_jump(thread_pool_t &pool)
+    {
+        int constexpr trials = 10;
+
+        set_cost(light_file);
+
+        telemetry::latency_histogram without_cancel;
+        telemetry::latency_histogram with_cancel;
+
+        for(int i = 0; i < trials; ++i) {
+            without_cancel.add(jump(pool, false));
+            with_cancel.add(jump(pool, true));
+        }
+
+        printf("jump 10 -> 900, %d prefetches of %s in flight, %d workers\n",
+               prefetch_depth,
+               light_file.name,
+               pool.worker_count());
+        printf("  not cancelled: p50 %6.1fms p90 %6.1fms max %6.1fms\n",
+               without_cancel.percentile(50),
+               without_cancel.percentile(90),
+               without_cancel.max_ms);
+        printf("  cancelled    : p50 %6.1fms p90 %6.1fms max %6.1fms\n",
+               with_cancel.percentile(50),
+               with_cancel.percentile(90),
+               with_cancel.max_ms);
+
+        // cancelled loads stop at their next chunk or band so the one asked for has the disk to itself
+
+        CHECK(with_cancel.total_ms < without_cancel.total_ms);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // hold the key down from file 100 to file 300, then let go
+    // how long after letting go does file 300 arrive
+
+    double sweep(thread_pool_t &pool, bool coalesce)
+    {
+        int constexpr first = 100;
+        int constexpr steps = 200;
+
+        viewer_t viewer;
+        viewer.coalesce = coalesce;
+        viewer.init(pool);
+        viewer.direction = 1;
+
+        viewer.load_image(first);
+        viewer.wait_for(first);
+
+        auto step_time = std::chrono::steady_clock::now();
+
+        for(int i = 1; i <= steps; ++i) {
+            step_time += repeat_time;
+            std::this_thread::sleep_until(step_time);
+            viewer.repeat_step(first + i);
+        }
+
+        // let go just before the next repeat would have come
+
+        std::this_thread::sleep_until(step_time + repeat_time);
+
+        auto start = std::chrono::steady_clock::now();
+
+        viewer.key_up(first + steps);
+        viewer.wait_for(first + steps);
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        viewer.cleanup();
+
+        return elapsed.count();
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // returns whether coalescing got the last file there sooner
+
+    bool measure_sweep(thread_pool_t &pool, cost_t const &cost)
+    {
+        int constexpr trials = 2;
+
+        set_cost(cost);
+
+        telemetry::latency_histogram without_coalescing;
+        telemetry::latency_histogram with_coalescing;
+
+        for(int i = 0; i < trials; ++i) {
+            without_coalescing.add(sweep(pool, false));
+            with_coalescing.add(sweep(pool, true));
+        }
+
+        printf("200 file sweep of %s at %dms a step, time to the last file after the key is released\n",
+               cost.name,
+               static_cast<int>(repeat_time.count()));
+        printf("  every step loaded: min %6.1fms p50 %6.1fms max %6.1fms\n",
+               without_coalescing.min_ms,
+               without_coalescing.percentile(50),
+               without_coalescing.max_ms);
+        printf("  coalesced        : min %6.1fms p50 %6.1fms max %6.1fms\n",
+               with_coalescing.min_ms,
+               with_coalescing.percentile(50),
+               with_coalescing.max_ms);
+
+        return with_coalescing.total_ms < without_coalescing.total_ms;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // percentiles move smoothly through a bucket rather than jumping to its top
+
+    void test_percentile()
+    {
+        telemetry::latency_histogram h;
+        CHECK(h.percentile(50) == 0);
+
+        // all in one bucket [16, 32), spread out between the min and max
+
+        for(int i = 0; i < 10; ++i) {
+            h.add(20.0 + i);
+        }
+        CHECK(h.min_ms == 20 && h.max_ms == 29);
+        CHECK(h.percentile(0) == 20);
+        CHECK(h.percentile(100) == 29);
+        CHECK(fabs(h.percentile(50) - 24.5) < 1e-9);
+
+        // half under 2ms, half in [64, 128)
+
+        telemetry::latency_histogram split;
+        for(int i = 0; i < 50; ++i) {
+            split.add(1.0);
+            split.add(100.0);
+        }
+        CHECK(split.percentile(25) >= 1.0 && split.percentile(25) < 2.0);
+        CHECK(split.percentile(75) >= 64.0 && split.percentile(75) <= 100.0);
+        CHECK(split.percentile(100) == 100.0);
+
+        // never goes down as p goes up
+
+        telemetry::latency_histogram spread;
+        std::mt19937 rng(1);
+        for(int i = 0; i < 1000; ++i) {
+            spread.add(std::exponential_distribution<double>(0.02)(rng));
+        }
+        double last = 0;
+        for(int p = 0; p <= 100; ++p) {
+            double v = spread.percentile(p);
+            CHECK(v >= last && v <= spread.max_ms);
+            last = v;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    test_percentile();
+
+    calibrate();
+
+    // the same number of workers as the app, a decoder per core and the reads on top
+
+    int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    thread_pool_t pool;
+    CHECK(SUCCEEDED(pool.init(cores + scheduler::load_scheduler::max_reads)));
+
+    measure_jump(pool);
+    // light files load faster than the key repeats so loading every step keeps up and the last
+    // one is already there, coalescing only wins when loads can't keep up
+
+    measure_sweep(pool, light_file);
+    CHECK(measure_sweep(pool, heavy_file));
+
+    pool.cleanup();
+
+    return imageview::test::result("load_latency_test");
+}
@@ -0,0 +1,389 @@
+//////////////////////////////////////////////////////////////////////
+// metadata_indexer reads everything it's given once, takes more while it's running
+// and stops when it's told to, and how many files a second it gets through
+
+#include "pch.h"
+#include "test.h"
+
+#include <filesystem>
+
+//////////////////////////////////////////////////////////////////////
+// the app reads the headers with WIC, this reads the width and height out of the
+// png and jpeg headers the test makes so there's some real file io in the timing
+
+namespace imageview::image
+{
+    HRESULT get_metadata(std::wstring const &filename, metadata_t &metadata)
+    {
+        std::string narrow;
+        for(wchar c : filename) {
+            narrow += c == L'\\' ? '/' : static_cast<char>(c);
+        }
+
+        FILE *f = fopen(narrow.c_str(), "rb");
+        if(f == null) {
+            return E_INVALIDARG;
+        }
+
+        byte header[4096];
+        size_t got = fread(header, 1, sizeof(header), f);
+        fclose(f);
+
+        auto be16 = [&](size_t i) { return static_cast<uint32>(header[i] << 8 | header[i + 1]); };
+        auto be32 = [&](size_t i) { return be16(i) << 16 | be16(i + 2); };
+
+        metadata = {};
+
+        // png, IHDR comes first
+
+        if(got >= 24 && memcmp(header, "\x89PNG", 4) == 0) {
+            metadata.width = be32(16);
+            metadata.height = be32(20);
+            return S_OK;
+        }
+
+        // jpeg, skip segments until a start of frame
+
+        if(got >= 4 && header[0] == 0xff && header[1] == 0xd8) {
+            for(size_t i = 2; i + 9 <= got && header[i] == 0xff;) {
+                byte marker = header[i + 1];
+                if(marker >= 0xc0 && marker <= 0xcf && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+                    metadata.height = be16(i + 5);
+                    metadata.width = be16(i + 7);
+                    return S_OK;
+                }
+                i += 2 + be16(i + 2);
+            }
+        }
+        return E_INVALIDARG;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    namespace fs = std::filesystem;
+
+    //////////////////////////////////////////////////////////////////////
+    // the results as they'd arrive at the main thread
+
+    struct receiver
+    {
+        std::mutex mutex;
+        std::condition_variable arrived;
+        std::vector<metadata_indexer::result_t> files;
+        int batches{ 0 };
+        int completes{ 0 };
+
+        metadata_indexer::results_callback callback()
+        {
+            return [this](metadata_indexer::results_t *results) {
+                {
+                    std::lock_guard lock(mutex);
+                    files.insert(files.end(), results->files.begin(), results->files.end());
+                    batches += 1;
+                    completes += results->complete ? 1 : 0;
+                }
+                arrived.notify_all();
+                delete results;
+            };
+        }
+
+        void clear()
+        {
+            std::lock_guard lock(mutex);
+            files.clear();
+            batches = 0;
+            completes = 0;
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // a folder of pngs and jpegs with made up sizes, padded out to `file_size`
+
+    struct corpus
+    {
+        fs::path folder;
+        std::vector<metadata_indexer::file_t> files;
+        std::vector<std::pair<uint32, uint32>> sizes;    // by index
+
+        uint32 width_of(uint64 i) const
+        {
+            return sizes[i].first;
+        }
+
+        uint32 height_of(uint64 i) const
+        {
+            return sizes[i].second;
+        }
+    };
+
+    void put16(std::vector<byte> &b, uint32 x)
+    {
+        b.push_back(static_cast<byte>(x >> 8));
+        b.push_back(static_cast<byte>(x));
+    }
+
+    void put32(std::vector<byte> &b, uint32 x)
+    {
+        put16(b, x >> 16);
+        put16(b, x & 0xffff);
+    }
+
+    std::vector<byte> make_png(uint32 w, uint32 h)
+    {
+        std::vector<byte> b{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        put32(b, 13);
+        b.insert(b.end(), { 'I', 'H', 'D', 'R' });
+        put32(b, w);
+        put32(b, h);
+        b.insert(b.end(), { 8, 6, 0, 0, 0 });
+        return b;
+    }
+
+    // an app1 segment in front of the frame header like a camera jpeg
+
+    std::vector<byte> make_jpeg(uint32 w, uint32 h)
+    {
+        std::vector<byte> b{ 0xff, 0xd8, 0xff, 0xe1 };
+        put16(b, 1000);
+        b.resize(b.size() + 998);
+        b.insert(b.end(), { 0xff, 0xc0 });
+        put16(b, 17);
+        b.push_back(8);
+        put16(b, h);
+        put16(b, w);
+        b.insert(b.end(), { 3, 1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1 });
+        return b;
+    }
+
+    corpus make_corpus(int count, size_t file_size)
+    {
+        corpus c;
+        c.folder = fs::temp_directory_path() / ("metadata_indexer_test_" + std::to_string(std::random_device()()));
+        fs::create_directories(c.folder);
+
+        std::mt19937 rng(1);
+
+        for(int i = 0; i < count; ++i) {
+
+            uint32 w = 1 + rng() % 8000;
+            uint32 h = 1 + rng() % 8000;
+
+            bool png = i % 2 == 0;
+            std::vector<byte> data = png ? make_png(w, h) : make_jpeg(w, h);
+            data.resize(std::max(data.size(), file_size));
+
+            char name[32];
+            snprintf(name, sizeof(name), "IMG_%05d.%s", i, png ? "png" : "jpg");
+
+            FILE *f = fopen((c.folder / name).c_str(), "wb");
+            CHECK(f != null);
+            if(f != null) {
+                fwrite(data.data(), 1, data.size(), f);
+                fclose(f);
+            }
+
+            c.files.push_back({ static_cast<uint64>(i), std::wstring(name, name + strlen(name)) });
+            c.sizes.emplace_back(w, h);
+        }
+        return c;
+    }
+
+    std::wstring wide_path(fs::path const &p)
+    {
+        std::string s = p.string();
+        return std::wstring(s.begin(), s.end());
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // every one once, with the right size
+
+    bool check_results(corpus const &c, std::vector<metadata_indexer::result_t> const &files, size_t count)
+    {
+        if(files.size() != count) {
+            fprintf(stderr, "got %zu results, expected %zu\n", files.size(), count);
+            return false;
+        }
+        std::vector<bool> seen(c.sizes.size());
+        for(auto const &r : files) {
+            if(r.index >= seen.size() || seen[r.index] || r.metadata.width != c.width_of(r.index) ||
+               r.metadata.height != c.height_of(r.index)) {
+                return false;
+            }
+            seen[r.index] = true;
+        }
+        return true;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void test_indexer(corpus const &c)
+    {
+        std::wstring path = wide_path(c.folder);
+
+        // nothing to add to until it's started
+
+        CHECK(metadata_indexer::add({ c.files[0] }) == E_NOT_VALID_STATE);
+
+        // all of them, timed
+
+        receiver r;
+
+        using clock = std::chrono::steady_clock;
+        using ms = std::chrono::duration<double, std::milli>;
+
+        auto start = clock::now();
+
+        std::vector<metadata_indexer::file_t> files(c.files.begin(), c.files.end());
+        CHECK(SUCCEEDED(metadata_indexer::start(path, std::move(files), r.callback())));
+
+        {
+            std::unique_lock lock(r.mutex);
+            CHECK(r.arrived.wait_for(lock, std::chrono::seconds(120), [&] { return r.completes != 0; }));
+        }
+
+        double elapsed = ms(clock::now() - start).count();
+
+        {
+            std::lock_guard lock(r.mutex);
+
+            CHECK(check_results(c, r.files, c.files.size()));
+            CHECK(r.completes == 1);
+
+            // batches double, so there are only a few of them
+
+            CHECK(r.batches > 1 && r.batches < 20);
+
+            printf("indexed %zu files in %.1fms, %.0f files/s in %d batches\n",
+                   c.files.size(),
+                   elapsed,
+                   c.files.size() * 1000.0 / elapsed,
+                   r.batches);
+        }
+
+        // it's idle now, one more file comes back on its own, complete, without a restart
+
+        r.clear();
+
+        CHECK(SUCCEEDED(metadata_indexer::add({ c.files[7] })));
+
+        {
+            std::unique_lock lock(r.mutex);
+            CHECK(r.arrived.wait_for(lock, std::chrono::seconds(60), [&] { return r.completes != 0; }));
+            CHECK(r.files.size() == 1 && r.files[0].index == 7 && r.batches == 1);
+            CHECK(r.files[0].metadata.width == c.width_of(7));
+        }
+
+        // a file which isn't there comes back with no metadata
+
+        r.clear();
+
+        CHECK(SUCCEEDED(metadata_indexer::add({ { 12345, L"not_there.jpg" } })));
+
+        {
+            std::unique_lock lock(r.mutex);
+            CHECK(r.arrived.wait_for(lock, std::chrono::seconds(60), [&] { return r.completes != 0; }));
+            CHECK(r.files.size() == 1 && r.files[0].index == 12345 && r.files[0].metadata.width == 0);
+        }
+
+        metadata_indexer::stop();
+        metadata_indexer::stop();
+
+        CHECK(metadata_indexer::add({ c.files[0] }) == E_NOT_VALID_STATE);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // files added while it's busy go on the end and come back once, the last batch is complete
+
+    void test_add_while_running(corpus const &c)
+    {
+        std::wstring path = wide_path(c.folder);
+
+        receiver r;
+
+        size_t half = c.files.size() / 2;
+
+        std::vector<metadata_indexer::file_t> first(c.files.begin(), c.files.begin() + half);
+        CHECK(SUCCEEDED(metadata_indexer::start(path, std::move(first), r.callback())));
+
+        for(size_t i = half; i < c.files.size(); i += 100) {
+            size_t end = std::min(i + 100, c.files.size());
+            CHECK(SUCCEEDED(metadata_indexer::add({ c.files.begin() + i, c.files.begin() + end })));
+        }
+
+        {
+            std::unique_lock lock(r.mutex);
+            auto all_there = [&] { return r.files.size() >= c.files.size(); };
+            CHECK(r.arrived.wait_for(lock, std::chrono::seconds(120), all_there));
+            CHECK(r.completes >= 1);
+        }
+
+        // nothing more turns up
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        {
+            std::lock_guard lock(r.mutex);
+            CHECK(check_results(c, r.files, c.files.size()));
+        }
+
+        metadata_indexer::stop();
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // stopping part way through doesn't wait for the rest, and nothing arrives afterwards
+
+    void test_stop(corpus const &c)
+    {
+        std::wstring path = wide_path(c.folder);
+
+        receiver r;
+
+        std::vector<metadata_indexer::file_t> files;
+        for(int i = 0; i < 20; ++i) {
+            files.insert(files.end(), c.files.begin(), c.files.end());
+        }
+        size_t total = files.size();
+
+        CHECK(SUCCEEDED(metadata_indexer::start(path, std::move(files), r.callback())));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        metadata_indexer::stop();
+
+        size_t got;
+        {
+            std::lock_guard lock(r.mutex);
+            got = r.files.size();
+            CHECK(r.completes == 0);
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        {
+            std::lock_guard lock(r.mutex);
+            CHECK(r.files.size() == got);
+            CHECK(got < total);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    corpus c = make_corpus(10000, 16384);
+
+    test_indexer(c);
+    test_add_while_running(c);
+    test_stop(c);
+
+    std::error_code ec;
+    fs::remove_all(c.folder, ec);
+
+    return imageview::test::result("metadata_indexer_test");
+}
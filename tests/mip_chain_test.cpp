@@ -0,0 +1,211 @@
+//////////////////////////////////////////////////////////////////////
+// mip_chain filter taps and levels, mostly odd sizes where a level isn't exactly half
+// and how long the chain for a 4K image takes
+
+#include "pch.h"
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    bool near(double a, double b)
+    {
+        return std::fabs(a - b) < 1e-5;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // each destination pixel's weights add up to 1 and each source pixel is used
+    // exactly once in total (its weights add up to dst / src), nothing outside the source
+
+    void check_taps(uint src_size, uint dst_size)
+    {
+        std::vector<mip_chain::taps_t> taps = mip_chain::get_taps(src_size, dst_size);
+
+        CHECK(taps.size() == dst_size);
+
+        std::vector<double> used(src_size, 0.0);
+
+        for(auto const &t : taps) {
+
+            CHECK(t.count >= 1 && t.count <= 3);
+            CHECK(t.first >= 0 && t.first + t.count <= static_cast<int>(src_size));
+
+            double total = 0;
+            for(int i = 0; i < t.count; ++i) {
+                CHECK(t.weights[i] > 0);
+                total += t.weights[i];
+                used[t.first + i] += t.weights[i];
+            }
+            CHECK(near(total, 1));
+        }
+
+        double share = static_cast<double>(dst_size) / src_size;
+
+        for(double u : used) {
+            CHECK(near(u, share));
+        }
+    }
+
+    void test_taps()
+    {
+        for(uint size = 1; size <= 257; ++size) {
+            check_taps(size, std::max(1u, size / 2));
+        }
+
+        check_taps(100001, 50000);
+        check_taps(3, 1);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a flat colour stays that colour all the way down, whatever the sizes
+
+    void test_flat_image()
+    {
+        uint const sizes[][2] = { { 1, 1 }, { 1, 9 }, { 7, 1 }, { 3, 3 }, { 5, 7 }, { 101, 37 }, { 64, 33 } };
+
+        for(auto const &s : sizes) {
+
+            uint w = s[0];
+            uint h = s[1];
+
+            std::vector<byte> src_pixels(static_cast<size_t>(w) * h * 4);
+            for(size_t i = 0; i < src_pixels.size(); i += 4) {
+                src_pixels[i + 0] = 40;
+                src_pixels[i + 1] = 128;
+                src_pixels[i + 2] = 201;
+                src_pixels[i + 3] = 255;
+            }
+
+            image::image_t src{ src_pixels.data(), w, h, w * 4 };
+
+            std::vector<byte> pixels;
+            std::vector<image::image_t> levels;
+
+            CHECK(SUCCEEDED(mip_chain::build(src, pixels, levels)));
+
+            // down to 1x1, each half the size (rounded down) of the one above
+
+            CHECK(levels.empty() == (w == 1 && h == 1));
+
+            uint lw = w;
+            uint lh = h;
+
+            for(auto const &level : levels) {
+
+                lw = std::max(1u, lw / 2);
+                lh = std::max(1u, lh / 2);
+
+                CHECK(level.width == lw && level.height == lh);
+
+                for(uint y = 0; y < level.height; ++y) {
+                    byte const *p = level.pixels + static_cast<size_t>(level.row_pitch) * y;
+                    for(uint x = 0; x < level.width; ++x, p += 4) {
+                        CHECK(std::abs(p[0] - 40) <= 1);
+                        CHECK(std::abs(p[1] - 128) <= 1);
+                        CHECK(std::abs(p[2] - 201) <= 1);
+                        CHECK(p[3] == 255);
+                    }
+                }
+            }
+
+            if(!levels.empty()) {
+                CHECK(levels.back().width == 1 && levels.back().height == 1);
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // what GenerateMips does, 2x2 average of the sRGB values, for comparison (even sizes only)
+
+    void srgb_box_chain(image::image_t const &src, std::vector<byte> &pixels)
+    {
+        uint w = src.width;
+        uint h = src.height;
+        byte const *s = src.pixels;
+        size_t offset = 0;
+
+        while(w > 1 && h > 1 && (w % 2) == 0 && (h % 2) == 0) {
+            uint dw = w / 2;
+            uint dh = h / 2;
+            byte *d = pixels.data() + offset;
+            for(uint y = 0; y < dh; ++y) {
+                byte const *r0 = s + static_cast<size_t>(y) * 2 * w * 4;
+                byte const *r1 = r0 + static_cast<size_t>(w) * 4;
+                for(uint x = 0; x < dw * 4; ++x) {
+                    uint i = (x / 4) * 8 + (x % 4);
+                    *d++ = static_cast<byte>((r0[i] + r0[i + 4] + r1[i] + r1[i + 4] + 2) / 4);
+                }
+            }
+            s = pixels.data() + offset;
+            offset += static_cast<size_t>(dw) * dh * 4;
+            w = dw;
+            h = dh;
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void benchmark_4k()
+    {
+        uint constexpr width = 3840;
+        uint constexpr height = 2160;
+
+        std::vector<byte> src_pixels(static_cast<size_t>(width) * height * 4);
+        std::mt19937 rng(3);
+        for(auto &b : src_pixels) {
+            b = static_cast<byte>(rng());
+        }
+        image::image_t src{ src_pixels.data(), width, height, width * 4 };
+
+        int constexpr runs = 10;
+
+        std::vector<byte> pixels;
+        std::vector<image::image_t> levels;
+
+        auto start = std::chrono::steady_clock::now();
+
+        for(int i = 0; i < runs; ++i) {
+            CHECK(SUCCEEDED(mip_chain::build(src, pixels, levels)));
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::vector<byte> srgb_pixels(src_pixels.size() / 2);
+
+        auto srgb_start = std::chrono::steady_clock::now();
+
+        for(int i = 0; i < runs; ++i) {
+            srgb_box_chain(src, srgb_pixels);
+        }
+
+        std::chrono::duration<double> srgb_elapsed = std::chrono::steady_clock::now() - srgb_start;
+
+        double ms = elapsed.count() * 1000.0 / runs;
+
+        printf("4K mip chain, linear light box: %.2fms (%.0f Mpixels/s) on %d workers, "
+               "sRGB 2x2 average on one thread: %.2fms\n",
+               ms,
+               width * height / (ms * 1000.0),
+               app::thread_pool.worker_count(),
+               srgb_elapsed.count() * 1000.0 / runs);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    CHECK(SUCCEEDED(app::thread_pool.init(4)));
+
+    test_taps();
+    test_flat_image();
+
+    benchmark_4k();
+
+    app::thread_pool.cleanup();
+
+    return imageview::test::result("mip_chain_test");
+}
@@ -0,0 +1,472 @@
+//////////////////////////////////////////////////////////////////////
+// stands in for src/pch.h so the parts of imageview which don't need Windows
+// can be built and tested anywhere
+//
+// CMakeLists.txt copies the sources next to this so their #include "pch.h" finds it
+// just enough of the Windows types and DirectXMath is here for them to compile
+
+#pragma once
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cwctype>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////
+// types.h
+
+constexpr std::nullptr_t null = nullptr;
+
+using uint8 = std::uint8_t;
+using uint16 = std::uint16_t;
+using uint32 = std::uint32_t;
+using uint64 = std::uint64_t;
+
+using int8 = std::int8_t;
+using int16 = std::int16_t;
+using int32 = std::int32_t;
+using int64 = std::int64_t;
+
+using uint = uint32;
+
+using wchar = wchar_t;
+
+//////////////////////////////////////////////////////////////////////
+// Windows
+
+using byte = unsigned char;
+using BOOL = int;
+using LONG = int32;
+using SHORT = int16;
+using DWORD = uint32;
+using HRESULT = int32;
+using HANDLE = void *;
+
+#define FALSE 0
+#define TRUE 1
+
+#define HRESULT_FROM_WIN32(x) ((HRESULT)(x) <= 0 ? ((HRESULT)(x)) : ((HRESULT)(((x) & 0x0000FFFF) | 0x80070000)))
+
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_ABORT ((HRESULT)0x80004004)
+#define E_FAIL ((HRESULT)0x80004005)
+#define E_UNEXPECTED ((HRESULT)0x8000FFFF)
+#define E_INVALIDARG ((HRESULT)0x80070057)
+#define E_BOUNDS ((HRESULT)0x8000000B)
+#define E_NOT_VALID_STATE ((HRESULT)0x8007139F)
+#define ERROR_BAD_ARGUMENTS 160L
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+struct POINT
+{
+    LONG x;
+    LONG y;
+};
+
+struct RECT
+{
+    LONG left;
+    LONG top;
+    LONG right;
+    LONG bottom;
+};
+
+// the exif orientations pixel_convert::transform does
+
+enum WICBitmapTransformOptions
+{
+    WICBitmapTransformRotate0 = 0,
+    WICBitmapTransformRotate90 = 0x1,
+    WICBitmapTransformRotate180 = 0x2,
+    WICBitmapTransformRotate270 = 0x3,
+    WICBitmapTransformFlipHorizontal = 0x8,
+    WICBitmapTransformFlipVertical = 0x10
+};
+
+struct POINTS
+{
+    SHORT x;
+    SHORT y;
+};
+
+union LARGE_INTEGER
+{
+    int64 QuadPart;
+};
+
+struct FILETIME
+{
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+};
+
+inline BOOL QueryPerformanceFrequency(LARGE_INTEGER *f)
+{
+    f->QuadPart = std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num;
+    return TRUE;
+}
+
+inline BOOL QueryPerformanceCounter(LARGE_INTEGER *c)
+{
+    c->QuadPart = std::chrono::steady_clock::now().time_since_epoch().count();
+    return TRUE;
+}
+
+// events are never set in the tests
+
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+
+inline DWORD WaitForSingleObject(HANDLE, DWORD)
+{
+    return WAIT_TIMEOUT;
+}
+
+inline BOOL CloseHandle(HANDLE)
+{
+    return TRUE;
+}
+
+inline DWORD GetLastError()
+{
+    return 0;
+}
+
+// the load scheduler's lock
+
+struct SRWLOCK
+{
+    std::mutex mutex;
+};
+
+struct CONDITION_VARIABLE
+{
+    std::condition_variable_any condition;
+};
+
+#define SRWLOCK_INIT {}
+#define CONDITION_VARIABLE_INIT {}
+#define INFINITE 0xFFFFFFFF
+
+inline void AcquireSRWLockExclusive(SRWLOCK *lock)
+{
+    lock->mutex.lock();
+}
+
+inline void ReleaseSRWLockExclusive(SRWLOCK *lock)
+{
+    lock->mutex.unlock();
+}
+
+inline BOOL SleepConditionVariableSRW(CONDITION_VARIABLE *c, SRWLOCK *lock, DWORD, uint32)
+{
+    c->condition.wait(lock->mutex);
+    return TRUE;
+}
+
+inline void WakeAllConditionVariable(CONDITION_VARIABLE *c)
+{
+    c->condition.notify_all();
+}
+
+// threads run at whatever priority they get, there's no COM
+
+#define THREAD_MODE_BACKGROUND_BEGIN 0x00010000
+#define THREAD_MODE_BACKGROUND_END 0x00020000
+
+inline HANDLE GetCurrentThread()
+{
+    return null;
+}
+
+inline BOOL SetThreadPriority(HANDLE, int)
+{
+    return TRUE;
+}
+
+#define COINIT_APARTMENTTHREADED 0x2
+
+inline HRESULT CoInitializeEx(void *, DWORD)
+{
+    return S_OK;
+}
+
+inline void CoUninitialize()
+{
+}
+
+// the cache governor, memory is never short in the tests
+
+struct MEMORYSTATUSEX
+{
+    DWORD dwLength;
+    DWORD dwMemoryLoad;
+    uint64 ullTotalPhys;
+    uint64 ullAvailPhys;
+};
+
+inline BOOL GlobalMemoryStatusEx(MEMORYSTATUSEX *status)
+{
+    status->dwMemoryLoad = 50;
+    status->ullTotalPhys = 16384llu << 20;
+    status->ullAvailPhys = 8192llu << 20;
+    return TRUE;
+}
+
+#define LowMemoryResourceNotification 0
+
+inline HANDLE CreateMemoryResourceNotification(int)
+{
+    static int notification;
+    return &notification;
+}
+
+inline BOOL QueryMemoryResourceNotification(HANDLE, BOOL *low)
+{
+    *low = FALSE;
+    return TRUE;
+}
+
+// only lower cases what towlower does, which is enough for the test names
+
+inline DWORD CharLowerBuffW(wchar_t *s, DWORD length)
+{
+    for(DWORD i = 0; i < length; ++i) {
+        s[i] = static_cast<wchar_t>(std::towlower(s[i]));
+    }
+    return length;
+}
+
+#define PF_SSSE3_INSTRUCTIONS_AVAILABLE 36
+
+inline BOOL IsProcessorFeaturePresent(DWORD feature)
+{
+    return feature == PF_SSSE3_INSTRUCTIONS_AVAILABLE && __builtin_cpu_supports("ssse3");
+}
+
+//////////////////////////////////////////////////////////////////////
+// the bits of DirectXMath which are used
+
+using XMVECTOR = __m128;
+
+struct XMMATRIX
+{
+    XMVECTOR r[4];
+};
+
+struct XMFLOAT4
+{
+    float x, y, z, w;
+};
+
+struct XMFLOAT4X4
+{
+    float _11, _12, _13, _14;
+    float _21, _22, _23, _24;
+    float _31, _32, _33, _34;
+    float _41, _42, _43, _44;
+};
+
+inline XMVECTOR XMVectorSet(float x, float y, float z, float w)
+{
+    return _mm_setr_ps(x, y, z, w);
+}
+
+inline XMVECTOR XMVectorSaturate(XMVECTOR v)
+{
+    return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+inline void XMStoreFloat4(XMFLOAT4 *f, XMVECTOR v)
+{
+    _mm_storeu_ps(&f->x, v);
+}
+
+inline void XMStoreFloat4x4(XMFLOAT4X4 *f, XMMATRIX const &m)
+{
+    float *p = &f->_11;
+    for(int i = 0; i < 4; ++i) {
+        _mm_storeu_ps(p + i * 4, m.r[i]);
+    }
+}
+
+inline XMMATRIX XMMatrixIdentity()
+{
+    return { { XMVectorSet(1, 0, 0, 0), XMVectorSet(0, 1, 0, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 0, 0, 1) } };
+}
+
+using matrix = XMMATRIX;
+using vec4 = XMVECTOR;
+
+//////////////////////////////////////////////////////////////////////
+// log.h
+
+// the arguments are still evaluated so nothing which is only logged is unused
+
+template <typename... args_t> void log_nop(args_t const &...)
+{
+}
+
+#define LOG_CONTEXT(x) static_assert(true, "")
+#define LOG_DEBUG(...) log_nop(__VA_ARGS__)
+#define LOG_VERBOSE(...) log_nop(__VA_ARGS__)
+#define LOG_INFO(...) log_nop(__VA_ARGS__)
+#define LOG_WARN(...) log_nop(__VA_ARGS__)
+#define LOG_ERROR(...) log_nop(__VA_ARGS__)
+
+//////////////////////////////////////////////////////////////////////
+// util.h
+
+namespace imageview
+{
+    inline std::wstring windows_error_message(uint32 = 0)
+    {
+        return {};
+    }
+
+    inline HRESULT display_error(std::wstring const &, HRESULT hr = E_UNEXPECTED)
+    {
+        return hr;
+    }
+
+    template <typename T> int sgn(T x)
+    {
+        return (T(0) < x) - (x < T(0));
+    }
+
+    template <typename T> T sub_point(T a, T b)
+    {
+        using Tx = decltype(a.x);
+        return { static_cast<Tx>(a.x - b.x), static_cast<Tx>(a.y - b.y) };
+    }
+
+    template <typename T> T add_point(T a, T b)
+    {
+        using Tx = decltype(a.x);
+        return { static_cast<Tx>(a.x + b.x), static_cast<Tx>(a.y + b.y) };
+    }
+
+    template <typename T> T mul_point(T a, T b)
+    {
+        using Tx = decltype(a.x);
+        return { static_cast<Tx>(a.x * b.x), static_cast<Tx>(a.y * b.y) };
+    }
+
+    template <typename T> T div_point(T a, T b)
+    {
+        using Tx = decltype(a.x);
+        return { static_cast<Tx>(a.x / b.x), static_cast<Tx>(a.y / b.y) };
+    }
+}
+
+#define CHK_NULL(x)                                  \
+    do {                                             \
+        if((x) == null) {                            \
+            return imageview::display_error(L"" #x); \
+        }                                            \
+    } while(false)
+
+//////////////////////////////////////////////////////////////////////
+// the real headers from here on
+
+// deferrer is a static in the header, which gcc doesn't like if it's not used
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#include "defer.h"
+#pragma GCC diagnostic pop
+
+#include "rect.h"
+#include "timer.h"
+#include "frame_scheduler.h"
+#include "thread_pool.h"
+#include "extension_table.h"
+
+namespace imageview
+{
+    // image.h has everything about files too, this is all the pixel code needs
+
+    namespace image
+    {
+        struct image_t
+        {
+            byte const *pixels;
+            uint width;
+            uint height;
+            uint row_pitch;
+
+            size_t size() const
+            {
+                return static_cast<size_t>(row_pitch) * height;
+            }
+        };
+
+        // the cache only needs to know where a file is in the folder
+        // and the load scheduler what it read and how long it took
+
+        struct image_file
+        {
+            std::wstring filename;
+            int index{ -1 };
+            std::vector<byte> bytes;
+            HRESULT hresult{ E_FAIL };
+            double read_seconds{ 0 };
+            double decode_seconds{ 0 };
+        };
+
+        // the metadata indexer reads these with WIC, a test has to say how
+
+        struct metadata_t
+        {
+            uint32 width{ 0 };
+            uint32 height{ 0 };
+            uint64 capture_date{ 0 };
+        };
+
+        HRESULT get_metadata(std::wstring const &filename, metadata_t &metadata);
+
+        // and the folder watcher asks which files are images
+
+        bool can_load_filename(wchar const *name, size_t length);
+    }
+
+    namespace app
+    {
+        inline thread_pool_t thread_pool;
+    }
+}
+
+#include "file.h"
+#include "folder_watcher.h"
+#include "cache.h"
+#include "mip_chain.h"
+#include "metadata_indexer.h"
+#include "pixel_convert.h"
+#include "software_renderer.h"
+#include "telemetry.h"
+#include "scheduler.h"
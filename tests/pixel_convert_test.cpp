@@ -0,0 +1,455 @@
+//////////////////////////////////////////////////////////////////////
+// the fast pixel conversions and extract against the one pixel at a time ones in pixel_convert::reference
+// exif transforms of parts of images matching the same part of the whole, and how long they take
+
+#include "pch.h"
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    //////////////////////////////////////////////////////////////////////
+    // random BGRA pixels with some slack on the end of each row
+
+    struct test_image
+    {
+        std::vector<byte> pixels;
+        image::image_t img;
+
+        test_image(uint w, uint h, std::mt19937 &rng)
+        {
+            uint pitch = w * 4 + 12;
+            pixels.resize(static_cast<size_t>(pitch) * h);
+            for(auto &p : pixels) {
+                p = static_cast<byte>(rng());
+            }
+            img = { pixels.data(), w, h, pitch };
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////
+    // odd widths so the SIMD loop has leftovers, the padding in dst must be left alone
+
+    void test_bgra_to_bgr()
+    {
+        std::mt19937 rng(1);
+
+        uint const widths[] = { 1, 2, 3, 5, 15, 16, 17, 31, 33, 63, 1001 };
+        uint const heights[] = { 1, 3, 130 };
+
+        for(uint w : widths) {
+            for(uint h : heights) {
+
+                test_image src(w, h, rng);
+
+                uint dst_pitch = ((w * 3) + 3) & ~3u;
+
+                std::vector<byte> fast(static_cast<size_t>(dst_pitch) * h, 0xcd);
+                std::vector<byte> slow(fast);
+
+                pixel_convert::bgra_to_bgr(src.img, fast.data(), dst_pitch);
+                pixel_convert::reference::bgra_to_bgr(src.img, slow.data(), dst_pitch);
+
+                CHECK(fast == slow);
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // cut a rectangle out in all 8 orientations, wide enough for a few column tiles
+
+    struct orientation_t
+    {
+        POINT x_step;
+        POINT y_step;
+    };
+
+    orientation_t const orientations[8] = {
+        { { 1, 0 }, { 0, 1 } },      // as it is
+        { { -1, 0 }, { 0, 1 } },     // flipped horizontally
+        { { 1, 0 }, { 0, -1 } },     // flipped vertically
+        { { -1, 0 }, { 0, -1 } },    // 180
+        { { 0, 1 }, { 1, 0 } },      // transposed
+        { { 0, -1 }, { 1, 0 } },     // 90 clockwise
+        { { 0, 1 }, { -1, 0 } },     // 90 anticlockwise
+        { { 0, -1 }, { -1, 0 } }     // transposed the other way
+    };
+
+    // where a step goes backwards along an axis, start from the far side of the rectangle
+
+    POINT get_origin(orientation_t const &o, int x, int y, int w, int h)
+    {
+        bool flip_x = o.x_step.x < 0 || o.y_step.x < 0;
+        bool flip_y = o.x_step.y < 0 || o.y_step.y < 0;
+        return { flip_x ? x + w - 1 : x, flip_y ? y + h - 1 : y };
+    }
+
+    struct rect_t
+    {
+        int x, y, w, h;
+    };
+
+    void test_extract()
+    {
+        std::mt19937 rng(2);
+
+        test_image src(301, 203, rng);
+
+        rect_t const rects[] = {
+            { 0, 0, 301, 203 },    // all of it
+            { 0, 0, 1, 1 },
+            { 300, 202, 1, 1 },
+            { 7, 3, 1, 99 },
+            { 5, 9, 199, 1 },
+            { 11, 13, 287, 131 },
+            { 1, 2, 33, 65 },
+        };
+
+        for(auto const &r : rects) {
+            for(auto const &o : orientations) {
+
+                bool across = o.x_step.x != 0;
+
+                uint w = across ? r.w : r.h;
+                uint h = across ? r.h : r.w;
+                uint pitch = w * 4 + 8;
+
+                std::vector<byte> fast(static_cast<size_t>(pitch) * h, 0xcd);
+                std::vector<byte> slow(fast);
+
+                POINT origin = get_origin(o, r.x, r.y, r.w, r.h);
+
+                image::image_t fast_img{ fast.data(), w, h, pitch };
+                image::image_t slow_img{ slow.data(), w, h, pitch };
+
+                CHECK(pixel_convert::extract(src.img, origin, o.x_step, o.y_step, fast_img) == S_OK);
+                CHECK(pixel_convert::reference::extract(src.img, origin, o.x_step, o.y_step, slow_img) == S_OK);
+                CHECK(fast == slow);
+            }
+        }
+
+        // one pixel too far in any direction is out of bounds and nothing gets written
+
+        rect_t const outside[] = {
+            { -1, 0, 10, 10 },
+            { 0, -1, 10, 10 },
+            { 292, 0, 10, 10 },
+            { 0, 194, 10, 10 },
+        };
+
+        for(auto const &r : outside) {
+            for(auto const &o : orientations) {
+
+                std::vector<byte> fast(10 * 40, 0xcd);
+                std::vector<byte> slow(fast);
+                std::vector<byte> untouched(fast);
+
+                POINT origin = get_origin(o, r.x, r.y, r.w, r.h);
+
+                image::image_t fast_img{ fast.data(), 10, 10, 40 };
+                image::image_t slow_img{ slow.data(), 10, 10, 40 };
+
+                CHECK(pixel_convert::extract(src.img, origin, o.x_step, o.y_step, fast_img) == E_BOUNDS);
+                CHECK(pixel_convert::reference::extract(src.img, origin, o.x_step, o.y_step, slow_img) == E_BOUNDS);
+                CHECK(fast == untouched);
+                CHECK(slow == untouched);
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // what image.cpp did before pixel_convert::transform, a pixel at a time down the source
+
+    void transform_pixels(byte const *src,
+                          uint src_w,
+                          uint src_h,
+                          uint src_pitch,
+                          byte *dst,
+                          uint dst_pitch,
+                          WICBitmapTransformOptions transform)
+    {
+        bool swap_dimensions = transform == WICBitmapTransformRotate90 || transform == WICBitmapTransformRotate270;
+
+        uint dst_w = swap_dimensions ? src_h : src_w;
+        uint dst_h = swap_dimensions ? src_w : src_h;
+
+        int64 pitch = src_pitch;
+        int64 last_row = pitch * (src_h - 1);
+        int64 last_column = 4ll * (src_w - 1);
+
+        app::thread_pool.parallel_for(static_cast<int>(dst_h), 64, [=](int y0, int y1) {
+
+            for(int64 y = y0; y < y1; ++y) {
+
+                int64 start;
+                int64 step;
+
+                switch(transform) {
+                case WICBitmapTransformRotate90:
+                    start = last_row + y * 4;
+                    step = -pitch;
+                    break;
+                case WICBitmapTransformRotate270:
+                    start = last_column - y * 4;
+                    step = pitch;
+                    break;
+                case WICBitmapTransformRotate180:
+                    start = last_row - y * pitch + last_column;
+                    step = -4;
+                    break;
+                case WICBitmapTransformFlipHorizontal:
+                    start = y * pitch + last_column;
+                    step = -4;
+                    break;
+                case WICBitmapTransformFlipVertical:
+                    start = last_row - y * pitch;
+                    step = 4;
+                    break;
+                default:
+                    start = y * pitch;
+                    step = 4;
+                    break;
+                }
+
+                byte const *s = src + start;
+                uint32 *d = reinterpret_cast<uint32 *>(dst + y * dst_pitch);
+
+                for(uint x = 0; x < dst_w; ++x) {
+                    d[x] = *reinterpret_cast<uint32 const *>(s);
+                    s += step;
+                }
+            }
+        });
+    }
+
+    WICBitmapTransformOptions const transforms[] = {
+        WICBitmapTransformRotate0,         WICBitmapTransformRotate90,       WICBitmapTransformRotate180,
+        WICBitmapTransformRotate270,       WICBitmapTransformFlipHorizontal, WICBitmapTransformFlipVertical,
+    };
+
+    char const *transform_name(WICBitmapTransformOptions t)
+    {
+        switch(t) {
+        case WICBitmapTransformRotate90:
+            return "rotate 90";
+        case WICBitmapTransformRotate180:
+            return "rotate 180";
+        case WICBitmapTransformRotate270:
+            return "rotate 270";
+        case WICBitmapTransformFlipHorizontal:
+            return "flip horizontal";
+        case WICBitmapTransformFlipVertical:
+            return "flip vertical";
+        default:
+            return "none";
+        }
+    }
+
+    bool swaps(WICBitmapTransformOptions t)
+    {
+        return t == WICBitmapTransformRotate90 || t == WICBitmapTransformRotate270;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // the whole image turned, same as it was before
+
+    void test_transform()
+    {
+        std::mt19937 rng(3);
+
+        uint const sizes[][2] = { { 1, 1 }, { 1, 7 }, { 7, 1 }, { 2, 3 }, { 65, 3 }, { 301, 203 }, { 130, 517 } };
+
+        for(auto const &size : sizes) {
+
+            test_image src(size[0], size[1], rng);
+
+            for(auto t : transforms) {
+
+                uint w = swaps(t) ? src.img.height : src.img.width;
+                uint h = swaps(t) ? src.img.width : src.img.height;
+                uint pitch = w * 4 + 4;
+
+                std::vector<byte> now(static_cast<size_t>(pitch) * h, 0xcd);
+                std::vector<byte> before(now);
+
+                CHECK(pixel_convert::transform(src.img, t, { now.data(), w, h, pitch }) == S_OK);
+                transform_pixels(
+                    src.img.pixels, src.img.width, src.img.height, src.img.row_pitch, before.data(), pitch, t);
+                CHECK(now == before);
+            }
+
+            // the wrong size for the output
+
+            std::vector<byte> small(static_cast<size_t>(size[0]) * size[1] * 4);
+            image::image_t too_wide{ small.data(), size[0] + 1, size[1], size[0] * 4 };
+            CHECK(pixel_convert::transform(src.img, WICBitmapTransformRotate0, too_wide) == E_BOUNDS);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // decode_region decodes source_rect of the file and transforms that, which has to come out the same
+    // as the same rectangle of the whole file decoded and transformed (when it's not scaled)
+
+    void test_region()
+    {
+        std::mt19937 rng(4);
+
+        test_image src(301, 203, rng);
+
+        for(auto t : transforms) {
+
+            uint full_w = swaps(t) ? src.img.height : src.img.width;
+            uint full_h = swaps(t) ? src.img.width : src.img.height;
+            uint full_pitch = full_w * 4;
+
+            std::vector<byte> full(static_cast<size_t>(full_pitch) * full_h);
+            CHECK(pixel_convert::transform(src.img, t, { full.data(), full_w, full_h, full_pitch }) == S_OK);
+
+            for(int i = 0; i < 200; ++i) {
+
+                // all of it, corners and edges, and random ones
+
+                LONG w = static_cast<LONG>(full_w);
+                LONG h = static_cast<LONG>(full_h);
+
+                RECT r;
+                switch(i) {
+                case 0:
+                    r = { 0, 0, w, h };
+                    break;
+                case 1:
+                    r = { 0, 0, 1, 1 };
+                    break;
+                case 2:
+                    r = { w - 1, h - 1, w, h };
+                    break;
+                case 3:
+                    r = { 0, h - 5, w, h };
+                    break;
+                case 4:
+                    r = { w - 3, 0, w, h };
+                    break;
+                default: {
+                    LONG x0 = static_cast<LONG>(rng() % full_w);
+                    LONG y0 = static_cast<LONG>(rng() % full_h);
+                    LONG x1 = x0 + 1 + static_cast<LONG>(rng() % (w - x0));
+                    LONG y1 = y0 + 1 + static_cast<LONG>(rng() % (h - y0));
+                    r = { x0, y0, x1, y1 };
+                    break;
+                }
+                }
+
+                RECT s = pixel_convert::source_rect(r, src.img.width, src.img.height, t);
+
+                LONG region_w = r.right - r.left;
+                LONG region_h = r.bottom - r.top;
+
+                CHECK(s.left >= 0 && s.top >= 0);
+                CHECK(s.right <= static_cast<LONG>(src.img.width) && s.bottom <= static_cast<LONG>(src.img.height));
+                CHECK(s.right - s.left == (swaps(t) ? region_h : region_w));
+                CHECK(s.bottom - s.top == (swaps(t) ? region_w : region_h));
+
+                // the clipped source, without copying it
+
+                image::image_t clipped{ src.img.pixels + s.top * static_cast<size_t>(src.img.row_pitch) + s.left * 4,
+                                        static_cast<uint>(s.right - s.left),
+                                        static_cast<uint>(s.bottom - s.top),
+                                        src.img.row_pitch };
+
+                uint pitch = region_w * 4;
+                std::vector<byte> region(static_cast<size_t>(pitch) * region_h);
+
+                uint region_width = static_cast<uint>(region_w);
+                uint region_height = static_cast<uint>(region_h);
+                image::image_t region_img{ region.data(), region_width, region_height, pitch };
+
+                CHECK(pixel_convert::transform(clipped, t, region_img) == S_OK);
+
+                bool same = true;
+                for(LONG y = 0; y < region_h; ++y) {
+                    byte const *a = region.data() + static_cast<size_t>(pitch) * y;
+                    byte const *b = full.data() + static_cast<size_t>(full_pitch) * (r.top + y) + r.left * 4;
+                    same &= memcmp(a, b, pitch) == 0;
+                }
+                CHECK(same);
+            }
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a 12MP photo turned the old way and with extract, and a screen sized bit of it
+
+    void benchmark_transform()
+    {
+        std::mt19937 rng(5);
+
+        test_image src(4000, 3000, rng);
+
+        std::vector<byte> dst(static_cast<size_t>(4000) * 3000 * 4);
+
+        using clock = std::chrono::steady_clock;
+        using ms = std::chrono::duration<double, std::milli>;
+
+        int constexpr runs = 5;
+
+        for(auto t : transforms) {
+
+            uint w = swaps(t) ? 3000 : 4000;
+            uint h = swaps(t) ? 4000 : 3000;
+
+            auto start = clock::now();
+            for(int i = 0; i < runs; ++i) {
+                transform_pixels(src.img.pixels, 4000, 3000, src.img.row_pitch, dst.data(), w * 4, t);
+            }
+            double before = ms(clock::now() - start).count() / runs;
+
+            start = clock::now();
+            for(int i = 0; i < runs; ++i) {
+                pixel_convert::transform(src.img, t, { dst.data(), w, h, w * 4 });
+            }
+            double now = ms(clock::now() - start).count() / runs;
+
+            RECT s = pixel_convert::source_rect({ 1000, 1000, 2920, 2080 }, 4000, 3000, t);
+
+            image::image_t clipped{ src.img.pixels + s.top * static_cast<size_t>(src.img.row_pitch) + s.left * 4,
+                                    static_cast<uint>(s.right - s.left),
+                                    static_cast<uint>(s.bottom - s.top),
+                                    src.img.row_pitch };
+
+            start = clock::now();
+            for(int i = 0; i < runs; ++i) {
+                pixel_convert::transform(clipped, t, { dst.data(), 1920, 1080, 1920 * 4 });
+            }
+            double region = ms(clock::now() - start).count() / runs;
+
+            printf("4000x3000 %-15s: %6.2fms, a pixel at a time %6.2fms, 1920x1080 of it %5.2fms\n",
+                   transform_name(t),
+                   now,
+                   before,
+                   region);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    // more than one worker so the rows get split up
+
+    CHECK(SUCCEEDED(app::thread_pool.init(4)));
+
+    test_bgra_to_bgr();
+    test_extract();
+    test_transform();
+    test_region();
+
+    benchmark_transform();
+
+    app::thread_pool.cleanup();
+
+    return imageview::test::result("pixel_convert_test");
+}
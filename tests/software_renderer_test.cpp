@@ -0,0 +1,461 @@
+//////////////////////////////////////////////////////////////////////
+// software_renderer against golden images drawn by a float model of the shaders
+// (vs_rectangle, ps_texture, ps_solid, ps_stripe, blend_state and the sampler)
+// and how long a 4K frame takes
+
+#include "pch.h"
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    using software_renderer::frame_t;
+    using software_renderer::overlay_t;
+
+    //////////////////////////////////////////////////////////////////////
+    // a color as b, g, r, a floats 0..1, which is how the pixels are laid out
+
+    struct color_t
+    {
+        float c[4];
+    };
+
+    color_t unpack(uint32 p)
+    {
+        color_t r;
+        for(int i = 0; i < 4; ++i) {
+            r.c[i] = ((p >> (i * 8)) & 0xff) / 255.0f;
+        }
+        return r;
+    }
+
+    uint32 pack(color_t const &c)
+    {
+        uint32 p = 0;
+        for(int i = 0; i < 4; ++i) {
+            p |= static_cast<uint32>(lrintf(std::clamp(c.c[i], 0.0f, 1.0f) * 255.0f)) << (i * 8);
+        }
+        return p;
+    }
+
+    color_t from_vec4(vec4 v)
+    {
+        XMFLOAT4 f;
+        XMStoreFloat4(&f, v);
+        return { { f.z, f.y, f.x, f.w } };
+    }
+
+    color_t lerp(color_t const &a, color_t const &b, float t)
+    {
+        color_t r;
+        for(int i = 0; i < 4; ++i) {
+            r.c[i] = a.c[i] + (b.c[i] - a.c[i]) * t;
+        }
+        return r;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // the sampler: border color 0, point when magnified, trilinear when minified
+
+    color_t texel(image::image_t const &img, int x, int y)
+    {
+        if(img.pixels == null || x < 0 || y < 0 || x >= static_cast<int>(img.width) ||
+           y >= static_cast<int>(img.height)) {
+            return { { 0, 0, 0, 0 } };
+        }
+        return unpack(*reinterpret_cast<uint32 const *>(img.pixels + static_cast<size_t>(img.row_pitch) * y + x * 4));
+    }
+
+    color_t sample_point(image::image_t const &img, float u, float v)
+    {
+        return texel(img, static_cast<int>(floorf(u * img.width)), static_cast<int>(floorf(v * img.height)));
+    }
+
+    color_t sample_linear(image::image_t const &img, float u, float v)
+    {
+        float fu = u * img.width - 0.5f;
+        float fv = v * img.height - 0.5f;
+        int x = static_cast<int>(floorf(fu));
+        int y = static_cast<int>(floorf(fv));
+        float wx = fu - x;
+        float wy = fv - y;
+        color_t top = lerp(texel(img, x, y), texel(img, x + 1, y), wx);
+        color_t bottom = lerp(texel(img, x, y + 1), texel(img, x + 1, y + 1), wx);
+        return lerp(top, bottom, wy);
+    }
+
+    color_t sample(image::image_t const &img, std::vector<image::image_t> const &mips, float rho, float u, float v)
+    {
+        if(rho <= 1.0f) {
+            return sample_point(img, u, v);
+        }
+
+        if(mips.empty()) {
+            return sample_linear(img, u, v);
+        }
+
+        int last = static_cast<int>(mips.size());
+        float lod = std::min(log2f(rho), static_cast<float>(last));
+        int level = static_cast<int>(lod);
+
+        auto get_level = [&](int l) -> image::image_t const & { return l == 0 ? img : mips[l - 1]; };
+
+        color_t a = sample_linear(get_level(level), u, v);
+        if(level == last) {
+            return a;
+        }
+        return lerp(a, sample_linear(get_level(level + 1), u, v), lod - level);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // pixel centers inside the rectangle, which is the rasterizer's top left rule
+
+    bool inside(rect_f const &r, float px, float py)
+    {
+        return px >= r.x && px < r.x + r.w && py >= r.y && py < r.y + r.h;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // ps_texture over a quad
+
+    void draw_quad(frame_t const &f,
+                   image::image_t const &img,
+                   std::vector<image::image_t> const &mips,
+                   rect_f const &r,
+                   float px,
+                   float py,
+                   color_t &c)
+    {
+        if(!inside(r, px, py)) {
+            return;
+        }
+
+        XMFLOAT4X4 m;
+        XMStoreFloat4x4(&m, f.texture_transform);
+
+        float sx = (px - r.x) / r.w;
+        float sy = (py - r.y) / r.h;
+        float u = sx * m._11 + sy * m._21 + m._41;
+        float v = sx * m._12 + sy * m._22 + m._42;
+
+        float tw = img.pixels != null ? static_cast<float>(img.width) : 0.0f;
+        float th = img.pixels != null ? static_cast<float>(img.height) : 0.0f;
+
+        float rho_x = hypotf(m._11 / r.w * tw, m._12 / r.w * th);
+        float rho_y = hypotf(m._21 / r.h * tw, m._22 / r.h * th);
+
+        color_t t = sample(img, mips, std::max(rho_x, rho_y), u, v);
+
+        int cx = static_cast<int>((px + f.checkerboard_offset.x) * f.checkerboard_scale) & 1;
+        int cy = static_cast<int>((py + f.checkerboard_offset.y) * f.checkerboard_scale) & 1;
+        color_t check = from_vec4(f.checkerboard_colors[cx + cy * 2]);
+
+        c = unpack(pack(lerp(check, t, t.c[3])));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a whole frame
+
+    std::vector<uint32> draw_golden(frame_t const &f, uint width, uint height)
+    {
+        std::vector<uint32> out(static_cast<size_t>(width) * height);
+
+        for(uint y = 0; y < height; ++y) {
+            for(uint x = 0; x < width; ++x) {
+
+                float px = x + 0.5f;
+                float py = y + 0.5f;
+
+                color_t c = unpack(pack(from_vec4(f.border_color)));
+
+                if(f.draw_image) {
+                    draw_quad(f, f.image, f.mips, f.image_rect, px, py, c);
+                    if(f.draw_detail) {
+                        draw_quad(f, f.detail, {}, f.detail_rect, px, py, c);
+                    }
+                }
+
+                for(auto const &o : f.overlays) {
+
+                    if(o.rect.w <= 0 || o.rect.h <= 0 || !inside(o.rect, px, py)) {
+                        continue;
+                    }
+
+                    int stripe = 0;
+                    if(o.stripe_scale != 0) {
+                        stripe = static_cast<int>((px + py - o.stripe_frame) * o.stripe_scale) & 1;
+                    }
+                    color_t s = unpack(pack(from_vec4(o.colors[stripe])));
+
+                    float a = s.c[3];
+                    for(int i = 0; i < 3; ++i) {
+                        c.c[i] = s.c[i] * a + c.c[i] * (1 - a);
+                    }
+                    c.c[3] = a;
+                    c = unpack(pack(c));
+                }
+
+                out[static_cast<size_t>(y) * width + x] = pack(c);
+            }
+        }
+        return out;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // draw it both ways and compare, channels can be out by `tolerance`
+    // (the cpu keeps 8 bit texels between the filter and the blend, the gpu doesn't)
+
+    void check_frame(char const *name, frame_t const &f, uint width, uint height, int tolerance)
+    {
+        std::vector<uint32> golden = draw_golden(f, width, height);
+
+        // a bit of padding on each row which mustn't be touched
+
+        uint pitch = width * 4 + 16;
+        std::vector<byte> out(static_cast<size_t>(pitch) * height, 0xcd);
+
+        CHECK(SUCCEEDED(software_renderer::render(f, { out.data(), width, height, pitch }, app::thread_pool)));
+
+        int bad = 0;
+        int worst = 0;
+        bool padding_ok = true;
+
+        for(uint y = 0; y < height; ++y) {
+
+            byte const *row = out.data() + static_cast<size_t>(pitch) * y;
+
+            for(uint x = 0; x < width; ++x) {
+
+                uint32 expected = golden[static_cast<size_t>(y) * width + x];
+                uint32 got = *reinterpret_cast<uint32 const *>(row + x * 4);
+
+                for(int i = 0; i < 4; ++i) {
+                    int e = (expected >> (i * 8)) & 0xff;
+                    int g = (got >> (i * 8)) & 0xff;
+                    int d = std::abs(e - g);
+                    worst = std::max(worst, d);
+                    if(d > tolerance && bad++ < 5) {
+                        fprintf(stderr,
+                                "%s: (%u,%u) channel %d expected %08x got %08x\n",
+                                name,
+                                x,
+                                y,
+                                i,
+                                expected,
+                                got);
+                    }
+                }
+            }
+
+            padding_ok &= std::all_of(row + width * 4, row + pitch, [](byte b) { return b == 0xcd; });
+        }
+
+        CHECK(bad == 0);
+        CHECK(padding_ok);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    matrix make_matrix(float const (&rows)[4][4])
+    {
+        matrix m;
+        for(int i = 0; i < 4; ++i) {
+            m.r[i] = XMVectorSet(rows[i][0], rows[i][1], rows[i][2], rows[i][3]);
+        }
+        return m;
+    }
+
+    // the same as rotate_matrix[rotate_90] and flip_matrix[1] in app.cpp
+
+    float const rotate_90[4][4] = { { 0, -1, 0, 0 }, { 1, 0, 0, 0 }, { 0, 0, 1, 0 }, { 0, 1, 0, 1 } };
+    float const flip_horizontal[4][4] = { { -1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 1, 0, 0, 1 } };
+
+    //////////////////////////////////////////////////////////////////////
+
+    struct random_image
+    {
+        std::vector<byte> pixels;
+        image::image_t img;
+
+        random_image(uint w, uint h, uint seed)
+        {
+            std::mt19937 rng(seed);
+            pixels.resize(static_cast<size_t>(w) * h * 4);
+            for(auto &p : pixels) {
+                p = static_cast<byte>(rng());
+            }
+            img = { pixels.data(), w, h, w * 4 };
+        }
+    };
+
+    // the checkerboard, selection and outline the way get_frame() sets them up
+
+    frame_t make_frame(image::image_t const &img, rect_f const &rect)
+    {
+        frame_t f;
+        f.border_color = XMVectorSet(0.2f, 0.4f, 0.6f, 1);
+        f.draw_image = true;
+        f.image = img;
+        f.image_rect = rect;
+        f.texture_transform = XMMatrixIdentity();
+
+        vec4 g1 = XMVectorSet(1, 1, 1, 1);
+        vec4 g2 = XMVectorSet(0.5f, 0.5f, 0.5f, 1);
+        f.checkerboard_colors[0] = g1;
+        f.checkerboard_colors[1] = g2;
+        f.checkerboard_colors[2] = g2;
+        f.checkerboard_colors[3] = g1;
+        f.checkerboard_offset = { -rect.x, -rect.y };
+        f.checkerboard_scale = 1 / 8.0f;
+
+        overlay_t fill{};
+        fill.rect = { 20.2f, 15.0f, 30.0f, 20.0f };
+        fill.colors[0] = XMVectorSet(1, 0, 0, 0.5f);
+        f.overlays.push_back(fill);
+
+        overlay_t outline{};
+        outline.rect = { 18.0f, 13.0f, 40.0f, 2.0f };
+        outline.colors[0] = XMVectorSet(1, 1, 1, 1);
+        outline.colors[1] = XMVectorSet(0, 0, 0, 0.7f);
+        outline.stripe_scale = 1 / 4.0f;
+        outline.stripe_frame = 100;
+        f.overlays.push_back(outline);
+
+        return f;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void test_magnified()
+    {
+        random_image src(37, 23, 1);
+
+        frame_t f = make_frame(src.img, { 10.3f, 7.7f, 37 * 2.5f, 23 * 2.5f });
+        check_frame("magnified", f, 150, 100, 1);
+
+        f.texture_transform = make_matrix(rotate_90);
+        check_frame("magnified, rotated", f, 150, 100, 1);
+
+        // off the edges of the target
+
+        f.image_rect = { -20.4f, -13.1f, 200.0f, 150.0f };
+        check_frame("magnified, clipped", f, 150, 100, 1);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+
+    void test_minified()
+    {
+        random_image src(301, 203, 2);
+
+        // without a mip chain it's bilinear from the image
+
+        frame_t f = make_frame(src.img, { 5.6f, 3.2f, 301 * 0.37f, 203 * 0.37f });
+        f.texture_transform = make_matrix(flip_horizontal);
+        check_frame("minified, no mips", f, 150, 100, 1);
+
+        // with one it's between two levels
+
+        std::vector<byte> mip_pixels;
+        CHECK(SUCCEEDED(mip_chain::build(src.img, mip_pixels, f.mips)));
+
+        float const scales[] = { 0.7f, 0.37f, 0.11f, 0.004f };
+
+        for(float scale : scales) {
+            f.image_rect = { 5.6f, 3.2f, 301 * scale, 203 * scale };
+            check_frame("minified, mips", f, 150, 100, 2);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // the detail is drawn over the image with its own pixels
+
+    void test_detail()
+    {
+        random_image src(37, 23, 3);
+        random_image detail(60, 50, 4);
+
+        frame_t f = make_frame(src.img, { 10.3f, 7.7f, 37 * 3.0f, 23 * 3.0f });
+        f.draw_detail = true;
+        f.detail = detail.img;
+        f.detail_rect = { 30.13f, 20.41f, 81.7f, 64.3f };
+        check_frame("detail", f, 150, 100, 1);
+
+        f.texture_transform = make_matrix(rotate_90);
+        check_frame("detail, rotated", f, 150, 100, 1);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // no pixels yet is just the checkerboard, no image at all is just the border
+
+    void test_no_image()
+    {
+        frame_t f = make_frame({}, { 10.3f, 7.7f, 100.0f, 60.0f });
+        check_frame("no pixels", f, 150, 100, 0);
+
+        f.draw_image = false;
+        check_frame("no image", f, 150, 100, 0);
+
+        // degenerate targets
+
+        CHECK(software_renderer::render(f, { null, 10, 10, 40 }, app::thread_pool) == E_INVALIDARG);
+
+        byte pixel[4];
+        CHECK(software_renderer::render(f, { pixel, 2, 1, 4 }, app::thread_pool) == E_INVALIDARG);
+        CHECK(software_renderer::render(f, { pixel, 0, 0, 0 }, app::thread_pool) == S_OK);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // frames per second for a 4K window with a big photo in it, just reported
+
+    void benchmark_4k()
+    {
+        uint constexpr width = 3840;
+        uint constexpr height = 2160;
+
+        random_image src(6000, 4000, 5);
+
+        frame_t f = make_frame(src.img, { 0, 0, 3240, 2160 });
+
+        std::vector<byte> mip_pixels;
+        CHECK(SUCCEEDED(mip_chain::build(src.img, mip_pixels, f.mips)));
+
+        std::vector<byte> out(static_cast<size_t>(width) * height * 4);
+        software_renderer::target_t target{ out.data(), width, height, width * 4 };
+
+        int constexpr frames = 20;
+
+        auto start = std::chrono::steady_clock::now();
+
+        for(int i = 0; i < frames; ++i) {
+            software_renderer::render(f, target, app::thread_pool);
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        printf("4K frame: %.2fms (%.1f fps) on %d workers\n",
+               elapsed.count() * 1000.0 / frames,
+               frames / elapsed.count(),
+               app::thread_pool.worker_count());
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    CHECK(SUCCEEDED(app::thread_pool.init(std::max(1u, std::thread::hardware_concurrency()))));
+
+    test_magnified();
+    test_minified();
+    test_detail();
+    test_no_image();
+    benchmark_4k();
+
+    app::thread_pool.cleanup();
+
+    return imageview::test::result("software_renderer_test");
+}
@@ -0,0 +1,312 @@
+//////////////////////////////////////////////////////////////////////
+// natural_sort_key orders names the way StrCmpLogicalW does (as far as file.h says it does)
+// and how long keying and sorting a million names takes
+
+#include "pch.h"
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    //////////////////////////////////////////////////////////////////////
+    // sort by key then exact name, like file_less does
+
+    bool key_less(std::wstring const &a, std::wstring const &b)
+    {
+        int diff = file::natural_sort_key(a).compare(file::natural_sort_key(b));
+        if(diff == 0) {
+            diff = a.compare(b);
+        }
+        return diff < 0;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // each list is in the order Explorer shows it, sorting a shuffled copy has to put it back
+
+    void check_order(std::vector<std::wstring> const &expected, std::mt19937 &rng)
+    {
+        for(size_t i = 1; i < expected.size(); ++i) {
+            if(!key_less(expected[i - 1], expected[i])) {
+                fprintf(stderr, "'%ls' should sort before '%ls'\n", expected[i - 1].c_str(), expected[i].c_str());
+                CHECK(false);
+            }
+        }
+
+        std::vector<std::wstring> names(expected);
+        std::shuffle(names.begin(), names.end(), rng);
+        std::sort(names.begin(), names.end(), key_less);
+        CHECK(names == expected);
+    }
+
+    void test_order()
+    {
+        std::mt19937 rng(1);
+
+        // digit runs by value, however long they are
+
+        check_order({ L"img.jpg",
+                      L"img0.jpg",
+                      L"img1.jpg",
+                      L"img2.jpg",
+                      L"img9.jpg",
+                      L"img10.jpg",
+                      L"img99.jpg",
+                      L"img100.jpg",
+                      L"img18446744073709551615.jpg",
+                      L"img18446744073709551616.jpg",
+                      L"img100000000000000000000000.jpg",
+                      L"imga.jpg" },
+                    rng);
+
+        // several numbers in one name, each compared by value
+
+        check_order({ L"2023-1-2.png", L"2023-1-10.png", L"2023-2-1.png", L"2023-10-1.png", L"2024-1-1.png" }, rng);
+
+        check_order({ L"v1.2.jpg", L"v1.10.jpg", L"v2.1.jpg", L"v10.jpg" }, rng);
+
+        // punctuation and spaces before numbers, numbers before letters
+
+        check_order({ L"photo (1).jpg",
+                      L"photo (2).jpg",
+                      L"photo (10).jpg",
+                      L"photo.jpg",
+                      L"photo_1.jpg",
+                      L"photo1.jpg",
+                      L"photo2.jpg",
+                      L"photoa.jpg" },
+                    rng);
+
+        check_order({ L"a b", L"a!b", L"a.b", L"a_b", L"a~b", L"a0", L"a1", L"ab" }, rng);
+
+        // numbers at the start
+
+        check_order({ L"1.jpg", L"2.jpg", L"10.jpg", L"a.jpg" }, rng);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // case and leading zeros don't change the key, the exact name breaks the tie
+
+    void test_equal_keys()
+    {
+        CHECK(file::natural_sort_key(L"IMG_0001.JPG") == file::natural_sort_key(L"img_0001.jpg"));
+        CHECK(file::natural_sort_key(L"img_0001.jpg") == file::natural_sort_key(L"img_1.jpg"));
+        CHECK(file::natural_sort_key(L"img_000.jpg") == file::natural_sort_key(L"img_0.jpg"));
+        CHECK(file::natural_sort_key(L"Photo") == file::natural_sort_key(L"pHOTO"));
+
+        // "0" is still a number, it's not dropped
+
+        CHECK(file::natural_sort_key(L"a0") != file::natural_sort_key(L"a"));
+        CHECK(key_less(L"a", L"a0"));
+
+        // equal keys sort by name so the order is always the same
+
+        CHECK(key_less(L"IMG_1.jpg", L"img_1.jpg"));
+        CHECK(key_less(L"img_001.jpg", L"img_1.jpg"));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // the key is ordered by a plain compare, so the same compare done token by token on the
+    // names (without making keys) has to agree with it for any names
+
+    struct token_t
+    {
+        bool number;
+        wchar c;               // if it's not a number
+        std::wstring digits;   // if it is, without leading zeros
+    };
+
+    std::vector<token_t> tokens(std::wstring const &name)
+    {
+        std::vector<token_t> t;
+
+        for(size_t i = 0; i < name.size();) {
+
+            wchar c = static_cast<wchar>(std::towlower(name[i]));
+
+            if(c < L'0' || c > L'9') {
+                t.push_back({ false, c, {} });
+                i += 1;
+                continue;
+            }
+
+            size_t end = i;
+            while(end < name.size() && name[end] >= L'0' && name[end] <= L'9') {
+                end += 1;
+            }
+
+            size_t start = i;
+            while(start < end - 1 && name[start] == L'0') {
+                start += 1;
+            }
+
+            t.push_back({ true, 0, name.substr(start, end - start) });
+            i = end;
+        }
+        return t;
+    }
+
+    // punctuation, then numbers, then everything else
+
+    int rank(token_t const &t)
+    {
+        if(t.number) {
+            return 1;
+        }
+        bool punctuation = (t.c >= L' ' && t.c < L'0') || (t.c > L'9' && t.c < L'A') ||
+                           (t.c > L'Z' && t.c < L'a') || (t.c > L'z' && t.c < 128);
+        return punctuation ? 0 : 2;
+    }
+
+    int compare_tokens(std::wstring const &a, std::wstring const &b)
+    {
+        std::vector<token_t> ta = tokens(a);
+        std::vector<token_t> tb = tokens(b);
+
+        for(size_t i = 0; i < ta.size() && i < tb.size(); ++i) {
+
+            token_t const &x = ta[i];
+            token_t const &y = tb[i];
+
+            if(rank(x) != rank(y)) {
+                return rank(x) - rank(y);
+            }
+
+            if(x.number) {
+                if(x.digits.size() != y.digits.size()) {
+                    return x.digits.size() < y.digits.size() ? -1 : 1;
+                }
+                if(int d = x.digits.compare(y.digits); d != 0) {
+                    return d;
+                }
+            } else if(x.c != y.c) {
+                return x.c < y.c ? -1 : 1;
+            }
+        }
+        return static_cast<int>(ta.size()) - static_cast<int>(tb.size());
+    }
+
+    int sign(int x)
+    {
+        return (x > 0) - (x < 0);
+    }
+
+    void test_against_tokens()
+    {
+        std::mt19937 rng(2);
+
+        // mostly digits so there are lots of runs, some letters, both cases and punctuation
+
+        wchar const alphabet[] = L"0000123456789aAbBzZ _-.()[]~!";
+        size_t const alphabet_size = std::size(alphabet) - 1;
+
+        std::vector<std::wstring> names(3000);
+        for(auto &name : names) {
+            size_t length = 1 + rng() % 10;
+            for(size_t i = 0; i < length; ++i) {
+                name += alphabet[rng() % alphabet_size];
+            }
+        }
+
+        int mismatches = 0;
+
+        for(size_t i = 0; i + 1 < names.size(); ++i) {
+            for(size_t j : { i + 1, static_cast<size_t>(rng() % names.size()) }) {
+
+                std::wstring const &a = names[i];
+                std::wstring const &b = names[j];
+
+                int by_key = sign(file::natural_sort_key(a).compare(file::natural_sort_key(b)));
+                int by_tokens = sign(compare_tokens(a, b));
+
+                if(by_key != by_tokens && mismatches++ < 5) {
+                    fprintf(stderr, "'%ls' vs '%ls': key %d, tokens %d\n", a.c_str(), b.c_str(), by_key, by_tokens);
+                }
+            }
+        }
+        CHECK(mismatches == 0);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // a million names the sort of thing cameras and phones make, keyed (that's done when
+    // the info is made) then sorted on the pool, and std::sort on one thread for comparison
+
+    void benchmark_sort()
+    {
+        int constexpr num_names = 1000000;
+
+        std::mt19937 rng(3);
+
+        wchar const *patterns[] = { L"IMG_%04u.JPG", L"DSC%05u.jpg", L"Screenshot %u-%02u.png", L"photo (%u).jpg" };
+
+        std::vector<std::wstring> names(num_names);
+        for(auto &name : names) {
+            wchar buffer[64];
+            swprintf(buffer, 64, patterns[rng() % 4], rng() % 100000, rng() % 60);
+            name = buffer;
+        }
+
+        using clock = std::chrono::steady_clock;
+        using ms = std::chrono::duration<double, std::milli>;
+
+        auto start = clock::now();
+
+        std::vector<file::info> files;
+        files.reserve(num_names);
+        for(uint64 i = 0; i < num_names; ++i) {
+            files.emplace_back(names[i], 0, 0, i);
+        }
+
+        double key_ms = ms(clock::now() - start).count();
+
+        std::vector<file::info> single(files);
+
+        start = clock::now();
+
+        file::sort_files(files, file::scan_folder_sort_field::name, file::scan_folder_sort_order::ascending);
+
+        double sort_ms = ms(clock::now() - start).count();
+
+        start = clock::now();
+
+        std::sort(single.begin(), single.end(), [](file::info const &a, file::info const &b) {
+            int diff = a.sort_key.compare(b.sort_key);
+            return diff < 0 || (diff == 0 && a.name < b.name);
+        });
+
+        double single_ms = ms(clock::now() - start).count();
+
+        // some names come up more than once so compare names, not which file went where
+
+        bool same = true;
+        for(int i = 0; i < num_names; ++i) {
+            same &= files[i].name == single[i].name;
+        }
+        CHECK(same);
+
+        printf("%d names: keys %.1fms, sort_files %.1fms on %d workers, std::sort %.1fms\n",
+               num_names,
+               key_ms,
+               sort_ms,
+               app::thread_pool.worker_count(),
+               single_ms);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    CHECK(SUCCEEDED(app::thread_pool.init(std::max(1u, std::thread::hardware_concurrency()))));
+
+    test_order();
+    test_equal_keys();
+    test_against_tokens();
+    benchmark_sort();
+
+    app::thread_pool.cleanup();
+
+    return imageview::test::result("sort_key_test");
+}
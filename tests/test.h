@@ -0,0 +1,28 @@
+//////////////////////////////////////////////////////////////////////
+// each test is its own program, CHECK counts failures and result()
+// is what main returns
+
+#pragma once
+
+//////////////////////////////////////////////////////////////////////
+
+namespace imageview::test
+{
+    inline int failures = 0;
+
+    inline void check(bool ok, char const *what, char const *file, int line)
+    {
+        if(!ok) {
+            failures += 1;
+            fprintf(stderr, "%s(%d): CHECK(%s) failed\n", file, line, what);
+        }
+    }
+
+    inline int result(char const *name)
+    {
+        printf("%s: %s\n", name, failures == 0 ? "passed" : "FAILED");
+        return failures == 0 ? 0 : 1;
+    }
+}
+
+#define CHECK(x) imageview::test::check((x), #x, __FILE__, __LINE__)
@@ -0,0 +1,366 @@
+//////////////////////////////////////////////////////////////////////
+// stress tests for thread_pool_t
+
+#include "pch.h"
+#include "test.h"
+
+//////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    using namespace imageview;
+
+    using namespace std::chrono_literals;
+
+    //////////////////////////////////////////////////////////////////////
+    // spin until done() or give up after a while, a deadlock shows up as a timeout
+
+    bool wait_for(std::function<bool()> const &done, std::chrono::seconds timeout = 30s)
+    {
+        auto give_up = std::chrono::steady_clock::now() + timeout;
+
+        while(!done()) {
+            if(std::chrono::steady_clock::now() > give_up) {
+                return false;
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+        return true;
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // lots of jobs from lots of threads at once, they should all run exactly once
+
+    void test_many_producers()
+    {
+        thread_pool_t pool;
+        CHECK(SUCCEEDED(pool.init(4)));
+
+        int constexpr num_producers = 8;
+        int constexpr jobs_each = 10000;
+
+        std::atomic<int> ran{ 0 };
+        std::atomic<int> refused{ 0 };
+
+        std::vector<std::thread> producers;
+
+        for(int i = 0; i < num_producers; ++i) {
+            producers.emplace_back([&]() {
+                for(int j = 0; j < jobs_each; ++j) {
+                    if(FAILED(pool.add_job([&]() { ran += 1; }))) {
+                        refused += 1;
+                    }
+                }
+            });
+        }
+
+        for(auto &p : producers) {
+            p.join();
+        }
+
+        CHECK(refused == 0);
+        CHECK(wait_for([&]() { return ran == num_producers * jobs_each; }));
+
+        pool.cleanup();
+
+        CHECK(ran == num_producers * jobs_each);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // cleanup waits for running jobs, drops the queued ones (and what they captured)
+    // and refuses new ones
+
+    void test_cleanup_with_queued_jobs()
+    {
+        thread_pool_t pool;
+        CHECK(SUCCEEDED(pool.init(2)));
+
+        // block both workers
+
+        std::atomic<int> blocked{ 0 };
+        std::atomic<bool> release{ false };
+        std::atomic<int> finished{ 0 };
+
+        for(int i = 0; i < 2; ++i) {
+            pool.add_job([&]() {
+                blocked += 1;
+                while(!release) {
+                    std::this_thread::sleep_for(1ms);
+                }
+                finished += 1;
+            });
+        }
+
+        CHECK(wait_for([&]() { return blocked == 2; }));
+
+        // then queue some which can't start
+
+        auto token = std::make_shared<int>(0);
+        std::atomic<int> ran{ 0 };
+
+        for(int i = 0; i < 1000; ++i) {
+            pool.add_job([&ran, token]() { ran += 1; });
+        }
+
+        CHECK(token.use_count() == 1001);
+
+        std::thread releaser([&]() {
+            std::this_thread::sleep_for(50ms);
+            release = true;
+        });
+
+        pool.cleanup();
+
+        releaser.join();
+
+        CHECK(finished == 2);
+        CHECK(ran == 0);
+        CHECK(token.use_count() == 1);
+        CHECK(pool.worker_count() == 0);
+        CHECK(pool.add_job([]() {}) == E_ABORT);
+
+        // and it can be started again
+
+        CHECK(SUCCEEDED(pool.init(2)));
+        CHECK(SUCCEEDED(pool.add_job([&ran]() { ran += 1; })));
+        CHECK(wait_for([&]() { return ran == 1; }));
+        pool.cleanup();
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // other threads adding jobs and doing parallel_fors while cleanup runs
+    // once add_job refuses a job the pool is stopping, parallel_for still does all of it
+
+    void test_add_job_during_cleanup()
+    {
+        for(int round = 0; round < 20; ++round) {
+
+            thread_pool_t pool;
+            CHECK(SUCCEEDED(pool.init(4)));
+
+            std::atomic<bool> stop{ false };
+            std::atomic<int> missed{ 0 };
+
+            std::vector<std::thread> producers;
+
+            for(int i = 0; i < 4; ++i) {
+                producers.emplace_back([&, i]() {
+                    while(!stop) {
+                        if(i & 1) {
+                            std::atomic<int> hits{ 0 };
+                            pool.parallel_for(64, 4, [&](int from, int to) { hits += to - from; });
+                            missed += hits != 64;
+                        } else {
+                            pool.add_job([]() {});
+                        }
+                    }
+                });
+            }
+
+            std::this_thread::sleep_for(2ms);
+
+            pool.cleanup();
+
+            stop = true;
+
+            for(auto &p : producers) {
+                p.join();
+            }
+
+            CHECK(missed == 0);
+            CHECK(pool.add_job([]() {}) == E_ABORT);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // jobs added from inside a job all go on that worker's deque, the idle ones should steal them
+
+    void test_stealing()
+    {
+        thread_pool_t pool;
+        CHECK(SUCCEEDED(pool.init(4)));
+
+        int constexpr num_jobs = 64;
+
+        std::mutex threads_mutex;
+        std::set<std::thread::id> threads;
+        std::atomic<int> ran{ 0 };
+
+        pool.add_job([&]() {
+            for(int i = 0; i < num_jobs; ++i) {
+                pool.add_job([&]() {
+                    std::this_thread::sleep_for(2ms);
+                    {
+                        std::lock_guard lock(threads_mutex);
+                        threads.insert(std::this_thread::get_id());
+                    }
+                    ran += 1;
+                });
+            }
+        });
+
+        CHECK(wait_for([&]() { return ran == num_jobs; }));
+
+        pool.cleanup();
+
+        CHECK(threads.size() > 1);
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // every index once, whatever the count and grain
+
+    void test_parallel_for_coverage()
+    {
+        thread_pool_t pool;
+        CHECK(SUCCEEDED(pool.init(4)));
+
+        int const counts[] = { 0, 1, 7, 64, 1000, 1001 };
+        int const grains[] = { -1, 0, 1, 3, 64, 5000 };
+
+        for(int count : counts) {
+            for(int grain : grains) {
+
+                std::vector<std::atomic<int>> hits(count);
+
+                pool.parallel_for(count, grain, [&](int from, int to) {
+                    CHECK(from < to);
+                    for(int i = from; i < to; ++i) {
+                        hits[i] += 1;
+                    }
+                });
+
+                CHECK(std::all_of(hits.begin(), hits.end(), [](auto const &h) { return h == 1; }));
+            }
+        }
+
+        pool.cleanup();
+
+        // with no workers the caller does it all
+
+        std::vector<int> hits(100);
+        pool.parallel_for(100, 10, [&](int from, int to) {
+            for(int i = from; i < to; ++i) {
+                hits[i] += 1;
+            }
+        });
+        CHECK(std::all_of(hits.begin(), hits.end(), [](int h) { return h == 1; }));
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // more jobs than workers, each doing a parallel_for with another one inside it
+    // the workers are all busy waiting on their own chunks so it only finishes if
+    // the callers do the chunks no helper picked up
+
+    void test_nested_parallel_for()
+    {
+        thread_pool_t pool;
+        CHECK(SUCCEEDED(pool.init(4)));
+
+        int constexpr num_jobs = 16;
+        int constexpr outer = 64;
+        int constexpr inner = 256;
+
+        std::vector<std::vector<std::atomic<int>>> hits(num_jobs);
+        for(auto &h : hits) {
+            h = std::vector<std::atomic<int>>(outer * inner);
+        }
+
+        std::atomic<int> done{ 0 };
+
+        for(int j = 0; j < num_jobs; ++j) {
+            pool.add_job([&, j]() {
+                pool.parallel_for(outer, 4, [&](int o0, int o1) {
+                    for(int o = o0; o < o1; ++o) {
+                        pool.parallel_for(inner, 16, [&](int i0, int i1) {
+                            for(int i = i0; i < i1; ++i) {
+                                hits[j][o * inner + i] += 1;
+                            }
+                        });
+                    }
+                });
+                done += 1;
+            });
+        }
+
+        if(!wait_for([&]() { return done == num_jobs; })) {
+
+            // deadlocked, cleanup would hang too
+
+            fprintf(stderr, "nested parallel_for didn't finish\n");
+            std::_Exit(1);
+        }
+
+        pool.cleanup();
+
+        for(auto const &h : hits) {
+            CHECK(std::all_of(h.begin(), h.end(), [](auto const &x) { return x == 1; }));
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////
+    // time the same parallel_for with no workers (the caller does it all) then
+    // 2 up to one per hardware thread, it's all arithmetic so it should scale
+
+    void benchmark_parallel_for()
+    {
+        int constexpr count = 1 << 24;
+        int constexpr grain = 1 << 14;
+
+        std::vector<double> sums(count / grain);
+
+        auto run = [&](thread_pool_t &pool) {
+
+            auto start = std::chrono::steady_clock::now();
+
+            pool.parallel_for(count, grain, [&](int from, int to) {
+                double sum = 0;
+                for(int i = from; i < to; ++i) {
+                    sum += std::sqrt(static_cast<double>(i)) * std::sin(i * 0.001);
+                }
+                sums[from / grain] = sum;
+            });
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            return elapsed.count() * 1000.0;
+        };
+
+        thread_pool_t pool;
+
+        double one = run(pool);
+
+        printf("parallel_for: caller only %.2fms\n", one);
+
+        int max_workers = std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+
+        for(int workers = 2; workers <= max_workers; workers += (workers < 8) ? 1 : 4) {
+
+            CHECK(SUCCEEDED(pool.init(workers)));
+
+            // best of a few, the first one wakes everything up
+
+            double best = run(pool);
+            for(int i = 0; i < 4; ++i) {
+                best = std::min(best, run(pool));
+            }
+
+            pool.cleanup();
+
+            printf("parallel_for: %d workers %.2fms (%.2fx)\n", workers, best, one / best);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    test_many_producers();
+    test_cleanup_with_queued_jobs();
+    test_add_job_during_cleanup();
+    test_stealing();
+    test_parallel_for_coverage();
+    test_nested_parallel_for();
+    benchmark_parallel_for();
+
+    return imageview::test::result("thread_pool_test");
+}